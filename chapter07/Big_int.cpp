@@ -0,0 +1,767 @@
+#include<algorithm>
+#include<climits>
+#include<stdexcept>
+#include<vector>
+#include "Big_int.h"
+
+namespace Big_lib {
+
+int karatsuba_threshold = 40;
+
+// -----------------------------------------------------------------------
+
+// operations on limb arrays, least significant limb first
+
+typedef std::uint64_t Wide;     // holds a product of two Limbs plus two Limbs
+
+// r[0:na) = a[0:na)+b[0:nb), na >= nb; return the carry
+// r may be a or b
+Limb add(Limb* r, const Limb* a, int na, const Limb* b, int nb)
+{
+    Wide c = 0;
+    for (int i = 0; i<nb; ++i) {
+        c += Wide(a[i])+b[i];
+        r[i] = Limb(c);
+        c >>= 32;
+    }
+    for (int i = nb; i<na; ++i) {
+        c += a[i];
+        r[i] = Limb(c);
+        c >>= 32;
+    }
+    return Limb(c);
+}
+
+// -----------------------------------------------------------------------
+
+// r[0:na) = a[0:na)-b[0:nb), na >= nb; return the borrow
+// r may be a or b
+Limb sub(Limb* r, const Limb* a, int na, const Limb* b, int nb)
+{
+    Limb borrow = 0;
+    for (int i = 0; i<na; ++i) {
+        const Wide t = Wide(a[i])-(i<nb ? b[i] : 0)-borrow;
+        r[i] = Limb(t);
+        borrow = Limb(t>>63);   // the subtraction wrapped around
+    }
+    return borrow;
+}
+
+// -----------------------------------------------------------------------
+
+// compare a[0:na) and b[0:nb), neither with leading zero limbs
+int cmp(const Limb* a, int na, const Limb* b, int nb)
+{
+    if (na != nb) return na<nb ? -1 : 1;
+    for (int i = na-1; i>=0; --i)
+        if (a[i] != b[i]) return a[i]<b[i] ? -1 : 1;
+    return 0;
+}
+
+// -----------------------------------------------------------------------
+
+// r[0:na+nb) = a[0:na)*b[0:nb); r must not overlap a or b
+void mul_basecase(Limb* r, const Limb* a, int na, const Limb* b, int nb)
+{
+    std::fill(r,r+nb,0);
+    for (int i = 0; i<na; ++i) {
+        const Wide ai = a[i];
+        Wide c = 0;
+        for (int j = 0; j<nb; ++j) {
+            c += ai*b[j]+r[i+j];
+            r[i+j] = Limb(c);
+            c >>= 32;
+        }
+        r[i+nb] = Limb(c);
+    }
+}
+
+// -----------------------------------------------------------------------
+
+inline int karatsuba_min() { return std::max(karatsuba_threshold,8); }
+
+// the scratch space karatsuba() needs for n limbs
+int karatsuba_scratch(int n)
+{
+    int s = 0;
+    while (n >= karatsuba_min()) {
+        const int m = n-n/2;
+        s += 4*(m+1);
+        n = m+1;
+    }
+    return s;
+}
+
+// -----------------------------------------------------------------------
+
+// r[0:2n) = a[0:n)*b[0:n), with t as scratch space
+// with a = a1*B^h+a0 and b = b1*B^h+b0 (B = 2^32):
+// a*b = a1*b1*B^2h + ((a0+a1)*(b0+b1)-a0*b0-a1*b1)*B^h + a0*b0
+void karatsuba(Limb* r, const Limb* a, const Limb* b, int n, Limb* t)
+{
+    if (n < karatsuba_min()) {
+        mul_basecase(r,a,n,b,n);
+        return;
+    }
+    const int h = n/2;
+    const int m = n-h;          // the limbs of a1 and b1, m >= h
+    Limb* sa = t;               // a0+a1
+    Limb* sb = t+m+1;           // b0+b1
+    Limb* z1 = t+2*(m+1);       // their product
+    Limb* rest = t+4*(m+1);
+
+    sa[m] = add(sa,a+h,m,a,h);
+    sb[m] = add(sb,b+h,m,b,h);
+    karatsuba(z1,sa,sb,m+1,rest);
+    karatsuba(r,a,b,h,rest);            // a0*b0
+    karatsuba(r+2*h,a+h,b+h,m,rest);    // a1*b1
+    sub(z1,z1,2*(m+1),r,2*h);
+    sub(z1,z1,2*(m+1),r+2*h,2*m);
+    add(r+h,r+h,2*n-h,z1,std::min(2*(m+1),2*n-h));  // the rest of z1 is 0
+}
+
+// -----------------------------------------------------------------------
+
+// r[0:na+nb) = a[0:na)*b[0:nb), na >= nb > 0; r must not overlap a or b
+// unbalanced operands are multiplied as na/nb balanced products
+void mul(Limb* r, const Limb* a, int na, const Limb* b, int nb)
+{
+    if (nb < karatsuba_min()) {
+        mul_basecase(r,a,na,b,nb);
+        return;
+    }
+    std::vector<Limb> t(2*nb+karatsuba_scratch(nb));
+    if (na == nb) {
+        karatsuba(r,a,b,nb,&t[0]);
+        return;
+    }
+    Limb* prod = &t[0];
+    std::fill(r,r+na+nb,0);
+    for (int off = 0; off<na; off += nb) {
+        const int len = std::min(nb,na-off);
+        if (len == nb) karatsuba(prod,a+off,b,nb,prod+2*nb);
+        else mul(prod,b,nb,a+off,len);
+        add(r+off,r+off,na+nb-off,prod,len+nb);
+    }
+}
+
+// -----------------------------------------------------------------------
+
+int leading_zeros(Limb x)   // x != 0
+{
+    int s = 0;
+    for (; !(x&0x80000000u); x <<= 1) ++s;
+    return s;
+}
+
+// -----------------------------------------------------------------------
+
+// q[0:na-nb+1) = a/b, r[0:nb) = a%b, for na >= nb >= 2 (Knuth's algorithm D)
+void divide_knuth(const Limb* a, int na, const Limb* b, int nb, Limb* q, Limb* r)
+{
+    // shift b left until its top bit is set, and a as much:
+    const int s = leading_zeros(b[nb-1]);
+    std::vector<Limb> u(na+1), v(nb);
+    for (int i = nb-1; i>0; --i) v[i] = (b[i]<<s) | (s ? b[i-1]>>(32-s) : 0);
+    v[0] = b[0]<<s;
+    u[na] = s ? a[na-1]>>(32-s) : 0;
+    for (int i = na-1; i>0; --i) u[i] = (a[i]<<s) | (s ? a[i-1]>>(32-s) : 0);
+    u[0] = a[0]<<s;
+
+    const Wide base = Wide(1)<<32;
+    for (int j = na-nb; j>=0; --j) {
+        // estimate the quotient limb from the top two limbs, off by at most 2:
+        const Wide num = (Wide(u[j+nb])<<32) | u[j+nb-1];
+        Wide qhat = num/v[nb-1];
+        Wide rhat = num%v[nb-1];
+        while (qhat>=base || qhat*v[nb-2] > ((rhat<<32) | u[j+nb-2])) {
+            --qhat;
+            rhat += v[nb-1];
+            if (rhat >= base) break;
+        }
+
+        // u[j:j+nb] -= qhat*v:
+        std::int64_t k = 0;
+        std::int64_t t;
+        for (int i = 0; i<nb; ++i) {
+            const Wide p = qhat*v[i];
+            t = std::int64_t(u[i+j])-k-std::int64_t(p&0xffffffff);
+            u[i+j] = Limb(t);
+            k = std::int64_t(p>>32)-(t>>32);
+        }
+        t = std::int64_t(u[j+nb])-k;
+        u[j+nb] = Limb(t);
+
+        q[j] = Limb(qhat);
+        if (t < 0) {    // qhat was one too large: add v back
+            --q[j];
+            Wide c = 0;
+            for (int i = 0; i<nb; ++i) {
+                c += Wide(u[i+j])+v[i];
+                u[i+j] = Limb(c);
+                c >>= 32;
+            }
+            u[j+nb] += Limb(c);
+        }
+    }
+
+    for (int i = 0; i<nb; ++i) r[i] = (u[i]>>s) | (s ? u[i+1]<<(32-s) : 0);
+}
+
+// -----------------------------------------------------------------------
+
+Big_int::Big_int(long long v)
+    :d(small), n(0), cap(small_limbs), neg(v<0)
+{
+    const unsigned long long u = neg ? 0ULL-(unsigned long long)v : v;
+    small[0] = Limb(u);
+    small[1] = Limb(u>>32);
+    n = small[1] ? 2 : small[0] ? 1 : 0;
+}
+
+// -----------------------------------------------------------------------
+
+Big_int::Big_int(const Big_int& x)
+    :d(small), n(0), cap(small_limbs), neg(x.neg)
+{
+    reserve(x.n);
+    std::copy(x.d,x.d+x.n,d);
+    n = x.n;
+}
+
+// -----------------------------------------------------------------------
+
+Big_int::Big_int(Big_int&& x)
+    :d(small), n(x.n), cap(small_limbs), neg(x.neg)
+{
+    if (x.d == x.small) std::copy(x.d,x.d+x.n,d);
+    else {
+        d = x.d;
+        cap = x.cap;
+        x.d = x.small;
+        x.cap = small_limbs;
+    }
+    x.n = 0;
+    x.neg = false;
+}
+
+// -----------------------------------------------------------------------
+
+Big_int& Big_int::operator=(const Big_int& x)
+{
+    if (this == &x) return *this;
+    n = 0;
+    reserve(x.n);
+    std::copy(x.d,x.d+x.n,d);
+    n = x.n;
+    neg = x.neg;
+    return *this;
+}
+
+// -----------------------------------------------------------------------
+
+Big_int& Big_int::operator=(Big_int&& x)
+{
+    if (this == &x) return *this;
+    if (x.d == x.small) std::copy(x.d,x.d+x.n,d);    // cap >= small_limbs
+    else {
+        if (d != small) delete[] d;
+        d = x.d;
+        cap = x.cap;
+        x.d = x.small;
+        x.cap = small_limbs;
+    }
+    n = x.n;
+    neg = x.neg;
+    x.n = 0;
+    x.neg = false;
+    return *this;
+}
+
+// -----------------------------------------------------------------------
+
+void Big_int::reserve(int c)
+{
+    if (c <= cap) return;
+    const int newcap = std::max(c,2*cap);
+    Limb* p = new Limb[newcap];
+    std::copy(d,d+n,p);
+    if (d != small) delete[] d;
+    d = p;
+    cap = newcap;
+}
+
+// -----------------------------------------------------------------------
+
+void Big_int::trim()
+{
+    while (n>0 && d[n-1]==0) --n;
+    if (n == 0) neg = false;
+}
+
+// -----------------------------------------------------------------------
+
+int Big_int::bits() const
+{
+    return n==0 ? 0 : 32*n-leading_zeros(d[n-1]);
+}
+
+// -----------------------------------------------------------------------
+
+bool Big_int::fits_int() const
+{
+    if (n == 0) return true;
+    if (n > 1) return false;
+    return d[0]<=Limb(INT_MAX) || (neg && d[0]==Limb(INT_MAX)+1);
+}
+
+// -----------------------------------------------------------------------
+
+int Big_int::to_int() const
+{
+    if (!fits_int()) throw std::overflow_error("Big_int: too large for an int");
+    if (n == 0) return 0;
+    return neg ? int(-(long long)d[0]) : int(d[0]);
+}
+
+// -----------------------------------------------------------------------
+
+void Big_int::add_magnitude(const Big_int& x)
+{
+    const int m = std::max(n,x.n);
+    reserve(m+1);
+    const Limb c = n>=x.n ? add(d,d,n,x.d,x.n) : add(d,x.d,x.n,d,n);
+    d[m] = c;
+    n = m+1;
+    trim();
+}
+
+// -----------------------------------------------------------------------
+
+void Big_int::sub_magnitude(const Big_int& x)
+{
+    if (cmp(d,n,x.d,x.n) >= 0) sub(d,d,n,x.d,x.n);
+    else {
+        reserve(x.n);
+        sub(d,x.d,x.n,d,n);
+        n = x.n;
+        neg = !neg;
+    }
+    trim();
+}
+
+// -----------------------------------------------------------------------
+
+Big_int& Big_int::operator+=(const Big_int& x)
+{
+    if (neg == x.neg) add_magnitude(x);
+    else sub_magnitude(x);
+    return *this;
+}
+
+// -----------------------------------------------------------------------
+
+Big_int& Big_int::operator-=(const Big_int& x)
+{
+    if (neg != x.neg) add_magnitude(x);
+    else sub_magnitude(x);
+    return *this;
+}
+
+// -----------------------------------------------------------------------
+
+Big_int& Big_int::operator*=(const Big_int& x)
+{
+    if (n==0 || x.n==0) {
+        n = 0;
+        neg = false;
+        return *this;
+    }
+    const bool sign = neg!=x.neg;
+    if (n==1 && x.n==1) {   // no allocation for small values
+        const Wide p = Wide(d[0])*x.d[0];
+        d[0] = Limb(p);
+        d[1] = Limb(p>>32);
+        n = 2;
+        neg = sign;
+        trim();
+        return *this;
+    }
+    Big_int r;
+    r.reserve(n+x.n);
+    if (n >= x.n) mul(r.d,d,n,x.d,x.n);
+    else mul(r.d,x.d,x.n,d,n);
+    r.n = n+x.n;
+    r.neg = sign;
+    r.trim();
+    return *this = std::move(r);
+}
+
+// -----------------------------------------------------------------------
+
+Big_int& Big_int::operator/=(const Big_int& x)
+{
+    Big_int r;
+    divide(*this,x,*this,r);
+    return *this;
+}
+
+// -----------------------------------------------------------------------
+
+Big_int& Big_int::operator%=(const Big_int& x)
+{
+    Big_int q;
+    divide(*this,x,q,*this);
+    return *this;
+}
+
+// -----------------------------------------------------------------------
+
+Big_int& Big_int::operator<<=(int bits)
+{
+    if (n==0 || bits<=0) return *this;
+    const int w = bits/32;
+    const int s = bits%32;
+    reserve(n+w+1);
+    d[n+w] = 0;
+    for (int i = n-1; i>=0; --i) {  // from the top, so that no limb is overwritten before it is read
+        if (s) d[i+w+1] |= d[i]>>(32-s);
+        d[i+w] = d[i]<<s;
+    }
+    std::fill(d,d+w,0);
+    n += w+1;
+    trim();
+    return *this;
+}
+
+// -----------------------------------------------------------------------
+
+Big_int& Big_int::operator>>=(int bits)
+{
+    if (bits <= 0) return *this;
+    const int w = bits/32;
+    const int s = bits%32;
+    if (w >= n) {
+        n = 0;
+        neg = false;
+        return *this;
+    }
+    for (int i = 0; i<n-w; ++i)
+        d[i] = s ? (d[i+w]>>s) | (i+w+1<n ? d[i+w+1]<<(32-s) : 0) : d[i+w];
+    n -= w;
+    trim();
+    return *this;
+}
+
+// -----------------------------------------------------------------------
+
+Big_int Big_int::operator-() const
+{
+    Big_int r = *this;
+    if (r.n) r.neg = !r.neg;
+    return r;
+}
+
+// -----------------------------------------------------------------------
+
+void Big_int::multiply_add(Limb m, Limb a)
+{
+    reserve(n+1);
+    Wide c = a;
+    for (int i = 0; i<n; ++i) {
+        c += Wide(d[i])*m;
+        d[i] = Limb(c);
+        c >>= 32;
+    }
+    d[n] = Limb(c);
+    ++n;
+    trim();
+}
+
+// -----------------------------------------------------------------------
+
+Limb Big_int::divide_small(Limb v)
+{
+    if (v == 0) throw std::domain_error("Big_int: divide by zero");
+    Wide rem = 0;
+    for (int i = n-1; i>=0; --i) {
+        const Wide cur = (rem<<32) | d[i];
+        d[i] = Limb(cur/v);
+        rem = cur%v;
+    }
+    trim();
+    return Limb(rem);
+}
+
+// -----------------------------------------------------------------------
+
+int compare_magnitude(const Big_int& a, const Big_int& b)
+{
+    return cmp(a.d,a.n,b.d,b.n);
+}
+
+// -----------------------------------------------------------------------
+
+int compare(const Big_int& a, const Big_int& b)
+{
+    if (a.neg != b.neg) return a.neg ? -1 : 1;
+    const int c = cmp(a.d,a.n,b.d,b.n);
+    return a.neg ? -c : c;
+}
+
+// -----------------------------------------------------------------------
+
+// q and r may be a or b
+void divide(const Big_int& a, const Big_int& b, Big_int& q, Big_int& r)
+{
+    if (b.n == 0) throw std::domain_error("Big_int: divide by zero");
+    Big_int qq;
+    Big_int rr;
+    if (cmp(a.d,a.n,b.d,b.n) < 0) rr = a;
+    else if (b.n == 1) {
+        qq = a;
+        rr = Big_int(qq.divide_small(b.d[0]));
+        qq.neg = a.neg!=b.neg;
+        rr.neg = a.neg;
+    }
+    else {
+        qq.reserve(a.n-b.n+1);
+        rr.reserve(b.n);
+        divide_knuth(a.d,a.n,b.d,b.n,qq.d,rr.d);
+        qq.n = a.n-b.n+1;
+        rr.n = b.n;
+        qq.neg = a.neg!=b.neg;
+        rr.neg = a.neg;
+    }
+    qq.trim();
+    rr.trim();
+    q = std::move(qq);
+    r = std::move(rr);
+}
+
+// -----------------------------------------------------------------------
+
+// decimal conversion
+
+const Limb decimal_base = 1000000000;   // 10^9, the largest power of 10 in a Limb
+const int decimal_limbs = 30;           // numbers up to that size are converted 9 digits at a time
+const int newton_limbs = 32;            // reciprocals up to that size are found by division
+
+// -----------------------------------------------------------------------
+
+// floor(B^2k/m) for B = 2^32 and k = m.size() > 0, by Newton's iteration
+// x' = x*(2-m*x/B^2k), which doubles the correct limbs of x, started from
+// the reciprocal of the top half of m
+Big_int reciprocal(const Big_int& m)
+{
+    const int k = m.size();
+    if (k <= newton_limbs) return (Big_int(1)<<64*k)/m;
+
+    const int h = k/2+4;        // a few limbs more than half, to leave a small error only
+    Big_int x = reciprocal(m>>32*(k-h))<<32*(k-h);
+    Big_int e = m*x;
+    e *= x;
+    e >>= 64*k;
+    x += x;
+    x -= e;
+
+    Big_int r = (Big_int(1)<<64*k)-m*x;  // a few times m, at most
+    while (r.is_negative()) {
+        x -= 1;
+        r += m;
+    }
+    while (compare(r,m) >= 0) {
+        x += 1;
+        r -= m;
+    }
+    return x;
+}
+
+// -----------------------------------------------------------------------
+
+// 10^(9*2^j) and its reciprocal, for decimal conversion
+struct Decimal_power {
+    Big_int p;
+    Big_int mu;     // reciprocal(p), made when first needed
+    Decimal_power(const Big_int& pp) :p(pp) { }
+};
+
+// make sure pw has the powers up to 10^(9*2^j)
+void decimal_powers(std::vector<Decimal_power>& pw, int j)
+{
+    if (pw.empty()) pw.push_back(Decimal_power(Big_int(decimal_base)));
+    while (int(pw.size()) <= j) pw.push_back(Decimal_power(pw.back().p*pw.back().p));
+}
+
+// -----------------------------------------------------------------------
+
+// q = x/p, r = x%p for 0 <= x < p^2 (Barrett's method: no division at all)
+void divide_by_power(const Big_int& x, Decimal_power& p, Big_int& q, Big_int& r)
+{
+    const int k = p.p.size();
+    if (p.mu.is_zero()) p.mu = reciprocal(p.p);
+    q = x>>32*(k-1);
+    q *= p.mu;
+    q >>= 32*(k+1);     // too small by 2 at most
+    r = x-q*p.p;
+    while (compare(r,p.p) >= 0) {
+        r -= p.p;
+        q += 1;
+    }
+}
+
+// -----------------------------------------------------------------------
+
+// append the digits of x >= 0 to s, padded with zeros to width digits
+void to_decimal_small(Big_int x, int width, std::string& s)
+{
+    std::vector<Limb> chunks;   // of 9 digits, least significant first
+    while (!x.is_zero()) chunks.push_back(x.divide_small(decimal_base));
+
+    std::string digits;
+    for (int i = int(chunks.size())-1; i>=0; --i) {
+        char buf[10];
+        int len = 0;
+        for (Limb c = chunks[i]; c; c /= 10) buf[len++] = char('0'+c%10);
+        if (i != int(chunks.size())-1) while (len < 9) buf[len++] = '0';
+        while (len) digits += buf[--len];
+    }
+    if (int(digits.size()) < width) s.append(width-digits.size(),'0');
+    s += digits;
+}
+
+// -----------------------------------------------------------------------
+
+// append the digits of 0 <= x < 10^(9*2^(j+1)) to s, padded to width digits
+void to_decimal(const Big_int& x, int j, int width, std::vector<Decimal_power>& pw, std::string& s)
+{
+    if (j<0 || x.size()<=decimal_limbs) {
+        to_decimal_small(x,width,s);
+        return;
+    }
+    Big_int q;
+    Big_int r;
+    divide_by_power(x,pw[j],q,r);
+    const int low = 9<<j;   // the digits of r
+    if (width==0 && q.is_zero()) to_decimal(r,j-1,0,pw,s);
+    else {
+        to_decimal(q,j-1,width ? width-low : 0,pw,s);
+        to_decimal(r,j-1,low,pw,s);
+    }
+}
+
+// -----------------------------------------------------------------------
+
+std::string Big_int::to_string() const
+{
+    if (n == 0) return "0";
+    std::string s;
+    if (neg) s += '-';
+    Big_int x = *this;
+    x.neg = false;
+
+    std::vector<Decimal_power> pw;
+    int j = -1;
+    if (n > decimal_limbs) {    // find the first 10^(9*2^j) with a square > x
+        j = 0;
+        for (decimal_powers(pw,0); 2*pw[j].p.size()-1 <= n && compare(pw[j].p*pw[j].p,x) <= 0; decimal_powers(pw,++j)) { }
+    }
+    to_decimal(x,j,0,pw,s);
+    return s;
+}
+
+// -----------------------------------------------------------------------
+
+// the value of the digits s[0:len)
+Big_int from_decimal(const char* s, int len, std::vector<Decimal_power>& pw)
+{
+    if (len <= 9*decimal_limbs) {
+        Big_int x;
+        for (int i = 0; i<len; ) {
+            const int chunk = i==0 && len%9 ? len%9 : 9;
+            Limb v = 0;
+            Limb scale = 1;
+            for (int k = 0; k<chunk; ++k) {
+                v = v*10+(s[i+k]-'0');
+                scale *= 10;
+            }
+            x.multiply_add(scale,v);
+            i += chunk;
+        }
+        return x;
+    }
+    int j = 0;
+    while ((9<<(j+1)) < len) ++j;   // 9*2^j < len <= 9*2^(j+1)
+    decimal_powers(pw,j);
+    const int low = 9<<j;
+    Big_int x = from_decimal(s,len-low,pw);
+    x *= pw[j].p;
+    x += from_decimal(s+len-low,low,pw);
+    return x;
+}
+
+// -----------------------------------------------------------------------
+
+Big_int::Big_int(const std::string& s)
+    :d(small), n(0), cap(small_limbs), neg(false)
+{
+    int i = 0;
+    if (i<int(s.size()) && (s[i]=='-' || s[i]=='+')) ++i;
+    if (i == int(s.size())) throw std::invalid_argument("Big_int: no digits in \""+s+'"');
+    for (int k = i; k<int(s.size()); ++k)
+        if (s[k]<'0' || '9'<s[k]) throw std::invalid_argument("Big_int: bad digit in \""+s+'"');
+
+    std::vector<Decimal_power> pw;
+    *this = from_decimal(s.data()+i,int(s.size())-i,pw);
+    neg = s[0]=='-' && n!=0;
+}
+
+// -----------------------------------------------------------------------
+
+Big_int pow(Big_int base, unsigned expo)
+{
+    Big_int r = 1;
+    while (expo) {
+        if (expo & 1) r *= base;
+        expo >>= 1;
+        if (expo) base *= base;
+    }
+    return r;
+}
+
+// -----------------------------------------------------------------------
+
+Big_int isqrt(const Big_int& x)
+{
+    if (x.is_negative()) throw std::domain_error("Big_int: square root of a negative number");
+    if (x.is_zero()) return x;
+    Big_int r = Big_int(1)<<(x.bits()+1)/2;    // >= the root
+    while (true) {  // Newton's iteration, decreasing until it stops
+        Big_int next = (r+x/r)>>1;
+        if (compare(next,r) >= 0) return r;
+        r = std::move(next);
+    }
+}
+
+// -----------------------------------------------------------------------
+
+// lo*(lo+1)*...*(hi-1)
+Big_int product(unsigned lo, unsigned hi)
+{
+    if (hi-lo <= 16) {
+        Big_int r = 1;
+        for (unsigned i = lo; i<hi; ++i) r.multiply_add(i,0);
+        return r;
+    }
+    const unsigned mid = lo+(hi-lo)/2;
+    return product(lo,mid)*product(mid,hi);
+}
+
+// -----------------------------------------------------------------------
+
+Big_int factorial(unsigned n)
+{
+    return product(1,n+1);
+}
+
+} // of namespace Big_lib
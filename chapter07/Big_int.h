@@ -0,0 +1,121 @@
+/*
+    Big_int: integers of any size, for the integer calculator of exercise 11
+
+    An int overflows silently: pow(3,21) or 13! come out as garbage. A
+    Big_int has as many digits as its value needs. It is kept as a sign and
+    32-bit limbs, least significant first; up to two limbs (any int or long
+    long) fit into the Big_int itself, so that ordinary numbers never touch
+    the free store.
+
+    Multiplication is done the schoolbook way below karatsuba_threshold limbs
+    and by Karatsuba's method above it (three half-size products instead of
+    four), which is where large powers and factorials spend their time.
+    Conversion to decimal splits the number by 10^(9*2^j) recursively, each
+    split a multiplication by a reciprocal found by Newton's method, instead
+    of a quadratic number of divisions by 10^9; reading a decimal string
+    does the same in reverse:
+
+        Big_int f = factorial(1000);        // 2568 digits
+        cout << f << '\n';
+        Big_int p = pow(Big_int(3),100000);
+        if (!p.fits_int()) ...
+
+    Division and % truncate, as for int.
+*/
+
+#ifndef BIG_INT_GUARD
+#define BIG_INT_GUARD
+
+#include<cstdint>
+#include<ostream>
+#include<string>
+
+namespace Big_lib {
+
+// -----------------------------------------------------------------------
+
+typedef std::uint32_t Limb;
+
+extern int karatsuba_threshold;     // limbs from which multiplication uses Karatsuba (at least 8)
+
+// -----------------------------------------------------------------------
+
+class Big_int {
+public:
+    Big_int(long long v = 0);
+    explicit Big_int(const std::string& s);     // decimal, with an optional sign; throws std::invalid_argument
+    Big_int(const Big_int& x);
+    Big_int(Big_int&& x);
+    Big_int& operator=(const Big_int& x);
+    Big_int& operator=(Big_int&& x);
+    ~Big_int() { if (d != small) delete[] d; }
+
+    bool is_zero() const { return n == 0; }
+    bool is_negative() const { return neg; }
+    int size() const { return n; }              // the number of limbs
+    int bits() const;                           // the number of bits of the magnitude
+    bool fits_int() const;
+    int to_int() const;                         // throws std::overflow_error unless fits_int()
+    std::string to_string() const;              // decimal
+
+    Big_int& operator+=(const Big_int& x);
+    Big_int& operator-=(const Big_int& x);
+    Big_int& operator*=(const Big_int& x);
+    Big_int& operator/=(const Big_int& x);      // throws std::domain_error for 0
+    Big_int& operator%=(const Big_int& x);
+    Big_int& operator<<=(int bits);             // multiply by 2^bits
+    Big_int& operator>>=(int bits);             // divide the magnitude by 2^bits
+    Big_int operator-() const;
+
+    void multiply_add(Limb m, Limb a);          // |*this| = |*this|*m+a
+    Limb divide_small(Limb v);                  // |*this| /= v, return the remainder
+
+    friend int compare(const Big_int& a, const Big_int& b);     // <0, 0 or >0 for a<b, a==b, a>b
+    friend int compare_magnitude(const Big_int& a, const Big_int& b);
+    friend void divide(const Big_int& a, const Big_int& b, Big_int& q, Big_int& r); // q = a/b, r = a%b
+private:
+    static const int small_limbs = 2;
+    Limb* d;                    // the limbs: small, or on the free store
+    int n;                      // limbs in use, the top one nonzero; 0 for zero
+    int cap;                    // limbs d can hold
+    bool neg;                   // never true for zero
+    Limb small[small_limbs];
+
+    void reserve(int c);        // make room for c limbs, keeping the value
+    void trim();                // drop leading zero limbs
+    void add_magnitude(const Big_int& x);   // |*this| += |x|
+    void sub_magnitude(const Big_int& x);   // |*this| = ||*this|-|x||, changing sign if |x| > |*this|
+};
+
+// -----------------------------------------------------------------------
+
+int compare(const Big_int& a, const Big_int& b);
+int compare_magnitude(const Big_int& a, const Big_int& b);
+void divide(const Big_int& a, const Big_int& b, Big_int& q, Big_int& r);
+
+inline Big_int operator+(Big_int a, const Big_int& b) { a += b; return a; }
+inline Big_int operator-(Big_int a, const Big_int& b) { a -= b; return a; }
+inline Big_int operator*(Big_int a, const Big_int& b) { a *= b; return a; }
+inline Big_int operator/(Big_int a, const Big_int& b) { a /= b; return a; }
+inline Big_int operator%(Big_int a, const Big_int& b) { a %= b; return a; }
+inline Big_int operator<<(Big_int a, int bits) { a <<= bits; return a; }
+inline Big_int operator>>(Big_int a, int bits) { a >>= bits; return a; }
+
+inline bool operator==(const Big_int& a, const Big_int& b) { return compare(a,b) == 0; }
+inline bool operator!=(const Big_int& a, const Big_int& b) { return compare(a,b) != 0; }
+inline bool operator<(const Big_int& a, const Big_int& b) { return compare(a,b) < 0; }
+inline bool operator<=(const Big_int& a, const Big_int& b) { return compare(a,b) <= 0; }
+inline bool operator>(const Big_int& a, const Big_int& b) { return compare(a,b) > 0; }
+inline bool operator>=(const Big_int& a, const Big_int& b) { return compare(a,b) >= 0; }
+
+inline std::ostream& operator<<(std::ostream& os, const Big_int& x) { return os << x.to_string(); }
+
+// -----------------------------------------------------------------------
+
+Big_int pow(Big_int base, unsigned expo);   // by repeated squaring
+Big_int isqrt(const Big_int& x);            // the largest r with r*r <= x; throws std::domain_error for x < 0
+Big_int factorial(unsigned n);              // as a product tree, so that the big multiplications are balanced
+
+} // of namespace Big_lib
+
+#endif // BIG_INT_GUARD
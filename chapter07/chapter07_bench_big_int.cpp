@@ -0,0 +1,108 @@
+// Chapter 07, Big_int benchmark: the things the integer calculator's users
+// type and int cannot hold, large factorials and powers, computed with
+// Karatsuba multiplication and with schoolbook multiplication only, and
+// their conversion to decimal by divide-and-conquer and by repeated division
+// by 10^9. Each pair must give the same result, and reading the decimal
+// string back must give the number again.
+//
+// Usage: chapter07_bench_big_int [n for n!] [e for 3^e]
+//
+// Build with optimisation, e.g.
+// g++ -std=c++11 -O2 chapter07_bench_big_int.cpp Big_int.cpp
+
+#include<chrono>
+#include<cstdlib>
+#include<iomanip>
+#include<iostream>
+#include<string>
+#include "Big_int.h"
+
+using namespace std;
+using namespace Big_lib;
+
+//------------------------------------------------------------------------------
+
+double seconds_since(chrono::steady_clock::time_point t)
+{
+    return chrono::duration<double>(chrono::steady_clock::now()-t).count();
+}
+
+template<class F> double time_it(F f)
+{
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    f();
+    return seconds_since(t);
+}
+
+//------------------------------------------------------------------------------
+
+// n! the way a loop over int would do it: one small factor at a time
+Big_int factorial_loop(unsigned n)
+{
+    Big_int r = 1;
+    for (unsigned i = 2; i<=n; ++i) r.multiply_add(i,0);
+    return r;
+}
+
+// decimal digits by repeated division by 10^9, least significant first
+string to_string_simple(Big_int x)
+{
+    string s;
+    while (!x.is_zero()) {
+        Limb c = x.divide_small(1000000000);
+        for (int i = 0; i<9; ++i, c /= 10) s += char('0'+c%10);
+    }
+    while (s.size()>1 && s[s.size()-1]=='0') s.erase(s.size()-1);
+    return string(s.rbegin(),s.rend());
+}
+
+//------------------------------------------------------------------------------
+
+void report(const string& what, double t_fast, double t_slow, bool same)
+{
+    cout << setw(28) << left << what << right << setw(9) << t_fast << " s  vs " << setw(9) << t_slow
+        << " s  (" << t_slow/t_fast << " times as fast)" << (same ? "" : "   DIFFERENT!") << '\n';
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+try {
+    const unsigned n = argc>1 ? atoi(argv[1]) : 50000;
+    const unsigned e = argc>2 ? atoi(argv[2]) : 500000;
+    const int threshold = karatsuba_threshold;
+    cout << setprecision(4);
+
+    Big_int f1, f2, f3;
+    const double t_tree = time_it([&] { f1 = factorial(n); });
+    const double t_loop = time_it([&] { f2 = factorial_loop(n); });
+    karatsuba_threshold = 1<<30;
+    const double t_school = time_it([&] { f3 = factorial(n); });
+    karatsuba_threshold = threshold;
+    cout << n << "! has " << f1.size() << " limbs\n";
+    report("product tree vs loop:",t_tree,t_loop,f1==f2);
+    report("Karatsuba vs schoolbook:",t_tree,t_school,f1==f3);
+
+    Big_int p1, p2;
+    const double t_pow = time_it([&] { p1 = pow(Big_int(3),e); });
+    karatsuba_threshold = 1<<30;
+    const double t_pow_school = time_it([&] { p2 = pow(Big_int(3),e); });
+    karatsuba_threshold = threshold;
+    cout << "3^" << e << " has " << p1.size() << " limbs\n";
+    report("Karatsuba vs schoolbook:",t_pow,t_pow_school,p1==p2);
+
+    string s1, s2;
+    const double t_dc = time_it([&] { s1 = f1.to_string(); });
+    const double t_simple = time_it([&] { s2 = to_string_simple(f1); });
+    cout << n << "! has " << s1.size() << " digits\n";
+    report("to_string() vs simple:",t_dc,t_simple,s1==s2);
+
+    Big_int back;
+    const double t_read = time_it([&] { back = Big_int(s1); });
+    cout << setw(28) << left << "reading it back:" << right << setw(9) << t_read << " s"
+        << (back==f1 ? "" : "   DIFFERENT!") << '\n';
+}
+catch (exception& e) {
+    cerr << "exception: " << e.what() << '\n';
+    return 1;
+}
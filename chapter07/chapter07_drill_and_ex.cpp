@@ -9,6 +9,7 @@
 // Exercise 08: complete grammar
 // Exercise 09: already done in exercise 4
 // Exercise 12: already done in exercise 2
+// and user-defined functions, compiled into expression trees
 
 /*
     Simple calculator
@@ -23,15 +24,24 @@
         Print
         Quit
         Help
+        Stats
         Calculation Statement
 
     Statement:
         Declaration
+        Function
         Expression
 
     Declaration:
         "let" Name "=" Expression
         "const" name "=" Expression
+
+    Function:
+        "fn" Name "(" Parameters ")" "=" Expression
+        "memo" Name "(" Parameters ")" "=" Expression
+    Parameters:
+        Name
+        Parameters "," Name
     Name:
         letter
         letter Sequence
@@ -52,6 +62,9 @@
     Help
         "help"
 
+    Stats:
+        "stats"
+
     Expression:
         Term
         Expression "+" Term
@@ -68,27 +81,143 @@
         "+" Primary
         "sqrt(" Expression ")"
         "pow(" Expression "," Integer ")"
+        "if(" Expression "," Expression "," Expression ")"
         Name
         Name "=" Expression
+        Name "(" Arguments ")"
+    Arguments:
+        Expression
+        Arguments "," Expression
     Number:
         floating-point-literal
 
     Input comes from cin through the Token_stream called ts.
+
+    A statement is compiled into an expression tree first and then evaluated.
+    The body of a function (parameters may be empty) is compiled once and kept:
+
+        fn gcd(a,b) = if(b, gcd(b,a%b), a)
+        memo fib(n) = if(n*(n-1), fib(n-1)+fib(n-2), n)
+
+    if(c,x,y) is y if c is 0, else x; only one of x and y is evaluated. A
+    call in tail position (the value of the function, as gcd() above) is made
+    without going deeper, as a loop; other calls may nest max_call_depth
+    deep. A "memo" function must be pure (use only its parameters, constants
+    and pure functions, and assign nothing): the results of its calls are
+    remembered, memo_capacity of them at most, the least recently used ones
+    go first. "stats" shows the calls, hits and misses.
 */
 
+#include<cstring>
+#include<list>
+#include<unordered_map>
 #include "../lib_files/std_lib_facilities.h"
 
 // -----------------------------------------------------------------------
 
+// type for (name,value) pairs
+class Variable {
+public:
+	string name;
+	double value;
+    bool is_const;
+    bool is_declared;   // names get a slot before they are declared
+    int function;       // the user-defined function of that name, -1 if none
+	Variable(string n, double v, bool b) :name(n), value(v), is_const(b), is_declared(true), function(-1) { }
+};
+
+// type for var_table and associated functions
+// every name gets a slot, its index in var_table, when the Token_stream first
+// sees it, so that evaluation needs no string compares; the slots are found
+// through index, an open-addressing hash table of slot+1 (0: free entry)
+class Symbol_table {
+public:
+    Symbol_table() :index(64,0) { }
+    int intern(const string& s);                    // the slot of s, made if s is new
+    double get(int slot);                           // return the value of the Variable in slot
+    void set(int slot, double d);                   // set the Variable in slot to d
+    double declare(int slot, double val, bool b);   // declare the Variable in slot
+    double declare(string var, double val, bool b) { return declare(intern(var),val,b); }
+    bool is_constant(int slot) const { return var_table[slot].is_declared && var_table[slot].is_const; }
+    int function(int slot) const { return var_table[slot].function; }
+    void set_function(int slot, int f) { var_table[slot].function = f; }
+private:
+    int probe(const string& s) const;   // the entry of index for s
+    vector<Variable> var_table; // vector of Variables, by slot
+    vector<int> index;          // its size is a power of 2, at most half full
+};
+
+// the entry of index that holds s, or the free one where it belongs
+int Symbol_table::probe(const string& s) const
+{
+    unsigned int h = 2166136261u;   // FNV-1a
+    for (size_t i = 0; i<s.size(); ++i) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    const int mask = index.size()-1;
+    for (int i = h&mask; ; i = (i+1)&mask)
+        if (index[i]==0 || var_table[index[i]-1].name==s) return i;
+}
+
+// the slot of s; a new name gets a slot, but is not declared
+int Symbol_table::intern(const string& s)
+{
+    int i = probe(s);
+    if (index[i]) return index[i]-1;
+    if (2*(var_table.size()+1) > index.size()) {    // grow, and put everything back
+        index.assign(2*index.size(),0);
+        for (int v = 0; v<int(var_table.size()); ++v)
+            index[probe(var_table[v].name)] = v+1;
+        i = probe(s);
+    }
+    var_table.push_back(Variable(s,0,false));
+    var_table.back().is_declared = false;
+    index[i] = var_table.size();
+    return var_table.size()-1;
+}
+
+// return the value of the Variable in slot
+double Symbol_table::get(int slot)
+{
+    if (!var_table[slot].is_declared) error("get: undefined variable ",var_table[slot].name);
+    return var_table[slot].value;
+}
+
+// set the Variable in slot to d
+void Symbol_table::set(int slot, double d)
+{
+    Variable& v = var_table[slot];
+    if (!v.is_declared) error("set: undefined variable ",v.name);
+    if (v.is_const) error(v.name," is a constant");
+    v.value = d;
+}
+
+// declare the Variable in slot with value val
+double Symbol_table::declare(int slot, double val, bool b)
+{
+    Variable& v = var_table[slot];
+    if (v.is_declared) error(v.name," declared twice");
+    v.value = val;
+    v.is_const = b;
+    v.is_declared = true;
+    return val;
+}
+
+Symbol_table st;        // provides get(), set(), intern() and declare()
+
+// -----------------------------------------------------------------------
+
 // a very simple user-defined type
 class Token {
 public:
 	char kind;      // what kind of token
 	double value;   // for numbers: a value
 	string name;    // for variables and functions: a name
-	Token(char ch) :kind(ch), value(0) { }                  // make a Token from a char
-	Token(char ch, double val) :kind(ch), value(val) { }    // make a Token from a char and a double
-    Token(char ch, string n) :kind(ch), name(n) { }         // make a Token from a char and a string
+    int slot;       // for variables: where st keeps them
+	Token(char ch) :kind(ch), value(0), slot(-1) { }                // make a Token from a char
+	Token(char ch, double val) :kind(ch), value(val), slot(-1) { }  // make a Token from a char and a double
+    Token(char ch, string n) :kind(ch), name(n), slot(st.intern(n)) { } // make a Token from a char and a name
 };
 
 // stream of tokens
@@ -117,12 +246,20 @@ const char number = '8';        // t.kind==number means that t is a number Token
 const char name = 'a';          // name token
 const char square_root = 's';   // square root token
 const char power = 'p';         // power function token
+const char cond = 'i';          // if token
+const char fn = 'f';            // function definition token
+const char memo = 'm';          // memo function definition token
+const char stats = 'S';         // stats token
 const string declkey = "let";   // declaration keyword
 const string conkey = "const";  // constant keyword
 const string sqrtkey = "sqrt";  // keyword for square root
 const string powkey = "pow";    // keyword for power function
 const string quitkey = "quit";  // keyword to quit
 const string helpkey = "help";  // keyword for help
+const string ifkey = "if";      // keyword for if
+const string fnkey = "fn";      // keyword for function definitions
+const string memokey = "memo";  // keyword for memo function definitions
+const string statskey = "stats";    // keyword for the statistics of functions
 
 // read characters from cin and compose a Token
 Token Token_stream::get()
@@ -133,10 +270,10 @@ Token Token_stream::get()
     }
 
 	char ch;
-    cin.get(ch);    // note that cin.get() does NOT skip whitespace
+    if (!cin.get(ch)) return Token(quit);   // note that cin.get() does NOT skip whitespace
     while (isspace(ch)) {
         if (ch == '\n') return Token(print); // if newline detected, return print Token
-        cin.get(ch);
+        if (!cin.get(ch)) return Token(quit);   // end of input: as if quit
     }
 
 	switch (ch) {
@@ -175,6 +312,10 @@ Token Token_stream::get()
             if (s == powkey) return Token(power);           // power function keyword
             if (s == helpkey) return Token(help);           // help keyword
             if (s == quitkey) return Token(quit);           // quit keyword
+            if (s == ifkey) return Token(cond);             // if keyword
+            if (s == fnkey) return Token(fn);               // function definition keyword
+            if (s == memokey) return Token(memo);           // memo function definition keyword
+            if (s == statskey) return Token(stats);         // stats keyword
 			return Token(name,s);
 		}
 		error("Bad token");
@@ -208,67 +349,130 @@ void Token_stream::ignore(char c)
 
 // -----------------------------------------------------------------------
 
-// type for (name,value) pairs
-class Variable {
-public:
-	string name;
-	double value;
-    bool is_const;
-	Variable(string n, double v, bool b) :name(n), value(v), is_const(b) { }
+Token_stream ts;        // provides get() and putback()
+
+// -----------------------------------------------------------------------
+
+// a node of a compiled expression tree
+// kind is that of the Token it comes from (number, name, '+', square_root, ...)
+// or one of the kinds below; the operands are indices in the same Tree
+struct Node {
+    char kind;
+    double value;   // for numbers
+    int arg;        // the slot of a variable, the index of a parameter or function, or the exponent of pow
+    int left;       // the (first) operand; for calls and ifs: where the operands start in Tree::args
+    int right;      // the second operand; for calls and ifs: how many operands there are
+    Node(char k, double v = 0, int a = 0, int l = -1, int r = -1) :kind(k), value(v), arg(a), left(l), right(r) { }
 };
 
-// type for var_table and associated functions
-class Symbol_table {
-public:
-    double get(string s);                           // return the value of the Variable named s
-    void set(string s, double d);                   // set the Variable named s to d
-    bool is_declared(string var);                   // is var already in var_table?
-    double declare(string var,double val,bool b);   // add (var,val) to var_table
-private:
-    vector<Variable> var_table; // vector of Variables
+const char unary_minus = 'u';   // unary minus node
+const char parameter = 'x';     // parameter node
+const char call = 'c';          // function call node
+
+// a compiled expression; operands come before the nodes that use them
+struct Tree {
+    vector<Node> nodes;
+    vector<int> args;   // the operands of calls and ifs
+    int root;
+    Tree() :root(-1) { }
+    int add(const Node& n) { nodes.push_back(n); return nodes.size()-1; }
 };
 
-// return the value of the Variable named s
-double Symbol_table::get(string s)
-{
-	for (int i = 0; i<var_table.size(); ++i)
-		if (var_table[i].name == s) return var_table[i].value;
-	error("get: undefined variable ",s);
-}
+// -----------------------------------------------------------------------
 
-// set the Variable named s to d
-void Symbol_table::set(string s, double d)
-{
-	for (int i = 0; i<var_table.size(); ++i)
-		if (var_table[i].name == s) {
-            if (var_table[i].is_const) error(s," is a constant");
-			var_table[i].value = d;
-			return;
-		}
-	error("set: undefined variable ",s);
-}
+// a user-defined function
+struct Function {
+    string name;
+    vector<int> params;     // the slots of the names of the parameters
+    Tree body;
+    bool pure;              // uses nothing but its parameters, constants and pure functions
+    bool memo;              // remember results
+    long calls;
+    long hits;              // calls answered by memo_cache
+    long misses;
+    Function(const string& n, bool m) :name(n), pure(false), memo(m), calls(0), hits(0), misses(0) { }
+};
 
-// is var already in var_table?
-bool Symbol_table::is_declared(string var)
+vector<Function> functions;     // by index, as in Variable::function
+int defining = -1;              // the function whose body is being compiled
+
+// -----------------------------------------------------------------------
+
+// a call of a function with its arguments
+struct Call_key {
+    int f;
+    vector<double> args;
+};
+
+// compare the arguments bit for bit, so that a NaN finds itself
+struct Call_key_equal {
+    bool operator()(const Call_key& a, const Call_key& b) const
+    {
+        return a.f==b.f && a.args.size()==b.args.size()
+            && memcmp(a.args.data(),b.args.data(),a.args.size()*sizeof(double))==0;
+    }
+};
+
+struct Call_key_hash {
+    size_t operator()(const Call_key& k) const
+    {
+        unsigned int h = 2166136261u ^ k.f;     // FNV-1a, as for names
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(k.args.data());
+        for (size_t i = 0; i<k.args.size()*sizeof(double); ++i) {
+            h ^= p[i];
+            h *= 16777619u;
+        }
+        return h;
+    }
+};
+
+// the results of calls of memo functions, at most capacity of them: when it is
+// full, the least recently used result goes
+class Memo_cache {
+public:
+    explicit Memo_cache(int cap) :capacity(cap), evictions(0) { }
+    bool find(const Call_key& k, double& v);    // and make it the most recently used
+    void insert(const Call_key& k, double v);
+    int size() const { return index.size(); }
+    int max_size() const { return capacity; }
+    long evicted() const { return evictions; }
+private:
+    typedef list<pair<Call_key,double> > Lru;
+    Lru lru;        // the most recently used first
+    unordered_map<Call_key,Lru::iterator,Call_key_hash,Call_key_equal> index;
+    int capacity;
+    long evictions;
+};
+
+bool Memo_cache::find(const Call_key& k, double& v)
 {
-	for (int i = 0; i<var_table.size(); ++i)
-		if (var_table[i].name == var) return true;
-	return false;
+    auto p = index.find(k);
+    if (p == index.end()) return false;
+    lru.splice(lru.begin(),lru,p->second);
+    v = p->second->second;
+    return true;
 }
 
-// add (var,val) to var_table
-double Symbol_table::declare(string var, double val, bool b)
+void Memo_cache::insert(const Call_key& k, double v)
 {
-    if (is_declared(var)) error(var," declared twice");
-    var_table.push_back(Variable(var,val,b));
-    return val;
+    if (capacity <= 0) return;
+    auto p = index.find(k);
+    if (p != index.end()) {
+        p->second->second = v;
+        lru.splice(lru.begin(),lru,p->second);
+        return;
+    }
+    if (int(index.size()) >= capacity) {
+        index.erase(lru.back().first);
+        lru.pop_back();
+        ++evictions;
+    }
+    lru.push_front(make_pair(k,v));
+    index[k] = lru.begin();
 }
 
-// -----------------------------------------------------------------------
-
-Token_stream ts;        // provides get() and putback()
-Symbol_table st;        // provides get(), set(), is_declared() and declare()
-double expression();    // declaration so that primary() can call expression()
+const int memo_capacity = 10000;    // results kept for memo functions
+Memo_cache memo_cache(memo_capacity);
 
 // -----------------------------------------------------------------------
 
@@ -286,49 +490,233 @@ double my_pow(double base, int expo)
     return res;
 }
 
-// deal with numbers, unary +/-, parentheses, sqrt, pow, names and assignments
+// -----------------------------------------------------------------------
+
+const int max_call_depth = 1000;        // nested calls of user-defined functions
+const long max_tail_calls = 10000000;   // tail calls in one call, to stop endless loops
+int call_depth = 0;
+
+// a call in tail position, which eval() leaves to call_function()
+struct Tail_call {
+    int f;              // -1 for none
+    vector<double> args;
+};
+
+double call_function(int f, vector<double>& args);
+
+// the value of node i of t; params are the arguments of the function t is
+// the body of; a call in tail position is not made if tail is given, but
+// put there
+double eval(const Tree& t, int i, const double* params, Tail_call* tail)
+{
+    const Node& n = t.nodes[i];
+    switch (n.kind) {
+    case number:
+        return n.value;
+    case name:
+        return st.get(n.arg);
+    case parameter:
+        return params[n.arg];
+    case '=':
+    {   double d = eval(t,n.left,params,0);
+        st.set(n.arg,d);
+        return d;
+    }
+    case unary_minus:
+        return -eval(t,n.left,params,0);
+    case '+':
+    {   double left = eval(t,n.left,params,0);   // the left operand first, for assignments in it
+        return left+eval(t,n.right,params,0);
+    }
+    case '-':
+    {   double left = eval(t,n.left,params,0);
+        return left-eval(t,n.right,params,0);
+    }
+    case '*':
+    {   double left = eval(t,n.left,params,0);
+        return left*eval(t,n.right,params,0);
+    }
+    case '/':
+    {   double left = eval(t,n.left,params,0);
+        double d = eval(t,n.right,params,0);
+        if (d == 0) error("divide by zero");
+        return left/d;
+    }
+    case '%':
+    {   double left = eval(t,n.left,params,0);
+        double d = eval(t,n.right,params,0);
+        int i1 = int(left);
+        if (i1 != left) error("left-hand operand of % not int");
+        int i2 = int(d);
+        if (i2 != d) error("right-hand operand of % not int");
+        if (i2 == 0) error("%: divide by zero");
+        return i1%i2;
+    }
+    case square_root:
+    {   double d = eval(t,n.left,params,0);
+        if (d < 0) error("Square roots of negative numbers... nope!");
+        return sqrt(d);
+    }
+    case power:
+        return my_pow(eval(t,n.left,params,0),n.arg);
+    case cond:  // the chosen operand is in tail position if the if is
+        return eval(t,t.args[n.left + (eval(t,t.args[n.left],params,0)!=0 ? 1 : 2)],params,tail);
+    case call:
+    {   vector<double> args(n.right);
+        for (int k = 0; k<n.right; ++k) args[k] = eval(t,t.args[n.left+k],params,0);
+        if (tail) {
+            tail->f = n.arg;
+            tail->args.swap(args);
+            return 0;
+        }
+        return call_function(n.arg,args);
+    }
+    default:
+        error("bad expression tree");
+        return 0;
+    }
+}
+
+// the value of a compiled statement
+double eval(const Tree& t)
+{
+    return eval(t,t.root,0,0);
+}
+
+// -----------------------------------------------------------------------
+
+// counts the calls of user-defined functions in progress
+struct Depth_guard {
+    Depth_guard() { ++call_depth; }
+    ~Depth_guard() { --call_depth; }
+};
+
+// call functions[f] with args
+// calls in tail position go round the loop instead of deeper into the stack;
+// the result of the first call of a memo function is remembered, as the rest
+// of the loop depends on its arguments only
+double call_function(int f, vector<double>& args)
+{
+    if (call_depth >= max_call_depth) error("recursion too deep in ",functions[f].name);
+    Depth_guard guard;
+    Call_key key;
+    bool remember = false;
+    Tail_call tail;
+    for (long n = 0; ; ++n) {
+        Function& func = functions[f];
+        ++func.calls;
+        if (func.memo) {
+            Call_key k = { f, args };
+            double v;
+            if (memo_cache.find(k,v)) {
+                ++func.hits;
+                if (remember) memo_cache.insert(key,v);
+                return v;
+            }
+            ++func.misses;
+            if (!remember) {
+                swap(key,k);
+                remember = true;
+            }
+        }
+        if (n == max_tail_calls) error("too many tail calls in ",func.name);
+
+        tail.f = -1;
+        double d = eval(func.body,func.body.root,args.data(),&tail);
+        if (tail.f < 0) {
+            if (remember) memo_cache.insert(key,d);
+            return d;
+        }
+        f = tail.f;
+        args.swap(tail.args);
+    }
+}
+
+// -----------------------------------------------------------------------
+
+int expression(Tree& t);    // declaration so that primary() can call expression()
+
+// the index of the parameter of the function being defined named by slot, -1 if none
+int parameter_index(int slot)
+{
+    if (defining < 0) return -1;
+    const vector<int>& p = functions[defining].params;
+    for (int i = 0; i<int(p.size()); ++i)
+        if (p[i] == slot) return i;
+    return -1;
+}
+
+// compile the operands of a call or an if, up to the ')', into t.args
+// returns where they start
+int operands(Tree& t, int& count)
+{
+    vector<int> ops;
+    Token t2 = ts.get();
+    if (t2.kind != ')') {
+        ts.putback(t2);
+        while (true) {
+            ops.push_back(expression(t));
+            t2 = ts.get();
+            if (t2.kind == ')') break;
+            if (t2.kind != ',') error("')' expected");
+        }
+    }
+    const int first = t.args.size();
+    for (size_t i = 0; i<ops.size(); ++i) t.args.push_back(ops[i]);
+    count = ops.size();
+    return first;
+}
+
+// deal with numbers, unary +/-, parentheses, sqrt, pow, if, names, assignments and calls
 // calls expression()
-double primary()
+int primary(Tree& tr)
 {
 	Token t = ts.get();
 	switch (t.kind) {
 	case '(':   // handle '(' expression ')'
-	{	double d = expression();
+	{	int d = expression(tr);
 		t = ts.get();
 		if (t.kind != ')') error("')' expected");
         return d;
 	}
 	case '-':
-		return - primary();
+		return tr.add(Node(unary_minus,0,0,primary(tr)));
     case '+':
-        return primary();
+        return primary(tr);
 	case number:
-		return t.value;
+		return tr.add(Node(number,t.value));
     case name:
     {   Token t2 = ts.get();    // check next token
         if (t2.kind == '=') {   // handle name '=' expression
-            double d = expression();
-            st.set(t.name,d);
-            return d;
+            if (parameter_index(t.slot) >= 0) error("assignment to parameter ",t.name);
+            int d = expression(tr);
+            return tr.add(Node('=',0,t.slot,d));
         }
-        else {  // not an assignment
-            ts.putback(t2);
-            return st.get(t.name);
+        if (t2.kind == '(') {   // handle name '(' arguments ')'
+            const int f = st.function(t.slot);
+            if (f < 0) error("undefined function ",t.name);
+            int count;
+            const int first = operands(tr,count);
+            if (count != int(functions[f].params.size())) error("wrong number of arguments for ",t.name);
+            return tr.add(Node(call,0,f,first,count));
         }
+        ts.putback(t2);         // not an assignment or a call
+        const int p = parameter_index(t.slot);
+        if (p >= 0) return tr.add(Node(parameter,0,p));
+        return tr.add(Node(name,0,t.slot));
     }
     case square_root:   // handle 'sqrt(' expression ')'
     {   t = ts.get();
         if (t.kind != '(') error("'(' expected");
-        double d = expression();
-        if (d < 0) error("Square roots of negative numbers... nope!");
+        int d = expression(tr);
         t = ts.get();
         if (t.kind != ')') error("')' expected");
-        return sqrt(d);
+        return tr.add(Node(square_root,0,0,d));
     }
     case power: // handle 'pow(' expression ',' integer ')'
     {   t = ts.get();
         if (t.kind != '(') error("'(' expected");
-        double d = expression();
+        int d = expression(tr);
         t = ts.get();
         if (t.kind != ',') error("',' expected");
         t = ts.get();
@@ -337,7 +725,15 @@ double primary()
         if (i != t.value) error("second argument of 'pow' is not an integer");
         t = ts.get();
         if (t.kind != ')') error("')' expected");
-        return my_pow(d,i);
+        return tr.add(Node(power,0,i,d));
+    }
+    case cond:  // handle 'if(' expression ',' expression ',' expression ')'
+    {   t = ts.get();
+        if (t.kind != '(') error("'(' expected");
+        int count;
+        const int first = operands(tr,count);
+        if (count != 3) error("if takes three arguments");
+        return tr.add(Node(cond,0,0,first,3));
     }
 	default:
 		error("primary expected");
@@ -348,32 +744,18 @@ double primary()
 
 // deal with *, / and %
 // calls primary()
-double term()
+int term(Tree& tr)
 {
-	double left = primary();
+	int left = primary(tr);
     Token t = ts.get(); // get the next token from Token_stream
 
 	while (true) {
 		switch(t.kind) {
 		case '*':
-			left *= primary();
-            t = ts.get();
-			break;
 		case '/':
-		{	double d = primary();
-			if (d == 0) error("divide by zero");
-			left /= d;
-            t = ts.get();
-			break;
-		}
         case '%':
-        {   double d = primary();
-            int i1 = int(left);
-            if (i1 != left) error("left-hand operand of % not int");
-            int i2 = int(d);
-            if (i2 != d) error("right-hand operand of % not int");
-            if (i2 == 0) error("%: divide by zero");
-            left = i1%i2;
+        {   int right = primary(tr);
+            left = tr.add(Node(t.kind,0,0,left,right));
             t = ts.get();
             break;
         }
@@ -388,26 +770,25 @@ double term()
 
 // deal with + and -
 // calls term()
-double expression()
+int expression(Tree& tr)
 {
-	double left = term();   // read and evaluate a Term
+	int left = term(tr);    // read and compile a Term
     Token t = ts.get();     // get the next Token from the Token stream
 
 	while (true) {
 		switch(t.kind) {
 		case '+':
-			left += term(); // evaluate Term and add
-            t = ts.get();
-			break;
 		case '-':
-			left -= term(); // evaluate Term and subtract
+        {   int right = term(tr);
+            left = tr.add(Node(t.kind,0,0,left,right));
             t = ts.get();
 			break;
+        }
         case '=':
             error("use of '=' outside of a declaration");
 		default:
 			ts.putback(t);  // put t back into the token stream
-			return left;    // finally: no more + or -; return the answer
+			return left;    // finally: no more + or -; return the tree
 		}
 	}
 }
@@ -421,18 +802,78 @@ double declaration(bool b)
 {
 	Token t = ts.get();
 	if (t.kind != name) error ("name expected in declaration");
-	string var_name = t.name;
 
 	Token t2 = ts.get();
-	if (t2.kind != '=') error("= missing in declaration of ",var_name);
+	if (t2.kind != '=') error("= missing in declaration of ",t.name);
 
-	double d = expression();
-    st.declare(var_name,d,b);
+    Tree tr;
+    tr.root = expression(tr);
+	double d = eval(tr);
+    st.declare(t.slot,d,b);
 	return d;
 }
 
 // -----------------------------------------------------------------------
 
+// does t use nothing but parameters, constants and pure functions?
+// self is the function t is the body of, which is pure if the rest is
+bool is_pure(const Tree& t, int self)
+{
+    for (size_t i = 0; i<t.nodes.size(); ++i) {
+        const Node& n = t.nodes[i];
+        if (n.kind == '=') return false;
+        if (n.kind==name && !st.is_constant(n.arg)) return false;
+        if (n.kind==call && n.arg!=self && !functions[n.arg].pure) return false;
+    }
+    return true;
+}
+
+// assume we have seen "fn" or "memo"
+// handle: name '(' parameters ')' '=' expression
+void function_definition(bool m)
+{
+    Token t = ts.get();
+    if (t.kind != name) error("name expected in function definition");
+    if (st.function(t.slot) >= 0) error(t.name," declared twice");
+
+    Token t2 = ts.get();
+    if (t2.kind != '(') error("'(' expected");
+    Function f(t.name,m);
+    t2 = ts.get();
+    while (t2.kind != ')') {
+        if (t2.kind != name) error("parameter name expected");
+        for (size_t i = 0; i<f.params.size(); ++i)
+            if (f.params[i] == t2.slot) error(t2.name," declared twice as a parameter");
+        f.params.push_back(t2.slot);
+        t2 = ts.get();
+        if (t2.kind == ',') t2 = ts.get();
+        else if (t2.kind != ')') error("')' expected");
+    }
+    t2 = ts.get();
+    if (t2.kind != '=') error("= missing in definition of ",t.name);
+
+    functions.push_back(f);     // before the body, which may call it
+    defining = functions.size()-1;
+    st.set_function(t.slot,defining);
+    try {
+        Tree body;
+        body.root = expression(body);
+        Function& g = functions[defining];
+        g.pure = is_pure(body,defining);
+        if (m && !g.pure) error("memo: not a pure function: ",t.name);
+        swap(g.body,body);
+    }
+    catch (...) {
+        st.set_function(t.slot,-1);
+        functions.pop_back();
+        defining = -1;
+        throw;
+    }
+    defining = -1;
+}
+
+// -----------------------------------------------------------------------
+
 // handles declarations and expressions
 double statement()
 {
@@ -443,13 +884,15 @@ double statement()
     case con:
         return declaration(true);
 	default:
-		ts.putback(t);
-		return expression();
+    {   ts.putback(t);
+        Tree tr;
+        tr.root = expression(tr);
+        return eval(tr);
+    }
 	}
 }
 
 // -----------------------------------------------------------------------
-
 // clean input after error
 void clean_up_mess()
 {
@@ -465,6 +908,22 @@ void print_help()
     cout << "a few functions, you can declare variables using\n";
     cout << "the 'let' keyword and constants with the 'const'\n";
     cout << "keyword.\n";
+    cout << "Define functions with 'fn', e.g. fn sq(x) = x*x, or with\n";
+    cout << "'memo' to have their results remembered; if(c,x,y) is x\n";
+    cout << "if c is not 0, else y; 'stats' shows the calls made.\n";
+}
+
+// print the calls, memo hits and misses of the user-defined functions
+void print_stats()
+{
+    for (size_t i = 0; i<functions.size(); ++i) {
+        const Function& f = functions[i];
+        cout << f.name << ": " << f.calls << " calls";
+        if (f.memo) cout << ", " << f.hits << " hits, " << f.misses << " misses";
+        cout << '\n';
+    }
+    cout << "memo cache: " << memo_cache.size() << " of " << memo_cache.max_size()
+        << " results, " << memo_cache.evicted() << " evicted\n";
 }
 
 const string prompt = "> ";
@@ -479,6 +938,9 @@ void calculate()
 		Token t = ts.get();
 		while (t.kind == print) t=ts.get(); // first discard all "prints"
         if (t.kind == help) print_help();   // print help instructions
+        else if (t.kind == stats) print_stats();
+        else if (t.kind == fn) function_definition(false);
+        else if (t.kind == memo) function_definition(true);
         else {
             if (t.kind == quit) return;
             ts.putback(t);
@@ -6,7 +6,9 @@
     This program implements a basic expression calculator.
     Input from cin; output to cout.
 
-    This is the integer version!
+    This is the integer version! It starts in int mode, in which any result
+    that does not fit into an int is an error instead of a silent overflow;
+    "big" switches to arbitrary precision (Big_int), "int" back.
 
     The grammar for input is:
 
@@ -15,6 +17,7 @@
         Print
         Quit
         Help
+        Mode
         Calculation Statement
 
     Statement:
@@ -45,16 +48,24 @@
     Help
         "help"
 
+    Mode:
+        "big"
+        "int"
+
     Expression:
         Term
         Expression "+" Term
         Expression "-" Term
 
     Term:
+        Secondary
+        Term "*" Secondary
+        Term "/" Secondary
+        Term "%" Secondary
+
+    Secondary:
         Primary
-        Term "*" Primary
-        Term "/" Primary
-        Term "%" Primary
+        Secondary "!"
 
     Primary:
         Number
@@ -67,23 +78,26 @@
         Name "=" Expression
 
     Number:
-        floating-point-literal
+        integer-literal
 
     Input comes from cin through the Token_stream called ts.
 */
 
+#include "Big_int.h"
 #include "../lib_files/std_lib_facilities.h"
 
+using Big_lib::Big_int;
+
 // -----------------------------------------------------------------------
 
 // a very simple user-defined type
 class Token {
 public:
     char kind;      // what kind of token
-    int value;      // for numbers: a value
+    Big_int value;  // for numbers: a value
     string name;    // for variables and functions: a name
     Token(char ch) :kind(ch), value(0) { }              // make a Token from a char
-    Token(char ch, int val) :kind(ch), value(val) { }   // make a Token from a char and an int
+    Token(char ch, const Big_int& val) :kind(ch), value(val) { }  // make a Token from a char and a Big_int
     Token(char ch, string n) :kind(ch), name(n) { }     // make a Token from a char and a string
 };
 
@@ -113,12 +127,16 @@ const char number = '8';        // t.kind==number means that t is a number Token
 const char name = 'a';          // name token
 const char square_root = 's';   // square root token
 const char power = 'p';         // power function token
+const char big = 'b';           // arbitrary precision mode token
+const char integer = 'i';       // int mode token
 const string declkey = "let";   // declaration keyword
 const string conkey = "const";  // constant keyword
 const string sqrtkey = "sqrt";  // keyword for square root
 const string powkey = "pow";    // keyword for power function
 const string quitkey = "quit";  // keyword to quit
 const string helpkey = "help";  // keyword for help
+const string bigkey = "big";    // keyword for arbitrary precision mode
+const string intkey = "int";    // keyword for int mode
 
 // read characters from cin and compose a Token
 Token Token_stream::get()
@@ -146,14 +164,16 @@ Token Token_stream::get()
     case '%':
     case '=':
     case ',':
+    case '!':
         return Token(ch);   // let each character represent itself
     //case '.':   // a floating-point-literal can start with a dot
     case '0': case '1': case '2': case '3': case '4':
     case '5': case '6': case '7': case '8': case '9':   // numeric literal
-    {	cin.putback(ch);    // put digit back into the input stream
-    int val;
-    cin >> val;         // read an integer number
-    return Token(number,val);
+    {   string digits;      // read an integer number of any length
+        digits += ch;
+        while (cin.get(ch) && isdigit(ch)) digits += ch;
+        cin.putback(ch);
+        return Token(number,Big_int(digits));
     }
     default:
         if (isalpha(ch)) {
@@ -167,6 +187,8 @@ Token Token_stream::get()
             if (s == powkey) return Token(power);           // power function keyword
             if (s == helpkey) return Token(help);           // help keyword
             if (s == quitkey) return Token(quit);           // quit keyword
+            if (s == bigkey) return Token(big);             // arbitrary precision keyword
+            if (s == intkey) return Token(integer);         // int mode keyword
             return Token(name,s);
         }
         error("Bad token");
@@ -204,24 +226,24 @@ void Token_stream::ignore(char c)
 class Variable {
 public:
     string name;
-    int value;
+    Big_int value;
     bool is_const;
-    Variable(string n, int v, bool b) :name(n), value(v), is_const(b) { }
+    Variable(string n, const Big_int& v, bool b) :name(n), value(v), is_const(b) { }
 };
 
 // type for var_table and associated functions
 class Symbol_table {
 public:
-    int get(string s);                          // return the value of the Variable named s
-    void set(string s, int d);                  // set the Variable named s to d
+    Big_int get(string s);                      // return the value of the Variable named s
+    void set(string s, const Big_int& d);       // set the Variable named s to d
     bool is_declared(string var);               // is var already in var_table?
-    int declare(string var, int val,bool b);    // add (var,val) to var_table
+    Big_int declare(string var, const Big_int& val, bool b);    // add (var,val) to var_table
 private:
     vector<Variable> var_table; // vector of Variables
 };
 
 // return the value of the Variable named s
-int Symbol_table::get(string s)
+Big_int Symbol_table::get(string s)
 {
     for (int i = 0; i<var_table.size(); ++i)
     if (var_table[i].name == s) return var_table[i].value;
@@ -229,7 +251,7 @@ int Symbol_table::get(string s)
 }
 
 // set the Variable named s to d
-void Symbol_table::set(string s, int d)
+void Symbol_table::set(string s, const Big_int& d)
 {
     for (int i = 0; i<var_table.size(); ++i)
     if (var_table[i].name == s) {
@@ -249,7 +271,7 @@ bool Symbol_table::is_declared(string var)
 }
 
 // add (var,val) to var_table
-int Symbol_table::declare(string var, int val, bool b)
+Big_int Symbol_table::declare(string var, const Big_int& val, bool b)
 {
     if (is_declared(var)) error(var," declared twice");
     var_table.push_back(Variable(var,val,b));
@@ -260,76 +282,107 @@ int Symbol_table::declare(string var, int val, bool b)
 
 Token_stream ts;        // provides get() and putback()
 Symbol_table st;        // provides get(), set(), is_declared() and declare()
-int expression();    // declaration so that primary() can call expression()
+Big_int expression();   // declaration so that primary() can call expression()
+bool big_mode = false;  // arbitrary precision; else results must fit into an int
 
 // -----------------------------------------------------------------------
 
+void overflow()
+{
+    error("integer overflow (enter 'big' for arbitrary precision)");
+}
+
+// in int mode, check that the result of an operation fits into an int
+Big_int checked(const Big_int& d)
+{
+    if (!big_mode && !d.fits_int()) overflow();
+    return d;
+}
+
+// -----------------------------------------------------------------------
+
+// results of pow and ! are kept below this, so that a typo can't make the
+// calculator spend minutes and gigabytes on one number (1000000! has 18.5 million bits)
+const long long max_result_bits = 20000000;
+
 // simple power function
 // handles only integers >= 0 as exponents
-int my_pow(int base, int expo)
+Big_int my_pow(const Big_int& base, int expo)
 {
+    if (expo < 0) error("pow: negative exponent");
     if (expo == 0) {
         if (base == 0) return 0;    // special case: pow(0,0)
         return 1;                   // something to power of 0
     }
-    int res = base;                 // corresponds to power of 1
-    for (int i = 2; i<=expo; ++i)   // powers of 2 and more
-        res *= base;
-    return res;
+    if (compare_magnitude(base,1)>0) {  // don't compute what cannot fit
+        if (!big_mode && expo>31) overflow();
+        if ((long long)base.bits()*expo > max_result_bits) error("pow: result too large");
+    }
+    return checked(Big_lib::pow(base,expo));
+}
+
+// -----------------------------------------------------------------------
+
+// n!, for n >= 0
+Big_int my_factorial(const Big_int& n)
+{
+    if (n < 0) error("factorial of a negative number");
+    if (!big_mode && n>12) overflow();      // 13! > INT_MAX
+    if (n > 1000000) error("factorial: argument too large");
+    return checked(Big_lib::factorial(n.to_int()));
 }
 
 // deal with numbers, unary +/-, parentheses, sqrt, pow, names and assignments
 // calls expression()
-int primary()
+Big_int primary()
 {
     Token t = ts.get();
     switch (t.kind) {
     case '(':   // handle '(' expression ')'
-    {	int d = expression();
+    {	Big_int d = expression();
         t = ts.get();
         if (t.kind != ')') error("')' expected");
         return d;
     }
     case '-':
-        return -primary();
+        return checked(-primary());
     case '+':
         return primary();
     case number:
-        return t.value;
+        return checked(t.value);
     case name:
     {   Token t2 = ts.get();    // check next token
         if (t2.kind == '=') {   // handle name '=' expression
-            int d = expression();
+            Big_int d = expression();
             st.set(t.name,d);
             return d;
         }
         else {  // not an assignment
             ts.putback(t2);
-            return st.get(t.name);
+            return checked(st.get(t.name));
         }
     }
     case square_root:   // handle 'sqrt(' expression ')'
     {   t = ts.get();
         if (t.kind != '(') error("'(' expected");
-        int d = expression();
+        Big_int d = expression();
         if (d < 0) error("Square roots of negative numbers... nope!");
         t = ts.get();
         if (t.kind != ')') error("')' expected");
-        double root = sqrt(d);
-        //int root_int = int(root);
-        if (int(root) != root) error("sqrt operation resulted in non-integer value");
-        return int(root);
+        Big_int root = Big_lib::isqrt(d);
+        if (root*root != d) error("sqrt operation resulted in non-integer value");
+        return root;
     }
     case power: // handle 'pow(' expression ',' integer ')'
     {   t = ts.get();
         if (t.kind != '(') error("'(' expected");
-        int d = expression();
+        Big_int d = expression();
         t = ts.get();
         if (t.kind != ',') error("',' expected");
         t = ts.get();
         if (t.kind != number) error("second argument of 'pow' is not a number");
-        int i = int(t.value);
-        if (i != t.value) error("second argument of 'pow' is not an integer");
+        if (!t.value.fits_int()) error("second argument of 'pow' is too large");
+        int i = t.value.to_int();
         t = ts.get();
         if (t.kind != ')') error("')' expected");
         return my_pow(d,i);
@@ -341,36 +394,46 @@ int primary()
 
 // -----------------------------------------------------------------------
 
-// deal with *, / and %
+// deal with !
 // calls primary()
-int term()
+Big_int secondary()
+{
+    Big_int left = primary();
+    Token t = ts.get();
+    while (t.kind == '!') {
+        left = my_factorial(left);
+        t = ts.get();
+    }
+    ts.putback(t);
+    return left;
+}
+
+// -----------------------------------------------------------------------
+
+// deal with *, / and %
+// calls secondary()
+Big_int term()
 {
-    int left = primary();
+    Big_int left = secondary();
     Token t = ts.get(); // get the next token from Token_stream
 
     while (true) {
         switch (t.kind) {
         case '*':
-            left *= primary();
+            left = checked(left*secondary());
             t = ts.get();
             break;
         case '/':
-        {	int d = primary();
+        {	Big_int d = secondary();
             if (d == 0) error("divide by zero");
-            left /= d;
-            int left_int = int(left);
-            if (left_int != left) error("division led to non-integer value");
+            left = checked(left/d);     // INT_MIN/-1 doesn't fit
             t = ts.get();
             break;
         }
         case '%':
-        {   int d = primary();
-            int i1 = int(left);
-            if (i1 != left) error("left-hand operand of % not int");
-            int i2 = int(d);
-            if (i2 != d) error("right-hand operand of % not int");
-            if (i2 == 0) error("%: divide by zero");
-            left = i1%i2;
+        {   Big_int d = secondary();
+            if (d == 0) error("%: divide by zero");
+            left %= d;
             t = ts.get();
             break;
         }
@@ -385,19 +448,19 @@ int term()
 
 // deal with + and -
 // calls term()
-int expression()
+Big_int expression()
 {
-    int left = term();  // read and evaluate a Term
+    Big_int left = term();  // read and evaluate a Term
     Token t = ts.get(); // get the next Token from the Token stream
 
     while (true) {
         switch (t.kind) {
         case '+':
-            left += term(); // evaluate Term and add
+            left = checked(left+term());    // evaluate Term and add
             t = ts.get();
             break;
         case '-':
-            left -= term(); // evaluate Term and subtract
+            left = checked(left-term());    // evaluate Term and subtract
             t = ts.get();
             break;
         case '=':
@@ -414,7 +477,7 @@ int expression()
 // assume we have seen "let" or "const"
 // handle: name = expression
 // declare a variable called "name" with the initial value "expression"
-int declaration(bool b)
+Big_int declaration(bool b)
 {
     Token t = ts.get();
     if (t.kind != name) error("name expected in declaration");
@@ -423,7 +486,7 @@ int declaration(bool b)
     Token t2 = ts.get();
     if (t2.kind != '=') error("= missing in declaration of ",var_name);
 
-    int d = expression();
+    Big_int d = expression();
     st.declare(var_name,d,b);
     return d;
 }
@@ -431,7 +494,7 @@ int declaration(bool b)
 // -----------------------------------------------------------------------
 
 // handles declarations and expressions
-int statement()
+Big_int statement()
 {
     Token t = ts.get();
     switch (t.kind) {
@@ -462,6 +525,8 @@ void print_help()
     cout << "a few functions, you can declare variables using\n";
     cout << "the 'let' keyword and constants with the 'const'\n";
     cout << "keyword.\n";
+    cout << "'big' switches to integers of any size,\n";
+    cout << "'int' back to results that must fit into an int.\n";
 }
 
 const string prompt = "> ";
@@ -476,6 +541,8 @@ void calculate()
         Token t = ts.get();
         while (t.kind == print) t=ts.get(); // first discard all "prints"
         if (t.kind == help) print_help();   // print help instructions
+        else if (t.kind == big) big_mode = true;
+        else if (t.kind == integer) big_mode = false;
         else {
             if (t.kind == quit) return;
             ts.putback(t);
@@ -1,3 +1,4 @@
+#include<cstring>
 #include "Chrono.h"
 
 namespace Chrono {
@@ -33,14 +34,26 @@ namespace Chrono {
 
     void Date::add_day(int n)
     {
-        // ...
+        int mm;
+        civil_from_days(days_from_civil(y,m,d)+n,y,mm,d);
+        m = Month(mm);
     }
 
     //------------------------------------------------------------------------------
 
+    // a day the month does not have (e.g. Jan 31 + 1 month) becomes the first
+    // of the month after it, as for Feb 29 in add_year()
     void Date::add_month(int n)
     {
-        // ...
+        int mm = m-1+n;
+        int yy = mm>=0 ? mm/12 : (mm-11)/12;    // round down, also for n < 0
+        mm -= yy*12;
+        y += yy;
+        m = Month(mm+1);
+        if (days_in_month(y,m) < d) {
+            d = 1;
+            add_month(1);
+        }
     }
 
     //------------------------------------------------------------------------------
@@ -58,38 +71,6 @@ namespace Chrono {
 
     // helper functions:
 
-    bool is_date(int y, Date::Month m, int d)
-    {
-        // assume that y is valid
-
-        if (d<=0) return false;     // d must be positive
-
-        int days_in_month = 31;     // most months have 31 days
-
-        switch (m) {
-        case Date::feb:             // the length of February varies
-            days_in_month = (leapyear(y)) ? 29 : 28;
-            break;
-        case Date::apr: case Date::jun: case Date::sep: case Date::nov:
-            days_in_month = 30;     // the rest have 30 days
-            break;
-        }
-
-        if (days_in_month<d) return false;
-
-        return true;
-    }
-
-    //------------------------------------------------------------------------------
-
-    // a leap year is disivible by 4, but not by 100, except if it is divisible by 400
-    bool leapyear(int y)
-    {
-        return (y%4==0 && y%100!=0) || y%400==0;
-    }
-
-    //------------------------------------------------------------------------------
-
     bool operator==(const Date& a, const Date& b)
     {
         return a.year()==b.year()
@@ -162,13 +143,10 @@ namespace Chrono {
 
     //------------------------------------------------------------------------------
     const Date first_date = Date(1970,Date::jan,1); // day 0 for linear representation of Date
-    const Day first_day = thursday;            // Jan 1, 1970 was a Thursday
 
     Day day_of_week(const Date& d)
     {
-        if (d.year() < first_date.year()) error("day_of_week: works only for 1970 and later");
-        int dlin = days_linear(d);
-        return Day((first_day + dlin) % 7);
+        return weekday(days_linear(d));
     }
 
     //------------------------------------------------------------------------------
@@ -209,23 +187,24 @@ namespace Chrono {
         return diy;
     }
 
+    // number of leap years before year y, counting from year 1
+    int leapyears_before(int y)
+    {
+        --y;
+        return y/4 - y/100 + y/400;
+    }
+
     // number of leap years between 1970 and Jan 1, year y
     int n_leapyears(int y)
     {
-        // go through every year since 1970, check if it is a leap year
-        int nl = 0;
-        for (int i = 1970; i<y; ++i) {
-            if (leapyear(i)) ++nl;
-        }
-        return nl;
+        if (y <= first_date.year()) return 0;
+        return leapyears_before(y) - leapyears_before(first_date.year());
     }
 
-    // number of days since Jan 1, 1970 (day 0)
+    // number of days since Jan 1, 1970 (day 0), negative before
     long int days_linear(const Date& d)
     {
-        if (d.year() < first_date.year()) error("days_linear: year must be 1970 or later");
-        int y = d.year() - first_date.year();
-        return y*365 + n_leapyears(d.year()) + day_in_year(d) - 1;
+        return days_from_civil(d.year(),d.month(),d.day());
     }
 
     //------------------------------------------------------------------------------
@@ -254,6 +233,390 @@ namespace Chrono {
 
     //------------------------------------------------------------------------------
 
+    int Fast_date::day() const
+    {
+        int y, m, d;
+        civil_from_days(n,y,m,d);
+        return d;
+    }
+
+    Date::Month Fast_date::month() const
+    {
+        int y, m, d;
+        civil_from_days(n,y,m,d);
+        return Date::Month(m);
+    }
+
+    int Fast_date::year() const
+    {
+        int y, m, d;
+        civil_from_days(n,y,m,d);
+        return y;
+    }
+
+    Date Fast_date::date() const
+    {
+        int y, m, d;
+        civil_from_days(n,y,m,d);
+        return Date(y,Date::Month(m),d);
+    }
+
+    void Fast_date::add_month(int k)
+    {
+        Date dd = date();
+        dd.add_month(k);
+        n = days_from_civil(dd.year(),dd.month(),dd.day());
+    }
+
+    void Fast_date::add_year(int k)
+    {
+        Date dd = date();
+        dd.add_year(k);
+        n = days_from_civil(dd.year(),dd.month(),dd.day());
+    }
+
+    ostream& operator<<(ostream& os, Fast_date d)
+    {
+        return os << d.date();
+    }
+
+    //------------------------------------------------------------------------------
+
+    // the value of the eight digits in w, the first in the lowest byte
+    // (as memcpy() puts them into w on a little-endian machine): each step
+    // combines neighbouring pairs, 1 into 2, 2 into 4, 4 into 8 digits
+    // (D. Lemire, "Faster integer parsing")
+    inline unsigned eight_digits(uint64_t w)
+    {
+        w = (w & 0x0F0F0F0F0F0F0F0FULL) * 2561 >> 8;
+        w = (w & 0x00FF00FF00FF00FFULL) * 6553601 >> 16;
+        return unsigned((w & 0x0000FFFF0000FFFFULL) * 42949672960001ULL >> 32);
+    }
+
+    // are all eight bytes of w '0'...'9'? the high half of every byte must
+    // be 3, also after adding 6 (which moves ':' to '?' up to the next 16)
+    inline bool all_digits(uint64_t w)
+    {
+        return ((w & 0xF0F0F0F0F0F0F0F0ULL)
+            | (((w + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) == 0x3333333333333333ULL;
+    }
+
+    // read yyyy-mm-dd at p, with p+10 <= e
+    const char* parse_iso_date(const char* p, int& days)
+    {
+        if (p[4]!='-' || p[7]!='-') return 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        uint64_t w;                 // "yyyy-mm-"
+        uint16_t dd;                // "dd"
+        memcpy(&w,p,8);
+        memcpy(&dd,p+8,2);
+        w = (w & 0xFFFFFFFFULL) | (w>>8 & 0xFFFF00000000ULL) | uint64_t(dd)<<48;  // "yyyymmdd"
+        if (!all_digits(w)) return 0;
+        const unsigned v = eight_digits(w);
+#else
+        static const int pos[] = { 0, 1, 2, 3, 5, 6, 8, 9 };
+        unsigned v = 0;
+        for (int i = 0; i<8; ++i) {
+            const unsigned c = p[pos[i]]-'0';
+            if (c > 9) return 0;
+            v = v*10+c;
+        }
+#endif
+        const int y = v/10000;
+        const int m = v/100%100;
+        const int d = v%100;
+        if (!is_date(y,Date::Month(m),d)) return 0;
+        days = days_from_civil(y,m,d);
+        return p+10;
+    }
+
+    // read an int of at most 9 digits, with an optional '-', at p
+    const char* parse_small_int(const char* p, const char* e, int& v)
+    {
+        const bool neg = p<e && *p=='-';
+        if (neg) ++p;
+        const char* b = p;
+        unsigned u = 0;
+        for (unsigned c; p<e && p-b<9 && (c = *p-'0')<=9; ++p) u = u*10+c;
+        if (p==b || (p<e && unsigned(*p-'0')<=9)) return 0;    // no digits, or too many
+        v = neg ? -int(u) : int(u);
+        return p;
+    }
+
+    // read (y,m,d) at p
+    const char* parse_paren_date(const char* p, const char* e, int& days)
+    {
+        int y, m, d;
+        if (*p++ != '(') return 0;
+        if (!(p = parse_small_int(p,e,y)) || p==e || *p++!=',') return 0;
+        if (!(p = parse_small_int(p,e,m)) || p==e || *p++!=',') return 0;
+        if (!(p = parse_small_int(p,e,d)) || p==e || *p++!=')') return 0;
+        if (!is_date(y,Date::Month(m),d)) return 0;
+        days = days_from_civil(y,m,d);
+        return p;
+    }
+
+    // read an ISO date whose year isn't four digits, as format_date() writes
+    // those before year 0 and after 9999: -0005-01-01, 12345-01-01
+    const char* parse_long_iso_date(const char* p, const char* e, int& days)
+    {
+        int y;
+        const char* q = parse_small_int(p,e,y);
+        if (!q || q-p-(*p=='-')<4 || e-q<6 || q[0]!='-' || q[3]!='-') return 0;
+        const unsigned m1 = q[1]-'0', m2 = q[2]-'0', d1 = q[4]-'0', d2 = q[5]-'0';
+        if (m1>9 || m2>9 || d1>9 || d2>9) return 0;
+        const int m = m1*10+m2;
+        const int d = d1*10+d2;
+        if (!is_date(y,Date::Month(m),d)) return 0;
+        days = days_from_civil(y,m,d);
+        return q+6;
+    }
+
+    const char* parse_date(const char* p, const char* e, int& days)
+    {
+        if (p == e) return 0;
+        if (*p == '(') return parse_paren_date(p,e,days);
+        if (e-p>=10 && p[4]=='-') return parse_iso_date(p,days);
+        return parse_long_iso_date(p,e,days);
+    }
+
+    long parse_dates(const char* b, const char* e, vector<int>& days, vector<long>* bad)
+    {
+        long n = 0;
+        const char* p = b;
+        while (true) {
+            while (p<e && isspace(*p)) ++p;
+            if (p == e) return n;
+            int d;
+            const char* q = parse_date(p,e,d);
+            if (q && (q==e || isspace(*q))) {
+                days.push_back(d);
+                ++n;
+                p = q;
+            }
+            else {
+                if (bad) bad->push_back(p-b);
+                while (p<e && !isspace(*p)) ++p;
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------
+
+    // write the digits of u, at least min of them, at out
+    inline char* write_unsigned(unsigned u, int min, char* out)
+    {
+        char buf[12];
+        char* p = buf+sizeof(buf);
+        do {
+            *--p = '0' + u%10;
+            u /= 10;
+        } while (u || buf+sizeof(buf)-p<min);
+        const int n = buf+sizeof(buf)-p;
+        memcpy(out,p,n);
+        return out+n;
+    }
+
+    inline char* write_int(int v, int min, char* out)
+    {
+        if (v < 0) *out++ = '-';
+        return write_unsigned(v<0 ? 0u-unsigned(v) : unsigned(v),min,out);
+    }
+
+    char* format_date(int days, Date_format f, char* out)
+    {
+        int y, m, d;
+        civil_from_days(days,y,m,d);
+        if (f == iso_format) {
+            out = write_int(y,4,out);
+            *out++ = '-';
+            *out++ = '0'+m/10;
+            *out++ = '0'+m%10;
+            *out++ = '-';
+            *out++ = '0'+d/10;
+            *out++ = '0'+d%10;
+            return out;
+        }
+        *out++ = '(';
+        out = write_int(y,1,out);
+        *out++ = ',';
+        out = write_unsigned(m,1,out);
+        *out++ = ',';
+        out = write_unsigned(d,1,out);
+        *out++ = ')';
+        return out;
+    }
+
+    void format_dates(const vector<int>& days, Date_format f, string& s)
+    {
+        const size_t start = s.size();
+        s.resize(start+days.size()*25);     // room for the longest date and '\n'
+        char* p = &s[start];
+        for (size_t i = 0; i<days.size(); ++i) {
+            p = format_date(days[i],f,p);
+            *p++ = '\n';
+        }
+        s.resize(p-s.data());
+    }
+
+    //------------------------------------------------------------------------------
+
+    // the number of bits set in w
+    inline int popcount(uint64_t w)
+    {
+#if defined(__GNUC__)
+        return __builtin_popcountll(w);
+#else
+        w -= (w>>1) & 0x5555555555555555ULL;
+        w = (w & 0x3333333333333333ULL) + ((w>>2) & 0x3333333333333333ULL);
+        w = (w + (w>>4)) & 0x0F0F0F0F0F0F0F0FULL;
+        return int((w * 0x0101010101010101ULL) >> 56);
+#endif
+    }
+
+    // the position of the lowest bit set in w, which is not 0
+    inline int lowest_bit(uint64_t w)
+    {
+#if defined(__GNUC__)
+        return __builtin_ctzll(w);
+#else
+        return popcount((w & (0-w)) - 1);
+#endif
+    }
+
+    Business_calendar::Business_calendar(int first_year, int last_year)
+        :first_y(first_year), last_y(last_year),
+        first(days_from_civil(first_year,Date::jan,1)),
+        end(days_from_civil(last_year+1,Date::jan,1)),
+        weekend(1<<saturday | 1<<sunday)
+    {
+        if (last_year < first_year) error("Business_calendar: no years");
+        build();
+    }
+
+    // bit d set for each Day d of days
+    unsigned day_bits(const vector<Day>& days)
+    {
+        unsigned b = 0;
+        for (size_t i = 0; i<days.size(); ++i) b |= 1<<days[i];
+        return b;
+    }
+
+    void Business_calendar::set_weekend(const vector<Day>& days)
+    {
+        weekend = day_bits(days);
+        build();
+    }
+
+    void Business_calendar::add_holiday(Fast_date d)
+    {
+        const int i = index(d);
+        holidays.push_back(d.days());
+        if (bits[i/64] >> i%64 & 1) {      // was a working day: the counts after it change
+            bits[i/64] &= ~(uint64_t(1) << i%64);
+            for (size_t w = i/64+1; w<before.size(); ++w) --before[w];
+        }
+    }
+
+    // the Day called s ("sunday", ...), by its first three letters
+    Day day_called(string s)
+    {
+        static const char* names[] = { "sun", "mon", "tue", "wed", "thu", "fri", "sat" };
+        for (size_t i = 0; i<s.size(); ++i) s[i] = tolower(s[i]);
+        for (int d = sunday; d<=saturday; ++d)
+            if (s.compare(0,3,names[d])==0) return Day(d);
+        error("not a weekday: ",s);
+        return sunday;      // never reached
+    }
+
+    void Business_calendar::load(const string& path)
+    {
+        ifstream ifs(path.c_str());
+        if (!ifs) error("can't open holiday file ",path);
+        vector<int> days;
+        string line;
+        for (int n = 1; getline(ifs,line); ++n) {
+            const size_t c = line.find('#');
+            if (c != string::npos) line.erase(c);
+            istringstream is(line);
+            string word;
+            if (!(is >> word)) continue;    // empty line
+            if (word == "weekend") {
+                vector<Day> wd;
+                while (is >> word) wd.push_back(day_called(word));
+                weekend = day_bits(wd);
+                continue;
+            }
+            int d;
+            const char* e = word.data()+word.size();
+            if (parse_date(word.data(),e,d)!=e || (is >> word))
+                error("bad date in holiday file, line ",to_string(n));
+            if (d<first || end<=d) error("holiday outside the calendar's years: ",word);
+            days.push_back(d);
+        }
+        holidays.insert(holidays.end(),days.begin(),days.end());
+        build();
+    }
+
+    void Business_calendar::build()
+    {
+        const int n = end-first;
+        bits.assign((n+63)/64,0);
+        for (int i = 0; i<n; ++i)
+            if (!(weekend >> weekday(first+i) & 1)) bits[i/64] |= uint64_t(1) << i%64;
+        for (size_t h = 0; h<holidays.size(); ++h) {
+            const int i = holidays[h]-first;
+            bits[i/64] &= ~(uint64_t(1) << i%64);
+        }
+        before.assign(bits.size()+1,0);
+        for (size_t w = 0; w<bits.size(); ++w) before[w+1] = before[w] + popcount(bits[w]);
+    }
+
+    int Business_calendar::index(Fast_date d) const
+    {
+        if (d.days()<first || end<=d.days()) error("Business_calendar: date outside the calendar's years");
+        return d.days()-first;
+    }
+
+    int Business_calendar::rank(int i) const
+    {
+        const int w = i/64;
+        if (i%64 == 0) return before[w];
+        return before[w] + popcount(bits[w] & ((uint64_t(1) << i%64) - 1));
+    }
+
+    int Business_calendar::select(int k) const
+    {
+        if (k<0 || before.back()<=k) error("Business_calendar: result outside the calendar's years");
+        const int w = upper_bound(before.begin(),before.end(),k) - before.begin() - 1;
+        uint64_t b = bits[w];
+        for (int j = k-before[w]; j>0; --j) b &= b-1;  // drop the working days before it
+        return w*64 + lowest_bit(b);
+    }
+
+    bool Business_calendar::is_business_day(Fast_date d) const
+    {
+        const int i = index(d);
+        return bits[i/64] >> i%64 & 1;
+    }
+
+    int Business_calendar::business_days(Fast_date a, Fast_date b) const
+    {
+        const int ia = a.days()==end ? end-first : index(a);   // the day after the calendar
+        const int ib = b.days()==end ? end-first : index(b);   // ends a range
+        return rank(ib) - rank(ia);
+    }
+
+    Fast_date Business_calendar::add_business_days(Fast_date d, int n) const
+    {
+        const int i = index(d);
+        if (n == 0) return d;
+        const int k = n>0 ? rank(i+1)+n-1 : rank(i)+n;
+        return Fast_date::from_days(first+select(k));
+    }
+
+    //------------------------------------------------------------------------------
+
 } // Chrono
 
 namespace Chrono974 {
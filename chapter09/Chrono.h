@@ -1,3 +1,7 @@
+#ifndef CHRONO_GUARD
+#define CHRONO_GUARD
+
+#include<cstdint>
 #include "../lib_files/std_lib_facilities.h"
 
 namespace Chrono {
@@ -33,11 +37,57 @@ namespace Chrono {
 
     //------------------------------------------------------------------------------
 
-    bool is_date(int y, Date::Month m, int d);  // true for valid date
+    // a leap year is disivible by 4, but not by 100, except if it is divisible by 400
+    constexpr bool leapyear(int y)              // true if y is a leap year
+    {
+        return (y%4==0 && y%100!=0) || y%400==0;
+    }
+
+    constexpr int days_in_month(int y, Date::Month m)
+    {
+        return m==Date::feb ? (leapyear(y) ? 29 : 28)
+            : (m==Date::apr || m==Date::jun || m==Date::sep || m==Date::nov) ? 30 : 31;
+    }
+
+    constexpr bool is_date(int y, Date::Month m, int d) // true for valid date
+    {
+        return Date::jan<=m && m<=Date::dec && 0<d && d<=days_in_month(y,m);
+    }
+
+    //------------------------------------------------------------------------------
+
+    // days since Jan 1, 1970 of y/m/d, for any valid date (before 1970: negative)
+    // without loops or tables: years are counted from March 1, so that the leap
+    // day comes last, in eras of 400 years, which all have 146097 days
+    // (H. Hinnant, "chrono-Compatible Low-Level Date Algorithms")
+    constexpr int era_of(int y) { return (y>=0 ? y : y-399)/400; }
+    constexpr int day_of_era(int yoe, int doy) { return yoe*365 + yoe/4 - yoe/100 + doy; }
+    constexpr int day_from_march(int m, int d) { return (153*(m>2 ? m-3 : m+9) + 2)/5 + d-1; }
+    constexpr int days_from_march_year(int y, int m, int d)
+    {
+        return era_of(y)*146097 + day_of_era(y-era_of(y)*400,day_from_march(m,d)) - 719468;
+    }
+    constexpr int days_from_civil(int y, int m, int d)
+    {
+        return days_from_march_year(m<=2 ? y-1 : y,m,d);
+    }
+
+    // the inverse of days_from_civil()
+    inline void civil_from_days(int n, int& y, int& m, int& d)
+    {
+        n += 719468;
+        const int era = (n>=0 ? n : n-146096)/146097;
+        const unsigned doe = n - era*146097;                            // day of era [0:146096]
+        const unsigned yoe = (doe - doe/1460 + doe/36524 - doe/146096)/365; // year of era [0:399]
+        const unsigned doy = doe - (365*yoe + yoe/4 - yoe/100);        // day from March 1 [0:365]
+        const unsigned mp = (5*doy + 2)/153;                            // month from March [0:11]
+        d = doy - (153*mp + 2)/5 + 1;
+        m = mp<10 ? mp+3 : mp-9;
+        y = int(yoe) + era*400 + (m<=2);
+    }
 
     //------------------------------------------------------------------------------
 
-    bool leapyear(int y);                       // true if y is a leap year
     int day_in_year(const Date& d);             // number of day in year
     int n_leapyears(int y);                     // number of leap years between Jan 1 of year y and first_date
     long int days_linear(const Date& d);        // days since first_date (day 0: Jan 1, 1970)
@@ -48,6 +98,48 @@ namespace Chrono {
     Day day_of_week(const Date& d);             // weekday of d
     ostream& operator<<(ostream& os, Day d);
 
+    // weekday of day n since Jan 1, 1970 (a Thursday), also for n < 0
+    constexpr Day weekday(int n) { return Day(n>=-4 ? (n+4)%7 : (n+5)%7+6); }
+
+    //------------------------------------------------------------------------------
+
+    // a Date as the number of days since Jan 1, 1970 (32 bits), for programs
+    // that do a lot of date arithmetic: adding days, differences, weekdays and
+    // comparisons are one integer operation; the fields are computed when
+    // asked for
+    class Fast_date {
+    public:
+        constexpr Fast_date(int y, Date::Month m, int d)   // check for valid date and initialize
+            :n(is_date(y,m,d) ? days_from_civil(y,m,d) : throw Date::Invalid()) { }
+        constexpr Fast_date() :n(days_from_civil(2001,Date::jan,1)) { } // default_date()
+        explicit Fast_date(const Date& dd) :n(days_from_civil(dd.year(),dd.month(),dd.day())) { }
+
+        static constexpr Fast_date from_days(int n) { return Fast_date(n,0); }
+
+        // non-modifying operations:
+        constexpr int days() const { return n; }    // days since Jan 1, 1970
+        constexpr Day weekday() const { return Chrono::weekday(n); }
+        int day() const;
+        Date::Month month() const;
+        int year() const;
+        Date date() const;
+
+        // modifying operations:
+        void add_day(int k) { n += k; }
+        void add_month(int k);          // as Date::add_month()
+        void add_year(int k);           // as Date::add_year()
+    private:
+        constexpr Fast_date(int days, int) :n(days) { }
+        int n;
+    };
+
+    constexpr int operator-(Fast_date a, Fast_date b) { return a.days()-b.days(); } // days from b to a
+    constexpr bool operator==(Fast_date a, Fast_date b) { return a.days()==b.days(); }
+    constexpr bool operator!=(Fast_date a, Fast_date b) { return a.days()!=b.days(); }
+    constexpr bool operator<(Fast_date a, Fast_date b) { return a.days()<b.days(); }
+
+    ostream& operator<<(ostream& os, Fast_date d);
+
     //------------------------------------------------------------------------------
 
     bool operator==(const Date& a, const Date& b);
@@ -60,6 +152,94 @@ namespace Chrono {
 
     //------------------------------------------------------------------------------
 
+    // reading and writing many dates at a time, straight from and to memory:
+    // a file of dates, e.g. mapped into memory, becomes a column of day
+    // numbers (Fast_date::days()) and back, without istreams or ostreams
+    //
+    //     vector<int> days;
+    //     vector<long> bad;
+    //     parse_dates(text.data(),text.data()+text.size(),days,&bad);
+    //     string out;
+    //     format_dates(days,iso_format,out);
+    //
+    // Dates are written as operator<<() writes them, "(2014,1,31)", or as in
+    // ISO 8601, "2014-01-31" (years before 0 or after 9999 as "-0005-01-01"
+    // and "12345-01-01"); parsing takes either, separated by white space.
+    // An ISO date is converted with a few operations on all of its eight
+    // digits at once, held in one 64-bit word.
+    enum Date_format {
+        paren_format,   // (y,m,d)
+        iso_format      // yyyy-mm-dd
+    };
+
+    // read one date at p, in either format; returns where it ends, or 0 if
+    // [p:e) does not start with a valid date
+    const char* parse_date(const char* p, const char* e, int& days);
+
+    // append the days of the dates in [b:e) to days, return how many there
+    // were; bad gets the offsets from b of what are not valid dates, which
+    // are skipped
+    long parse_dates(const char* b, const char* e, vector<int>& days, vector<long>* bad = 0);
+
+    // write a date into out, which must have room for 24 characters
+    // returns the end of what was written
+    char* format_date(int days, Date_format f, char* out);
+
+    // append the dates of days to s, one per line
+    void format_dates(const vector<int>& days, Date_format f, string& s);
+
+    //------------------------------------------------------------------------------
+
+    // which days are working days, from Jan 1 of first_year to Dec 31 of
+    // last_year: not weekend days (Saturday and Sunday unless set otherwise)
+    // and not holidays
+    //
+    //     Business_calendar cal(2000,2050);
+    //     cal.load("holidays.txt");
+    //     Fast_date due = cal.add_business_days(Fast_date(2014,Date::jan,31),10);
+    //     int late = cal.business_days(due,today);
+    //
+    // The calendar is a bitset with one bit per day, set for working days,
+    // precomputed for all its years, and for every 64 days the number of
+    // working days before them, so that counting the working days in any
+    // range is two lookups and two popcounts, and finding the n-th working
+    // day is a binary search of those counts and a search of one word.
+    // Dates outside the years of the calendar are errors.
+    //
+    // A holiday file has one date per line, as "(y,m,d)" or yyyy-mm-dd, and
+    // may have a line "weekend" followed by the names of the weekend days
+    // ("weekend friday saturday"); '#' starts a comment.
+    class Business_calendar {
+    public:
+        Business_calendar(int first_year, int last_year);
+
+        void set_weekend(const vector<Day>& days);  // replaces Saturday and Sunday
+        void add_holiday(Fast_date d);
+        void load(const string& path);              // weekend and holidays from a file
+
+        bool is_business_day(Fast_date d) const;
+        int business_days(Fast_date a, Fast_date b) const;  // in [a:b), negative if b < a
+        Fast_date add_business_days(Fast_date d, int n) const;  // the n-th business day after d (n < 0: before)
+        int first_year() const { return first_y; }
+        int last_year() const { return last_y; }
+    private:
+        int first_y;
+        int last_y;
+        int first;                  // day number of Jan 1, first_year
+        int end;                    // ... and of Jan 1 after last_year
+        unsigned weekend;           // bit d for Day d
+        vector<int> holidays;       // day numbers
+        vector<uint64_t> bits;      // bit i%64 of bits[i/64] for day first+i
+        vector<int> before;         // before[w]: working days in bits[0:w)
+
+        void build();               // compute bits and before from weekend and holidays
+        int index(Fast_date d) const;   // of d in bits, checked
+        int rank(int i) const;      // working days in [first:first+i)
+        int select(int k) const;    // the index of the k+1st working day
+    };
+
+    //------------------------------------------------------------------------------
+
 } // Chrono
 
 namespace Chrono974 {
@@ -161,3 +341,5 @@ namespace Chrono941 {
     // operators
     ostream& operator<<(ostream& os, const Date& d);
 }   // Chrono941
+
+#endif // CHRONO_GUARD
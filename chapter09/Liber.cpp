@@ -145,8 +145,14 @@ namespace Liber {
     }
 
     Library::Library(vector<Book> b, vector<Patron> p, vector<Transaction> t)
-        :books(b), patrons(p), transactions(t)
+        :books(), patrons(), transactions(t)
     {
+        books.reserve(b.size());
+        book_index.reserve(b.size());
+        for (int i = 0; i<b.size(); ++i) add_book(b[i]);
+        patrons.reserve(p.size());
+        patron_index.reserve(p.size());
+        for (int i = 0; i<p.size(); ++i) add_patron(p[i]);
     }
 
     const Library& default_library()
@@ -165,52 +171,58 @@ namespace Liber {
     {
     }
 
+    int Library::book_at(const ISBN& i) const
+    {
+        unordered_map<ISBN,int,ISBN_hash>::const_iterator p = book_index.find(i);
+        return p==book_index.end() ? -1 : p->second;
+    }
+
+    int Library::patron_at(int card_number) const
+    {
+        unordered_map<int,int>::const_iterator p = patron_index.find(card_number);
+        return p==patron_index.end() ? -1 : p->second;
+    }
+
+    const Book* Library::find_book(const ISBN& i) const
+    {
+        const int idx = book_at(i);
+        return idx<0 ? 0 : &books[idx];
+    }
+
+    const Patron* Library::find_patron(int card_number) const
+    {
+        const int idx = patron_at(card_number);
+        return idx<0 ? 0 : &patrons[idx];
+    }
+
     void Library::add_book(const Book& b)
     {
         // check if book is already in library
-        for (int i = 0; i<books.size(); ++i) {
-            if (books[i] == b) error("add_book(): book is already in library");
-        }
+        if (!book_index.insert(make_pair(b.isbn(),int(books.size()))).second)
+            error("add_book(): book is already in library");
         books.push_back(b);
     }
 
     void Library::add_patron(const Patron& p)
     {
         // check if patron is already registered
-        for (int i = 0; i<patrons.size(); ++i) {
-            if (patrons[i] == p) error("add_patron(): patron is already registered");
-        }
+        if (!patron_index.insert(make_pair(p.get_number(),int(patrons.size()))).second)
+            error("add_patron(): patron is already registered");
         patrons.push_back(p);
     }
 
     void Library::check_out(Book& b, const Patron& p, const Chrono::Date& d)
     {
         // check if book is in library
-        bool b_exists = false;
-        int b_idx = 0;
-        for (int i = 0; i<books.size(); ++i) {
-            if (books[i] == b) {
-                b_exists = true;
-                b_idx = i;
-                break;  // no need to look any further
-            }
-        }
-        if (!b_exists) error("check_out(): book is not in library");
+        const int b_idx = book_at(b.isbn());
+        if (b_idx < 0) error("check_out(): book is not in library");
 
         // check if book is checked out
         if (books[b_idx].checked_out()) error("check_out(): book is already checked out");
 
         // check if patron is registered
-        bool p_exists = false;
-        int p_idx = 0;
-        for (int i = 0; i<patrons.size(); ++i) {
-            if (patrons[i] == p) {
-                p_exists = true;
-                p_idx = i;
-                break;  // no need to look any further
-            }
-        }
-        if (!p_exists) error("check_out(): patron is not registered");
+        const int p_idx = patron_at(p.get_number());
+        if (p_idx < 0) error("check_out(): patron is not registered");
 
         // check if patron owes fees
         if (patrons[p_idx].get_fees() > 0) error("check_out(): patron owes library fees");
@@ -223,16 +235,8 @@ namespace Liber {
     void Library::set_fee(const Patron& p, double f)
     {
         // find patron
-        int idx = 0;
-        bool exists = false;
-        for (int i = 0; i<patrons.size(); ++i) {
-            if (patrons[i] == p) {
-                exists = true;
-                idx = i;
-                break;
-            }
-        }
-        if (!exists) error("Library::set_fee(): patron does not exist");
+        const int idx = patron_at(p.get_number());
+        if (idx < 0) error("Library::set_fee(): patron does not exist");
         patrons[idx].set_fee(f);
     }
 
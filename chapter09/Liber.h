@@ -1,3 +1,4 @@
+#include<unordered_map>
 #include "../lib_files/std_lib_facilities.h"
 #include "Chrono.h"
 
@@ -18,6 +19,17 @@ bool is_isbn(int, int, int, char x);  // true for valid ISBN number
 
 bool operator==(const ISBN& i1, const ISBN& i2);
 
+// for unordered_map<ISBN,...>
+struct ISBN_hash {
+    size_t operator()(const ISBN& i) const
+    {
+        size_t h = i.n1;
+        h = h*1000003 ^ i.n2;
+        h = h*1000003 ^ i.n3;
+        return h*1000003 ^ (unsigned char)i.x;
+    }
+};
+
 // simple Book type
 class Book {
 public:
@@ -80,6 +92,9 @@ bool operator==(const Patron& p1, const Patron& p2);
 bool operator!=(const Patron& p1, const Patron& p2);
 
 // library type
+// books and patrons are found through hash tables by ISBN and by card
+// number, so that adding them and checking out a book take the same time
+// however large the library is
 class Library {
 public:
     // type for transaction, combining Book, Customer and Date types
@@ -103,14 +118,21 @@ public:
     void set_fee(const Patron& p, double f);
 
     // nonmodifying operations:
-    vector<Book> get_books() const { return books; }
-    vector<Patron> get_patrons() const { return patrons; }
-    vector<Transaction> get_transactions() const { return transactions; }
+    const vector<Book>& get_books() const { return books; }
+    const vector<Patron>& get_patrons() const { return patrons; }
+    const vector<Transaction>& get_transactions() const { return transactions; }
     vector<Patron> get_debtors() const; // list of patrons who owe fees
+    const Book* find_book(const ISBN& i) const;         // 0 if not in library
+    const Patron* find_patron(int card_number) const;   // 0 if not registered
 
 private:
     vector<Book> books;
     vector<Patron> patrons;
     vector<Transaction> transactions;
+    unordered_map<ISBN,int,ISBN_hash> book_index;   // index in books by ISBN
+    unordered_map<int,int> patron_index;            // index in patrons by card number
+
+    int book_at(const ISBN& i) const;       // index in books, -1 if none
+    int patron_at(int card_number) const;   // index in patrons, -1 if none
 };
 }   // Liber
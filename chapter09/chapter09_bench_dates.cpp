@@ -0,0 +1,109 @@
+// Chapter 09, date benchmark: reading and writing a file's worth of dates
+// through operator>>() and operator<<() and through parse_dates() and
+// format_dates(), and date arithmetic with Date and with Fast_date. Each pair
+// must give the same dates.
+//
+// Usage: chapter09_bench_dates [number of dates]
+//
+// Build with optimisation, e.g.
+// g++ -std=c++11 -O2 chapter09_bench_dates.cpp Chrono.cpp
+
+#include<chrono>
+#include<random>
+#include "Chrono.h"
+
+using namespace Chrono;
+
+//------------------------------------------------------------------------------
+
+double seconds_since(chrono::steady_clock::time_point t)
+{
+    return chrono::duration<double>(chrono::steady_clock::now()-t).count();
+}
+
+template<class F> double time_it(F f)
+{
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    f();
+    return seconds_since(t);
+}
+
+void report(const string& what, long n, double t_fast, double t_slow, bool same)
+{
+    cout << setw(24) << left << what << right << setw(8) << n/t_fast/1e6 << " M/s  vs "
+        << setw(8) << n/t_slow/1e6 << " M/s  (" << t_slow/t_fast << " times as fast)"
+        << (same ? "" : "   DIFFERENT!") << '\n';
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+try {
+    const long n = argc>1 ? atol(argv[1]) : 2000000;
+    cout << setprecision(4);
+
+    // random dates from 1900 to 2100, as Date, as days, and as text
+    mt19937 rng(9);
+    uniform_int_distribution<int> dist(days_from_civil(1900,1,1),days_from_civil(2100,12,31));
+    vector<int> days(n);
+    for (long i = 0; i<n; ++i) days[i] = dist(rng);
+    vector<Date> dates;
+    for (long i = 0; i<n; ++i) dates.push_back(Fast_date::from_days(days[i]).date());
+    string paren;
+    string iso;
+    format_dates(days,paren_format,paren);
+    format_dates(days,iso_format,iso);
+    cout << n << " dates, " << paren.size() << " bytes as (y,m,d), " << iso.size() << " as yyyy-mm-dd\n";
+
+    // reading
+    vector<int> d1;
+    vector<int> d2;
+    vector<int> d3;
+    const double t_istream = time_it([&] {
+        istringstream is(paren);
+        Date dd;
+        while (is >> dd) d1.push_back(days_linear(dd));
+    });
+    const double t_paren = time_it([&] { parse_dates(paren.data(),paren.data()+paren.size(),d2); });
+    const double t_iso = time_it([&] { parse_dates(iso.data(),iso.data()+iso.size(),d3); });
+    report("parse (y,m,d):",n,t_paren,t_istream,d2==days && d1==days);
+    report("parse yyyy-mm-dd:",n,t_iso,t_istream,d3==days);
+
+    // writing
+    string s1;
+    string s2;
+    const double t_ostream = time_it([&] {
+        ostringstream os;
+        for (long i = 0; i<n; ++i) os << dates[i] << '\n';
+        s1 = os.str();
+    });
+    const double t_format = time_it([&] { format_dates(days,paren_format,s2); });
+    report("format (y,m,d):",n,t_format,t_ostream,s1==paren && s2==paren);
+
+    // arithmetic: a week on from each date, and the days between it and the next
+    long sum1 = 0;
+    long sum2 = 0;
+    const double t_date = time_it([&] {
+        Date prev(1970,Date::jan,1);
+        for (long i = 0; i<n; ++i) {
+            Date dd = dates[i];
+            dd.add_day(7);
+            sum1 += days_linear(dd)-days_linear(prev)+day_of_week(dd);
+            prev = dd;
+        }
+    });
+    const double t_fast = time_it([&] {
+        Fast_date prev(1970,Date::jan,1);
+        for (long i = 0; i<n; ++i) {
+            Fast_date dd = Fast_date::from_days(days[i]);
+            dd.add_day(7);
+            sum2 += (dd-prev)+dd.weekday();
+            prev = dd;
+        }
+    });
+    report("add, subtract, weekday:",n,t_fast,t_date,sum1==sum2);
+}
+catch (exception& e) {
+    cerr << "exception: " << e.what() << '\n';
+    return 1;
+}
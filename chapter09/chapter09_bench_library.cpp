@@ -0,0 +1,115 @@
+// Chapter 09, library benchmark: a Library with a million books and a
+// hundred thousand patrons, and a day's worth of check outs of random books
+// by random patrons (some already checked out, some patrons owing fees),
+// each with its due date ten business days later. Compares finding a book
+// through the Library's index with the linear search check_out() used to do.
+//
+// Usage: chapter09_bench_library [books] [patrons] [check outs]
+//
+// Build with optimisation, e.g.
+// g++ -std=c++11 -O2 chapter09_bench_library.cpp Liber.cpp Chrono.cpp
+
+#include<chrono>
+#include<random>
+#include "Liber.h"
+
+using namespace Liber;
+using Chrono::Date;
+using Chrono::Fast_date;
+using Chrono::Business_calendar;
+
+//------------------------------------------------------------------------------
+
+double seconds_since(chrono::steady_clock::time_point t)
+{
+    return chrono::duration<double>(chrono::steady_clock::now()-t).count();
+}
+
+template<class F> double time_it(F f)
+{
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    f();
+    return seconds_since(t);
+}
+
+//------------------------------------------------------------------------------
+
+ISBN isbn_of(int i)
+{
+    return ISBN(i/1000,i%1000,i%97,char('0'+i%10));
+}
+
+// the index of the book with isbn i in v, the way check_out() found it before
+int linear_find(const vector<Book>& v, const ISBN& i)
+{
+    for (int k = 0; k<int(v.size()); ++k)
+        if (v[k].isbn() == i) return k;
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+try {
+    const int n_books = argc>1 ? atoi(argv[1]) : 1000000;
+    const int n_patrons = argc>2 ? atoi(argv[2]) : 100000;
+    const int n_check_outs = argc>3 ? atoi(argv[3]) : 500000;
+    cout << setprecision(4);
+
+    Library lib;
+    const double t_books = time_it([&] {
+        for (int i = 0; i<n_books; ++i)
+            lib.add_book(Book(isbn_of(i),"Title","Author",1900+i%120,Book::Genre(i%5),false));
+    });
+    const double t_patrons = time_it([&] {
+        for (int i = 0; i<n_patrons; ++i)
+            lib.add_patron(Patron("Name",i+1,i%20==0 ? 1.5 : 0));    // every 20th owes fees
+    });
+    cout << n_books << " books added in " << t_books << " s, "
+        << n_patrons << " patrons in " << t_patrons << " s\n";
+
+    Business_calendar cal(2000,2050);
+    const Date today(2014,Date::jan,31);
+    const Fast_date fast_today(today);
+    mt19937 rng(25);
+    uniform_int_distribution<int> book(0,n_books-1);
+    uniform_int_distribution<int> patron(1,n_patrons);
+
+    long failed = 0;
+    long due_sum = 0;
+    const double t_check_out = time_it([&] {
+        for (int i = 0; i<n_check_outs; ++i) {
+            Book b(isbn_of(book(rng)),"","",0,Book::fiction,false);
+            const Patron* p = lib.find_patron(patron(rng));
+            try {
+                lib.check_out(b,*p,today);
+                due_sum += cal.add_business_days(fast_today,10).days();
+            }
+            catch (exception&) {
+                ++failed;   // checked out already, or the patron owes fees
+            }
+        }
+    });
+    cout << n_check_outs << " check outs (" << failed << " refused) in " << t_check_out << " s: "
+        << n_check_outs/t_check_out/1e6 << " M/s; " << lib.get_transactions().size()
+        << " transactions\n";
+
+    // finding books, by index and by linear search (fewer: it is slow)
+    const int n_linear = 200;
+    long found1 = 0;
+    long found2 = 0;
+    const double t_index = time_it([&] {
+        for (int i = 0; i<n_linear; ++i) found1 += lib.find_book(isbn_of(book(rng))) != 0;
+    });
+    const double t_linear = time_it([&] {
+        for (int i = 0; i<n_linear; ++i) found2 += linear_find(lib.get_books(),isbn_of(book(rng))) >= 0;
+    });
+    cout << "finding a book: " << t_index/n_linear*1e9 << " ns by index, "
+        << t_linear/n_linear*1e9 << " ns by linear search ("
+        << t_linear/t_index << " times as long)" << (found1==found2 ? "" : "   DIFFERENT!") << '\n';
+    cout << "(due date check sum " << due_sum << ")\n";
+}
+catch (exception& e) {
+    cerr << "exception: " << e.what() << '\n';
+    return 1;
+}
@@ -0,0 +1,69 @@
+// Chapter 16, calculator benchmark: a script of statements replayed many
+// times, as our batch jobs do, once with the Program cache of Calc_lib
+// (every statement is compiled once and then only run) and once with the
+// cache turned off (every statement goes through the Token_stream and the
+// parser again). The results of both must be the same.
+//
+// Usage: chapter16_bench_calc [repetitions]
+//
+// Build with optimisation, e.g.
+// g++ -std=c++11 -O2 chapter16_bench_calc.cpp chapter16_ex09_calc.cpp
+
+#include<chrono>
+#include "chapter16_ex09_calc.h"
+
+using namespace Calc_lib;
+
+//------------------------------------------------------------------------------
+
+const char* script[] = {
+    "x = x+0.001",
+    "y = x*x-2*x+1",
+    "sqrt(y+1)/(x+1)",
+    "pow(x,3)-pow(y,2)+3*(x-y)",
+    "(x*k+pi)/(e*2)-(1+2+3)*4",
+    "y = -(-y)+0*x",
+};
+
+const int script_size = sizeof(script)/sizeof(*script);
+
+//------------------------------------------------------------------------------
+
+// run script reps times on c, return the seconds taken and the last result
+double replay(Calculator& c, int reps, string& last)
+{
+    c.calculate("let x = 0");
+    c.calculate("let y = 0");
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    for (int r = 0; r<reps; ++r)
+        for (int i = 0; i<script_size; ++i)
+            last = c.calculate(script[i]);
+    return chrono::duration<double>(chrono::steady_clock::now()-t).count();
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+try {
+    const int reps = argc>1 ? atoi(argv[1]) : 100000;
+    const double statements = double(reps)*script_size;
+
+    Calculator parsed;
+    parsed.set_cache_limit(0);
+    string r1;
+    const double t1 = replay(parsed,reps,r1);
+
+    Calculator compiled;
+    string r2;
+    const double t2 = replay(compiled,reps,r2);
+
+    cout << statements << " statements\n"
+        << "parsed every time: " << statements/t1/1e6 << " M statements/s\n"
+        << "compiled once:     " << statements/t2/1e6 << " M statements/s\n"
+        << "speedup: " << t1/t2 << '\n';
+    if (r1 != r2) cout << "different results: " << r1 << " and " << r2 << '\n';
+}
+catch (exception& e) {
+    cerr << "exception: " << e.what() << '\n';
+    return 1;
+}
@@ -0,0 +1,74 @@
+// Chapter 16, column evaluation benchmark: a calculator expression evaluated
+// for ten million values of x, once by setting x and running the compiled
+// Program for each value, and once by calculate_column(), which runs the
+// Program on cache-sized chunks of the column on all cores. Both must give
+// the same values.
+//
+// Usage: chapter16_bench_column [number of values]
+//
+// Build with optimisation, e.g.
+// g++ -std=c++11 -O3 -march=native -pthread chapter16_bench_column.cpp chapter16_ex09_calc.cpp
+
+#include<chrono>
+#include "chapter16_ex09_calc.h"
+
+using namespace Calc_lib;
+
+//------------------------------------------------------------------------------
+
+const char* expressions[] = {
+    "x*2+1",
+    "(x*x-2*x+1)/(x+k)",
+    "sqrt(x*x+1)-pow(x,3)/(1+x*x)+pi*x",
+};
+
+//------------------------------------------------------------------------------
+
+double seconds_since(chrono::steady_clock::time_point t)
+{
+    return chrono::duration<double>(chrono::steady_clock::now()-t).count();
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+try {
+    const long n = argc>1 ? atol(argv[1]) : 10000000;
+    vector<double> x(n);
+    for (long i = 0; i<n; ++i) x[i] = 0.001*(i%100000);
+
+    Calculator calc;
+    calc.calculate("let x = 0");
+    const int slot = calc.symbols().intern("x");
+
+    for (size_t e = 0; e<sizeof(expressions)/sizeof(*expressions); ++e) {
+        const Program& p = calc.compile(expressions[e]);
+
+        vector<double> y1(n);
+        chrono::steady_clock::time_point t = chrono::steady_clock::now();
+        for (long i = 0; i<n; ++i) {
+            calc.symbols().set(slot,x[i]);
+            y1[i] = calc.run(p);
+        }
+        const double t1 = seconds_since(t);
+
+        vector<double> y2;
+        t = chrono::steady_clock::now();
+        calc.calculate_column(expressions[e],"x",x,y2);
+        const double t2 = seconds_since(t);
+
+        long diff = 0;
+        for (long i = 0; i<n; ++i)
+            if (y1[i] != y2[i]) ++diff;
+
+        cout << expressions[e] << ":\n"
+            << "    one value at a time: " << n/t1/1e6 << " M values/s\n"
+            << "    calculate_column():  " << n/t2/1e6 << " M values/s ("
+            << t1/t2 << " times as fast)\n";
+        if (diff) cout << "    " << diff << " values differ!\n";
+    }
+}
+catch (exception& e) {
+    cerr << "exception: " << e.what() << '\n';
+    return 1;
+}
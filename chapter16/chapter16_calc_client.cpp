@@ -0,0 +1,163 @@
+// Chapter 16, load generator for chapter16_calc_server: a number of
+// connections, each on a thread of its own, each sending a stream of
+// statements with up to depth of them on the way at any time (depth 1: wait
+// for every answer). Reports the statements per second over all
+// connections, the 50th and 99th percentile of the time from sending a
+// statement to reading its answer, and the server's own "#stats".
+//
+// Usage: chapter16_calc_client [socket] [connections] [statements per connection] [depth]
+//
+// Build with optimisation, e.g.
+// g++ -std=c++11 -O2 -pthread chapter16_calc_client.cpp
+
+#include<algorithm>
+#include<chrono>
+#include<cstring>
+#include<thread>
+#include<sys/socket.h>
+#include<sys/un.h>
+#include<unistd.h>
+#include "../lib_files/std_lib_facilities.h"
+
+typedef chrono::steady_clock Clock;
+
+//------------------------------------------------------------------------------
+
+const char* statements[] = {
+    "x = x+1",
+    "sqrt(x*x+1)/(x+k)",
+    "pow(x,3)-2*x+pi",
+    "y = x%7",
+    "(x+y)*(x-y)/e",
+};
+
+const int n_statements = sizeof(statements)/sizeof(*statements);
+
+//------------------------------------------------------------------------------
+
+int connect_to(const string& path)
+{
+    sockaddr_un addr;
+    memset(&addr,0,sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) error("socket path too long: ",path);
+    strcpy(addr.sun_path,path.c_str());
+    const int fd = socket(AF_UNIX,SOCK_STREAM,0);
+    if (fd<0 || connect(fd,(sockaddr*)&addr,sizeof(addr))!=0) error("cannot connect to ",path);
+    return fd;
+}
+
+void send_all(int fd, const string& s)
+{
+    for (size_t done = 0; done<s.size(); ) {
+        const ssize_t n = send(fd,s.data()+done,s.size()-done,MSG_NOSIGNAL);
+        if (n <= 0) error("send failed");
+        done += n;
+    }
+}
+
+// read the next line from fd into line, with buf holding what was read beyond it
+void read_line(int fd, string& buf, string& line)
+{
+    size_t e;
+    while ((e = buf.find('\n')) == string::npos) {
+        char tmp[65536];
+        const ssize_t n = read(fd,tmp,sizeof(tmp));
+        if (n <= 0) error("connection closed by the server");
+        buf.append(tmp,n);
+    }
+    line.assign(buf,0,e);
+    buf.erase(0,e+1);
+}
+
+//------------------------------------------------------------------------------
+
+// what one connection measured
+struct Connection_result {
+    vector<double> latencies;   // microseconds
+    long errors;
+    string failure;             // what went wrong, if anything
+    Connection_result() :errors(0) { }
+};
+
+void run_connection(const string& path, long count, int depth, Connection_result& res)
+try {
+    const int fd = connect_to(path);
+    string buf;
+    string line;
+    send_all(fd,"let x = 0\nlet y = 0\n");
+    read_line(fd,buf,line);
+    read_line(fd,buf,line);
+
+    vector<Clock::time_point> sent(count);
+    res.latencies.reserve(count);
+    long n_sent = 0;
+    long n_read = 0;
+    string batch;
+    while (n_read < count) {
+        batch.clear();
+        const Clock::time_point now = Clock::now();
+        for (; n_sent<count && n_sent-n_read<depth; ++n_sent) {
+            batch += statements[n_sent%n_statements];
+            batch += '\n';
+            sent[n_sent] = now;
+        }
+        if (!batch.empty()) send_all(fd,batch);
+
+        read_line(fd,buf,line);
+        res.latencies.push_back(chrono::duration<double,micro>(Clock::now()-sent[n_read]).count());
+        char* end;
+        strtod(line.c_str(),&end);
+        if (end == line.c_str()) ++res.errors;  // not a number: an error message
+        ++n_read;
+    }
+    close(fd);
+}
+catch (exception& e) {
+    res.failure = e.what();
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+try {
+    const string path = argc>1 ? argv[1] : "/tmp/calc.sock";
+    const int connections = argc>2 ? atoi(argv[2]) : 16;
+    const long count = argc>3 ? atol(argv[3]) : 100000;
+    const int depth = argc>4 ? max(1,atoi(argv[4])) : 32;
+
+    vector<Connection_result> results(connections);
+    vector<thread> threads;
+    const Clock::time_point t = Clock::now();
+    for (int i = 0; i<connections; ++i)
+        threads.push_back(thread(run_connection,path,count,depth,ref(results[i])));
+    for (int i = 0; i<connections; ++i) threads[i].join();
+    const double s = chrono::duration<double>(Clock::now()-t).count();
+
+    vector<double> all;
+    long errors = 0;
+    for (int i = 0; i<connections; ++i) {
+        if (!results[i].failure.empty()) cerr << "connection " << i << ": " << results[i].failure << '\n';
+        all.insert(all.end(),results[i].latencies.begin(),results[i].latencies.end());
+        errors += results[i].errors;
+    }
+    if (all.empty()) error("no answers");
+    sort(all.begin(),all.end());
+
+    cout << connections << " connections, depth " << depth << ": " << all.size() << " statements in "
+        << s << " s, " << all.size()/s << " statements/s\n"
+        << "latency p50 " << all[all.size()/2] << " us, p99 " << all[min(all.size()-1,all.size()*99/100)] << " us\n";
+    if (errors) cout << errors << " answers were errors\n";
+
+    const int fd = connect_to(path);
+    send_all(fd,"#stats\n");
+    string buf;
+    string line;
+    read_line(fd,buf,line);
+    close(fd);
+    cout << "server: " << line << '\n';
+}
+catch (exception& e) {
+    cerr << "exception: " << e.what() << '\n';
+    return 1;
+}
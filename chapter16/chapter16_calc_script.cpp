@@ -0,0 +1,51 @@
+// Chapter 16, calculator scripts: run a file of calculator statements, one
+// per line or separated by ';', as fast as Calc_lib can. The file is mapped
+// into memory and tokenized in place; each result (or error, with its line
+// and column) goes on a line of its own, and the throughput to cerr.
+// With -j, the statements are run by run_batch() on that many threads (0: one
+// per core) instead of one after the other by run_script(); the output is the
+// same.
+//
+// Usage: chapter16_calc_script [-j threads] script [output]
+//
+// Build with optimisation, e.g.
+// g++ -std=c++11 -O2 -pthread chapter16_calc_script.cpp chapter16_ex09_calc.cpp
+
+#include<chrono>
+#include "chapter16_ex09_calc.h"
+
+using namespace Calc_lib;
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+try {
+    int threads = -1;       // -1: run_script()
+    if (argc>2 && string(argv[1])=="-j") {
+        threads = atoi(argv[2]);
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc<2) error("usage: chapter16_calc_script [-j threads] script [output]");
+    Script_file script(argv[1]);
+    ofstream ofs;
+    if (argc>2) {
+        ofs.open(argv[2]);
+        if (!ofs) error("cannot open output file ",argv[2]);
+    }
+    ostream& os = argc>2 ? ofs : cout;
+
+    Calculator calc;
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    const long n = threads<0 ? calc.run_script(script.begin(),script.end(),os)
+        : calc.run_batch(script.begin(),script.end(),os,threads);
+    os.flush();
+    const double s = chrono::duration<double>(chrono::steady_clock::now()-t).count();
+
+    cerr << n << " statements, " << script.size() << " bytes in " << s << " s: "
+        << n/s/1e6 << " M statements/s, " << script.size()/s/1e6 << " MB/s\n";
+}
+catch (exception& e) {
+    cerr << "exception: " << e.what() << '\n';
+    return 1;
+}
@@ -0,0 +1,537 @@
+// Chapter 16, calculator server: many calculator sessions at the same time
+// over a Unix domain socket. Every connection is a session with a Calculator
+// (and so a Symbol_table) of its own: the client sends statements, one per
+// line, and gets a line back for each, its value or the error, in order. A
+// client need not wait for an answer before it sends the next statement.
+//
+// One thread runs an epoll loop over all connections: it reads, cuts what
+// it read into lines and writes the answers. The statements are run by a
+// fixed number of worker threads; all statements a session has waiting
+// make up one job, so that no session is ever run by two workers at once
+// and its answers stay in order. The job queue is bounded: when it is full,
+// sessions wait their turn, and the loop stops reading from a session that
+// has max_waiting statements waiting until the workers have caught up.
+//
+// The time from reading a statement to having its answer goes into a
+// histogram. The statement "#stats" is answered with the number of
+// statements and the 50th and 99th percentiles of that time, which are
+// also written to cerr every 10 seconds.
+//
+// Linux only (epoll, eventfd). chapter16_calc_client generates load for it.
+//
+// Usage: chapter16_calc_server [socket] [workers]
+//
+// Build with optimisation, e.g.
+// g++ -std=c++11 -O2 -pthread chapter16_calc_server.cpp chapter16_ex09_calc.cpp
+
+#include<cerrno>
+#include<chrono>
+#include<cmath>
+#include<condition_variable>
+#include<csignal>
+#include<deque>
+#include<functional>
+#include<memory>
+#include<unordered_set>
+#include<sys/epoll.h>
+#include<sys/eventfd.h>
+#include<sys/socket.h>
+#include<sys/un.h>
+#include "chapter16_ex09_calc.h"
+
+using namespace Calc_lib;
+
+typedef chrono::steady_clock Clock;
+
+//------------------------------------------------------------------------------
+
+const int max_waiting = 4096;       // statements read but not run, per session
+const int max_line = 65536;         // longer lines close the session
+const int job_queue_size = 1024;    // sessions waiting for a worker
+
+volatile sig_atomic_t stop_requested = 0;
+
+extern "C" void request_stop(int) { stop_requested = 1; }
+
+//------------------------------------------------------------------------------
+
+// latencies in microseconds, in buckets of an eighth of a power of 2,
+// so that a percentile is off by 6% at most
+class Latency_histogram {
+public:
+    Latency_histogram() :counts(buckets,0), n(0) { }
+    void add(double us);
+    double percentile(double p) const;  // the latency p% of the statements stay under
+    long count() const { return n; }
+private:
+    static const int buckets = 40*8;
+    static int bucket(double us);
+    vector<long> counts;
+    long n;
+};
+
+int Latency_histogram::bucket(double us)
+{
+    if (us < 1) return 0;
+    int e;
+    const double m = frexp(us,&e);  // us = m*2^e, 0.5 <= m < 1
+    return min(e*8+int((m-0.5)*16),buckets-1);
+}
+
+void Latency_histogram::add(double us)
+{
+    ++counts[bucket(us)];
+    ++n;
+}
+
+double Latency_histogram::percentile(double p) const
+{
+    const long target = long(ceil(p/100*n));
+    long sum = 0;
+    for (int b = 0; b<buckets; ++b) {
+        sum += counts[b];
+        if (sum>=target && sum>0) return b==0 ? 1 : ldexp(0.5+(b%8+1)/16.0,b/8);  // the top of the bucket
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+// a connection and its calculator
+struct Session {
+    int fd;
+    Calculator calc;
+    string in;                  // read, not yet a complete line
+    string out;                 // answers not yet written
+    vector<string> waiting;     // statements not yet given to a worker
+    vector<Clock::time_point> waiting_since;
+    vector<string> running;     // statements given to a worker, and their answers
+    vector<Clock::time_point> running_since;
+    string answers;
+    unsigned events;            // what epoll watches for
+    bool busy;                  // a worker has (or will have) running
+    bool queued;                // in the server's ready list
+    bool eof;                   // the client has sent all it will send
+    bool dead;                  // the connection failed: drop everything
+    bool closing;               // to be deleted at the end of this round
+
+    explicit Session(int f)
+        :fd(f), events(0), busy(false), queued(false), eof(false), dead(false), closing(false) { }
+};
+
+//------------------------------------------------------------------------------
+
+// a fixed number of threads running the statements of the Sessions given to
+// them; finished sessions are collected for the event loop, which is woken
+// through wake_fd
+class Worker_pool {
+public:
+    Worker_pool(int n, int capacity, int wake, const function<void(Session*)>& run);
+    ~Worker_pool();
+    bool try_submit(Session* s);            // false if the queue is full
+    void take_finished(vector<Session*>& v);
+private:
+    void work();
+
+    mutex mtx;
+    condition_variable cv;
+    deque<Session*> jobs;
+    vector<Session*> finished;
+    int capacity;
+    int wake_fd;
+    function<void(Session*)> run;
+    bool stop;
+    vector<thread> workers;
+};
+
+Worker_pool::Worker_pool(int n, int cap, int wake, const function<void(Session*)>& r)
+    :capacity(cap), wake_fd(wake), run(r), stop(false)
+{
+    for (int i = 0; i<n; ++i) workers.push_back(thread(&Worker_pool::work,this));
+}
+
+Worker_pool::~Worker_pool()
+{
+    {
+        lock_guard<mutex> lck(mtx);
+        stop = true;
+    }
+    cv.notify_all();
+    for (size_t i = 0; i<workers.size(); ++i) workers[i].join();
+}
+
+bool Worker_pool::try_submit(Session* s)
+{
+    {
+        lock_guard<mutex> lck(mtx);
+        if (int(jobs.size()) >= capacity) return false;
+        jobs.push_back(s);
+    }
+    cv.notify_one();
+    return true;
+}
+
+void Worker_pool::take_finished(vector<Session*>& v)
+{
+    lock_guard<mutex> lck(mtx);
+    v.swap(finished);
+    finished.clear();
+}
+
+void Worker_pool::work()
+{
+    while (true) {
+        Session* s;
+        {
+            unique_lock<mutex> lck(mtx);
+            cv.wait(lck,[this] { return stop || !jobs.empty(); });
+            if (jobs.empty()) return;   // stop
+            s = jobs.front();
+            jobs.pop_front();
+        }
+        run(s);
+        {
+            lock_guard<mutex> lck(mtx);
+            finished.push_back(s);
+        }
+        const uint64_t one = 1;
+        if (write(wake_fd,&one,sizeof(one)) < 0) { }    // the counter can't overflow in practice
+    }
+}
+
+//------------------------------------------------------------------------------
+
+class Calc_server {
+public:
+    Calc_server(const string& path, int workers);
+    ~Calc_server();
+    void serve();           // until SIGINT or SIGTERM
+private:
+    void accept_all();
+    void read_from(Session* s);
+    void write_to(Session* s);
+    void finish_jobs();
+    void dispatch();
+    void watch(Session* s);     // set the epoll events s needs
+    void close_if_done(Session* s);
+    void run(Session* s);       // on a worker thread
+    string stats();
+
+    string path;
+    int listen_fd;
+    int epoll_fd;
+    int wake_fd;
+    int sessions;
+    unordered_set<Session*> live;   // all sessions not closing
+    deque<Session*> ready;      // sessions with statements waiting and no job
+    vector<Session*> closing;
+    mutex stats_mtx;            // for latencies and sessions
+    Latency_histogram latencies;
+    unique_ptr<Worker_pool> pool;
+};
+
+// what an epoll event is for, besides sessions
+char listen_tag;
+char wake_tag;
+
+//------------------------------------------------------------------------------
+
+Calc_server::Calc_server(const string& p, int workers)
+    :path(p), listen_fd(-1), epoll_fd(-1), wake_fd(-1), sessions(0)
+{
+    sockaddr_un addr;
+    memset(&addr,0,sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) error("socket path too long: ",path);
+    strcpy(addr.sun_path,path.c_str());
+    unlink(path.c_str());
+
+    listen_fd = socket(AF_UNIX,SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC,0);
+    if (listen_fd<0 || bind(listen_fd,(sockaddr*)&addr,sizeof(addr))!=0 || listen(listen_fd,SOMAXCONN)!=0)
+        error("cannot listen on ",path);
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC);
+    if (epoll_fd<0 || wake_fd<0) error("cannot make epoll or eventfd");
+
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &listen_tag;
+    epoll_ctl(epoll_fd,EPOLL_CTL_ADD,listen_fd,&ev);
+    ev.data.ptr = &wake_tag;
+    epoll_ctl(epoll_fd,EPOLL_CTL_ADD,wake_fd,&ev);
+
+    pool.reset(new Worker_pool(workers,job_queue_size,wake_fd,[this](Session* s) { run(s); }));
+}
+
+Calc_server::~Calc_server()
+{
+    pool.reset();   // wait for the workers before their sessions go
+    for (unordered_set<Session*>::iterator p = live.begin(); p!=live.end(); ++p) {
+        close((*p)->fd);
+        delete *p;
+    }
+    for (size_t i = 0; i<closing.size(); ++i) delete closing[i];
+    close(listen_fd);
+    close(epoll_fd);
+    close(wake_fd);
+    unlink(path.c_str());
+}
+
+//------------------------------------------------------------------------------
+
+void Calc_server::serve()
+{
+    epoll_event events[256];
+    Clock::time_point last_report = Clock::now();
+    long last_count = 0;
+
+    while (!stop_requested) {
+        const int n = epoll_wait(epoll_fd,events,256,1000);
+        if (n<0 && errno!=EINTR) error("epoll_wait failed");
+        for (int i = 0; i<n; ++i) {
+            void* tag = events[i].data.ptr;
+            if (tag == &listen_tag) accept_all();
+            else if (tag == &wake_tag) finish_jobs();
+            else {
+                Session* s = static_cast<Session*>(tag);
+                if (s->closing) continue;
+                if (events[i].events & (EPOLLERR|EPOLLHUP) && !(events[i].events & EPOLLIN)) s->dead = true;
+                if (events[i].events & EPOLLIN) read_from(s);
+                if (events[i].events & EPOLLOUT) write_to(s);
+                watch(s);
+                close_if_done(s);
+            }
+        }
+        dispatch();
+        for (size_t i = 0; i<closing.size(); ++i) delete closing[i];
+        closing.clear();
+
+        if (Clock::now()-last_report > chrono::seconds(10)) {
+            last_report = Clock::now();
+            lock_guard<mutex> lck(stats_mtx);
+            if (latencies.count() != last_count) {
+                last_count = latencies.count();
+                cerr << stats() << '\n';
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void Calc_server::accept_all()
+{
+    while (true) {
+        const int fd = accept4(listen_fd,0,0,SOCK_NONBLOCK|SOCK_CLOEXEC);
+        if (fd < 0) return;     // EAGAIN, or a connection that went away already
+        Session* s = new Session(fd);
+        live.insert(s);
+        epoll_event ev;
+        ev.events = s->events = EPOLLIN;
+        ev.data.ptr = s;
+        epoll_ctl(epoll_fd,EPOLL_CTL_ADD,fd,&ev);
+        lock_guard<mutex> lck(stats_mtx);
+        ++sessions;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// read what is there, up to max_waiting statements
+void Calc_server::read_from(Session* s)
+{
+    char buf[65536];
+    while (!s->eof && !s->dead && s->waiting.size()<max_waiting) {
+        const ssize_t n = read(s->fd,buf,sizeof(buf));
+        if (n == 0) {
+            s->eof = true;
+            if (!s->in.empty()) {   // the last statement, without its '\n'
+                s->waiting.push_back(s->in);
+                s->waiting_since.push_back(Clock::now());
+                s->in.clear();
+            }
+        }
+        else if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN) s->dead = true;
+            break;
+        }
+        else {
+            const Clock::time_point now = Clock::now();
+            s->in.append(buf,n);
+            size_t b = 0;
+            for (size_t e; (e = s->in.find('\n',b)) != string::npos; b = e+1) {
+                const size_t len = e>b && s->in[e-1]=='\r' ? e-b-1 : e-b;
+                s->waiting.push_back(s->in.substr(b,len));
+                s->waiting_since.push_back(now);
+            }
+            s->in.erase(0,b);
+            if (s->in.size() > max_line) s->dead = true;
+        }
+    }
+    if (!s->waiting.empty() && !s->busy && !s->queued) {
+        s->queued = true;
+        ready.push_back(s);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// write what the socket takes
+void Calc_server::write_to(Session* s)
+{
+    size_t done = 0;
+    while (done < s->out.size()) {
+        const ssize_t n = send(s->fd,s->out.data()+done,s->out.size()-done,MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN) s->dead = true;
+            break;
+        }
+        done += n;
+    }
+    s->out.erase(0,done);
+}
+
+//------------------------------------------------------------------------------
+
+// hand the answers of the finished jobs to their sessions
+void Calc_server::finish_jobs()
+{
+    uint64_t count;
+    if (read(wake_fd,&count,sizeof(count)) < 0) { }     // EAGAIN: nothing to do
+    vector<Session*> done;
+    pool->take_finished(done);
+
+    const Clock::time_point now = Clock::now();
+    {
+        lock_guard<mutex> lck(stats_mtx);
+        for (size_t i = 0; i<done.size(); ++i)
+            for (size_t k = 0; k<done[i]->running_since.size(); ++k)
+                latencies.add(chrono::duration<double,micro>(now-done[i]->running_since[k]).count());
+    }
+
+    for (size_t i = 0; i<done.size(); ++i) {
+        Session* s = done[i];
+        s->busy = false;
+        s->running.clear();
+        s->running_since.clear();
+        if (s->dead) {
+            close_if_done(s);
+            continue;
+        }
+        s->out += s->answers;
+        s->answers.clear();
+        write_to(s);
+        if (!s->waiting.empty() && !s->queued) {
+            s->queued = true;
+            ready.push_back(s);
+        }
+        watch(s);
+        close_if_done(s);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// give the waiting statements of ready sessions to the workers
+void Calc_server::dispatch()
+{
+    while (!ready.empty()) {
+        Session* s = ready.front();
+        if (!s->dead) {
+            swap(s->running,s->waiting);
+            swap(s->running_since,s->waiting_since);
+            if (!pool->try_submit(s)) {     // the queue is full
+                swap(s->running,s->waiting);
+                swap(s->running_since,s->waiting_since);
+                return;
+            }
+            s->busy = true;
+        }
+        ready.pop_front();
+        s->queued = false;
+        watch(s);
+        close_if_done(s);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void Calc_server::watch(Session* s)
+{
+    if (s->closing) return;
+    unsigned events = 0;
+    if (!s->eof && !s->dead && s->waiting.size()<max_waiting) events |= EPOLLIN;
+    if (!s->out.empty() && !s->dead) events |= EPOLLOUT;
+    if (events == s->events) return;
+    epoll_event ev;
+    ev.events = s->events = events;
+    ev.data.ptr = s;
+    epoll_ctl(epoll_fd,EPOLL_CTL_MOD,s->fd,&ev);
+}
+
+//------------------------------------------------------------------------------
+
+// close s if it failed, or the client is done and has all its answers;
+// s is deleted at the end of the round, as other events may still refer to it
+void Calc_server::close_if_done(Session* s)
+{
+    if (s->closing || s->busy || s->queued) return;
+    if (!s->dead && !(s->eof && s->waiting.empty() && s->out.empty())) return;
+    epoll_ctl(epoll_fd,EPOLL_CTL_DEL,s->fd,0);
+    close(s->fd);
+    s->closing = true;
+    live.erase(s);
+    closing.push_back(s);
+    lock_guard<mutex> lck(stats_mtx);
+    --sessions;
+}
+
+//------------------------------------------------------------------------------
+
+void Calc_server::run(Session* s)
+{
+    for (size_t i = 0; i<s->running.size(); ++i) {
+        if (s->running[i] == "#stats") {
+            lock_guard<mutex> lck(stats_mtx);
+            s->answers += stats();
+        }
+        else s->answers += s->calc.calculate(s->running[i]);
+        s->answers += '\n';
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// with stats_mtx held
+string Calc_server::stats()
+{
+    ostringstream os;
+    os << "statements " << latencies.count() << ", p50 " << latencies.percentile(50)
+        << " us, p99 " << latencies.percentile(99) << " us, sessions " << sessions;
+    return os.str();
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+try {
+    const string path = argc>1 ? argv[1] : "/tmp/calc.sock";
+    const int workers = argc>2 ? atoi(argv[2]) : max(1u,thread::hardware_concurrency());
+
+    struct sigaction sa;
+    memset(&sa,0,sizeof(sa));
+    sa.sa_handler = request_stop;   // no SA_RESTART: epoll_wait() returns
+    sigaction(SIGINT,&sa,0);
+    sigaction(SIGTERM,&sa,0);
+    signal(SIGPIPE,SIG_IGN);
+
+    Calc_server server(path,workers);
+    cerr << "serving on " << path << " with " << workers << " workers\n";
+    server.serve();
+}
+catch (exception& e) {
+    cerr << "exception: " << e.what() << '\n';
+    return 1;
+}
@@ -1,39 +1,58 @@
 // This is calculator support code for the GUI version of the calculator
 
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include<windows.h>
+#else
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+#endif
 #include "chapter16_ex09_calc.h"
 
 namespace Calc_lib {;
 
 // -----------------------------------------------------------------------
 
-// constructor
-Token_stream::Token_stream()
-    :full(false), buffer(0) { } // no Token in buffer
+// read [b:e); line is that of b
+Token_stream::Token_stream(const char* b, const char* e, Symbol_table& st, int l)
+    :p(b), end(e), line_start(b), line(l), names(st), first(0), count(0) { }
 
 // -----------------------------------------------------------------------
 
-// read from stringstream instead of cin
-Token_stream::Token_stream(string s)
-    :full(false), buffer(0), iss(s) { }
+// read from s, without copying it
+Token_stream::Token_stream(const string& s, Symbol_table& st)
+    :p(s.data()), end(s.data()+s.size()), line_start(s.data()), line(1), names(st), first(0), count(0) { }
 
 // -----------------------------------------------------------------------
 
-// read characters from iss and compose a Token
-Token Token_stream::get()
+inline bool is_name_char(char ch) { return isalpha(ch) || isdigit(ch) || ch=='_'; }
+
+// compose a Token from the characters at p
+Token Token_stream::read()
 {
-    if (full) { // check if we already have a Token ready
-        full = false;
-        return buffer;
-    }
-    if (iss.eof()) return print;
-    char ch;
-    iss.get(ch);    // note that get() does NOT skip whitespace
-    while (isspace(ch)) {
-        //if (ch == '\n') return Token(print); // if newline detected, return print Token
-        iss.get(ch);
-        if (iss.eof()) return print;
+    while (p<end && isspace(*p)) {
+        //if (*p == '\n') return Token(print); // if newline detected, return print Token
+        if (*p == '\n') {
+            ++line;
+            line_start = p+1;
+        }
+        ++p;
     }
 
+    Token t(print);
+    t.text = p;
+    t.line = line;
+    t.column = p-line_start+1;
+    if (p == end) return t;   // end of input: as if print
+
+    const char ch = *p;
     switch (ch) {
     //case print:
     case '(':
@@ -45,41 +64,75 @@ Token Token_stream::get()
     case '%':
     case '=':
     case ',':
-        return Token(ch);   // let each character represent itself
+        t.kind = ch;        // let each character represent itself
+        t.size = 1;
+        ++p;
+        return t;
     case '.':   // a floating-point-literal can start with a dot
     case '0': case '1': case '2': case '3': case '4':
     case '5': case '6': case '7': case '8': case '9':   // numeric literal
-    {	iss.putback(ch);    // put digit back into the input stream
-        double val;
-        iss >> val;         // read a floating-point number
-        return Token(number,val);
-    }
+        t.kind = number;
+        p = parse_number(p,end,t.value);
+        t.size = p-t.text;
+        return t;
     default:
         if (isalpha(ch)) {
-            string s;
-            s += ch;
-            while (iss.get(ch) && !iss.eof() && (isalpha(ch) || isdigit(ch) || ch=='_')) s+=ch;
-            if (!iss.eof()) iss.putback(ch);
-            if (s == declkey) return Token(let);            // declaration keyword
-            if (s == conkey) return Token(con);             // constant keyword
-            if (s == sqrtkey) return Token(square_root);    // square root keyword
-            if (s == powkey) return Token(power);           // power function keyword
-            //if (s == helpkey) return Token(help);           // help keyword
-            //if (s == quitkey) return Token(quit);           // quit keyword
-            return Token(name,s);
+            const char* q = p+1;
+            while (q<end && is_name_char(*q)) ++q;
+            t.size = q-p;
+            p = q;
+            if (t.size==3 && memcmp(t.text,"let",3)==0) t.kind = let;               // declaration keyword
+            else if (t.size==5 && memcmp(t.text,"const",5)==0) t.kind = con;        // constant keyword
+            else if (t.size==4 && memcmp(t.text,"sqrt",4)==0) t.kind = square_root; // square root keyword
+            else if (t.size==3 && memcmp(t.text,"pow",3)==0) t.kind = power;        // power function keyword
+            else {
+                t.kind = name;
+                t.slot = names.intern(t.text,t.size);
+            }
+            return t;
         }
+        last = t;   // for where()
         error("Bad token");
     }
+    return t;
+}
+
+// -----------------------------------------------------------------------
+
+// get the next Token
+Token Token_stream::get()
+{
+    if (count == 0) last = read();
+    else {  // check if we already have a Token ready
+        last = ahead[first];
+        first = (first+1)%max_ahead;
+        --count;
+    }
+    return last;
+}
+
+// -----------------------------------------------------------------------
+
+// look n Tokens ahead without consuming them
+const Token& Token_stream::peek(int n)
+{
+    if (n >= max_ahead) error("peek() too far ahead");
+    while (count <= n) {
+        ahead[(first+count)%max_ahead] = read();
+        ++count;
+    }
+    return ahead[(first+n)%max_ahead];
 }
 
 // -----------------------------------------------------------------------
 
-// put Token back into Token stream
+// put Token back into Token stream; several can be put back
 void Token_stream::putback(Token t)
 {
-    if (full) error("putback() into full buffer");
-    buffer = t;     // copy t to buffer
-    full = true;    // buffer is now full
+    if (count == max_ahead) error("putback() into full buffer");
+    first = (first+max_ahead-1)%max_ahead;
+    ahead[first] = t;
+    ++count;
 }
 
 // -----------------------------------------------------------------------
@@ -89,16 +142,192 @@ void Token_stream::ignore(char c)
 // c represents the kind of Token
 {
     // first look in buffer:
-    if (full && c==buffer.kind) {
-        full = false;
-        return;
+    while (count > 0) {
+        const char k = ahead[first].kind;
+        first = (first+1)%max_ahead;
+        --count;
+        if (k == c) return;
     }
-    full = false;
 
     // now search input:
-    char ch = 0;
-    while (iss>>ch)
-    if (ch==c) return;
+    while (p<end) {
+        if (*p == '\n') {
+            ++line;
+            line_start = p+1;
+        }
+        if (*p++ == c) return;
+    }
+}
+
+// -----------------------------------------------------------------------
+
+// where the last Token got starts
+string Token_stream::where() const
+{
+    ostringstream os;
+    os << "line " << last.line << ", column " << last.column;
+    return os.str();
+}
+
+// -----------------------------------------------------------------------
+
+// hand-written conversion of a floating-point-literal
+// digits are gathered into an integer and scaled by an exact power of 10:
+// both are exact and only one rounding happens (Clinger's fast path)
+const char* parse_number(const char* p, const char* e, double& d)
+{
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char* const b = p;
+    unsigned long long m = 0;   // the significant digits
+    int digits = 0;             // ... how many of them
+    int scale = 0;              // m*10^scale is the value
+    while (p<e && *p=='0') ++p; // leading zeros are not significant
+    for (; p<e && isdigit(*p); ++p, ++digits)
+        if (digits < 19) m = m*10+(*p-'0');
+        else ++scale;
+    if (p<e && *p=='.') {
+        ++p;
+        if (digits == 0)
+            for (; p<e && *p=='0'; ++p) --scale;
+        for (; p<e && isdigit(*p); ++p, ++digits)
+            if (digits < 19) {
+                m = m*10+(*p-'0');
+                --scale;
+            }
+    }
+    if (p==b+1 && *b=='.') error("Bad token");  // a lone '.'
+    if (p<e && (*p=='e' || *p=='E')) {  // an exponent, if digits follow
+        const char* q = p+1;
+        bool neg = false;
+        if (q<e && (*q=='+' || *q=='-')) neg = *q++=='-';
+        if (q<e && isdigit(*q)) {
+            int x = 0;
+            for (; q<e && isdigit(*q); ++q)
+                if (x < 100000) x = x*10+(*q-'0');
+            scale += neg ? -x : x;
+            p = q;
+        }
+    }
+
+    if (digits<=15 && -22<=scale && scale<=22) {    // m < 2^53: exact as a double
+        d = scale<0 ? double(m)/pow10[-scale] : double(m)*pow10[scale];
+        return p;
+    }
+    if (m == 0) {
+        d = 0;
+        return p;
+    }
+    string s(b,p);  // the rare case: let the library round correctly
+    d = strtod(s.c_str(),0);
+    return p;
+}
+
+// -----------------------------------------------------------------------
+
+Symbol_table::Symbol_table()
+    :index(64,0) { }
+
+// -----------------------------------------------------------------------
+
+// FNV-1a
+size_t Symbol_table::hash(const char* s, int n)
+{
+    size_t h = 2166136261u;
+    for (int i = 0; i<n; ++i) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// -----------------------------------------------------------------------
+
+// the entry of index that holds s[0:n), or the free one where it belongs
+size_t Symbol_table::probe(const char* s, int n, size_t h) const
+{
+    const size_t mask = index.size()-1;
+    for (size_t i = h&mask; ; i = (i+1)&mask) {
+        const int e = index[i];
+        if (e == 0) return i;
+        const string& en = var_table[e-1].name;
+        if (int(en.size())==n && memcmp(en.data(),s,n)==0) return i;
+    }
+}
+
+// -----------------------------------------------------------------------
+
+// double the size of index
+void Symbol_table::grow()
+{
+    vector<int> old(index.size()*2,0);
+    swap(old,index);
+    for (int i = 0; i<int(var_table.size()); ++i) {
+        const string& n = var_table[i].name;
+        index[probe(n.data(),n.size(),hash(n.data(),n.size()))] = i+1;
+    }
+}
+
+// -----------------------------------------------------------------------
+
+// the slot of s[0:n); a new name gets a slot, but is not declared
+int Symbol_table::intern(const char* s, int n)
+{
+    size_t i = probe(s,n,hash(s,n));
+    if (index[i]) return index[i]-1;
+    if (2*(var_table.size()+1) > index.size()) {
+        grow();
+        i = probe(s,n,hash(s,n));
+    }
+    var_table.push_back(Variable(string(s,s+n),0,false));
+    var_table.back().is_declared = false;
+    index[i] = var_table.size();
+    return var_table.size()-1;
+}
+
+// -----------------------------------------------------------------------
+
+// the slot of s, -1 if s was never seen
+int Symbol_table::find(const string& s) const
+{
+    const int e = index[probe(s.data(),s.size(),hash(s.data(),s.size()))];
+    return e-1;
+}
+
+// -----------------------------------------------------------------------
+
+// return the value of the Variable in slot
+double Symbol_table::get(int slot)
+{
+    const Variable& v = var_table[slot];
+    if (!v.is_declared) error("get: undefined variable ",v.name);
+    return v.value;
+}
+
+// -----------------------------------------------------------------------
+
+// set the Variable in slot to d
+void Symbol_table::set(int slot, double d)
+{
+    Variable& v = var_table[slot];
+    if (!v.is_declared) error("set: undefined variable ",v.name);
+    if (v.is_const) error(v.name," is a constant");
+    v.value = d;
+}
+
+// -----------------------------------------------------------------------
+
+// declare the name in slot with value val
+double Symbol_table::declare(int slot, double val, bool b)
+{
+    Variable& v = var_table[slot];
+    if (v.is_declared) error(v.name," declared twice");
+    v.value = val;
+    v.is_const = b;
+    v.is_declared = true;
+    return val;
 }
 
 // -----------------------------------------------------------------------
@@ -106,9 +335,9 @@ void Token_stream::ignore(char c)
 // return the value of the Variable named s
 double Symbol_table::get(string s)
 {
-    for (int i = 0; i<var_table.size(); ++i)
-    if (var_table[i].name == s) return var_table[i].value;
-    error("get: undefined variable ",s);
+    const int slot = find(s);
+    if (slot < 0) error("get: undefined variable ",s);
+    return get(slot);
 }
 
 // -----------------------------------------------------------------------
@@ -116,13 +345,9 @@ double Symbol_table::get(string s)
 // set the Variable named s to d
 void Symbol_table::set(string s, double d)
 {
-    for (int i = 0; i<var_table.size(); ++i)
-    if (var_table[i].name == s) {
-        if (var_table[i].is_const) error(s," is a constant");
-        var_table[i].value = d;
-        return;
-    }
-    error("set: undefined variable ",s);
+    const int slot = find(s);
+    if (slot < 0) error("set: undefined variable ",s);
+    set(slot,d);
 }
 
 // -----------------------------------------------------------------------
@@ -130,9 +355,8 @@ void Symbol_table::set(string s, double d)
 // is var already in var_table?
 bool Symbol_table::is_declared(string var)
 {
-    for (int i = 0; i<var_table.size(); ++i)
-    if (var_table[i].name == var) return true;
-    return false;
+    const int slot = find(var);
+    return slot>=0 && var_table[slot].is_declared;
 }
 
 // -----------------------------------------------------------------------
@@ -140,9 +364,7 @@ bool Symbol_table::is_declared(string var)
 // add (var,val) to var_table
 double Symbol_table::declare(string var, double val, bool b)
 {
-    if (is_declared(var)) error(var," declared twice");
-    var_table.push_back(Variable(var,val,b));
-    return val;
+    return declare(intern(var),val,b);
 }
 
 // -----------------------------------------------------------------------
@@ -171,6 +393,7 @@ double my_pow(double base, int expo)
 // initialise Calculator with predefined names
 // Token stream initialisation goes either here or into calculate()
 Calculator::Calculator()
+    :cache_limit(10000)
 {
     st.declare("pi",3.1415926535,true);
     st.declare("e",2.7182818284,true);
@@ -179,49 +402,119 @@ Calculator::Calculator()
 
 // -----------------------------------------------------------------------
 
+// the unary operations: op_neg, op_sqrt and op_pow
+inline double unary(const Instruction& in, double d)
+{
+    switch (in.op) {
+    case op_neg:
+        return -d;
+    case op_sqrt:
+        if (d < 0) error("Square roots of negative numbers... nope!");
+        return sqrt(d);
+    default:
+        return my_pow(d,in.arg);
+    }
+}
+
+// -----------------------------------------------------------------------
+
+// the binary operations: op_add, op_sub, op_mul, op_div and op_mod
+inline double binary(Opcode op, double left, double d)
+{
+    switch (op) {
+    case op_add:
+        return left+d;
+    case op_sub:
+        return left-d;
+    case op_mul:
+        return left*d;
+    case op_div:
+        if (d == 0) error("divide by zero");
+        return left/d;
+    default:
+    {   int i1 = int(left);
+        if (i1 != left) error("left-hand operand of % not int");
+        int i2 = int(d);
+        if (i2 != d) error("right-hand operand of % not int");
+        if (i2 == 0) error("%: divide by zero");
+        return i1%i2;
+    }
+    }
+}
+
+// -----------------------------------------------------------------------
+
+// append in to p.code; an operation on constants is done right away
+// unless it fails: then the error is left for run() to report
+void emit(Program& p, const Instruction& in)
+{
+    vector<Instruction>& c = p.code;
+    const int n = c.size();
+    try {
+        if ((in.op==op_neg || in.op==op_sqrt || in.op==op_pow)
+            && n>=1 && c[n-1].op==op_number) {
+            c[n-1].value = unary(in,c[n-1].value);
+            return;
+        }
+        if (in.op>=op_add && n>=2 && c[n-2].op==op_number && c[n-1].op==op_number) {
+            c[n-2].value = binary(in.op,c[n-2].value,c[n-1].value);
+            c.pop_back();
+            return;
+        }
+    }
+    catch (exception&) { }
+    c.push_back(in);
+}
+
+// -----------------------------------------------------------------------
+
 // deal with numbers, unary +/-, parentheses, sqrt, pow, names and assignments
 // calls expression()
-double Calculator::primary(Token_stream& ts)
+void Calculator::primary(Token_stream& ts, Program& p)
 {
     Token t = ts.get();
     switch (t.kind) {
     case '(':   // handle '(' expression ')'
-    {	double d = expression(ts);
+    {	expression(ts,p);
         t = ts.get();
         if (t.kind != ')') error("')' expected");
-        return d;
+        return;
     }
     case '-':
-        return -primary(ts);
+        primary(ts,p);
+        emit(p,Instruction(op_neg));
+        return;
     case '+':
-        return primary(ts);
+        primary(ts,p);
+        return;
     case number:
-        return t.value;
+        emit(p,Instruction(op_number,0,t.value));
+        return;
     case name:
     {   Token t2 = ts.get();    // check next token
         if (t2.kind == '=') {   // handle name '=' expression
-            double d = expression(ts);
-            st.set(t.name,d);
-            return d;
+            expression(ts,p);
+            emit(p,Instruction(op_set,t.slot));
         }
         else {  // not an assignment
             ts.putback(t2);
-            return st.get(t.name);
+            emit(p,Instruction(op_get,t.slot));
         }
+        return;
     }
     case square_root:   // handle 'sqrt(' expression ')'
     {   t = ts.get();
         if (t.kind != '(') error("'(' expected");
-        double d = expression(ts);
-        if (d < 0) error("Square roots of negative numbers... nope!");
+        expression(ts,p);
         t = ts.get();
         if (t.kind != ')') error("')' expected");
-        return sqrt(d);
+        emit(p,Instruction(op_sqrt));
+        return;
     }
     case power: // handle 'pow(' expression ',' integer ')'
     {   t = ts.get();
         if (t.kind != '(') error("'(' expected");
-        double d = expression(ts);
+        expression(ts,p);
         t = ts.get();
         if (t.kind != ',') error("',' expected");
         t = ts.get();
@@ -230,7 +523,8 @@ double Calculator::primary(Token_stream& ts)
         if (i != t.value) error("second argument of 'pow' is not an integer");
         t = ts.get();
         if (t.kind != ')') error("')' expected");
-        return my_pow(d,i);
+        emit(p,Instruction(op_pow,i));
+        return;
     }
     default:
         error("primary expected");
@@ -241,38 +535,31 @@ double Calculator::primary(Token_stream& ts)
 
 // deal with *, / and %
 // calls primary()
-double Calculator::term(Token_stream& ts)
+void Calculator::term(Token_stream& ts, Program& p)
 {
-    double left = primary(ts);
+    primary(ts,p);
     Token t = ts.get(); // get the next token from Token_stream
 
     while (true) {
         switch (t.kind) {
         case '*':
-            left *= primary(ts);
+            primary(ts,p);
+            emit(p,Instruction(op_mul));
             t = ts.get();
             break;
         case '/':
-        {	double d = primary(ts);
-            if (d == 0) error("divide by zero");
-            left /= d;
+            primary(ts,p);
+            emit(p,Instruction(op_div));
             t = ts.get();
             break;
-        }
         case '%':
-        {   double d = primary(ts);
-            int i1 = int(left);
-            if (i1 != left) error("left-hand operand of % not int");
-            int i2 = int(d);
-            if (i2 != d) error("right-hand operand of % not int");
-            if (i2 == 0) error("%: divide by zero");
-            left = i1%i2;
+            primary(ts,p);
+            emit(p,Instruction(op_mod));
             t = ts.get();
             break;
-        }
         default:
             ts.putback(t);  // put t back into the Token_stream
-            return left;
+            return;
         }
     }
 }
@@ -281,26 +568,28 @@ double Calculator::term(Token_stream& ts)
 
 // deal with + and -
 // calls term()
-double Calculator::expression(Token_stream& ts)
+void Calculator::expression(Token_stream& ts, Program& p)
 {
-    double left = term(ts);  // read and evaluate a Term
+    term(ts,p);         // read and compile a Term
     Token t = ts.get(); // get the next Token from the Token stream
 
     while (true) {
         switch (t.kind) {
         case '+':
-            left += term(ts); // evaluate Term and add
+            term(ts,p); // compile Term and add
+            emit(p,Instruction(op_add));
             t = ts.get();
             break;
         case '-':
-            left -= term(ts); // evaluate Term and subtract
+            term(ts,p); // compile Term and subtract
+            emit(p,Instruction(op_sub));
             t = ts.get();
             break;
         case '=':
             error("use of '=' outside of a declaration");
         default:
             ts.putback(t);  // put t back into the token stream
-            return left;    // finally: no more + or -; return the answer
+            return;         // finally: no more + or -
         }
     }
 }
@@ -310,35 +599,599 @@ double Calculator::expression(Token_stream& ts)
 // assume we have seen "let" or "const"
 // handle: name = expression
 // declare a variable called "name" with the initial value "expression"
-double Calculator::declaration(bool b, Token_stream& ts)
+void Calculator::declaration(bool b, Token_stream& ts, Program& p)
 {
     Token t = ts.get();
     if (t.kind != name) error("name expected in declaration");
-    string var_name = t.name;
 
     Token t2 = ts.get();
-    if (t2.kind != '=') error("= missing in declaration of ",var_name);
+    if (t2.kind != '=') error("= missing in declaration of ",t.str());
 
-    double d = expression(ts);
-    st.declare(var_name,d,b);
-    return d;
+    expression(ts,p);
+    emit(p,Instruction(b ? op_const : op_let,t.slot));
 }
 
 // -----------------------------------------------------------------------
 
 // handles declarations and expressions
-double Calculator::statement(Token_stream& ts)
+void Calculator::statement(Token_stream& ts, Program& p)
 {
     Token t = ts.get();
     switch (t.kind) {
     case let:
-        return declaration(false,ts);
+        declaration(false,ts,p);
+        break;
     case con:
-        return declaration(true,ts);
+        declaration(true,ts,p);
+        break;
     default:
         ts.putback(t);
-        return expression(ts);
+        expression(ts,p);
+    }
+
+    // the deepest the stack gets: loads push, binary operations pop
+    int depth = 0;
+    for (size_t i = 0; i<p.code.size(); ++i) {
+        if (p.code[i].op==op_number || p.code[i].op==op_get) ++depth;
+        else if (p.code[i].op>=op_add) --depth;
+        if (p.max_depth < depth) p.max_depth = depth;
+    }
+}
+
+// -----------------------------------------------------------------------
+
+// compile input, or find it in the cache
+// a statement that doesn't compile throws and is not cached
+const Program& Calculator::compile(const string& input)
+{
+    return compile(input.data(),input.data()+input.size(),0);
+}
+
+// -----------------------------------------------------------------------
+
+// compile [b:e), which starts on line; with line>0 errors say where they are
+const Program& Calculator::compile(const char* b, const char* e, int line)
+{
+    string key;
+    if (cache_limit > 0) {
+        key.assign(b,e);
+        unordered_map<string,Program,Source_hash>::iterator it = cache.find(key);
+        if (it != cache.end()) return it->second;
+    }
+
+    Program p;
+    Token_stream ts(b,e,st,line>0 ? line : 1);
+    try {
+        statement(ts,p);
+    }
+    catch (exception& x) {
+        if (line > 0) error(ts.where()+": "+x.what());
+        throw;
+    }
+
+    if (cache_limit == 0) {
+        swap(uncached,p);
+        return uncached;
+    }
+    if (int(cache.size()) >= cache_limit) cache.clear();    // simplest of eviction policies
+    Program& q = cache[key];
+    swap(q,p);
+    return q;
+}
+
+// -----------------------------------------------------------------------
+
+// execute p on the stack machine
+double Calculator::run(const Program& p)
+{
+    if (int(stack.size()) < p.max_depth) stack.resize(p.max_depth);
+    double* sp = stack.empty() ? 0 : &stack[0];    // one beyond the top of the stack
+
+    for (size_t i = 0; i<p.code.size(); ++i) {
+        const Instruction& in = p.code[i];
+        switch (in.op) {
+        case op_number:
+            *sp++ = in.value;
+            break;
+        case op_get:
+            *sp++ = st.get(in.arg);
+            break;
+        case op_set:
+            st.set(in.arg,sp[-1]);
+            break;
+        case op_let:
+        case op_const:
+            st.declare(in.arg,sp[-1],in.op==op_const);
+            break;
+        case op_neg:
+        case op_sqrt:
+        case op_pow:
+            sp[-1] = unary(in,sp[-1]);
+            break;
+        default:
+            --sp;
+            sp[-1] = binary(in.op,sp[-1],sp[0]);
+        }
+    }
+    return sp[-1];
+}
+
+// -----------------------------------------------------------------------
+
+// one element of the stack of run_column(): a chunk of values, or one
+// value for all elements while it doesn't depend on the column
+struct Column_slot {
+    double* v;
+    bool scalar;
+    double s;
+};
+
+// -----------------------------------------------------------------------
+
+// run_column() for at most column_chunk elements
+// each instruction is a simple loop over the chunk; the checks for errors
+// are loops of their own, so that they don't keep the others from vectorizing
+void run_chunk(const vector<Instruction>& code, const double* x, double* y, int n, double* buf)
+{
+    Column_slot stk[64];
+    Column_slot* sp = stk;  // one beyond the top
+    for (size_t i = 0; i<code.size(); ++i) {
+        const Instruction& in = code[i];
+        switch (in.op) {
+        case op_number:
+            sp->v = buf+(sp-stk)*column_chunk;
+            sp->scalar = true;
+            sp->s = in.value;
+            ++sp;
+            break;
+        case op_get:
+            sp->v = buf+(sp-stk)*column_chunk;
+            sp->scalar = false;
+            for (int j = 0; j<n; ++j) sp->v[j] = x[j];
+            ++sp;
+            break;
+        case op_neg:
+        case op_sqrt:
+        case op_pow:
+        {   Column_slot& a = sp[-1];
+            if (a.scalar) {
+                a.s = unary(in,a.s);
+                break;
+            }
+            double* v = a.v;
+            if (in.op == op_neg)
+                for (int j = 0; j<n; ++j) v[j] = -v[j];
+            else if (in.op == op_sqrt) {
+                bool neg = false;
+                for (int j = 0; j<n; ++j) neg |= v[j]<0;
+                if (neg) error("Square roots of negative numbers... nope!");
+                for (int j = 0; j<n; ++j) v[j] = sqrt(v[j]);
+            }
+            else
+                for (int j = 0; j<n; ++j) v[j] = my_pow(v[j],in.arg);
+            break;
+        }
+        default:
+        {   --sp;
+            Column_slot& a = sp[-1];
+            const Column_slot& b = sp[0];
+            if (a.scalar && b.scalar) {
+                a.s = binary(in.op,a.s,b.s);
+                break;
+            }
+            double* v = a.v;
+            const double* w = b.v;
+            if (in.op==op_div || in.op==op_mod) {
+                bool zero = false;
+                if (b.scalar) zero = b.s==0;
+                else for (int j = 0; j<n; ++j) zero |= w[j]==0;
+                if (zero) error(in.op==op_div ? "divide by zero" : "%: divide by zero");
+            }
+            if (in.op == op_mod) {  // not worth vectorizing: goes through int
+                for (int j = 0; j<n; ++j)
+                    v[j] = binary(op_mod,a.scalar ? a.s : v[j],b.scalar ? b.s : w[j]);
+                a.scalar = false;
+                break;
+            }
+            if (a.scalar) {     // scalar op column
+                const double c = a.s;
+                switch (in.op) {
+                case op_add: for (int j = 0; j<n; ++j) v[j] = c+w[j]; break;
+                case op_sub: for (int j = 0; j<n; ++j) v[j] = c-w[j]; break;
+                case op_mul: for (int j = 0; j<n; ++j) v[j] = c*w[j]; break;
+                default:     for (int j = 0; j<n; ++j) v[j] = c/w[j];
+                }
+                a.scalar = false;
+            }
+            else if (b.scalar) {    // column op scalar
+                const double c = b.s;
+                switch (in.op) {
+                case op_add: for (int j = 0; j<n; ++j) v[j] += c; break;
+                case op_sub: for (int j = 0; j<n; ++j) v[j] -= c; break;
+                case op_mul: for (int j = 0; j<n; ++j) v[j] *= c; break;
+                default:     for (int j = 0; j<n; ++j) v[j] /= c;
+                }
+            }
+            else {
+                switch (in.op) {
+                case op_add: for (int j = 0; j<n; ++j) v[j] += w[j]; break;
+                case op_sub: for (int j = 0; j<n; ++j) v[j] -= w[j]; break;
+                case op_mul: for (int j = 0; j<n; ++j) v[j] *= w[j]; break;
+                default:     for (int j = 0; j<n; ++j) v[j] /= w[j];
+                }
+            }
+        }
+        }
+    }
+    if (stk[0].scalar)
+        for (int j = 0; j<n; ++j) y[j] = stk[0].s;
+    else
+        for (int j = 0; j<n; ++j) y[j] = stk[0].v[j];
+}
+
+// -----------------------------------------------------------------------
+
+// run code for x[0:n), chunk by chunk
+void run_column(const vector<Instruction>& code, int max_depth, const double* x, double* y, long n, double* buf)
+{
+    if (max_depth > 64) error("expression too deeply nested for a column");
+    for (long i = 0; i<n; i += column_chunk)
+        run_chunk(code,x+i,y+i,int(min(n-i,long(column_chunk))),buf);
+}
+
+// -----------------------------------------------------------------------
+
+// evaluate input for every element of x as var
+// the column is cut into one contiguous range per thread
+void Calculator::calculate_column(const string& input, const string& var, const vector<double>& x, vector<double>& y)
+{
+    const Program& p = compile(input);
+    const int slot = st.intern(var);
+
+    // variables other than var are constants here:
+    vector<Instruction> code = p.code;
+    for (size_t i = 0; i<code.size(); ++i) {
+        if (code[i].op==op_set || code[i].op==op_let || code[i].op==op_const)
+            error("calculate_column(): no assignments or declarations, please");
+        if (code[i].op==op_get && code[i].arg!=slot)
+            code[i] = Instruction(op_number,0,st.get(code[i].arg));
+    }
+
+    const long n = x.size();
+    y.resize(n);
+    if (n == 0) return;
+    const int depth = max(p.max_depth,1);
+    const long hw = max(1u,thread::hardware_concurrency());
+    const long threads = max(1L,min(hw,n/column_min_per_thread));
+
+    if (threads == 1) {
+        vector<double> buf(depth*column_chunk);
+        run_column(code,depth,&x[0],&y[0],n,&buf[0]);
+        return;
+    }
+
+    vector<exception_ptr> errors(threads);
+    vector<thread> workers;
+    const long per = (n+threads-1)/threads;
+    for (long t = 0; t<threads; ++t) {
+        const long lo = t*per;
+        const long hi = min(n,lo+per);
+        workers.push_back(thread([&,t,lo,hi] {
+            try {
+                vector<double> buf(depth*column_chunk);
+                run_column(code,depth,&x[0]+lo,&y[0]+lo,hi-lo,&buf[0]);
+            }
+            catch (...) {
+                errors[t] = current_exception();
+            }
+        }));
+    }
+    for (size_t t = 0; t<workers.size(); ++t) workers[t].join();
+    for (size_t t = 0; t<errors.size(); ++t)
+        if (errors[t]) rethrow_exception(errors[t]);
+}
+
+// -----------------------------------------------------------------------
+
+// run each statement of [b:e); a statement ends at ';' or a newline
+long Calculator::run_script(const char* b, const char* e, ostream& os)
+{
+    long n = 0;
+    int line = 1;
+    while (b < e) {
+        const char* q = b;
+        while (q<e && *q!=';' && *q!='\n') ++q;
+        const char* s = b;
+        while (s<q && isspace(*s)) ++s;
+        if (s < q) {    // not just white space
+            ++n;
+            try {
+                os << run(compile(b,q,line)) << '\n';
+            }
+            catch (exception& x) {
+                const string what = x.what();
+                if (what.compare(0,5,"line ") == 0) os << what << '\n';
+                else os << "line " << line << ": " << what << '\n';
+            }
+        }
+        if (q<e && *q=='\n') ++line;
+        b = q+1;
+    }
+    return n;
+}
+
+// -----------------------------------------------------------------------
+
+// the state of a variable after a statement of run_batch() wrote it
+struct Batch_version {
+    int slot;
+    int prev;           // the statement that wrote slot before, -1 if none
+    bool written;       // false if the statement failed before writing slot
+    double value;
+    bool is_declared;
+    bool is_const;
+};
+
+// -----------------------------------------------------------------------
+
+// a statement of run_batch()
+struct Batch_statement {
+    const char* b;      // its text
+    const char* e;
+    int line;
+    Program p;
+    vector<pair<int,int> > inputs;  // (slot, last statement before that wrote it) for the slots used
+    vector<Batch_version> writes;   // for the slots written
+    string result;      // its value or error, as output
+};
+
+// -----------------------------------------------------------------------
+
+// the statements of a run_batch() and what they have done
+// a statement sees the variables as written by the last statement before it
+// that wrote them, not as they are in the Symbol_table, which is only
+// updated at the end: statements that don't read each others' variables
+// can run in any order
+struct Batch {
+    vector<Batch_statement> stmts;
+    unique_ptr<atomic<char>[]> done;    // done[i]: stmts[i] has run
+    Symbol_table& st;
+
+    Batch(Symbol_table& s) :st(s) { }
+    Batch_version& own(int i, int slot);
+    Batch_version current(int i, int slot);
+    double run(int i);
+};
+
+// -----------------------------------------------------------------------
+
+// the entry of stmts[i].writes for slot, which stmts[i] must write
+Batch_version& Batch::own(int i, int slot)
+{
+    vector<Batch_version>& w = stmts[i].writes;
+    int k = 0;
+    while (w[k].slot != slot) ++k;
+    return w[k];
+}
+
+// -----------------------------------------------------------------------
+
+// the variable in slot as seen by stmts[i]
+Batch_version Batch::current(int i, int slot)
+{
+    const vector<Batch_version>& ow = stmts[i].writes;
+    for (size_t k = 0; k<ow.size(); ++k)
+        if (ow[k].slot==slot && ow[k].written) return ow[k];
+
+    int w = -1;
+    const vector<pair<int,int> >& in = stmts[i].inputs;
+    for (size_t k = 0; k<in.size(); ++k)
+        if (in[k].first == slot) w = in[k].second;
+    while (w >= 0) {    // w < i, so it has been handed out to a thread, and it will finish
+        while (!done[w].load(memory_order_acquire)) this_thread::yield();
+        const Batch_version& v = own(w,slot);
+        if (v.written) return v;
+        w = v.prev;
+    }
+
+    const Variable& var = st.variable(slot);  // not changed while statements run
+    Batch_version v = { slot, -1, true, var.value, var.is_declared, var.is_const };
+    return v;
+}
+
+// -----------------------------------------------------------------------
+
+// Calculator::run() for stmts[i]
+double Batch::run(int i)
+{
+    const Program& p = stmts[i].p;
+    vector<double> stack(max(p.max_depth,1));
+    double* sp = &stack[0];
+
+    for (size_t k = 0; k<p.code.size(); ++k) {
+        const Instruction& in = p.code[k];
+        switch (in.op) {
+        case op_number:
+            *sp++ = in.value;
+            break;
+        case op_get:
+        {   const Batch_version v = current(i,in.arg);
+            if (!v.is_declared) error("get: undefined variable ",st.name(in.arg));
+            *sp++ = v.value;
+            break;
+        }
+        case op_set:
+        {   const Batch_version v = current(i,in.arg);
+            if (!v.is_declared) error("set: undefined variable ",st.name(in.arg));
+            if (v.is_const) error(st.name(in.arg)," is a constant");
+            Batch_version& w = own(i,in.arg);
+            w.written = true;
+            w.value = sp[-1];
+            w.is_declared = true;
+            w.is_const = false;
+            break;
+        }
+        case op_let:
+        case op_const:
+        {   if (current(i,in.arg).is_declared) error(st.name(in.arg)," declared twice");
+            Batch_version& w = own(i,in.arg);
+            w.written = true;
+            w.value = sp[-1];
+            w.is_declared = true;
+            w.is_const = in.op==op_const;
+            break;
+        }
+        case op_neg:
+        case op_sqrt:
+        case op_pow:
+            sp[-1] = unary(in,sp[-1]);
+            break;
+        default:
+            --sp;
+            sp[-1] = binary(in.op,sp[-1],sp[0]);
+        }
+    }
+    return sp[-1];
+}
+
+// -----------------------------------------------------------------------
+
+// run_script() in four steps:
+// - find the statements (serially: it is just a scan for ';' and newlines)
+// - compile them in parallel, each thread with a Symbol_table of its own,
+//   then translate the slots to those of st
+// - find for each variable a statement uses which statement wrote it last
+//   (serially, in order)
+// - run them in parallel: the statements are handed out in order and wait for
+//   the writers of what they read; a statement only waits for one before it,
+//   which has been handed out already, so the first one not done can always run
+long Calculator::run_batch(const char* b, const char* e, ostream& os, int threads)
+{
+    if (threads <= 0) threads = max(1u,thread::hardware_concurrency());
+    Batch batch(st);
+    vector<Batch_statement>& stmts = batch.stmts;
+
+    for (int line = 1; b < e; ) {
+        const char* q = b;
+        while (q<e && *q!=';' && *q!='\n') ++q;
+        const char* s = b;
+        while (s<q && isspace(*s)) ++s;
+        if (s < q) {    // not just white space
+            stmts.push_back(Batch_statement());
+            stmts.back().b = b;
+            stmts.back().e = q;
+            stmts.back().line = line;
+        }
+        if (q<e && *q=='\n') ++line;
+        b = q+1;
+    }
+    const long n = stmts.size();
+    if (n == 0) return 0;
+    threads = int(min(long(threads),max(1L,n/1024)));
+
+    // compile:
+    const long chunk = 1024;
+    atomic<long> next(0);
+    mutex mtx;      // for st
+    vector<thread> workers;
+    for (int t = 0; t<threads; ++t)
+        workers.push_back(thread([&] {
+            Symbol_table local;
+            vector<int> global;     // the slot in st of each slot of local
+            for (long c = next++; c*chunk<n; c = next++) {
+                const long hi = min(n,(c+1)*chunk);
+                for (long i = c*chunk; i<hi; ++i) {
+                    Batch_statement& bs = stmts[i];
+                    Token_stream ts(bs.b,bs.e,local,bs.line);
+                    try {
+                        statement(ts,bs.p);
+                    }
+                    catch (exception& x) {
+                        bs.result = ts.where()+": "+x.what();
+                        bs.p.code.clear();
+                    }
+                }
+                lock_guard<mutex> lck(mtx);
+                for (int s = global.size(); s<local.size(); ++s) global.push_back(st.intern(local.name(s)));
+                for (long i = c*chunk; i<hi; ++i) {
+                    vector<Instruction>& code = stmts[i].p.code;
+                    for (size_t k = 0; k<code.size(); ++k)
+                        if (code[k].op==op_get || code[k].op==op_set || code[k].op==op_let || code[k].op==op_const)
+                            code[k].arg = global[code[k].arg];
+                }
+            }
+        }));
+    for (size_t t = 0; t<workers.size(); ++t) workers[t].join();
+    workers.clear();
+
+    // who wrote what last:
+    vector<int> writer(st.size(),-1);
+    for (long i = 0; i<n; ++i) {
+        Batch_statement& bs = stmts[i];
+        const vector<Instruction>& code = bs.p.code;
+        for (size_t k = 0; k<code.size(); ++k) {
+            if (code[k].op!=op_get && code[k].op!=op_set && code[k].op!=op_let && code[k].op!=op_const) continue;
+            const int slot = code[k].arg;
+            bool seen = false;
+            for (size_t j = 0; j<bs.inputs.size(); ++j) seen |= bs.inputs[j].first==slot;
+            if (!seen) bs.inputs.push_back(make_pair(slot,writer[slot]));
+            if (code[k].op == op_get) continue;
+            seen = false;
+            for (size_t j = 0; j<bs.writes.size(); ++j) seen |= bs.writes[j].slot==slot;
+            if (!seen) {
+                Batch_version v = { slot, writer[slot], false, 0, false, false };
+                bs.writes.push_back(v);
+            }
+        }
+        for (size_t j = 0; j<bs.writes.size(); ++j) writer[bs.writes[j].slot] = i;
+    }
+
+    // run:
+    batch.done.reset(new atomic<char>[n]);
+    for (long i = 0; i<n; ++i) batch.done[i].store(0,memory_order_relaxed);
+    next = 0;
+    for (int t = 0; t<threads; ++t)
+        workers.push_back(thread([&] {
+            char buf[32];
+            for (long i = next++; i<n; i = next++) {
+                Batch_statement& bs = stmts[i];
+                if (bs.result.empty()) {    // compiled
+                    try {
+                        snprintf(buf,sizeof(buf),"%g",batch.run(i));  // as ostream's default
+                        bs.result = buf;
+                    }
+                    catch (exception& x) {
+                        ostringstream es;
+                        es << "line " << bs.line << ": " << x.what();
+                        bs.result = es.str();
+                    }
+                }
+                batch.done[i].store(1,memory_order_release);
+            }
+        }));
+    for (size_t t = 0; t<workers.size(); ++t) workers[t].join();
+
+    for (long i = 0; i<n; ++i) os << stmts[i].result << '\n';
+
+    // and finally the variables as the last statements left them:
+    for (int slot = 0; slot<int(writer.size()); ++slot) {
+        if (writer[slot] < 0) continue;
+        const Batch_version v = batch.current(writer[slot],slot);
+        Variable& var = st.variable(slot);
+        var.value = v.value;
+        var.is_declared = v.is_declared;
+        var.is_const = v.is_const;
     }
+    return n;
+}
+
+// -----------------------------------------------------------------------
+
+// keep at most n compiled statements
+void Calculator::set_cache_limit(int n)
+{
+    cache_limit = n;
+    cache.clear();
 }
 
 // -----------------------------------------------------------------------
@@ -359,10 +1212,9 @@ string Calculator::print_help()
 // expression evaluation loop: read input from string
 string Calculator::calculate(string input)
 {
-    Token_stream ts(input);
     ostringstream ofs;
     try {
-            ofs << statement(ts);
+            ofs << run(compile(input));
             return ofs.str();
     }
     catch (exception& e) {
@@ -374,4 +1226,49 @@ string Calculator::calculate(string input)
 
 // -----------------------------------------------------------------------
 
-}   // of namespace Calc_lib
\ No newline at end of file
+// map path into memory
+Script_file::Script_file(const string& path)
+    :addr(0), len(0)
+{
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(),GENERIC_READ,FILE_SHARE_READ,0,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,0);
+    if (file==INVALID_HANDLE_VALUE) error("cannot open script ",path);
+    LARGE_INTEGER sz;
+    if (!GetFileSizeEx(file,&sz)) { CloseHandle(file); error("cannot open script ",path); }
+    len = sz.QuadPart;
+    mapping = len ? CreateFileMappingA(file,0,PAGE_READONLY,0,0,0) : 0;
+    if (mapping) addr = static_cast<const char*>(MapViewOfFile(mapping,FILE_MAP_READ,0,0,0));
+    if (len && addr==0) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        error("cannot map script ",path);
+    }
+#else
+    const int fd = open(path.c_str(),O_RDONLY);
+    if (fd<0) error("cannot open script ",path);
+    struct stat sb;
+    if (fstat(fd,&sb)!=0) { ::close(fd); error("cannot open script ",path); }
+    len = sb.st_size;
+    void* q = len ? mmap(0,size_t(len),PROT_READ,MAP_SHARED,fd,0) : 0;
+    ::close(fd);    // the mapping keeps the file open
+    if (q==MAP_FAILED) error("cannot map script ",path);
+    addr = static_cast<const char*>(q);
+#endif
+}
+
+// -----------------------------------------------------------------------
+
+Script_file::~Script_file()
+{
+#ifdef _WIN32
+    if (addr) UnmapViewOfFile(addr);
+    if (mapping) CloseHandle(mapping);
+    CloseHandle(file);
+#else
+    if (addr) munmap(const_cast<char*>(addr),size_t(len));
+#endif
+}
+
+// -----------------------------------------------------------------------
+
+}   // of namespace Calc_lib
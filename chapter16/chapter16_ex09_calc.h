@@ -66,42 +66,149 @@
         floating-point-literal
 
     Input comes from cin through the Token_stream called ts.
+
+    A statement is not evaluated while it is parsed: the parser compiles it
+    into a Program of Instructions for a small stack machine, folding
+    operations on constants as it goes, and run() executes that. Programs are
+    cached by their source text, so a statement that comes again (with other
+    values in its variables) never sees the Token_stream again:
+
+        Calculator c;
+        c.calculate("let x = 2");
+        c.calculate("x = x*x+1");       // compiled
+        c.calculate("x = x*x+1");       // taken from the cache
+
+    Names are interned: the Token_stream looks each name up in the
+    Calculator's Symbol_table (a hash table) once and hands out its slot, and
+    compiled Programs refer to variables by slot only.
+
+    For long scripts, the Token_stream reads straight from memory, e.g. a
+    Script_file mapped into memory: numbers are converted by a hand-written
+    parser, Tokens point into the text instead of copying it, any number of
+    Tokens can be looked at ahead of get(), and every Token knows its line
+    and column, so that errors can say where they are:
+
+        Script_file f("statements.txt");
+        c.run_script(f.begin(),f.end(),cout);    // one result or error per statement
+        c.run_batch(f.begin(),f.end(),cout);     // the same, on all cores
+
+    An expression can also be evaluated for a whole column of values of one
+    of its variables, e.g. to graph it at many points. The compiled Program is
+    then run on chunks of the column that stay in cache, one instruction
+    for all elements of a chunk at a time, in loops the compiler vectorizes,
+    with the column split among the processor's cores:
+
+        vector<double> x(10000000), y;
+        ...
+        c.calculate_column("sqrt(x*x+1)/(x+k)","x",x,y);    // y[i] is the value for x[i]
 */
 
 #ifndef CALC_GUARD
 #define CALC_GUARD
 
+#include<cstring>
+#include<atomic>
+#include<cstdio>
+#include<exception>
+#include<mutex>
+#include<thread>
+#include<unordered_map>
+
 #include "../lib_files/std_lib_facilities.h"
 
 namespace Calc_lib {;
 
 // -----------------------------------------------------------------------
 
+// type for (name,value) pairs
+class Variable {
+public:
+    string name;
+    double value;
+    bool is_const;
+    bool is_declared;   // interned names exist before they are declared
+    Variable(string n, double v, bool b) :name(n), value(v), is_const(b), is_declared(true) { }
+};
+
+// -----------------------------------------------------------------------
+
+// type for var_table and associated functions
+// every name gets a slot, its index in var_table, the first time it is seen;
+// index is an open-addressing hash table (linear probing) of slot+1, 0 for
+// free entries, from which names are found without going through var_table
+class Symbol_table {
+public:
+    Symbol_table();
+
+    int intern(const char* s, int n);               // the slot of the name s[0:n), made if new
+    int intern(const string& s) { return intern(s.data(),s.size()); }
+    int find(const string& s) const;                // the slot of s, -1 if s was never seen
+
+    double get(int slot);                           // return the value of the Variable in slot
+    void set(int slot, double d);                   // set the Variable in slot to d
+    bool is_declared(int slot) const { return var_table[slot].is_declared; }
+    double declare(int slot, double val, bool b);   // declare the name in slot with value val
+    const string& name(int slot) const { return var_table[slot].name; }
+    int size() const { return var_table.size(); }   // the number of slots
+    Variable& variable(int slot) { return var_table[slot]; }
+
+    double get(string s);                           // return the value of the Variable named s
+    void set(string s, double d);                   // set the Variable named s to d
+    bool is_declared(string var);                   // is var already in var_table?
+    double declare(string var, double val, bool b); // add (var,val) to var_table
+private:
+    static size_t hash(const char* s, int n);
+    size_t probe(const char* s, int n, size_t h) const; // the entry of index for s[0:n)
+    void grow();
+
+    vector<Variable> var_table; // vector of Variables, by slot
+    vector<int> index;          // its size is a power of 2, at most half full
+};
+
+// -----------------------------------------------------------------------
+
 // a very simple user-defined type
+// the text of a Token is not copied: it points into the Token_stream's input
 class Token {
 public:
-    char kind;      // what kind of token
-    double value;   // for numbers: a value
-    string name;    // for variables and functions: a name
-    Token(char ch) :kind(ch), value(0) { }                  // make a Token from a char
-    Token(char ch, double val) :kind(ch), value(val) { }    // make a Token from a char and an double
-    Token(char ch, string n) :kind(ch), name(n) { }         // make a Token from a char and a string
+    char kind;          // what kind of token
+    double value;       // for numbers: a value
+    int slot;           // for names: the slot in the Symbol_table
+    const char* text;   // the characters of the Token
+    int size;           // ... and how many there are
+    int line;           // where the Token starts, from 1
+    int column;
+    Token(char ch = 0) :kind(ch), value(0), slot(-1), text(0), size(0), line(0), column(0) { }  // make a Token from a char
+    Token(char ch, double val) :kind(ch), value(val), slot(-1), text(0), size(0), line(0), column(0) { }   // make a Token from a char and a double
+    string str() const { return string(text,text+size); }
 };
 
 // -----------------------------------------------------------------------
 
-// stream of tokens
+// stream of tokens from characters in memory
+// get() returns print at the end of the input
 class Token_stream {
 public:
-    Token_stream();             // make a Token_stream that reads from cin
-    Token_stream(string s);     // make a Token_stream that reads from string
+    Token_stream(const char* b, const char* e, Symbol_table& st, int line = 1); // read [b:e)
+    Token_stream(const string& s, Symbol_table& st);   // read from s, which must outlive the Token_stream
     Token get();                // get a Token
+    const Token& peek(int n = 0);   // look at the n+1st Token get() will return
     void putback(Token t);      // put a Token back
     void ignore(char c);        // discard characters up to and including a c
+    string where() const;       // "line l, column c" of the last Token read by get()
 private:
-    bool full;                  // is there a Token in the buffer?
-    Token buffer;               // here is where we keep a Token put back using putback()
-    istringstream iss;          // read from here when not using cin
+    Token read();               // compose a Token from the characters at p
+
+    const char* p;              // next character
+    const char* end;
+    const char* line_start;     // where the line of p starts
+    int line;
+    Symbol_table& names;
+    static const int max_ahead = 8;
+    Token ahead[max_ahead];     // Tokens read but not yet got, as a ring buffer:
+    int first;                  // ahead[first] is the next one
+    int count;
+    Token last;                 // the last Token got
 };
 
 // -----------------------------------------------------------------------
@@ -126,51 +233,134 @@ const string powkey = "pow";    // keyword for power function
 
 // -----------------------------------------------------------------------
 
-// type for (name,value) pairs
-class Variable {
-public:
-    string name;
-    double value;
-    bool is_const;
-    Variable(string n, double v, bool b) :name(n), value(v), is_const(b) { }
+// read a floating-point-literal from [p:e) without going through an istream
+// returns the character after it; the conversion is exact (correctly rounded)
+// for up to 15 significant digits and exponents up to 22, else strtod() does it
+const char* parse_number(const char* p, const char* e, double& d);
+
+// -----------------------------------------------------------------------
+
+// simple power function
+// handles only integers >= 0 as exponents
+double my_pow(double base, int expo);
+
+// -----------------------------------------------------------------------
+
+// the operations of the stack machine that runs compiled statements
+enum Opcode {
+    op_number,      // push value
+    op_get,         // push the value of the variable in slot arg
+    op_set,         // set the variable in slot arg to the top of the stack, which stays
+    op_let,         // declare variable arg with the top of the stack as value
+    op_const,       // declare constant arg with the top of the stack as value
+    op_neg,         // replace the top of the stack by its negation
+    op_sqrt,        // ... by its square root
+    op_pow,         // ... by its arg-th power
+    op_add,         // replace the two top elements by their sum
+    op_sub,         // ... difference
+    op_mul,         // ... product
+    op_div,         // ... quotient
+    op_mod          // ... remainder
 };
 
 // -----------------------------------------------------------------------
 
-// type for var_table and associated functions
-class Symbol_table {
-public:
-    double get(string s);                           // return the value of the Variable named s
-    void set(string s, double d);                   // set the Variable named s to d
-    bool is_declared(string var);                   // is var already in var_table?
-    double declare(string var, double val, bool b); // add (var,val) to var_table
-private:
-    vector<Variable> var_table; // vector of Variables
+// one instruction of a Program
+struct Instruction {
+    Opcode op;
+    int arg;        // a Symbol_table slot, or the exponent of op_pow
+    double value;   // for op_number
+    Instruction(Opcode o, int a = 0, double v = 0) :op(o), arg(a), value(v) { }
 };
 
 // -----------------------------------------------------------------------
 
-// simple power function
-// handles only integers >= 0 as exponents
-double my_pow(double base, int expo);
+// a compiled statement; its slots are those of the Calculator that compiled it
+struct Program {
+    vector<Instruction> code;
+    int max_depth;          // stack elements needed to run code
+    Program() :max_depth(0) { }
+};
 
 // -----------------------------------------------------------------------
 
+const int column_chunk = 512;           // elements per instruction in calculate_column()
+const int column_min_per_thread = 32768; // a thread of calculate_column() gets at least that many
+
+// run code, in which op_get means "the column x", for x[0:n), giving y[0:n)
+// buf must hold max_depth*column_chunk elements
+void run_column(const vector<Instruction>& code, int max_depth, const double* x, double* y, long n, double* buf);
+
+// -----------------------------------------------------------------------
+
+// hashes the cache's keys: string may be std_lib_facilities.h's String,
+// for which there is no std::hash
+struct Source_hash {
+    size_t operator()(const std::basic_string<char>& s) const { return std::hash<std::basic_string<char> >()(s); }
+};
+
 // handles parsing and evaluation
 class Calculator {
 public:
     Calculator();
     string calculate(string input); // expression evaluation loop
     string print_help();            // return help instructions
+
+    const Program& compile(const string& input);    // compile a statement, or find it in the cache
+    double run(const Program& p);                   // execute a compiled statement
+    void set_cache_limit(int n);                    // keep at most n Programs; 0: compile every time
+
+    // calculate the statements of [b:e), separated by ';' or newlines, and
+    // write one line per statement to os: its value, or the error with its
+    // line and column; returns the number of statements
+    long run_script(const char* b, const char* e, ostream& os);
+
+    // run_script() on threads threads (0: one per core), with the same
+    // output: the statements are compiled in parallel, and each runs as soon
+    // as those that wrote the variables it reads have run
+    long run_batch(const char* b, const char* e, ostream& os, int threads = 0);
+
+    // evaluate the expression input with the variable var bound to each
+    // element of x in turn, giving y; other variables keep their values
+    void calculate_column(const string& input, const string& var, const vector<double>& x, vector<double>& y);
+
+    Symbol_table& symbols() { return st; }          // for setting variables from a program
 private:
-    double primary(Token_stream& ts);               // deal with numbers, unary +/-, (), sqrt, pow, names and assignments
-    double term(Token_stream& ts);                  // deal with *, / and %
-    double expression(Token_stream& ts);            // deal with + and -
-    double declaration(bool b, Token_stream& ts);   // handle 'name = expression'
-    double statement(Token_stream& ts);             // handle declarations and expressions
+    const Program& compile(const char* b, const char* e, int line);
+
+    void primary(Token_stream& ts, Program& p);             // deal with numbers, unary +/-, (), sqrt, pow, names and assignments
+    void term(Token_stream& ts, Program& p);                // deal with *, / and %
+    void expression(Token_stream& ts, Program& p);         // deal with + and -
+    void declaration(bool b, Token_stream& ts, Program& p); // handle 'name = expression'
+    void statement(Token_stream& ts, Program& p);          // handle declarations and expressions
     //void clean_up_mess(Token_stream& ts);           // clean up after error
 
     Symbol_table st;                                // provides get(), set(), is_declared() and declare()
+    unordered_map<string,Program,Source_hash> cache;    // compiled statements by source text
+    int cache_limit;
+    Program uncached;                               // compile()'s result when nothing is cached
+    vector<double> stack;                           // run()'s operand stack
+};
+
+// -----------------------------------------------------------------------
+
+// a script mapped read-only into memory, for Calculator::run_script()
+class Script_file {
+public:
+    explicit Script_file(const string& path);
+    ~Script_file();
+    const char* begin() const { return addr; }
+    const char* end() const { return addr+len; }
+    long long size() const { return len; }
+private:
+    const char* addr;
+    long long len;
+#ifdef _WIN32
+    void* file;         // HANDLEs, kept as void* so that this header does not need windows.h
+    void* mapping;
+#endif
+    Script_file(const Script_file&);    // no copying of mappings
+    void operator=(const Script_file&);
 };
 
 } // of namespace Calc_lib
@@ -0,0 +1,125 @@
+/*
+    Arena and Arena_allocator for Numeric_lib
+
+    Many short-lived matrices (the temporaries of an iteration, the rows of a
+    blocked algorithm, ...) cost a malloc() and a free() each. An Arena hands
+    out memory from large chunks by bumping a pointer and gives it all back at
+    once with reset(), so such matrices cost next to nothing to make:
+
+        Arena arena;
+        for (int it = 0; it<iterations; ++it) {
+            Matrix<double,2,Checked,Arena_allocator<double> > t(n,n,uninitialized,Arena_allocator<double>(arena));
+            // ...
+            // t is gone before the reset()
+            arena.reset();
+        }
+
+    An Arena is not thread safe; use one per thread.
+*/
+
+#ifndef ARENA_LIB
+#define ARENA_LIB
+
+#include<algorithm>
+#include<cstddef>
+#include<new>
+#include<vector>
+#include "Matrix.h"
+
+namespace Numeric_lib {
+
+//-----------------------------------------------------------------------------
+
+class Arena {
+    // memory is handed out in chunks of at least chunk_size bytes, each
+    // allocation aligned to matrix_alignment; deallocation is a no-op until reset()
+public:
+    explicit Arena(std::size_t chunk_size = 1<<20)
+        :csz(chunk_size), cur(0), next(0), last(0) { }
+
+    ~Arena()
+    {
+        for (std::size_t i = 0; i<chunks.size(); ++i) ::operator delete(chunks[i]);
+    }
+
+    void* allocate(std::size_t n)
+    {
+        n = (n+matrix_alignment-1) & ~(matrix_alignment-1);
+        if (next+n > last) {
+            // move on to the next chunk, making a new one if there is none big enough
+            if (cur==chunks.size() || sizes[cur]<n) {
+                const std::size_t sz = std::max(csz,n);
+                chunks.insert(chunks.begin()+cur,static_cast<char*>(::operator new(sz+matrix_alignment)));
+                sizes.insert(sizes.begin()+cur,sz);
+            }
+            use_chunk(cur++);
+        }
+        char* p = next;
+        next += n;
+        return p;
+    }
+
+    void reset()
+        // free everything allocated since construction or the previous reset()
+        // the chunks are kept for reuse
+    {
+        cur = 0;
+        next = last = 0;
+    }
+
+    std::size_t capacity() const    // bytes in all chunks
+    {
+        std::size_t s = 0;
+        for (std::size_t i = 0; i<sizes.size(); ++i) s += sizes[i];
+        return s;
+    }
+private:
+    void use_chunk(std::size_t i)
+    {
+        std::size_t p = reinterpret_cast<std::size_t>(chunks[i]);
+        next = reinterpret_cast<char*>((p+matrix_alignment-1) & ~(matrix_alignment-1));
+        last = next+sizes[i];
+    }
+
+    std::size_t csz;
+    std::vector<char*> chunks;
+    std::vector<std::size_t> sizes;    // usable bytes in chunks[i]
+    std::size_t cur;                   // chunks in use; chunks[cur-1] is the current one
+    char* next;                        // first free byte in the current chunk
+    char* last;                        // one past the end of the current chunk
+
+    Arena(const Arena&);    // no copying of arenas
+    void operator=(const Arena&);
+};
+
+//-----------------------------------------------------------------------------
+
+template<class T> class Arena_allocator {
+    // allocator for Matrix that takes its memory from an Arena
+    // a default constructed Arena_allocator has no Arena and falls back on
+    // Aligned_allocator, so that Rows and the like still work
+public:
+    Arena_allocator() :a(0) { }
+    explicit Arena_allocator(Arena& arena) :a(&arena) { }
+
+    T* allocate(Index n)
+    {
+        if (a==0) return Aligned_allocator<T>().allocate(n);
+        return static_cast<T*>(a->allocate(std::size_t(n)*sizeof(T)));
+    }
+
+    void deallocate(T* p, Index n)
+    {
+        if (a==0) Aligned_allocator<T>().deallocate(p,n);
+        // else: given back by Arena::reset()
+    }
+
+    Arena* arena() const { return a; }
+private:
+    Arena* a;
+};
+
+//-----------------------------------------------------------------------------
+
+}
+#endif
@@ -0,0 +1,197 @@
+/*
+    Batched solution of many small independent systems for Numeric_lib
+
+    Solving tens of thousands of 8 by 8 to 64 by 64 systems one after another
+    leaves the vector units mostly idle: every row operation is short, and
+    each pivot search is a chain of dependent comparisons. batched_solve()
+    takes all the systems at once, as a Matrix<T,3> a (a[k] is system k) and
+    a Matrix<T,2> b (b[k] is its right-hand side), and interleaves groups of
+    batch_lanes systems element by element, so that each SIMD lane works on a
+    system of its own and every instruction does useful work for all of them.
+    The groups are given out to the thread pool.
+
+    A singular system does not stop the others: its entry in the result says
+    where elimination found no pivot, and its solution is set to NaN:
+
+        Matrix<double,3> a(count,n,n);
+        Matrix<double,2> b(count,n);
+        ...
+        std::vector<Index> status = batched_solve(a,b);    // b[k] now solves a[k]*x==b[k]
+        for (Index k = 0; k<count; ++k)
+            if (status[k]) cerr << "system " << k << " is singular\n";
+*/
+
+#ifndef BATCHED_LIB
+#define BATCHED_LIB
+
+#include<algorithm>
+#include<cmath>
+#include<limits>
+#include<vector>
+#include "Matrix.h"
+#include "Thread_pool.h"
+
+namespace Numeric_lib {
+
+//-----------------------------------------------------------------------------
+
+const Index batch_lanes = 8;    // systems per group: a 512-bit register of doubles, two 256-bit ones
+
+//-----------------------------------------------------------------------------
+
+template<class T> Index solve_interleaved(T* a, T* b, Index n, Index* status)
+    // solve batch_lanes systems stored element by element: element (i,j) of
+    // system l is a[(i*n+j)*batch_lanes+l], element i of its right-hand side
+    // b[i*batch_lanes+l]; the solutions replace the right-hand sides
+    // status[l] is set to 0, or to j+1 if system l has no pivot in column j
+    // returns the number of singular systems
+{
+    const Index W = batch_lanes;
+    T inv[batch_lanes*64];    // reciprocals of the pivots, for back substitution
+    std::vector<T> inv_big;
+    T* pinv = inv;
+    if (n>64) {
+        inv_big.resize(n*W);
+        pinv = &inv_big[0];
+    }
+    for (Index l = 0; l<W; ++l) status[l] = 0;
+
+    for (Index j = 0; j<n; ++j) {
+        // look for a pivot in each lane at once
+        Index prow[batch_lanes];
+        T best[batch_lanes];
+        T* ajj = a+(j*n+j)*W;
+        for (Index l = 0; l<W; ++l) {
+            prow[l] = j;
+            best[l] = std::abs(ajj[l]);
+        }
+        for (Index i = j+1; i<n; ++i) {
+            const T* aij = a+(i*n+j)*W;
+            for (Index l = 0; l<W; ++l) {
+                const T v = std::abs(aij[l]);
+                const bool better = v>best[l];
+                best[l] = better ? v : best[l];
+                prow[l] = better ? i : prow[l];
+            }
+        }
+
+        // the row swaps differ from lane to lane, but cost only O(n) each
+        for (Index l = 0; l<W; ++l) {
+            if (best[l]==T()) {    // singular: carry on with a harmless pivot
+                if (status[l]==0) status[l] = j+1;
+                ajj[l] = T(1);
+                continue;
+            }
+            const Index p = prow[l];
+            if (p!=j) {
+                for (Index k = j; k<n; ++k) std::swap(a[(j*n+k)*W+l],a[(p*n+k)*W+l]);
+                std::swap(b[j*W+l],b[p*W+l]);
+            }
+        }
+
+        T* invj = pinv+j*W;
+        for (Index l = 0; l<W; ++l) invj[l] = T(1)/ajj[l];
+
+        // elimination: the inner loops run across the lanes
+        const T* bj = b+j*W;
+        for (Index i = j+1; i<n; ++i) {
+            T* ai = a+i*n*W;
+            T mult[batch_lanes];
+            for (Index l = 0; l<W; ++l) mult[l] = ai[j*W+l]/ajj[l];    // not *invj: a copy of the pivot row must cancel exactly
+            for (Index k = j+1; k<n; ++k) {
+                const T* ajk = a+(j*n+k)*W;
+                T* aik = ai+k*W;
+                for (Index l = 0; l<W; ++l) aik[l] -= mult[l]*ajk[l];
+            }
+            T* bi = b+i*W;
+            for (Index l = 0; l<W; ++l) bi[l] -= mult[l]*bj[l];
+        }
+    }
+
+    // back substitution
+    for (Index i = n-1; i>=0; --i) {
+        T s[batch_lanes];
+        T* bi = b+i*W;
+        for (Index l = 0; l<W; ++l) s[l] = bi[l];
+        for (Index k = i+1; k<n; ++k) {
+            const T* aik = a+(i*n+k)*W;
+            const T* bk = b+k*W;
+            for (Index l = 0; l<W; ++l) s[l] -= aik[l]*bk[l];
+        }
+        const T* invi = pinv+i*W;
+        for (Index l = 0; l<W; ++l) bi[l] = s[l]*invi[l];
+    }
+
+    Index failures = 0;
+    for (Index l = 0; l<W; ++l)
+        if (status[l]) ++failures;
+    return failures;
+}
+
+//-----------------------------------------------------------------------------
+
+template<class T, class C, class A, class C2, class A2>
+std::vector<Index> batched_solve(const Matrix<T,3,C,A>& a, Matrix<T,2,C2,A2>& b, Thread_pool& pool = default_thread_pool())
+    // solve a[k]*x==b[k] for every k, by Gaussian elimination with partial
+    // pivoting; b[k] is replaced by the solution
+    // returns one entry per system: 0 if it was solved, j+1 if a[k] is singular
+    // (no pivot in column j), in which case b[k] is set to NaN
+{
+    const Index count = a.dim1();
+    const Index n = a.dim2();
+    if (a.dim3()!=n) error("batched_solve(): systems not square");
+    if (b.dim1()!=count || b.dim2()!=n) error("batched_solve(): wrong right-hand sides");
+
+    std::vector<Index> status(count,0);
+    if (count==0 || n==0) return status;
+
+    const Index W = batch_lanes;
+    const Index groups = (count+W-1)/W;
+    const T* pa = a.data();
+    T* pb = b.data();
+    Index* ps = &status[0];
+
+    // a group costs about n^3/3 * W multiply-adds
+    const Index grain = std::max(Index(1),parallel_grain/std::max(Index(1),n*n*W/3));
+    pool.parallel_for(0,groups,grain,[=](Index lo, Index hi) {
+        std::vector<T> ga(n*n*W);    // one group, interleaved
+        std::vector<T> gb(n*W);
+        Index gs[batch_lanes];
+        for (Index g = lo; g<hi; ++g) {
+            const Index k0 = g*W;
+            const Index lanes = std::min(W,count-k0);
+
+            for (Index l = 0; l<lanes; ++l) {
+                const T* ak = pa+(k0+l)*n*n;
+                for (Index e = 0; e<n*n; ++e) ga[e*W+l] = ak[e];
+                const T* bk = pb+(k0+l)*n;
+                for (Index i = 0; i<n; ++i) gb[i*W+l] = bk[i];
+            }
+            for (Index l = lanes; l<W; ++l) {    // pad the last group with identities
+                for (Index e = 0; e<n*n; ++e) ga[e*W+l] = T();
+                for (Index i = 0; i<n; ++i) {
+                    ga[(i*n+i)*W+l] = T(1);
+                    gb[i*W+l] = T();
+                }
+            }
+
+            solve_interleaved(&ga[0],&gb[0],n,gs);
+
+            for (Index l = 0; l<lanes; ++l) {
+                T* bk = pb+(k0+l)*n;
+                ps[k0+l] = gs[l];
+                if (gs[l])
+                    std::fill(bk,bk+n,std::numeric_limits<T>::quiet_NaN());
+                else
+                    for (Index i = 0; i<n; ++i) bk[i] = gb[i*W+l];
+            }
+        }
+    });
+
+    return status;
+}
+
+//-----------------------------------------------------------------------------
+
+}
+#endif
@@ -0,0 +1,192 @@
+/*
+    Integral_matrix: a summed-area table for Matrix<T,2>
+
+    The sum of m[0:n) (all elements of the first n rows) done as in exercise 11
+    of chapter 26 costs O(n*dim2()), and so does the sum over any rectangle of
+    m. An Integral_matrix holds, for every (i,j), the sum of the elements of m
+    above and to the left of it. It costs one extra element per element of m
+    and is built in two parallel sweeps; after that the sum over any rectangle
+    (or any number of leading rows) is three additions and can be asked for in
+    O(1), and rows can be appended as they come in:
+
+        Integral_matrix<double> im(m);
+        double s = im.sum(i0,j0,i1,j1);    // sum of m(i,j) for i in [i0:i1), j in [j0:j1)
+        double r = im.row_prefix(n);        // sum of m[0:n)
+        im.append_row(r);                   // one more row of m, in O(dim2())
+
+    For floating-point elements the running sums are accumulated with Kahan
+    compensation, so that adding a long row of small elements to a large sum
+    does not lose them.
+*/
+
+#ifndef INTEGRAL_MATRIX_LIB
+#define INTEGRAL_MATRIX_LIB
+
+#include<algorithm>
+#include<type_traits>
+#include<vector>
+#include "Matrix.h"
+#include "Thread_pool.h"
+
+namespace Numeric_lib {
+
+//-----------------------------------------------------------------------------
+
+template<class T, bool = std::is_floating_point<T>::value> struct Running_sum {
+    // s += x, exactly for integers
+    T s;
+    explicit Running_sum(T init = T(), T = T()) :s(init) { }
+    void add(T x) { s += x; }
+    T sum() const { return s; }
+    T compensation() const { return T(); }
+};
+
+template<class T> struct Running_sum<T,true> {
+    // s += x with Kahan compensation: c holds the low-order part lost so far
+    T s;
+    T c;
+    explicit Running_sum(T init = T(), T comp = T()) :s(init), c(comp) { }
+    void add(T x)
+    {
+        const T y = x-c;
+        const T t = s+y;
+        c = (t-s)-y;
+        s = t;
+    }
+    T sum() const { return s; }
+    T compensation() const { return c; }
+};
+
+//-----------------------------------------------------------------------------
+
+template<class T = double> class Integral_matrix {
+    // s(i,j) is the sum of m(r,c) for r<i and c<j, for i in [0:dim1()] and
+    // j in [0:dim2()]; row 0 and column 0 are zero, so no query needs a special case
+public:
+    explicit Integral_matrix(Index cols)    // no rows yet: append them
+        :d1(0), d2(cols), s(cols+1,T()), carry(cols+1,T())
+    {
+        if (cols<0) error("Integral_matrix: negative number of columns");
+    }
+
+    template<class C, class A>
+    explicit Integral_matrix(const Matrix<T,2,C,A>& m, Thread_pool& pool = default_thread_pool());
+
+    Index dim1() const { return d1; }    // the rows and columns of the Matrix summed
+    Index dim2() const { return d2; }
+
+    T prefix(Index i, Index j) const
+        // sum of m(r,c) for r in [0:i), c in [0:j)
+    {
+        if (i<0 || d1<i || j<0 || d2<j) error("Integral_matrix: range error");
+        return s[i*(d2+1)+j];
+    }
+
+    T sum(Index i0, Index j0, Index i1, Index j1) const
+        // sum of m(r,c) for r in [i0:i1), c in [j0:j1)
+    {
+        if (i0<0 || i1<i0 || d1<i1 || j0<0 || j1<j0 || d2<j1) error("Integral_matrix: bad rectangle");
+        const T* p0 = &s[i0*(d2+1)];
+        const T* p1 = &s[i1*(d2+1)];
+        return (p1[j1]-p0[j1]) - (p1[j0]-p0[j0]);
+    }
+
+    T row_prefix(Index n) const { return prefix(n,d2); }    // sum of m[0:n)
+    T row_sum(Index i) const { return sum(i,0,i+1,d2); }     // sum of m[i]
+    T total() const { return s[d1*(d2+1)+d2]; }
+
+    void append_row(const T* p);    // p points to dim2() elements
+
+    template<class C, class A> void append_row(const Matrix<T,1,C,A>& r)
+    {
+        if (r.size()!=d2) error("Integral_matrix::append_row(): wrong number of elements");
+        append_row(r.data());
+    }
+
+    template<class C, class A> void append_rows(const Matrix<T,2,C,A>& m)
+    {
+        if (m.dim2()!=d2) error("Integral_matrix::append_rows(): wrong number of columns");
+        s.reserve((d1+m.dim1()+1)*(d2+1));
+        for (Index i = 0; i<m.dim1(); ++i) append_row(m.data()+i*d2);
+    }
+private:
+    Index d1, d2;
+    std::vector<T> s;        // (d1+1)*(d2+1) elements
+    std::vector<T> carry;    // compensation of the running sum down each column, for append_row()
+
+    static void row_prefix_sums(const T* p, Index n, T* out)
+        // out[0] = 0, out[j+1] = p[0]+...+p[j]
+    {
+        Running_sum<T> r;
+        out[0] = T();
+        for (Index j = 0; j<n; ++j) {
+            r.add(p[j]);
+            out[j+1] = r.sum();
+        }
+    }
+};
+
+//-----------------------------------------------------------------------------
+
+template<class T> template<class C, class A>
+Integral_matrix<T>::Integral_matrix(const Matrix<T,2,C,A>& m, Thread_pool& pool)
+    :d1(m.dim1()), d2(m.dim2()), s((m.dim1()+1)*(m.dim2()+1)), carry(m.dim2()+1,T())
+    // first the sums along each row, row by row in parallel; then the running
+    // sums down the columns, a block of columns per thread, each block going
+    // down the rows so that it reads contiguous memory
+{
+    const Index n1 = d1;
+    const Index n2 = d2;
+    const Index w = n2+1;
+    const T* pm = m.data();
+    T* ps = &s[0];
+    T* pc = &carry[0];
+
+    std::fill(ps,ps+w,T());
+    pool.parallel_for(0,n1,std::max(Index(1),parallel_grain/std::max(Index(1),n2)),[=](Index lo, Index hi) {
+        for (Index i = lo; i<hi; ++i) row_prefix_sums(pm+i*n2,n2,ps+(i+1)*w);
+    });
+
+    const Index block = 512;    // columns: a few cache lines per row
+    pool.parallel_for(0,(w+block-1)/block,std::max(Index(1),parallel_grain/std::max(Index(1),n1*block)),[=](Index lo, Index hi) {
+        std::vector<Running_sum<T> > col(block);
+        for (Index b = lo; b<hi; ++b) {
+            const Index j0 = b*block;
+            const Index j1 = std::min(j0+block,w);
+            std::fill(col.begin(),col.end(),Running_sum<T>());
+            for (Index i = 1; i<=n1; ++i) {
+                T* row = ps+i*w;
+                for (Index j = j0; j<j1; ++j) {
+                    Running_sum<T>& r = col[j-j0];
+                    r.add(row[j]);
+                    row[j] = r.sum();
+                }
+            }
+            for (Index j = j0; j<j1; ++j) pc[j] = col[j-j0].compensation();
+        }
+    });
+}
+
+//-----------------------------------------------------------------------------
+
+template<class T> void Integral_matrix<T>::append_row(const T* p)
+    // the new last row of s is the old one plus the prefix sums of p
+{
+    const Index w = d2+1;
+    s.resize(s.size()+w);
+    T* last = &s[d1*w];
+    T* row = last+w;
+    row_prefix_sums(p,d2,row);
+    for (Index j = 0; j<w; ++j) {
+        Running_sum<T> r(last[j],carry[j]);
+        r.add(row[j]);
+        row[j] = r.sum();
+        carry[j] = r.compensation();
+    }
+    ++d1;
+}
+
+//-----------------------------------------------------------------------------
+
+}
+#endif
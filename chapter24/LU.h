@@ -0,0 +1,263 @@
+/*
+    LU factorization with partial pivoting for Numeric_lib
+
+    LU_factorization<T> lu(A) factors A once, at O(n^3) cost. After that every
+    lu.solve(b) costs only O(n^2), so solving many systems that share the same
+    A doesn't repeat the elimination for each right-hand side.
+
+    mixed_precision_solve() factors a double A in float, which takes half the
+    memory traffic and (with SIMD) half the time, and then refines the float
+    solution with residuals computed in double until it is as accurate as a
+    double solve would be. If A is too badly conditioned for that to work,
+    it falls back to factoring A in double.
+*/
+
+#ifndef LU_LIB
+#define LU_LIB
+
+#include<cmath>
+#include<limits>
+#include<vector>
+#include "Matrix.h"
+#include "Thread_pool.h"
+
+namespace Numeric_lib {
+
+//-----------------------------------------------------------------------------
+
+template<class T = double> class LU_factorization {
+    // PA = LU for a square A, by blocked right-looking elimination: a panel of
+    // nb columns is factored with partial pivoting, the rows of U to its right
+    // are solved for, and the rest of the matrix is updated by a single gemm()
+    // on the thread pool, which is where nearly all of the time goes
+    // L (with an implicit unit diagonal) and U are stored in one matrix; P is
+    // kept as a vector of row swaps: in step i, row i was swapped with row pivots()[i]
+public:
+    template<class C, class A>
+    explicit LU_factorization(const Matrix<T,2,C,A>& a, Index block = 64, Thread_pool& p = default_thread_pool());
+
+    Index dim() const { return lu.dim1(); }
+    const Matrix<T,2>& factors() const { return lu; }
+    const std::vector<Index>& pivots() const { return piv; }
+
+    template<class C, class A> Matrix<T,1,C,A> solve(const Matrix<T,1,C,A>& b) const;    // x such that Ax==b
+    template<class C, class A> Matrix<T,2,C,A> solve(const Matrix<T,2,C,A>& b) const;    // X such that AX==B: one right-hand side per column
+private:
+    Matrix<T,2> lu;
+    std::vector<Index> piv;
+    Index nb;
+    Thread_pool* pool;
+};
+
+//-----------------------------------------------------------------------------
+
+template<class T> template<class C, class A>
+LU_factorization<T>::LU_factorization(const Matrix<T,2,C,A>& a, Index block, Thread_pool& p)
+    :lu(a.expr()), piv(a.dim1()), nb(std::max(Index(1),block)), pool(&p)
+{
+    const Index n = lu.dim1();
+    if (n != lu.dim2()) error("LU_factorization: matrix not square");
+    T* m = lu.data();
+
+    for (Index k0 = 0; k0<n; k0 += nb) {
+        const Index k1 = std::min(k0+nb,n);    // the panel is columns [k0:k1)
+
+        // factor the panel, swapping whole rows so that the L already computed follows:
+        for (Index j = k0; j<k1; ++j) {
+            Index pr = j;
+            for (Index i = j+1; i<n; ++i)
+                if (std::abs(m[i*n+j]) > std::abs(m[pr*n+j])) pr = i;
+            if (m[pr*n+j] == T()) error("LU_factorization: singular matrix");
+            piv[j] = pr;
+            if (pr != j) std::swap_ranges(m+j*n,m+(j+1)*n,m+pr*n);
+
+            const T* uj = m+j*n;
+            for (Index i = j+1; i<n; ++i) {
+                T* ai = m+i*n;
+                const T l = ai[j] /= uj[j];
+                for (Index c = j+1; c<k1; ++c) ai[c] -= l*uj[c];
+            }
+        }
+        if (k1 == n) break;
+
+        // U12 = inverse(L11)*A12; each block of columns can be done on its own
+        pool->parallel_for(k1,n,256,[=](Index lo, Index hi) {
+            for (Index i = k0+1; i<k1; ++i) {
+                T* ui = m+i*n;
+                for (Index r = k0; r<i; ++r) {
+                    const T l = ui[r];
+                    const T* ur = m+r*n;
+                    for (Index c = lo; c<hi; ++c) ui[c] -= l*ur[c];
+                }
+            }
+        });
+
+        // A22 -= L21*U12
+        gemm(*pool,n-k1,n-k1,k1-k0,T(-1),m+k1*n+k0,n,m+k0*n+k1,n,m+k1*n+k1,n);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+template<class T> template<class C, class A> Matrix<T,1,C,A> LU_factorization<T>::solve(const Matrix<T,1,C,A>& b) const
+{
+    const Index n = dim();
+    if (b.size() != n) error("LU_factorization::solve(): wrong number of elements");
+    Matrix<T,1,C,A> x(b.data(),n);
+
+    for (Index i = 0; i<n; ++i)    // Pb
+        if (piv[i] != i) std::swap(x(i),x(piv[i]));
+
+    for (Index i = 1; i<n; ++i)    // Ly = Pb
+        x(i) -= dot_product(lu[i].slice(0,i),x.slice(0,i));
+
+    for (Index i = n-1; i>=0; --i)    // Ux = y
+        x(i) = (x(i)-dot_product(lu[i].slice(i+1),x.slice(i+1))) / lu(i,i);
+
+    return x;
+}
+
+//-----------------------------------------------------------------------------
+
+template<class T> template<class C, class A> Matrix<T,2,C,A> LU_factorization<T>::solve(const Matrix<T,2,C,A>& b) const
+    // block by block, so that most of the work is done by gemm()
+{
+    const Index n = dim();
+    const Index k = b.dim2();
+    if (b.dim1() != n) error("LU_factorization::solve(): wrong number of rows");
+    Matrix<T,2,C,A> x(b);
+    const T* m = lu.data();
+    T* px = x.data();
+
+    for (Index i = 0; i<n; ++i)    // PB
+        x.swap_rows(i,piv[i]);
+
+    for (Index k0 = 0; k0<n; k0 += nb) {    // LY = PB
+        const Index k1 = std::min(k0+nb,n);
+        for (Index i = k0+1; i<k1; ++i)
+            for (Index r = k0; r<i; ++r)
+                x[i] = scale_and_add(x[r],-lu(i,r),x[i]);
+        if (k1<n) gemm(*pool,n-k1,k,k1-k0,T(-1),m+k1*n+k0,n,px+k0*k,k,px+k1*k,k);
+    }
+
+    for (Index k1 = n; k1>0; k1 -= nb) {    // UX = Y, from the bottom up
+        const Index k0 = std::max(Index(0),k1-nb);
+        if (k1<n) gemm(*pool,k1-k0,k,n-k1,T(-1),m+k0*n+k1,n,px+k1*k,k,px+k0*k,k);
+        for (Index i = k1-1; i>=k0; --i) {
+            for (Index r = i+1; r<k1; ++r)
+                x[i] = scale_and_add(x[r],-lu(i,r),x[i]);
+            x[i] /= lu(i,i);
+        }
+    }
+
+    return x;
+}
+
+//-----------------------------------------------------------------------------
+
+struct Refinement_result {
+    Index iterations;    // refinement steps taken (not counting the first float solve)
+    double residual;     // |b-Ax| / (|A||x|+|b|), in the max norm, at the end
+    bool converged;      // residual <= the tolerance asked for
+    bool fell_back;      // the float factors didn't do: x comes from a double factorization
+};
+
+// the norms are NaN if an element is: std::max() would drop it, and a
+// float factorization that overflowed would look like a perfect solution
+
+template<class T, class C, class A> T max_norm(const Matrix<T,1,C,A>& v)
+{
+    T m = T();
+    for (Index i = 0; i<v.size(); ++i) {
+        const T e = std::abs(v(i));
+        if (e>m || std::isnan(e)) m = e;
+        if (std::isnan(m)) break;
+    }
+    return m;
+}
+
+template<class T, class C, class A> T max_norm(const Matrix<T,2,C,A>& a)
+    // the largest sum of absolute values of a row
+{
+    T m = T();
+    for (Index i = 0; i<a.dim1(); ++i) {
+        const T* p = a.data()+i*a.dim2();
+        T s = T();
+        for (Index j = 0; j<a.dim2(); ++j) s += std::abs(p[j]);
+        if (s>m || std::isnan(s)) m = s;
+        if (std::isnan(m)) break;
+    }
+    return m;
+}
+
+//-----------------------------------------------------------------------------
+
+template<class C, class A, class C2, class A2>
+Refinement_result mixed_precision_solve(const Matrix<double,2,C,A>& a, const Matrix<double,1,C2,A2>& b, Matrix<double,1,C2,A2>& x,
+                                        double tol = 0, Index max_iter = 30, Thread_pool& pool = default_thread_pool())
+    // x such that Ax==b: factor A in float, then repeat x += inverse(LU)*(b-Ax)
+    // with b-Ax in double until the residual is <= tol (default: that of a
+    // double solve, sqrt(n) times the double epsilon)
+    // if the factorization fails in float, or the residual stops shrinking by at
+    // least half each step, or max_iter steps aren't enough, A is factored in double
+{
+    const Index n = a.dim1();
+    if (a.dim2()!=n) error("mixed_precision_solve(): matrix not square");
+    if (b.size()!=n || x.size()!=n) error("mixed_precision_solve(): wrong sizes");
+    if (tol<=0) tol = std::sqrt(double(std::max(n,Index(1))))*std::numeric_limits<double>::epsilon();
+
+    const double anorm = max_norm(a);
+    const double bnorm = max_norm(b);
+    auto backward_error = [&](const Matrix<double,1,C2,A2>& r) {
+        const double d = anorm*max_norm(x)+bnorm;
+        return d==0 ? 0.0 : max_norm(r)/d;    // NaN if x or r is
+    };
+
+    Refinement_result res;
+    res.iterations = 0;
+    res.fell_back = false;
+
+    Matrix<float,1> rf(n,uninitialized);
+    Matrix<double,1,C2,A2> r(n,uninitialized);
+    try {
+        Matrix<float,2> af(n,n,uninitialized);
+        for (Index i = 0; i<a.size(); ++i) af.data()[i] = float(a.data()[i]);
+        LU_factorization<float> lu(af,64,pool);
+
+        for (Index i = 0; i<n; ++i) rf(i) = float(b(i));
+        Matrix<float,1> d = lu.solve(rf);
+        for (Index i = 0; i<n; ++i) x(i) = d(i);
+
+        r = scale_and_add(a*x,-1.0,b);    // b-Ax, in double
+        res.residual = backward_error(r);
+        while (res.residual>tol && res.iterations<max_iter) {
+            for (Index i = 0; i<n; ++i) rf(i) = float(r(i));
+            d = lu.solve(rf);
+            for (Index i = 0; i<n; ++i) x(i) += d(i);
+            ++res.iterations;
+
+            r = scale_and_add(a*x,-1.0,b);
+            const double prev = res.residual;
+            res.residual = backward_error(r);
+            if (res.residual>0.5*prev) break;    // stalled: float isn't good enough for A
+        }
+    }
+    catch (Matrix_error&) {    // singular in float
+        res.residual = std::numeric_limits<double>::infinity();
+    }
+
+    if (!(res.residual<=tol)) {    // NaN too: the float factors overflowed
+        LU_factorization<double> lu(a,64,pool);    // throws if A is singular in double too
+        x = lu.solve(b);
+        r = scale_and_add(a*x,-1.0,b);
+        res.residual = backward_error(r);
+        res.fell_back = true;
+    }
+    res.converged = res.residual<=tol;
+    return res;
+}
+
+//-----------------------------------------------------------------------------
+
+}
+#endif
@@ -13,7 +13,13 @@
 
 #include<string>
 #include<algorithm>
+#include<cstddef>
+#include<new>
+#include<type_traits>
+#include<vector>
 //#include<iostream>
+#include "Thread_pool.h"
+#include "Simd.h"
 
 namespace Numeric_lib {
 
@@ -38,15 +44,69 @@ typedef long Index;    // I still dislike unsigned
 
 //-----------------------------------------------------------------------------
 
+// Range checking policies, the third template argument of Matrix and Row.
+// The tests are on compile-time constants, so a check that is turned off
+// costs nothing and doesn't keep the compiler from vectorizing a loop.
+
+struct Checked {          // check every subscript (the default)
+    static const bool check_elements = true;
+    static const bool check_rows = true;
+};
+
+struct Unchecked {        // check nothing
+    static const bool check_elements = false;
+    static const bool check_rows = false;
+};
+
+struct Debug_sampled {    // check only when taking a row out of a Matrix (slices clamp anyway),
+                          // not every element access inside the loops that use the row
+    static const bool check_elements = false;
+    static const bool check_rows = true;
+};
+
+//-----------------------------------------------------------------------------
+
+// Allocators for the elements of a Matrix, the fourth template argument of
+// Matrix and Row. An allocator needs only
+//     T* allocate(Index n);              // raw memory for n elements
+//     void deallocate(T* p, Index n);    // give back what allocate(n) returned
+// and must be copyable; std::allocator<T> will do, as will the Arena_allocator
+// of Arena.h, which serves short-lived matrices without calling malloc().
+
+const std::size_t matrix_alignment = 64;    // a cache line; enough for any SIMD load
+
+template<class T> class Aligned_allocator {
+    // the default: elements start on a matrix_alignment boundary
+public:
+    T* allocate(Index n)
+    {
+        // over-allocate, and keep the pointer we got just in front of the aligned block
+        const std::size_t bytes = std::size_t(n)*sizeof(T) + matrix_alignment + sizeof(void*);
+        char* raw = static_cast<char*>(::operator new(bytes));
+        std::size_t p = reinterpret_cast<std::size_t>(raw+sizeof(void*));
+        p = (p+matrix_alignment-1) & ~(matrix_alignment-1);
+        reinterpret_cast<void**>(p)[-1] = raw;
+        return reinterpret_cast<T*>(p);
+    }
+
+    void deallocate(T* p, Index)
+    {
+        if (p) ::operator delete(reinterpret_cast<void**>(p)[-1]);
+    }
+};
+
+//-----------------------------------------------------------------------------
+
 // The general Matrix template is simply a prop for its specializations:
-template<class T = double, int D = 1> class Matrix {
+template<class T = double, int D = 1, class C = Checked, class A = Aligned_allocator<T> > class Matrix {
     // multidimensional matrix class
     // ( ) does multidimensional subscripting
     // [ ] does C style "slicing": gives an N-1 dimensional matrix from an N dimensional one
     // row() is equivalent to [ ]
-    // column() is not (yet) implemented because it requires strides.
+    // column(), transposed() and block() give views (see Vector_view and Matrix_view)
     // = has copy semantics
-    // ( ) and [ ] are range checked
+    // ( ) and [ ] are range checked, unless C says otherwise
+    // A allocates the elements; they are aligned for SIMD by default
     // slice() to give sub-ranges 
 private:
     Matrix();    // this should never be compiled
@@ -54,7 +114,10 @@ private:
 
 //-----------------------------------------------------------------------------
 
-template<class T = double, int D = 1> class Row ;    // forward declaration
+template<class T = double, int D = 1, class C = Checked, class A = Aligned_allocator<T> > class Row ;    // forward declaration
+
+template<class T, class C = Checked> class Vector_view;    // evenly spaced elements, such as a column
+template<class T, class C = Checked> class Matrix_view;    // evenly spaced rows of evenly spaced elements
 
 //-----------------------------------------------------------------------------
 
@@ -107,8 +170,45 @@ template<class T> struct Complement {
 
 //-----------------------------------------------------------------------------
 
+struct Uninitialized { };    // tag for constructors that leave the elements uninitialized
+const Uninitialized uninitialized = Uninitialized();
+    // for when every element is about to be overwritten anyway:
+    //     Matrix<double,2> m(n,n,uninitialized);
+    // for built-in types such as double the elements have indeterminate values;
+    // class types are default constructed
+
+//-----------------------------------------------------------------------------
+
+const Index parallel_grain = 16384;    // elements: below that, a chunk isn't worth a thread
+
+struct Parallel {
+    // tag for apply(par,f) and apply_new(par,f): do the work on a Thread_pool
+    //     m.apply(par,f);              // on default_thread_pool()
+    //     m.apply(par(pool,256),f);    // on pool, at least 256 elements at a time
+    // each chunk of elements gets its own copy of f; a Matrix of less than
+    // a couple of grains is done by the calling thread alone
+    Thread_pool* pool;    // 0 for default_thread_pool()
+    Index grain;          // the fewest elements given to a thread at a time
+
+    explicit Parallel(Thread_pool* p = 0, Index g = parallel_grain) :pool(p), grain(g) { }
+
+    Parallel operator()(Thread_pool& p, Index g = parallel_grain) const { return Parallel(&p,g); }
+    Parallel operator()(Index g) const { return Parallel(pool,g); }
+
+    Thread_pool& thread_pool() const { return pool ? *pool : default_thread_pool(); }
+};
+
+const Parallel par = Parallel();
+
+//-----------------------------------------------------------------------------
+
+template<class T> struct Expr_leaf;    // see "Expression templates" below
+template<class T, class E1, class E2> struct Expr_scale_and_add;
+
+//-----------------------------------------------------------------------------
+
 // Matrix_base represents the common part of the Matrix classes:
-template<class T> class Matrix_base {
+template<class T, class A = Aligned_allocator<T> > class Matrix_base {
     // matrixs store their memory (elements) in Matrix_base and have copy semantics
     // Matrix_base does element-wise operations
 protected:
@@ -116,13 +216,23 @@ protected:
     const Index sz;    
     mutable bool owns;
     mutable bool xfer;
+    A alloc;    // for owned elements
 public:
-    Matrix_base(Index n) :elem(new T[n]()), sz(n), owns(true), xfer(false)
+    Matrix_base(Index n, const A& a = A()) :elem(0), sz(n), owns(true), xfer(false), alloc(a)
         // matrix of n elements (default initialized)
     {
+        elem = alloc.allocate(n);
+        for (Index i = 0; i<n; ++i) new(elem+i) T();
         // std::cerr << "new[" << n << "]->" << elem << "\n";
     }
 
+    Matrix_base(Index n, Uninitialized, const A& a = A()) :elem(0), sz(n), owns(true), xfer(false), alloc(a)
+        // matrix of n elements, left uninitialized
+    {
+        elem = alloc.allocate(n);
+        for (Index i = 0; i<n; ++i) new(elem+i) T;
+    }
+
     Matrix_base(Index n, T* p) :elem(p), sz(n), owns(false), xfer(false)
         // descriptor for matrix of n elements owned by someone else
     {
@@ -132,7 +242,8 @@ public:
     {
         if (owns) {
             // std::cerr << "delete[" << sz << "] " << elem << "\n";
-            delete[]elem;
+            for (Index i = 0; i<sz; ++i) elem[i].~T();
+            alloc.deallocate(elem,sz);
         }
     }
 
@@ -141,6 +252,8 @@ public:
     const T* data() const { return elem; }
     Index    size() const { return sz; }
 
+    const A& get_allocator() const { return alloc; }
+
     void copy_elements(const Matrix_base& a)
     {
         if (sz!=a.sz) error("copy_elements()");
@@ -151,6 +264,7 @@ public:
 
     void base_copy(const Matrix_base& a)
     {
+        alloc = a.alloc;
         if (a.xfer) {          // a is just about to be deleted
                                // so we can transfer ownership rather than copy
             // std::cerr << "xfer @" << a.elem << " [" << a.sz << "]\n";
@@ -159,9 +273,9 @@ public:
             a.owns = false;
         }
         else {
-            elem = new T[a.sz];
+            elem = alloc.allocate(a.sz);
             // std::cerr << "base copy @" << a.elem << " [" << a.sz << "]\n";
-            copy_elements(a);
+            for (Index i = 0; i<a.sz; ++i) new(elem+i) T(a.elem[i]);
         }
         owns = true;
         xfer = false;
@@ -174,10 +288,45 @@ public:
         owns = false;     // now the elements are safe from deletion by original owner
         x.xfer = true;    // target asserts temporary ownership
         x.owns = true;
+        x.alloc = alloc;  // and will give them back to the same allocator
     }
 
     template<class F> void base_apply(F f) { for (Index i = 0; i<size(); ++i) f(elem[i]); }
     template<class F> void base_apply(F f, const T& c) { for (Index i = 0; i<size(); ++i) f(elem[i],c); }
+
+    template<class F> void base_apply(const Parallel& p, F f)
+    {
+        T* e = elem;
+        p.thread_pool().parallel_for(0,sz,p.grain,[=](Index lo, Index hi) {
+            F g(f);
+            for (Index i = lo; i<hi; ++i) g(e[i]);
+        });
+    }
+
+    template<class F> void base_apply(const Parallel& p, F f, const T& c)
+    {
+        T* e = elem;
+        const T cc = c;
+        p.thread_pool().parallel_for(0,sz,p.grain,[=](Index lo, Index hi) {
+            F g(f);
+            for (Index i = lo; i<hi; ++i) g(e[i],cc);
+        });
+    }
+
+    // evaluate an expression (see Matrix_expr) into the elements in one pass:
+    template<class E> void base_assign_expr(const E& e) { for (Index i = 0; i<sz; ++i) elem[i] = e[i]; }
+
+    // scale_and_add() of two Matrices or Rows is common enough to get a SIMD kernel (see Simd.h):
+    void base_assign_expr(const Expr_scale_and_add<T,Expr_leaf<T>,Expr_leaf<T> >& e) { scale_and_add_kernel(sz,e.a.p,e.c,e.b.p,elem); }
+
+    template<class E> void base_assign_expr(const Parallel& p, const E& e)
+    {
+        T* d = elem;
+        p.thread_pool().parallel_for(0,sz,p.grain,[=](Index lo, Index hi) {
+            E x(e);
+            for (Index i = lo; i<hi; ++i) d[i] = x[i];
+        });
+    }
 private:
     void operator=(const Matrix_base&);    // no ordinary copy of bases
     Matrix_base(const Matrix_base&);
@@ -185,48 +334,165 @@ private:
 
 //-----------------------------------------------------------------------------
 
-template<class T> class Matrix<T,1> : public Matrix_base<T> {
+// function objects for the element-wise expressions below:
+
+template<class T> struct Add {
+    T operator()(const T& a, const T& c) const { return a+c; }
+};
+template<class T> struct Minus {
+    T operator()(const T& a, const T& c) const { return a-c; }
+};
+template<class T> struct Mul {
+    T operator()(const T& a, const T& c) const { return a*c; }
+};
+template<class T> struct Div {
+    T operator()(const T& a, const T& c) const { return a/c; }
+};
+template<class T> struct Mod {
+    T operator()(const T& a, const T& c) const { return a%c; }
+};
+template<class T> struct Or {
+    T operator()(const T& a, const T& c) const { return a|c; }
+};
+template<class T> struct Xor {
+    T operator()(const T& a, const T& c) const { return a^c; }
+};
+template<class T> struct And {
+    T operator()(const T& a, const T& c) const { return a&c; }
+};
+
+//-----------------------------------------------------------------------------
+
+// Expression templates
+//
+// m*c, m+c, -m, scale_and_add(a,c,b), apply(f,m) etc. don't compute anything:
+// they return a Matrix_expr recording what to do. The elements are computed
+// in a single pass, without temporary matrices, when the expression is
+// assigned to a Matrix or a Row (or used to initialize a Matrix). Element i
+// of the result depends only on element i of the operands, so assigning to
+// one of the operands, as in a[i].slice(j) = scale_and_add(a[j].slice(j),c,a[i].slice(j)),
+// is fine.
+//
+// Leaves hold a pointer to the elements, not a reference to the Matrix or Row,
+// because slices are usually temporaries. As with any slice, the expression
+// must not outlive the Matrix whose elements it refers to.
+
+template<class T> struct Expr_leaf {
+    // the elements of a Matrix or a Row
+    const T* p;
+    explicit Expr_leaf(const T* q) :p(q) { }
+    T operator[](Index i) const { return p[i]; }
+};
+
+template<class T, class E, class F> struct Expr_unary {
+    // f(e[i]); f gets a copy of the element, so it can't modify the operand
+    E e;
+    mutable F f;
+    Expr_unary(const E& ee, F ff) :e(ee), f(ff) { }
+    T operator[](Index i) const { T a = e[i]; return f(a); }
+};
+
+template<class T, class E, class F, class Arg> struct Expr_scalar {
+    // f(e[i],c) for a fixed c
+    E e;
+    mutable F f;
+    Arg c;
+    Expr_scalar(const E& ee, F ff, const Arg& cc) :e(ee), f(ff), c(cc) { }
+    T operator[](Index i) const { T a = e[i]; return f(a,c); }
+};
+
+template<class T, class E1, class E2> struct Expr_scale_and_add {
+    // a[i]*c+b[i]
+    E1 a;
+    T c;
+    E2 b;
+    Expr_scale_and_add(const E1& aa, const T& cc, const E2& bb) :a(aa), c(cc), b(bb) { }
+    T operator[](Index i) const { return a[i]*c+b[i]; }
+};
+
+//-----------------------------------------------------------------------------
+
+template<class T, int D, class E> class Matrix_expr {
+    // an unevaluated element-wise expression with the shape of a Matrix<T,D>
+    E e;
+    Index d[3];
+public:
+    Matrix_expr(const E& ee, Index n1, Index n2 = 1, Index n3 = 1) :e(ee)
+    {
+        d[0] = n1;
+        d[1] = n2;
+        d[2] = n3;
+    }
+
+    Index dim1() const { return d[0]; }
+    Index dim2() const { return d[1]; }
+    Index dim3() const { return d[2]; }
+    Index size() const { return d[0]*d[1]*d[2]; }
+
+    const E& expr() const { return e; }
+    T elem(Index i) const { return e[i]; }    // the i'th element in memory order
+};
+
+//-----------------------------------------------------------------------------
+
+template<class T, int D, class E, class F>
+Matrix_expr<T,D,Expr_unary<T,E,F> > unary_expr(const Matrix_expr<T,D,E>& x, F f)
+{
+    return Matrix_expr<T,D,Expr_unary<T,E,F> >(Expr_unary<T,E,F>(x.expr(),f),x.dim1(),x.dim2(),x.dim3());
+}
+
+template<class T, int D, class E, class F, class Arg>
+Matrix_expr<T,D,Expr_scalar<T,E,F,Arg> > scalar_expr(const Matrix_expr<T,D,E>& x, F f, const Arg& c)
+{
+    return Matrix_expr<T,D,Expr_scalar<T,E,F,Arg> >(Expr_scalar<T,E,F,Arg>(x.expr(),f,c),x.dim1(),x.dim2(),x.dim3());
+}
+
+//-----------------------------------------------------------------------------
+
+template<class T, class C, class A> class Matrix<T,1,C,A> : public Matrix_base<T,A> {
     const Index d1;
 
 protected:
     // for use by Row:
-    Matrix(Index n1, T* p) : Matrix_base<T>(n1,p), d1(n1)
+    Matrix(Index n1, T* p) : Matrix_base<T,A>(n1,p), d1(n1)
     {
         // std::cerr << "construct 1D Matrix from data\n";
     }
 
 public:
 
-    Matrix(Index n1) : Matrix_base<T>(n1), d1(n1) { }
+    Matrix(Index n1, const A& a = A()) : Matrix_base<T,A>(n1,a), d1(n1) { }
+
+    Matrix(Index n1, Uninitialized u, const A& a = A()) : Matrix_base<T,A>(n1,u,a), d1(n1) { }
 
-    Matrix(Row<T,1>& a) : Matrix_base<T>(a.dim1(),a.p), d1(a.dim1()) 
+    Matrix(Row<T,1,C,A>& a) : Matrix_base<T,A>(a.dim1(),a.p), d1(a.dim1()) 
     { 
         // std::cerr << "construct 1D Matrix from Row\n";
     }
 
     // copy constructor: let the base do the copy:
-    Matrix(const Matrix& a) : Matrix_base<T>(a.size(),0), d1(a.d1)
+    Matrix(const Matrix& a) : Matrix_base<T,A>(a.size(),0), d1(a.d1)
     {
         // std::cerr << "copy ctor\n";
         this->base_copy(a);
     }
 
     template<int n> 
-    Matrix(const T (&a)[n]) : Matrix_base<T>(n), d1(n)
+    Matrix(const T (&a)[n]) : Matrix_base<T,A>(n,uninitialized), d1(n)
         // deduce "n" (and "T"), Matrix_base allocates T[n]
     {
         // std::cerr << "matrix ctor\n";
         for (Index i = 0; i<n; ++i) this->elem[i]=a[i];
     }
 
-    Matrix(const T* p, Index n) : Matrix_base<T>(n), d1(n)
+    Matrix(const T* p, Index n) : Matrix_base<T,A>(n,uninitialized), d1(n)
         // Matrix_base allocates T[n]
     {
         // std::cerr << "matrix ctor\n";
         for (Index i = 0; i<n; ++i) this->elem[i]=p[i];
     }
 
-    template<class F> Matrix(const Matrix& a, F f) : Matrix_base<T>(a.size()), d1(a.d1)
+    template<class F> Matrix(const Matrix& a, F f) : Matrix_base<T,A>(a.size(),uninitialized,a.get_allocator()), d1(a.d1)
         // construct a new Matrix with element's that are functions of a's elements:
         // does not modify a unless f has been specifically programmed to modify its argument
         // T f(const T&) would be a typical type for f
@@ -234,7 +500,7 @@ public:
         for (Index i = 0; i<this->sz; ++i) this->elem[i] = f(a.elem[i]); 
     }
 
-    template<class F, class Arg> Matrix(const Matrix& a, F f, const Arg& t1) : Matrix_base<T>(a.size()), d1(a.d1)
+    template<class F, class Arg> Matrix(const Matrix& a, F f, const Arg& t1) : Matrix_base<T,A>(a.size(),uninitialized,a.get_allocator()), d1(a.d1)
         // construct a new Matrix with element's that are functions of a's elements:
         // does not modify a unless f has been specifically programmed to modify its argument
         // T f(const T&, const Arg&) would be a typical type for f
@@ -251,6 +517,26 @@ public:
         return *this;
     }
 
+    template<class E> Matrix(const Matrix_expr<T,1,E>& x, const A& a = A()) : Matrix_base<T,A>(x.size(),uninitialized,a), d1(x.dim1())
+        // evaluate an expression into a new Matrix
+    {
+        this->base_assign_expr(x.expr());
+    }
+
+    template<class U, class C2> Matrix(const Vector_view<U,C2>& v, const A& a = A()) : Matrix_base<T,A>(v.size(),uninitialized,a), d1(v.dim1())
+        // copy the elements of a view, say a column
+    {
+        for (Index i = 0; i<d1; ++i) this->elem[i] = v.data()[i*v.stride()];
+    }
+
+    template<class E> Matrix& operator=(const Matrix_expr<T,1,E>& x)
+        // evaluate an expression into this Matrix; no temporaries are created
+    {
+        if (d1!=x.dim1()) error("length error in 1D=");
+        this->base_assign_expr(x.expr());
+        return *this;
+    }
+
     ~Matrix() { }
 
     Index dim1() const { return d1; }    // number of elements in a row
@@ -269,55 +555,57 @@ public:
     }
 
     // subscripting:
-          T& operator()(Index n1)       { range_check(n1); return this->elem[n1]; }
-    const T& operator()(Index n1) const { range_check(n1); return this->elem[n1]; }
+          T& operator()(Index n1)       { if (C::check_elements) range_check(n1); return this->elem[n1]; }
+    const T& operator()(Index n1) const { if (C::check_elements) range_check(n1); return this->elem[n1]; }
 
     // slicing (the same as subscripting for 1D matrixs):
           T& operator[](Index n)       { return row(n); }
     const T& operator[](Index n) const { return row(n); }
 
-          T& row(Index n)       { range_check(n); return this->elem[n]; }
-    const T& row(Index n) const { range_check(n); return this->elem[n]; }
+          T& row(Index n)       { if (C::check_elements) range_check(n); return this->elem[n]; }
+    const T& row(Index n) const { if (C::check_elements) range_check(n); return this->elem[n]; }
 
-    Row<T,1> slice(Index n)
+    Row<T,1,C,A> slice(Index n)
         // the last elements from a[n] onwards
     {
         if (n<0) n=0;
         else if(d1<n) n=d1;// one beyond the end
-        return Row<T,1>(d1-n,this->elem+n);
+        return Row<T,1,C,A>(d1-n,this->elem+n);
     }
 
-    const Row<T,1> slice(Index n) const
+    const Row<T,1,C,A> slice(Index n) const
         // the last elements from a[n] onwards
     {
         if (n<0) n=0;
         else if(d1<n) n=d1;// one beyond the end
-        return Row<T,1>(d1-n,this->elem+n);
+        return Row<T,1,C,A>(d1-n,this->elem+n);
     }
 
-    Row<T,1> slice(Index n, Index m)
+    Row<T,1,C,A> slice(Index n, Index m)
         // m elements starting with a[n]
     {
         if (n<0) n=0;
         else if(d1<n) n=d1;    // one beyond the end
         if (m<0) m = 0;
         else if (d1<n+m) m=d1-n;
-        return Row<T,1>(m,this->elem+n);
+        return Row<T,1,C,A>(m,this->elem+n);
     }
 
-    const Row<T,1> slice(Index n, Index m) const
+    const Row<T,1,C,A> slice(Index n, Index m) const
         // m elements starting with a[n]
     {
         if (n<0) n=0;
         else if(d1<n) n=d1;    // one beyond the end
         if (m<0) m = 0;
         else if (d1<n+m) m=d1-n;
-        return Row<T,1>(m,this->elem+n);
+        return Row<T,1,C,A>(m,this->elem+n);
     }
 
     // element-wise operations:
     template<class F> Matrix& apply(F f) { this->base_apply(f); return *this; }
     template<class F> Matrix& apply(F f,const T& c) { this->base_apply(f,c); return *this; }
+    template<class F> Matrix& apply(const Parallel& p, F f)            { this->base_apply(p,f);   return *this; }
+    template<class F> Matrix& apply(const Parallel& p, F f,const T& c) { this->base_apply(p,f,c); return *this; }
 
     Matrix& operator=(const T& c)  { this->base_apply(Assign<T>(),c);       return *this; }
 
@@ -331,11 +619,27 @@ public:
     Matrix& operator|=(const T& c) { this->base_apply(Or_assign<T>(),c);    return *this; }
     Matrix& operator^=(const T& c) { this->base_apply(Xor_assign<T>(),c);   return *this; }
 
-    Matrix operator!() { return xfer(Matrix(*this,Not<T>())); }
-    Matrix operator-() { return xfer(Matrix(*this,Unary_minus<T>())); }
-    Matrix operator~() { return xfer(Matrix(*this,Complement<T>()));  }
+    // the elements as the leaf of an expression:
+    Matrix_expr<T,1,Expr_leaf<T> > expr() const { return Matrix_expr<T,1,Expr_leaf<T> >(Expr_leaf<T>(this->elem),d1); }
 
-    template<class F> Matrix apply_new(F f) { return xfer(Matrix(*this,f)); }
+    // element-wise operations returning an (unevaluated) expression:
+    Matrix_expr<T,1,Expr_unary<T,Expr_leaf<T>,Not<T> > >         operator!() const { return unary_expr(expr(),Not<T>()); }
+    Matrix_expr<T,1,Expr_unary<T,Expr_leaf<T>,Unary_minus<T> > > operator-() const { return unary_expr(expr(),Unary_minus<T>()); }
+    Matrix_expr<T,1,Expr_unary<T,Expr_leaf<T>,Complement<T> > >  operator~() const { return unary_expr(expr(),Complement<T>()); }
+
+    template<class F> Matrix_expr<T,1,Expr_unary<T,Expr_leaf<T>,F > > apply_new(F f) const { return unary_expr(expr(),f); }
+
+    // the elements as a view, to be used with other views:
+    Vector_view<T,C>       view()       { return Vector_view<T,C>(this->elem,d1); }
+    Vector_view<const T,C> view() const { return Vector_view<const T,C>(this->elem,d1); }
+
+    template<class F> Matrix apply_new(const Parallel& p, F f) const
+        // evaluated right away, on p's threads
+    {
+        Matrix res(d1,uninitialized,this->get_allocator());
+        res.base_assign_expr(p,unary_expr(expr(),f).expr());
+        return res;
+    }
     
     void swap_rows(Index i, Index j)
         // swap_rows() uses a row's worth of memory for better run-time performance
@@ -343,7 +647,7 @@ public:
     {
         if (i == j) return;
     /*
-        Matrix<T,1> temp = (*this)[i];
+        Matrix<T,1,C,A> temp = (*this)[i];
         (*this)[i] = (*this)[j];
         (*this)[j] = temp;
     */
@@ -354,35 +658,37 @@ public:
 
 //-----------------------------------------------------------------------------
 
-template<class T> class Matrix<T,2> : public Matrix_base<T> {
+template<class T, class C, class A> class Matrix<T,2,C,A> : public Matrix_base<T,A> {
     const Index d1;
     const Index d2;
 
 protected:
     // for use by Row:
-    Matrix(Index n1, Index n2, T* p) : Matrix_base<T>(n1*n2,p), d1(n1), d2(n2) 
+    Matrix(Index n1, Index n2, T* p) : Matrix_base<T,A>(n1*n2,p), d1(n1), d2(n2) 
     {
         // std::cerr << "construct 3D Matrix from data\n";
     }
 
 public:
 
-    Matrix(Index n1, Index n2) : Matrix_base<T>(n1*n2), d1(n1), d2(n2) { }
+    Matrix(Index n1, Index n2, const A& a = A()) : Matrix_base<T,A>(n1*n2,a), d1(n1), d2(n2) { }
+
+    Matrix(Index n1, Index n2, Uninitialized u, const A& a = A()) : Matrix_base<T,A>(n1*n2,u,a), d1(n1), d2(n2) { }
 
-    Matrix(Row<T,2>& a) : Matrix_base<T>(a.dim1()*a.dim2(),a.p), d1(a.dim1()), d2(a.dim2())
+    Matrix(Row<T,2,C,A>& a) : Matrix_base<T,A>(a.dim1()*a.dim2(),a.p), d1(a.dim1()), d2(a.dim2())
     { 
         // std::cerr << "construct 2D Matrix from Row\n";
     }
 
     // copy constructor: let the base do the copy:
-    Matrix(const Matrix& a) : Matrix_base<T>(a.size(),0), d1(a.d1), d2(a.d2)
+    Matrix(const Matrix& a) : Matrix_base<T,A>(a.size(),0), d1(a.d1), d2(a.d2)
     {
         // std::cerr << "copy ctor\n";
         this->base_copy(a);
     }
 
     template<int n1, int n2> 
-    Matrix(const T (&a)[n1][n2]) : Matrix_base<T>(n1*n2), d1(n1), d2(n2)
+    Matrix(const T (&a)[n1][n2]) : Matrix_base<T,A>(n1*n2,uninitialized), d1(n1), d2(n2)
         // deduce "n1", "n2" (and "T"), Matrix_base allocates T[n1*n2]
     {
         // std::cerr << "matrix ctor\n";
@@ -390,7 +696,7 @@ public:
             for (Index j = 0; j<n2; ++j) this->elem[i*n2+j]=a[i][j];
     }
 
-    template<class F> Matrix(const Matrix& a, F f) : Matrix_base<T>(a.size()), d1(a.d1), d2(a.d2)
+    template<class F> Matrix(const Matrix& a, F f) : Matrix_base<T,A>(a.size(),uninitialized,a.get_allocator()), d1(a.d1), d2(a.d2)
         // construct a new Matrix with element's that are functions of a's elements:
         // does not modify a unless f has been specifically programmed to modify its argument
         // T f(const T&) would be a typical type for f
@@ -398,7 +704,7 @@ public:
         for (Index i = 0; i<this->sz; ++i) this->elem[i] = f(a.elem[i]); 
     }
 
-    template<class F, class Arg> Matrix(const Matrix& a, F f, const Arg& t1) : Matrix_base<T>(a.size()), d1(a.d1), d2(a.d2)
+    template<class F, class Arg> Matrix(const Matrix& a, F f, const Arg& t1) : Matrix_base<T,A>(a.size(),uninitialized,a.get_allocator()), d1(a.d1), d2(a.d2)
         // construct a new Matrix with element's that are functions of a's elements:
         // does not modify a unless f has been specifically programmed to modify its argument
         // T f(const T&, const Arg&) would be a typical type for f
@@ -415,6 +721,26 @@ public:
         return *this;
     }
 
+    template<class E> Matrix(const Matrix_expr<T,2,E>& x, const A& a = A()) : Matrix_base<T,A>(x.size(),uninitialized,a), d1(x.dim1()),d2(x.dim2())
+        // evaluate an expression into a new Matrix
+    {
+        this->base_assign_expr(x.expr());
+    }
+
+    template<class U, class C2> Matrix(const Matrix_view<U,C2>& v, const A& a = A()) : Matrix_base<T,A>(v.size(),uninitialized,a), d1(v.dim1()), d2(v.dim2())
+        // copy the elements of a view, say a transposed Matrix
+    {
+        v.copy_to(this->elem);
+    }
+
+    template<class E> Matrix& operator=(const Matrix_expr<T,2,E>& x)
+        // evaluate an expression into this Matrix; no temporaries are created
+    {
+        if (d1!=x.dim1() || d2!=x.dim2()) error("length error in 2D =");
+        this->base_assign_expr(x.expr());
+        return *this;
+    }
+
     ~Matrix() { }
     
     Index dim1() const { return d1; }    // number of elements in a row
@@ -435,54 +761,75 @@ public:
     }
 
     // subscripting:
-          T& operator()(Index n1, Index n2)       { range_check(n1,n2); return this->elem[n1*d2+n2]; }
-    const T& operator()(Index n1, Index n2) const { range_check(n1,n2); return this->elem[n1*d2+n2]; }
+          T& operator()(Index n1, Index n2)       { if (C::check_elements) range_check(n1,n2); return this->elem[n1*d2+n2]; }
+    const T& operator()(Index n1, Index n2) const { if (C::check_elements) range_check(n1,n2); return this->elem[n1*d2+n2]; }
 
     // slicing (return a row):
-          Row<T,1> operator[](Index n)       { return row(n); }
-    const Row<T,1> operator[](Index n) const { return row(n); }
+          Row<T,1,C,A> operator[](Index n)       { return row(n); }
+    const Row<T,1,C,A> operator[](Index n) const { return row(n); }
 
-          Row<T,1> row(Index n)       { range_check(n,0); return Row<T,1>(d2,&this->elem[n*d2]); }
-    const Row<T,1> row(Index n) const { range_check(n,0); return Row<T,1>(d2,&this->elem[n*d2]); }
+          Row<T,1,C,A> row(Index n)       { if (C::check_rows) range_check(n,0); return Row<T,1,C,A>(d2,&this->elem[n*d2]); }
+    const Row<T,1,C,A> row(Index n) const { if (C::check_rows) range_check(n,0); return Row<T,1,C,A>(d2,&this->elem[n*d2]); }
 
-    Row<T,2> slice(Index n)
+    Row<T,2,C,A> slice(Index n)
         // rows [n:d1)
     {
         if (n<0) n=0;
         else if(d1<n) n=d1;    // one beyond the end
-        return Row<T,2>(d1-n,d2,this->elem+n*d2);
+        return Row<T,2,C,A>(d1-n,d2,this->elem+n*d2);
     }
 
-    const Row<T,2> slice(Index n) const
+    const Row<T,2,C,A> slice(Index n) const
         // rows [n:d1)
     {
         if (n<0) n=0;
         else if(d1<n) n=d1;    // one beyond the end
-        return Row<T,2>(d1-n,d2,this->elem+n*d2);
+        return Row<T,2,C,A>(d1-n,d2,this->elem+n*d2);
     }
 
-    Row<T,2> slice(Index n, Index m)
+    Row<T,2,C,A> slice(Index n, Index m)
         // the rows [n:m)
     {
         if (n<0) n=0;
         if(d1<m) m=d1;    // one beyond the end
-        return Row<T,2>(m-n,d2,this->elem+n*d2);
+        return Row<T,2,C,A>(m-n,d2,this->elem+n*d2);
 
     }
 
-    const Row<T,2> slice(Index n, Index m) const
+    const Row<T,2,C,A> slice(Index n, Index m) const
         // the rows [n:sz)
     {
         if (n<0) n=0;
         if(d1<m) m=d1;    // one beyond the end
-        return Row<T,2>(m-n,d2,this->elem+n*d2);
+        return Row<T,2,C,A>(m-n,d2,this->elem+n*d2);
+    }
+
+    // views, refering to the elements in place:
+    Matrix_view<T,C>       view()       { return Matrix_view<T,C>(this->elem,d1,d2,d2); }
+    Matrix_view<const T,C> view() const { return Matrix_view<const T,C>(this->elem,d1,d2,d2); }
+
+    Vector_view<T,C>       column(Index n)       { return view().column(n); }
+    Vector_view<const T,C> column(Index n) const { return view().column(n); }
+
+    Matrix_view<T,C>       transposed()       { return view().transposed(); }
+    Matrix_view<const T,C> transposed() const { return view().transposed(); }
+
+    Matrix_view<T,C> block(Index i, Index j, Index n1, Index n2, Index step1 = 1, Index step2 = 1)
+        // see Matrix_view::block()
+    {
+        return view().block(i,j,n1,n2,step1,step2);
     }
 
-    // Column<T,1> column(Index n); // not (yet) implemented: requies strides and operations on columns
+    Matrix_view<const T,C> block(Index i, Index j, Index n1, Index n2, Index step1 = 1, Index step2 = 1) const
+    {
+        return view().block(i,j,n1,n2,step1,step2);
+    }
 
     // element-wise operations:
     template<class F> Matrix& apply(F f)            { this->base_apply(f);   return *this; }
     template<class F> Matrix& apply(F f,const T& c) { this->base_apply(f,c); return *this; }
+    template<class F> Matrix& apply(const Parallel& p, F f)            { this->base_apply(p,f);   return *this; }
+    template<class F> Matrix& apply(const Parallel& p, F f,const T& c) { this->base_apply(p,f,c); return *this; }
 
     Matrix& operator=(const T& c)  { this->base_apply(Assign<T>(),c);       return *this; }
 
@@ -496,11 +843,23 @@ public:
     Matrix& operator|=(const T& c) { this->base_apply(Or_assign<T>(),c);    return *this; }
     Matrix& operator^=(const T& c) { this->base_apply(Xor_assign<T>(),c);   return *this; }
 
-    Matrix operator!() { return xfer(Matrix(*this,Not<T>())); }
-    Matrix operator-() { return xfer(Matrix(*this,Unary_minus<T>())); }
-    Matrix operator~() { return xfer(Matrix(*this,Complement<T>()));  }
+    // the elements as the leaf of an expression:
+    Matrix_expr<T,2,Expr_leaf<T> > expr() const { return Matrix_expr<T,2,Expr_leaf<T> >(Expr_leaf<T>(this->elem),d1,d2); }
 
-    template<class F> Matrix apply_new(F f) { return xfer(Matrix(*this,f)); }
+    // element-wise operations returning an (unevaluated) expression:
+    Matrix_expr<T,2,Expr_unary<T,Expr_leaf<T>,Not<T> > >         operator!() const { return unary_expr(expr(),Not<T>()); }
+    Matrix_expr<T,2,Expr_unary<T,Expr_leaf<T>,Unary_minus<T> > > operator-() const { return unary_expr(expr(),Unary_minus<T>()); }
+    Matrix_expr<T,2,Expr_unary<T,Expr_leaf<T>,Complement<T> > >  operator~() const { return unary_expr(expr(),Complement<T>()); }
+
+    template<class F> Matrix_expr<T,2,Expr_unary<T,Expr_leaf<T>,F > > apply_new(F f) const { return unary_expr(expr(),f); }
+
+    template<class F> Matrix apply_new(const Parallel& p, F f) const
+        // evaluated right away, on p's threads
+    {
+        Matrix res(d1,d2,uninitialized,this->get_allocator());
+        res.base_assign_expr(p,unary_expr(expr(),f).expr());
+        return res;
+    }
     
     void swap_rows(Index i, Index j)
         // swap_rows() uses a row's worth of memory for better run-time performance
@@ -508,7 +867,7 @@ public:
     {
         if (i == j) return;
     /*
-        Matrix<T,1> temp = (*this)[i];
+        Matrix<T,1,C,A> temp = (*this)[i];
         (*this)[i] = (*this)[j];
         (*this)[j] = temp;
     */
@@ -517,46 +876,51 @@ public:
     }
 
     void swap_columns(Index i, Index j)
+        // the columns are checked once, not element by element
     {
         if (i==j) return;
-        Index max = dim1();
-        for (Index ii = 0; ii<max; ++ii)
-            std::swap((*this)(ii,i),(*this)(ii,j));
+        T* a = column(i).data();
+        T* b = column(j).data();
+        for (Index ii = 0; ii<d1; ++ii)
+            std::swap(a[ii*d2],b[ii*d2]);
     }
 };
 
 //-----------------------------------------------------------------------------
 
-template<class T> class Matrix<T,3> : public Matrix_base<T> {
+template<class T, class C, class A> class Matrix<T,3,C,A> : public Matrix_base<T,A> {
     const Index d1;
     const Index d2;
     const Index d3;
 
 protected:
     // for use by Row:
-    Matrix(Index n1, Index n2, Index n3, T* p) : Matrix_base<T>(n1*n2*n3,p), d1(n1), d2(n2), d3(n3) 
+    Matrix(Index n1, Index n2, Index n3, T* p) : Matrix_base<T,A>(n1*n2*n3,p), d1(n1), d2(n2), d3(n3) 
     {
         // std::cerr << "construct 3D Matrix from data\n";
     }
 
 public:
 
-    Matrix(Index n1, Index n2, Index n3) : Matrix_base<T>(n1*n2*n3), d1(n1), d2(n2), d3(n3) { }
+    Matrix(Index n1, Index n2, Index n3, const A& a = A()) : Matrix_base<T,A>(n1*n2*n3,a), d1(n1), d2(n2), d3(n3) { }
+
+    Matrix(Index n1, Index n2, Index n3, Uninitialized u, const A& a = A())
+        : Matrix_base<T,A>(n1*n2*n3,u,a), d1(n1), d2(n2), d3(n3) { }
 
-    Matrix(Row<T,3>& a) : Matrix_base<T>(a.dim1()*a.dim2()*a.dim3(),a.p), d1(a.dim1()), d2(a.dim2()), d3(a.dim3())
+    Matrix(Row<T,3,C,A>& a) : Matrix_base<T,A>(a.dim1()*a.dim2()*a.dim3(),a.p), d1(a.dim1()), d2(a.dim2()), d3(a.dim3())
     { 
         // std::cerr << "construct 3D Matrix from Row\n";
     }
 
     // copy constructor: let the base do the copy:
-    Matrix(const Matrix& a) : Matrix_base<T>(a.size(),0), d1(a.d1), d2(a.d2), d3(a.d3)
+    Matrix(const Matrix& a) : Matrix_base<T,A>(a.size(),0), d1(a.d1), d2(a.d2), d3(a.d3)
     {
         // std::cerr << "copy ctor\n";
         this->base_copy(a);
     }
 
     template<int n1, int n2, int n3> 
-    Matrix(const T (&a)[n1][n2][n3]) : Matrix_base<T>(n1*n2), d1(n1), d2(n2), d3(n3)
+    Matrix(const T (&a)[n1][n2][n3]) : Matrix_base<T,A>(n1*n2), d1(n1), d2(n2), d3(n3)
         // deduce "n1", "n2", "n3" (and "T"), Matrix_base allocates T[n1*n2*n3]
     {
         // std::cerr << "matrix ctor\n";
@@ -566,7 +930,7 @@ public:
                     this->elem[i*n2*n3+j*n3+k]=a[i][j][k];
     }
 
-    template<class F> Matrix(const Matrix& a, F f) : Matrix_base<T>(a.size()), d1(a.d1), d2(a.d2), d3(a.d3)
+    template<class F> Matrix(const Matrix& a, F f) : Matrix_base<T,A>(a.size(),uninitialized,a.get_allocator()), d1(a.d1), d2(a.d2), d3(a.d3)
         // construct a new Matrix with element's that are functions of a's elements:
         // does not modify a unless f has been specifically programmed to modify its argument
         // T f(const T&) would be a typical type for f
@@ -574,7 +938,7 @@ public:
         for (Index i = 0; i<this->sz; ++i) this->elem[i] = f(a.elem[i]); 
     }
 
-    template<class F, class Arg> Matrix(const Matrix& a, F f, const Arg& t1) : Matrix_base<T>(a.size()), d1(a.d1), d2(a.d2), d3(a.d3)
+    template<class F, class Arg> Matrix(const Matrix& a, F f, const Arg& t1) : Matrix_base<T,A>(a.size(),uninitialized,a.get_allocator()), d1(a.d1), d2(a.d2), d3(a.d3)
         // construct a new Matrix with element's that are functions of a's elements:
         // does not modify a unless f has been specifically programmed to modify its argument
         // T f(const T&, const Arg&) would be a typical type for f
@@ -591,6 +955,20 @@ public:
         return *this;
     }
 
+    template<class E> Matrix(const Matrix_expr<T,3,E>& x, const A& a = A()) : Matrix_base<T,A>(x.size(),uninitialized,a), d1(x.dim1()),d2(x.dim2()),d3(x.dim3())
+        // evaluate an expression into a new Matrix
+    {
+        this->base_assign_expr(x.expr());
+    }
+
+    template<class E> Matrix& operator=(const Matrix_expr<T,3,E>& x)
+        // evaluate an expression into this Matrix; no temporaries are created
+    {
+        if (d1!=x.dim1() || d2!=x.dim2() || d3!=x.dim3()) error("length error in 3D =");
+        this->base_assign_expr(x.expr());
+        return *this;
+    }
+
     ~Matrix() { }
 
     Index dim1() const { return d1; }    // number of elements in a row
@@ -613,47 +991,47 @@ public:
     }
 
     // subscripting:
-          T& operator()(Index n1, Index n2, Index n3)       { range_check(n1,n2,n3); return this->elem[d2*d3*n1+d3*n2+n3]; }; 
-    const T& operator()(Index n1, Index n2, Index n3) const { range_check(n1,n2,n3); return this->elem[d2*d3*n1+d3*n2+n3]; };
+          T& operator()(Index n1, Index n2, Index n3)       { if (C::check_elements) range_check(n1,n2,n3); return this->elem[d2*d3*n1+d3*n2+n3]; }; 
+    const T& operator()(Index n1, Index n2, Index n3) const { if (C::check_elements) range_check(n1,n2,n3); return this->elem[d2*d3*n1+d3*n2+n3]; };
 
     // slicing (return a row):
-          Row<T,2> operator[](Index n)       { return row(n); }
-    const Row<T,2> operator[](Index n) const { return row(n); }
+          Row<T,2,C,A> operator[](Index n)       { return row(n); }
+    const Row<T,2,C,A> operator[](Index n) const { return row(n); }
 
-          Row<T,2> row(Index n)       { range_check(n,0,0); return Row<T,2>(d2,d3,&this->elem[n*d2*d3]); }
-    const Row<T,2> row(Index n) const { range_check(n,0,0); return Row<T,2>(d2,d3,&this->elem[n*d2*d3]); }
+          Row<T,2,C,A> row(Index n)       { if (C::check_rows) range_check(n,0,0); return Row<T,2,C,A>(d2,d3,&this->elem[n*d2*d3]); }
+    const Row<T,2,C,A> row(Index n) const { if (C::check_rows) range_check(n,0,0); return Row<T,2,C,A>(d2,d3,&this->elem[n*d2*d3]); }
 
-    Row<T,3> slice(Index n)
+    Row<T,3,C,A> slice(Index n)
         // rows [n:d1)
     {
         if (n<0) n=0;
         else if(d1<n) n=d1;    // one beyond the end
-        return Row<T,3>(d1-n,d2,d3,this->elem+n*d2*d3);
+        return Row<T,3,C,A>(d1-n,d2,d3,this->elem+n*d2*d3);
     }
 
-    const Row<T,3> slice(Index n) const
+    const Row<T,3,C,A> slice(Index n) const
         // rows [n:d1)
     {
         if (n<0) n=0;
         else if(d1<n) n=d1;    // one beyond the end
-        return Row<T,3>(d1-n,d2,d3,this->elem+n*d2*d3);
+        return Row<T,3,C,A>(d1-n,d2,d3,this->elem+n*d2*d3);
     }
 
-    Row<T,3> slice(Index n, Index m)
+    Row<T,3,C,A> slice(Index n, Index m)
         // the rows [n:m)
     {
         if (n<0) n=0;
         if(d1<m) m=d1;    // one beyond the end
-        return Row<T,3>(m-n,d2,d3,this->elem+n*d2*d3);
+        return Row<T,3,C,A>(m-n,d2,d3,this->elem+n*d2*d3);
 
     }
 
-    const Row<T,3> slice(Index n, Index m) const
+    const Row<T,3,C,A> slice(Index n, Index m) const
         // the rows [n:sz)
     {
         if (n<0) n=0;
         if(d1<m) m=d1;    // one beyond the end
-        return Row<T,3>(m-n,d2,d3,this->elem+n*d2*d3);
+        return Row<T,3,C,A>(m-n,d2,d3,this->elem+n*d2*d3);
     }
 
     // Column<T,2> column(Index n); // not (yet) implemented: requies strides and operations on columns
@@ -661,6 +1039,8 @@ public:
     // element-wise operations:
     template<class F> Matrix& apply(F f)            { this->base_apply(f);   return *this; }
     template<class F> Matrix& apply(F f,const T& c) { this->base_apply(f,c); return *this; }
+    template<class F> Matrix& apply(const Parallel& p, F f)            { this->base_apply(p,f);   return *this; }
+    template<class F> Matrix& apply(const Parallel& p, F f,const T& c) { this->base_apply(p,f,c); return *this; }
 
     Matrix& operator=(const T& c)  { this->base_apply(Assign<T>(),c);       return *this; }
                                                                             
@@ -674,11 +1054,23 @@ public:
     Matrix& operator|=(const T& c) { this->base_apply(Or_assign<T>(),c);    return *this; }
     Matrix& operator^=(const T& c) { this->base_apply(Xor_assign<T>(),c);   return *this; }
 
-    Matrix operator!() { return xfer(Matrix(*this,Not<T>())); }
-    Matrix operator-() { return xfer(Matrix(*this,Unary_minus<T>())); }
-    Matrix operator~() { return xfer(Matrix(*this,Complement<T>()));  }
+    // the elements as the leaf of an expression:
+    Matrix_expr<T,3,Expr_leaf<T> > expr() const { return Matrix_expr<T,3,Expr_leaf<T> >(Expr_leaf<T>(this->elem),d1,d2,d3); }
 
-    template<class F> Matrix apply_new(F f) { return xfer(Matrix(*this,f)); }
+    // element-wise operations returning an (unevaluated) expression:
+    Matrix_expr<T,3,Expr_unary<T,Expr_leaf<T>,Not<T> > >         operator!() const { return unary_expr(expr(),Not<T>()); }
+    Matrix_expr<T,3,Expr_unary<T,Expr_leaf<T>,Unary_minus<T> > > operator-() const { return unary_expr(expr(),Unary_minus<T>()); }
+    Matrix_expr<T,3,Expr_unary<T,Expr_leaf<T>,Complement<T> > >  operator~() const { return unary_expr(expr(),Complement<T>()); }
+
+    template<class F> Matrix_expr<T,3,Expr_unary<T,Expr_leaf<T>,F > > apply_new(F f) const { return unary_expr(expr(),f); }
+
+    template<class F> Matrix apply_new(const Parallel& p, F f) const
+        // evaluated right away, on p's threads
+    {
+        Matrix res(d1,d2,d3,uninitialized,this->get_allocator());
+        res.base_assign_expr(p,unary_expr(expr(),f).expr());
+        return res;
+    }
     
     void swap_rows(Index i, Index j)
         // swap_rows() uses a row's worth of memory for better run-time performance
@@ -686,7 +1078,7 @@ public:
     {
         if (i == j) return;
         
-        Matrix<T,2> temp = (*this)[i];
+        Matrix<T,2,C,A> temp = (*this)[i];
         (*this)[i] = (*this)[j];
         (*this)[j] = temp;
     }
@@ -694,42 +1086,67 @@ public:
 
 //-----------------------------------------------------------------------------
 
-template<class T> Matrix<T> scale_and_add(const Matrix<T>& a, T c, const Matrix<T>& b)
+template<class T, int D, class E1, class E2>
+Matrix_expr<T,D,Expr_scale_and_add<T,E1,E2> > scale_and_add(const Matrix_expr<T,D,E1>& a, T c, const Matrix_expr<T,D,E2>& b)
     //  Fortran "saxpy()" ("fma" for "fused multiply-add").
-    // will the copy constructor be called twice and defeat the xfer optimization?
+    // a*c+b is computed when the result is assigned, no temporary Matrix is made
 {
     if (a.size() != b.size()) error("sizes wrong for scale_and_add()");
-    Matrix<T> res(a.size());
-    for (Index i = 0; i<a.size(); ++i) res[i] += a[i]*c+b[i];
-    return res.xfer();
+    return Matrix_expr<T,D,Expr_scale_and_add<T,E1,E2> >(Expr_scale_and_add<T,E1,E2>(a.expr(),c,b.expr()),
+                                                        a.dim1(),a.dim2(),a.dim3());
+}
+
+template<class T, int D, class C1, class A1, class C2, class A2>
+Matrix_expr<T,D,Expr_scale_and_add<T,Expr_leaf<T>,Expr_leaf<T> > > scale_and_add(const Matrix<T,D,C1,A1>& a, T c, const Matrix<T,D,C2,A2>& b)
+{
+    return scale_and_add(a.expr(),c,b.expr());
 }
 
 //-----------------------------------------------------------------------------
 
-template<class T> T dot_product(const Matrix<T>&a , const Matrix<T>& b)
+template<class T, class C1, class A1, class C2, class A2> T dot_product(const Matrix<T,1,C1,A1>&a , const Matrix<T,1,C2,A2>& b)
+    // the sizes are checked once, so the loop itself needs no range checks
+    // for float and double the SIMD kernel of Simd.h does the work
 {
     if (a.size() != b.size()) error("sizes wrong for dot product");
-    T sum = 0;
-    for (Index i = 0; i<a.size(); ++i) sum += a[i]*b[i];
-    return sum;
+    return dot_kernel(a.data(),b.data(),a.size());
+}
+
+template<class T, class C1, class A1, class C2, class A2> T dot_product_compensated(const Matrix<T,1,C1,A1>&a , const Matrix<T,1,C2,A2>& b)
+    // for floating-point T: slower than dot_product(), but accurate even when
+    // the products nearly cancel (see Simd.h)
+{
+    if (a.size() != b.size()) error("sizes wrong for dot product");
+    return dot_compensated_kernel(a.data(),1,b.data(),1,a.size());
 }
 
 //-----------------------------------------------------------------------------
 
-template<class T, int N> Matrix<T,N> xfer(Matrix<T,N>& a)
+template<class T, int N, class C, class A> Matrix<T,N,C,A> xfer(Matrix<T,N,C,A>& a)
 {
     return a.xfer();
 }
 
 //-----------------------------------------------------------------------------
 
-template<class F, class A>            A apply(F f, A x)        { A res(x,f);   return xfer(res); }
-template<class F, class Arg, class A> A apply(F f, A x, Arg a) { A res(x,f,a); return xfer(res); }
+// f(x[i]) and f(x[i],a) for every element, evaluated when assigned; x is not modified:
+template<class F, class T, int D, class C, class A>
+Matrix_expr<T,D,Expr_unary<T,Expr_leaf<T>,F> > apply(F f, const Matrix<T,D,C,A>& x) { return unary_expr(x.expr(),f); }
+template<class F, class T, int D, class E>
+Matrix_expr<T,D,Expr_unary<T,E,F> > apply(F f, const Matrix_expr<T,D,E>& x) { return unary_expr(x,f); }
+template<class F, class Arg, class T, int D, class C, class A>
+Matrix_expr<T,D,Expr_scalar<T,Expr_leaf<T>,F,Arg> > apply(F f, const Matrix<T,D,C,A>& x, Arg a) { return scalar_expr(x.expr(),f,a); }
+template<class F, class Arg, class T, int D, class E>
+Matrix_expr<T,D,Expr_scalar<T,E,F,Arg> > apply(F f, const Matrix_expr<T,D,E>& x, Arg a) { return scalar_expr(x,f,a); }
+
+// apply(par,f,x) can't wait: the work is done on par's threads right away
+template<class F, class T, int D, class C, class A>
+Matrix<T,D,C,A> apply(const Parallel& p, F f, const Matrix<T,D,C,A>& x) { return x.apply_new(p,f); }
 
 //-----------------------------------------------------------------------------
 
-// The default values for T and D have been declared before.
-template<class T, int D> class Row {
+// The default values for T, D, C and A have been declared before.
+template<class T, int D, class C, class A> class Row {
     // general version exists only to allow specializations
 private:
         Row();
@@ -737,57 +1154,378 @@ private:
 
 //-----------------------------------------------------------------------------
 
-template<class T> class Row<T,1> : public Matrix<T,1> {
+template<class T, class C, class A> class Row<T,1,C,A> : public Matrix<T,1,C,A> {
 public:
-    Row(Index n, T* p) : Matrix<T,1>(n,p)
+    Row(Index n, T* p) : Matrix<T,1,C,A>(n,p)
     {
     }
 
-    Matrix<T,1>& operator=(const T& c) { this->base_apply(Assign<T>(),c); return *this; }
+    Matrix<T,1,C,A>& operator=(const T& c) { this->base_apply(Assign<T>(),c); return *this; }
+
+    Matrix<T,1,C,A>& operator=(const Matrix<T,1,C,A>& a)
+    {
+        return *static_cast<Matrix<T,1,C,A>*>(this)=a;
+    }
 
-    Matrix<T,1>& operator=(const Matrix<T,1>& a)
+    template<class E> Matrix<T,1,C,A>& operator=(const Matrix_expr<T,1,E>& x)
     {
-        return *static_cast<Matrix<T,1>*>(this)=a;
+        return *static_cast<Matrix<T,1,C,A>*>(this)=x;
     }
 };
 
 //-----------------------------------------------------------------------------
 
-template<class T> class Row<T,2> : public Matrix<T,2> {
+template<class T, class C, class A> class Row<T,2,C,A> : public Matrix<T,2,C,A> {
 public:
-    Row(Index n1, Index n2, T* p) : Matrix<T,2>(n1,n2,p)
+    Row(Index n1, Index n2, T* p) : Matrix<T,2,C,A>(n1,n2,p)
     {
     }
         
-    Matrix<T,2>& operator=(const T& c) { this->base_apply(Assign<T>(),c); return *this; }
+    Matrix<T,2,C,A>& operator=(const T& c) { this->base_apply(Assign<T>(),c); return *this; }
 
-    Matrix<T,2>& operator=(const Matrix<T,2>& a)
+    Matrix<T,2,C,A>& operator=(const Matrix<T,2,C,A>& a)
     {
-        return *static_cast<Matrix<T,2>*>(this)=a;
+        return *static_cast<Matrix<T,2,C,A>*>(this)=a;
+    }
+
+    template<class E> Matrix<T,2,C,A>& operator=(const Matrix_expr<T,2,E>& x)
+    {
+        return *static_cast<Matrix<T,2,C,A>*>(this)=x;
     }
 };
 
 //-----------------------------------------------------------------------------
 
-template<class T> class Row<T,3> : public Matrix<T,3> {
+template<class T, class C, class A> class Row<T,3,C,A> : public Matrix<T,3,C,A> {
 public:
-    Row(Index n1, Index n2, Index n3, T* p) : Matrix<T,3>(n1,n2,n3,p)
+    Row(Index n1, Index n2, Index n3, T* p) : Matrix<T,3,C,A>(n1,n2,n3,p)
     {
     }
 
-    Matrix<T,3>& operator=(const T& c) { this->base_apply(Assign<T>(),c); return *this; }
+    Matrix<T,3,C,A>& operator=(const T& c) { this->base_apply(Assign<T>(),c); return *this; }
+
+    Matrix<T,3,C,A>& operator=(const Matrix<T,3,C,A>& a)
+    {
+        return *static_cast<Matrix<T,3,C,A>*>(this)=a;
+    }
 
-    Matrix<T,3>& operator=(const Matrix<T,3>& a)
+    template<class E> Matrix<T,3,C,A>& operator=(const Matrix_expr<T,3,E>& x)
     {
-        return *static_cast<Matrix<T,3>*>(this)=a;
+        return *static_cast<Matrix<T,3,C,A>*>(this)=x;
     }
 };
 
 //-----------------------------------------------------------------------------
 
-template<class T, int N> Matrix<T,N-1> scale_and_add(const Matrix<T,N>& a, const Matrix<T,N-1> c, const Matrix<T,N-1>& b)
+// Views: elements of a Matrix that are evenly spaced in memory, but not
+// necessarily next to each other, such as a column, the rows of a transposed
+// Matrix, or a sub-block. A view is a descriptor, like a Row: copying a view
+// gives another view of the same elements, while assigning to a view assigns
+// to the elements. T is const for a view through which the elements can't be
+// changed. A view must not outlive the Matrix whose elements it refers to.
+
+template<class T> struct Expr_strided {
+    // the elements of a Vector_view
+    const T* p;
+    Index s;
+    Expr_strided(const T* q, Index ss) :p(q), s(ss) { }
+    T operator[](Index i) const { return p[i*s]; }
+};
+
+template<class T> struct Expr_strided2 {
+    // the elements of a Matrix_view, numbered row by row as in a Matrix<T,2>
+    const T* p;
+    Index n2, s1, s2;
+    Expr_strided2(const T* q, Index nn2, Index ss1, Index ss2) :p(q), n2(nn2), s1(ss1), s2(ss2) { }
+    T operator[](Index i) const { const Index r = i/n2; return p[r*s1+(i-r*n2)*s2]; }
+};
+
+//-----------------------------------------------------------------------------
+
+template<class T, class C> class Vector_view {
+    // n elements p[0], p[s], p[2*s], ...
+public:
+    typedef typename std::remove_const<T>::type value_type;
+
+    Vector_view(T* q, Index n, Index s = 1) :p(q), d1(n), st(s) { }
+
+    Index dim1() const { return d1; }
+    Index size() const { return d1; }
+    Index stride() const { return st; }
+    T* data() const { return p; }
+
+    void range_check(Index n) const
+    {
+        if (n<0 || d1<=n) error("Vector_view range error");
+    }
+
+    T& operator()(Index n) const { if (C::check_elements) range_check(n); return p[n*st]; }
+    T& operator[](Index n) const { if (C::check_elements) range_check(n); return p[n*st]; }
+
+    Vector_view slice(Index n) const
+        // elements [n:d1)
+    {
+        if (n<0) n=0;
+        else if (d1<n) n=d1;
+        return Vector_view(p+n*st,d1-n,st);
+    }
+
+    Vector_view slice(Index n, Index m) const
+        // elements [n:m)
+    {
+        if (n<0) n=0;
+        if (d1<m) m=d1;
+        if (m<n) m=n;
+        return Vector_view(p+n*st,m-n,st);
+    }
+
+    // assignment assigns to the elements:
+    Vector_view& operator=(const Vector_view& v) { return assign(v); }
+    template<class U, class C2> Vector_view& operator=(const Vector_view<U,C2>& v) { return assign(v); }
+
+    template<class C2, class A2> Vector_view& operator=(const Matrix<value_type,1,C2,A2>& m)
+    {
+        if (d1!=m.size()) error("length error in Vector_view=");
+        for (Index i = 0; i<d1; ++i) p[i*st] = m.data()[i];
+        return *this;
+    }
+
+    template<class E> Vector_view& operator=(const Matrix_expr<value_type,1,E>& x)
+    {
+        if (d1!=x.dim1()) error("length error in Vector_view=");
+        const E& e = x.expr();
+        for (Index i = 0; i<d1; ++i) p[i*st] = e[i];
+        return *this;
+    }
+
+    Vector_view& operator=(const value_type& c) { return apply(Assign<value_type>(),c); }
+
+    Vector_view& operator*=(const value_type& c) { return apply(Mul_assign<value_type>(),c); }
+    Vector_view& operator/=(const value_type& c) { return apply(Div_assign<value_type>(),c); }
+    Vector_view& operator+=(const value_type& c) { return apply(Add_assign<value_type>(),c); }
+    Vector_view& operator-=(const value_type& c) { return apply(Minus_assign<value_type>(),c); }
+
+    template<class F> Vector_view& apply(F f) { for (Index i = 0; i<d1; ++i) f(p[i*st]); return *this; }
+    template<class F> Vector_view& apply(F f, const value_type& c) { for (Index i = 0; i<d1; ++i) f(p[i*st],c); return *this; }
+
+    Matrix_expr<value_type,1,Expr_strided<value_type> > expr() const
+    {
+        return Matrix_expr<value_type,1,Expr_strided<value_type> >(Expr_strided<value_type>(p,st),d1);
+    }
+
+    template<class F> Matrix_expr<value_type,1,Expr_unary<value_type,Expr_strided<value_type>,F> > apply_new(F f) const
+    {
+        return unary_expr(expr(),f);
+    }
+private:
+    T* p;
+    Index d1;
+    Index st;
+
+    template<class V> Vector_view& assign(const V& v)
+        // elements are read before they are written, index by index, so
+        // overlapping views work only if they overlap element for element
+    {
+        if (d1!=v.size()) error("length error in Vector_view=");
+        for (Index i = 0; i<d1; ++i) p[i*st] = v.data()[i*v.stride()];
+        return *this;
+    }
+};
+
+//-----------------------------------------------------------------------------
+
+template<class T, class C> class Matrix_view {
+    // n1 rows of n2 elements: element (i,j) is p[i*s1+j*s2]
+public:
+    typedef typename std::remove_const<T>::type value_type;
+
+    Matrix_view(T* q, Index n1, Index n2, Index ss1, Index ss2 = 1) :p(q), d1(n1), d2(n2), s1(ss1), s2(ss2) { }
+
+    Index dim1() const { return d1; }
+    Index dim2() const { return d2; }
+    Index size() const { return d1*d2; }
+    Index stride1() const { return s1; }    // between rows
+    Index stride2() const { return s2; }    // between elements of a row
+    T* data() const { return p; }
+
+    void range_check(Index n1, Index n2) const
+    {
+        if (n1<0 || d1<=n1) error("Matrix_view range error: dimension 1");
+        if (n2<0 || d2<=n2) error("Matrix_view range error: dimension 2");
+    }
+
+    T& operator()(Index n1, Index n2) const { if (C::check_elements) range_check(n1,n2); return p[n1*s1+n2*s2]; }
+
+    Vector_view<T,C> operator[](Index n) const { return row(n); }
+    Vector_view<T,C> row(Index n) const { if (C::check_rows) range_check(n,0); return Vector_view<T,C>(p+n*s1,d2,s2); }
+    Vector_view<T,C> column(Index n) const { if (C::check_rows) range_check(0,n); return Vector_view<T,C>(p+n*s2,d1,s1); }
+
+    Matrix_view transposed() const { return Matrix_view(p,d2,d1,s2,s1); }
+
+    Matrix_view block(Index i, Index j, Index n1, Index n2, Index step1 = 1, Index step2 = 1) const
+        // n1 by n2 elements starting at (i,j), taking every step1'th row and every step2'th column
+    {
+        if (n1<0 || n2<0 || step1<1 || step2<1) error("Matrix_view::block(): bad arguments");
+        if (n1 && n2) {
+            range_check(i,j);
+            range_check(i+(n1-1)*step1,j+(n2-1)*step2);
+        }
+        return Matrix_view(p+i*s1+j*s2,n1,n2,s1*step1,s2*step2);
+    }
+
+    // assignment assigns to the elements:
+    Matrix_view& operator=(const Matrix_view& v) { return assign(v); }
+    template<class U, class C2> Matrix_view& operator=(const Matrix_view<U,C2>& v) { return assign(v); }
+
+    template<class C2, class A2> Matrix_view& operator=(const Matrix<value_type,2,C2,A2>& m)
+    {
+        return assign(Matrix_view<const value_type,C2>(m.data(),m.dim1(),m.dim2(),m.dim2()));
+    }
+
+    template<class E> Matrix_view& operator=(const Matrix_expr<value_type,2,E>& x)
+    {
+        if (d1!=x.dim1() || d2!=x.dim2()) error("length error in Matrix_view=");
+        const E& e = x.expr();
+        for (Index i = 0; i<d1; ++i)
+            for (Index j = 0; j<d2; ++j)
+                p[i*s1+j*s2] = e[i*d2+j];
+        return *this;
+    }
+
+    Matrix_view& operator=(const value_type& c) { return apply(Assign<value_type>(),c); }
+
+    Matrix_view& operator*=(const value_type& c) { return apply(Mul_assign<value_type>(),c); }
+    Matrix_view& operator/=(const value_type& c) { return apply(Div_assign<value_type>(),c); }
+    Matrix_view& operator+=(const value_type& c) { return apply(Add_assign<value_type>(),c); }
+    Matrix_view& operator-=(const value_type& c) { return apply(Minus_assign<value_type>(),c); }
+
+    template<class F> Matrix_view& apply(F f)
+    {
+        for (Index i = 0; i<d1; ++i)
+            for (Index j = 0; j<d2; ++j) f(p[i*s1+j*s2]);
+        return *this;
+    }
+
+    template<class F> Matrix_view& apply(F f, const value_type& c)
+    {
+        for (Index i = 0; i<d1; ++i)
+            for (Index j = 0; j<d2; ++j) f(p[i*s1+j*s2],c);
+        return *this;
+    }
+
+    Matrix_expr<value_type,2,Expr_strided2<value_type> > expr() const
+    {
+        return Matrix_expr<value_type,2,Expr_strided2<value_type> >(Expr_strided2<value_type>(p,d2,s1,s2),d1,d2);
+    }
+
+    template<class F> Matrix_expr<value_type,2,Expr_unary<value_type,Expr_strided2<value_type>,F> > apply_new(F f) const
+    {
+        return unary_expr(expr(),f);
+    }
+
+    void copy_to(value_type* q) const
+        // the elements, row by row, to q[0:size())
+    {
+        for (Index i = 0; i<d1; ++i)
+            for (Index j = 0; j<d2; ++j) *q++ = p[i*s1+j*s2];
+    }
+private:
+    T* p;
+    Index d1, d2;
+    Index s1, s2;
+
+    template<class V> Matrix_view& assign(const V& v)
+        // as for Vector_view, overlapping views work only element for element:
+        // m.view() = m.transposed() does not transpose m
+    {
+        if (d1!=v.dim1() || d2!=v.dim2()) error("length error in Matrix_view=");
+        for (Index i = 0; i<d1; ++i)
+            for (Index j = 0; j<d2; ++j)
+                p[i*s1+j*s2] = v.data()[i*v.stride1()+j*v.stride2()];
+        return *this;
+    }
+};
+
+//-----------------------------------------------------------------------------
+
+// views with dot_product(), scale_and_add() and apply():
+
+template<class T, class U, class C1, class C2>
+typename Vector_view<T,C1>::value_type dot_product(const Vector_view<T,C1>& a, const Vector_view<U,C2>& b)
+{
+    if (a.size() != b.size()) error("sizes wrong for dot product");
+    const T* pa = a.data();
+    const U* pb = b.data();
+    const Index sa = a.stride();
+    const Index sb = b.stride();
+    typename Vector_view<T,C1>::value_type sum = 0;
+    for (Index i = 0; i<a.size(); ++i) sum += pa[i*sa]*pb[i*sb];
+    return sum;
+}
+
+template<class T, class U, class C1, class C2>
+typename Vector_view<T,C1>::value_type dot_product_compensated(const Vector_view<T,C1>& a, const Vector_view<U,C2>& b)
+{
+    if (a.size() != b.size()) error("sizes wrong for dot product");
+    typedef typename Vector_view<T,C1>::value_type V;
+    return dot_compensated_kernel<V>(a.data(),a.stride(),b.data(),b.stride(),a.size());
+}
+
+template<class T, class U, class C1, class A1, class C2>
+T dot_product(const Matrix<T,1,C1,A1>& a, const Vector_view<U,C2>& b)
+{
+    return dot_product(Vector_view<const T,C1>(a.data(),a.size()),b);
+}
+
+template<class T, class U, class C1, class A1, class C2>
+T dot_product(const Vector_view<U,C1>& a, const Matrix<T,1,C2,A1>& b)
+{
+    return dot_product(a,Vector_view<const T,C2>(b.data(),b.size()));
+}
+
+template<class T, class U, class C1, class C2>
+Matrix_expr<typename Vector_view<T,C1>::value_type,1,Expr_scale_and_add<typename Vector_view<T,C1>::value_type,
+    Expr_strided<typename Vector_view<T,C1>::value_type>,Expr_strided<typename Vector_view<T,C1>::value_type> > >
+scale_and_add(const Vector_view<T,C1>& a, typename Vector_view<T,C1>::value_type c, const Vector_view<U,C2>& b)
 {
-    Matrix<T> res(a.size());
+    return scale_and_add(a.expr(),c,b.expr());
+}
+
+template<class T, class U, class C1, class A1, class C2>
+Matrix_expr<T,1,Expr_scale_and_add<T,Expr_leaf<T>,Expr_strided<T> > >
+scale_and_add(const Matrix<T,1,C1,A1>& a, T c, const Vector_view<U,C2>& b)
+{
+    return scale_and_add(a.expr(),c,b.expr());
+}
+
+template<class T, class U, class C1, class A1, class C2>
+Matrix_expr<T,1,Expr_scale_and_add<T,Expr_strided<T>,Expr_leaf<T> > >
+scale_and_add(const Vector_view<U,C1>& a, T c, const Matrix<T,1,C2,A1>& b)
+{
+    return scale_and_add(a.expr(),c,b.expr());
+}
+
+template<class T, class U, class C1, class C2>
+Matrix_expr<typename Matrix_view<T,C1>::value_type,2,Expr_scale_and_add<typename Matrix_view<T,C1>::value_type,
+    Expr_strided2<typename Matrix_view<T,C1>::value_type>,Expr_strided2<typename Matrix_view<T,C1>::value_type> > >
+scale_and_add(const Matrix_view<T,C1>& a, typename Matrix_view<T,C1>::value_type c, const Matrix_view<U,C2>& b)
+{
+    return scale_and_add(a.expr(),c,b.expr());
+}
+
+template<class F, class T, class C>
+Matrix_expr<typename Vector_view<T,C>::value_type,1,Expr_unary<typename Vector_view<T,C>::value_type,Expr_strided<typename Vector_view<T,C>::value_type>,F> >
+apply(F f, const Vector_view<T,C>& v) { return v.apply_new(f); }
+
+template<class F, class T, class C>
+Matrix_expr<typename Matrix_view<T,C>::value_type,2,Expr_unary<typename Matrix_view<T,C>::value_type,Expr_strided2<typename Matrix_view<T,C>::value_type>,F> >
+apply(F f, const Matrix_view<T,C>& v) { return v.apply_new(f); }
+
+//-----------------------------------------------------------------------------
+
+template<class T, int N, class C, class A> Matrix<T,N-1,C,A> scale_and_add(const Matrix<T,N,C,A>& a, const Matrix<T,N-1,C,A> c, const Matrix<T,N-1,C,A>& b)
+{
+    Matrix<T,1,C,A> res(a.size());
     if (a.size() != b.size()) error("sizes wrong for scale_and_add");
     for (Index i = 0; i<a.size(); ++i) res[i] += a[i]*c+b[i];
     return res.xfer();
@@ -795,15 +1533,349 @@ template<class T, int N> Matrix<T,N-1> scale_and_add(const Matrix<T,N>& a, const
 
 //-----------------------------------------------------------------------------
 
-template<class T, int D> Matrix<T,D> operator*(const Matrix<T,D>& m, const T& c) { Matrix<T,D> r(m); return r*=c; }
-template<class T, int D> Matrix<T,D> operator/(const Matrix<T,D>& m, const T& c) { Matrix<T,D> r(m); return r/=c; }
-template<class T, int D> Matrix<T,D> operator%(const Matrix<T,D>& m, const T& c) { Matrix<T,D> r(m); return r%=c; }
-template<class T, int D> Matrix<T,D> operator+(const Matrix<T,D>& m, const T& c) { Matrix<T,D> r(m); return r+=c; }
-template<class T, int D> Matrix<T,D> operator-(const Matrix<T,D>& m, const T& c) { Matrix<T,D> r(m); return r-=c; }
+// element-wise operations with a scalar; they return unevaluated expressions:
+
+template<class T, int D, class C, class A> Matrix_expr<T,D,Expr_scalar<T,Expr_leaf<T>,Mul<T>,T> > operator*(const Matrix<T,D,C,A>& m, const T& c)      { return scalar_expr(m.expr(),Mul<T>(),c); }
+template<class T, int D, class C, class A> Matrix_expr<T,D,Expr_scalar<T,Expr_leaf<T>,Div<T>,T> > operator/(const Matrix<T,D,C,A>& m, const T& c)      { return scalar_expr(m.expr(),Div<T>(),c); }
+template<class T, int D, class C, class A> Matrix_expr<T,D,Expr_scalar<T,Expr_leaf<T>,Mod<T>,T> > operator%(const Matrix<T,D,C,A>& m, const T& c)      { return scalar_expr(m.expr(),Mod<T>(),c); }
+template<class T, int D, class C, class A> Matrix_expr<T,D,Expr_scalar<T,Expr_leaf<T>,Add<T>,T> > operator+(const Matrix<T,D,C,A>& m, const T& c)      { return scalar_expr(m.expr(),Add<T>(),c); }
+template<class T, int D, class C, class A> Matrix_expr<T,D,Expr_scalar<T,Expr_leaf<T>,Minus<T>,T> > operator-(const Matrix<T,D,C,A>& m, const T& c)      { return scalar_expr(m.expr(),Minus<T>(),c); }
+
+template<class T, int D, class C, class A> Matrix_expr<T,D,Expr_scalar<T,Expr_leaf<T>,And<T>,T> > operator&(const Matrix<T,D,C,A>& m, const T& c)      { return scalar_expr(m.expr(),And<T>(),c); }
+template<class T, int D, class C, class A> Matrix_expr<T,D,Expr_scalar<T,Expr_leaf<T>,Or<T>,T> > operator|(const Matrix<T,D,C,A>& m, const T& c)      { return scalar_expr(m.expr(),Or<T>(),c); }
+template<class T, int D, class C, class A> Matrix_expr<T,D,Expr_scalar<T,Expr_leaf<T>,Xor<T>,T> > operator^(const Matrix<T,D,C,A>& m, const T& c)      { return scalar_expr(m.expr(),Xor<T>(),c); }
+
+template<class T, int D, class E> Matrix_expr<T,D,Expr_scalar<T,E,Mul<T>,T> > operator*(const Matrix_expr<T,D,E>& x, const T& c) { return scalar_expr(x,Mul<T>(),c); }
+template<class T, int D, class E> Matrix_expr<T,D,Expr_scalar<T,E,Div<T>,T> > operator/(const Matrix_expr<T,D,E>& x, const T& c) { return scalar_expr(x,Div<T>(),c); }
+template<class T, int D, class E> Matrix_expr<T,D,Expr_scalar<T,E,Mod<T>,T> > operator%(const Matrix_expr<T,D,E>& x, const T& c) { return scalar_expr(x,Mod<T>(),c); }
+template<class T, int D, class E> Matrix_expr<T,D,Expr_scalar<T,E,Add<T>,T> > operator+(const Matrix_expr<T,D,E>& x, const T& c) { return scalar_expr(x,Add<T>(),c); }
+template<class T, int D, class E> Matrix_expr<T,D,Expr_scalar<T,E,Minus<T>,T> > operator-(const Matrix_expr<T,D,E>& x, const T& c) { return scalar_expr(x,Minus<T>(),c); }
+
+template<class T, int D, class E> Matrix_expr<T,D,Expr_scalar<T,E,And<T>,T> > operator&(const Matrix_expr<T,D,E>& x, const T& c) { return scalar_expr(x,And<T>(),c); }
+template<class T, int D, class E> Matrix_expr<T,D,Expr_scalar<T,E,Or<T>,T> > operator|(const Matrix_expr<T,D,E>& x, const T& c) { return scalar_expr(x,Or<T>(),c); }
+template<class T, int D, class E> Matrix_expr<T,D,Expr_scalar<T,E,Xor<T>,T> > operator^(const Matrix_expr<T,D,E>& x, const T& c) { return scalar_expr(x,Xor<T>(),c); }
+
+template<class T, int D, class E> Matrix_expr<T,D,Expr_unary<T,E,Unary_minus<T> > > operator-(const Matrix_expr<T,D,E>& x) { return unary_expr(x,Unary_minus<T>()); }
+
+//-----------------------------------------------------------------------------
+
+// Matrix multiplication
+//
+// gemm() computes C += alpha*A*B on row-major blocks given by a pointer to the
+// first element and a leading dimension (the distance between two rows), so it
+// works on whole matrices and on sub-blocks of them alike. It uses the usual
+// GotoBLAS scheme: B is packed into a kc*nc block that stays in L3/L2, A into
+// an mc*kc block that stays in L2, and a register-tiled micro-kernel computes
+// an mr*nr tile of C from one micro-panel of each. Packing pads the edges with
+// zeros, so the micro-kernel never has to deal with partial panels.
+//
+// The double and float micro-kernels use AVX2/FMA when the processor has it,
+// chosen at run time like the kernels of Simd.h (so -mavx2 isn't needed; with
+// other compilers than GCC and Clang only when it is targeted, e.g. /arch:AVX2).
+// All other cases use the portable version, which is several times slower:
+// there, LU_factorization (LU.h) is slower than textbook elimination.
+
+const Index gemm_mr = 6;       // rows of a C tile kept in registers
+const Index gemm_nr = 8;       // columns of a C tile kept in registers
+const Index gemm_kc = 256;     // depth of the packed panels: an mr*kc and a kc*nr panel fit in L1
+const Index gemm_mc = 96;      // rows of the packed A block (a multiple of mr): mc*kc fits in L2
+const Index gemm_nc = 2048;    // columns of the packed B block (a multiple of nr): kc*nc fits in L3
+
+//-----------------------------------------------------------------------------
+
+template<class T> void gemm_micro_kernel(Index kc, const T* a, const T* b, T* c, Index ldc)
+    // c[0:mr)[0:nr) += a*b for one packed micro-panel of a (mr wide) and of b (nr wide)
+{
+    T ab[gemm_mr][gemm_nr];
+    for (Index i = 0; i<gemm_mr; ++i)
+        for (Index j = 0; j<gemm_nr; ++j) ab[i][j] = T();
+
+    for (Index p = 0; p<kc; ++p) {
+        for (Index i = 0; i<gemm_mr; ++i)
+            for (Index j = 0; j<gemm_nr; ++j) ab[i][j] += a[i]*b[j];
+        a += gemm_mr;
+        b += gemm_nr;
+    }
+
+    for (Index i = 0; i<gemm_mr; ++i)
+        for (Index j = 0; j<gemm_nr; ++j) c[i*ldc+j] += ab[i][j];
+}
+
+#ifdef MATRIX_LIB_AVX2_KERNELS
+MATRIX_LIB_TARGET("avx2,fma") inline void gemm_micro_kernel_avx2(Index kc, const double* a, const double* b, double* c, Index ldc)
+    // 6x8 AVX2/FMA kernel: the C tile lives in 12 ymm registers,
+    // each step loads one row of b and broadcasts one column of a
+{
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    __m256d c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd();
+    __m256d c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+
+    for (Index p = 0; p<kc; ++p) {
+        const __m256d b0 = _mm256_loadu_pd(b);
+        const __m256d b1 = _mm256_loadu_pd(b+4);
+        __m256d ai;
+        ai = _mm256_broadcast_sd(a+0); c00 = _mm256_fmadd_pd(ai,b0,c00); c01 = _mm256_fmadd_pd(ai,b1,c01);
+        ai = _mm256_broadcast_sd(a+1); c10 = _mm256_fmadd_pd(ai,b0,c10); c11 = _mm256_fmadd_pd(ai,b1,c11);
+        ai = _mm256_broadcast_sd(a+2); c20 = _mm256_fmadd_pd(ai,b0,c20); c21 = _mm256_fmadd_pd(ai,b1,c21);
+        ai = _mm256_broadcast_sd(a+3); c30 = _mm256_fmadd_pd(ai,b0,c30); c31 = _mm256_fmadd_pd(ai,b1,c31);
+        ai = _mm256_broadcast_sd(a+4); c40 = _mm256_fmadd_pd(ai,b0,c40); c41 = _mm256_fmadd_pd(ai,b1,c41);
+        ai = _mm256_broadcast_sd(a+5); c50 = _mm256_fmadd_pd(ai,b0,c50); c51 = _mm256_fmadd_pd(ai,b1,c51);
+        a += gemm_mr;
+        b += gemm_nr;
+    }
+
+    double* ci = c;
+    _mm256_storeu_pd(ci,_mm256_add_pd(_mm256_loadu_pd(ci),c00)); _mm256_storeu_pd(ci+4,_mm256_add_pd(_mm256_loadu_pd(ci+4),c01)); ci += ldc;
+    _mm256_storeu_pd(ci,_mm256_add_pd(_mm256_loadu_pd(ci),c10)); _mm256_storeu_pd(ci+4,_mm256_add_pd(_mm256_loadu_pd(ci+4),c11)); ci += ldc;
+    _mm256_storeu_pd(ci,_mm256_add_pd(_mm256_loadu_pd(ci),c20)); _mm256_storeu_pd(ci+4,_mm256_add_pd(_mm256_loadu_pd(ci+4),c21)); ci += ldc;
+    _mm256_storeu_pd(ci,_mm256_add_pd(_mm256_loadu_pd(ci),c30)); _mm256_storeu_pd(ci+4,_mm256_add_pd(_mm256_loadu_pd(ci+4),c31)); ci += ldc;
+    _mm256_storeu_pd(ci,_mm256_add_pd(_mm256_loadu_pd(ci),c40)); _mm256_storeu_pd(ci+4,_mm256_add_pd(_mm256_loadu_pd(ci+4),c41)); ci += ldc;
+    _mm256_storeu_pd(ci,_mm256_add_pd(_mm256_loadu_pd(ci),c50)); _mm256_storeu_pd(ci+4,_mm256_add_pd(_mm256_loadu_pd(ci+4),c51));
+}
+
+MATRIX_LIB_TARGET("avx2,fma") inline void gemm_micro_kernel_avx2(Index kc, const float* a, const float* b, float* c, Index ldc)
+    // 6x8 AVX2/FMA kernel for float: a row of the C tile fits in one ymm
+    // register, so each step does the work of the double kernel in half the instructions
+{
+    __m256 c0 = _mm256_setzero_ps(), c1 = _mm256_setzero_ps(), c2 = _mm256_setzero_ps();
+    __m256 c3 = _mm256_setzero_ps(), c4 = _mm256_setzero_ps(), c5 = _mm256_setzero_ps();
+
+    for (Index p = 0; p<kc; ++p) {
+        const __m256 b0 = _mm256_loadu_ps(b);
+        c0 = _mm256_fmadd_ps(_mm256_broadcast_ss(a+0),b0,c0);
+        c1 = _mm256_fmadd_ps(_mm256_broadcast_ss(a+1),b0,c1);
+        c2 = _mm256_fmadd_ps(_mm256_broadcast_ss(a+2),b0,c2);
+        c3 = _mm256_fmadd_ps(_mm256_broadcast_ss(a+3),b0,c3);
+        c4 = _mm256_fmadd_ps(_mm256_broadcast_ss(a+4),b0,c4);
+        c5 = _mm256_fmadd_ps(_mm256_broadcast_ss(a+5),b0,c5);
+        a += gemm_mr;
+        b += gemm_nr;
+    }
+
+    float* ci = c;
+    _mm256_storeu_ps(ci,_mm256_add_ps(_mm256_loadu_ps(ci),c0)); ci += ldc;
+    _mm256_storeu_ps(ci,_mm256_add_ps(_mm256_loadu_ps(ci),c1)); ci += ldc;
+    _mm256_storeu_ps(ci,_mm256_add_ps(_mm256_loadu_ps(ci),c2)); ci += ldc;
+    _mm256_storeu_ps(ci,_mm256_add_ps(_mm256_loadu_ps(ci),c3)); ci += ldc;
+    _mm256_storeu_ps(ci,_mm256_add_ps(_mm256_loadu_ps(ci),c4)); ci += ldc;
+    _mm256_storeu_ps(ci,_mm256_add_ps(_mm256_loadu_ps(ci),c5));
+}
+#endif
+
+// the dispatchers: the best micro-kernel allowed by simd_level(), looked up
+// once per gemm() rather than once per tile
+
+template<class T> struct Gemm_kernel {
+    typedef void (*type)(Index kc, const T* a, const T* b, T* c, Index ldc);
+};
+
+template<class T> typename Gemm_kernel<T>::type gemm_micro_kernel_for(const T*) { return gemm_micro_kernel<T>; }
+
+#ifdef MATRIX_LIB_AVX2_KERNELS
+inline Gemm_kernel<double>::type gemm_micro_kernel_for(const double*)
+{
+    if (simd_level() >= simd_avx2) return gemm_micro_kernel_avx2;
+    return gemm_micro_kernel<double>;
+}
+
+inline Gemm_kernel<float>::type gemm_micro_kernel_for(const float*)
+{
+    if (simd_level() >= simd_avx2) return gemm_micro_kernel_avx2;
+    return gemm_micro_kernel<float>;
+}
+#endif
+
+//-----------------------------------------------------------------------------
+
+template<class T> void gemm_pack_a(Index mc, Index kc, T alpha, const T* a, Index lda, T* pa)
+    // copy alpha*a[0:mc)[0:kc) into micro-panels of mr rows, column by column
+{
+    for (Index ir = 0; ir<mc; ir += gemm_mr) {
+        const Index mr = std::min(gemm_mr,mc-ir);
+        for (Index p = 0; p<kc; ++p) {
+            for (Index i = 0; i<mr; ++i) pa[i] = alpha*a[(ir+i)*lda+p];
+            for (Index i = mr; i<gemm_mr; ++i) pa[i] = T();
+            pa += gemm_mr;
+        }
+    }
+}
 
-template<class T, int D> Matrix<T,D> operator&(const Matrix<T,D>& m, const T& c) { Matrix<T,D> r(m); return r&=c; }
-template<class T, int D> Matrix<T,D> operator|(const Matrix<T,D>& m, const T& c) { Matrix<T,D> r(m); return r|=c; }
-template<class T, int D> Matrix<T,D> operator^(const Matrix<T,D>& m, const T& c) { Matrix<T,D> r(m); return r^=c; }
+template<class T> void gemm_pack_b(Index kc, Index nc, const T* b, Index ldb, T* pb)
+    // copy b[0:kc)[0:nc) into micro-panels of nr columns, row by row
+{
+    for (Index jr = 0; jr<nc; jr += gemm_nr) {
+        const Index nr = std::min(gemm_nr,nc-jr);
+        for (Index p = 0; p<kc; ++p) {
+            const T* bp = b+p*ldb+jr;
+            for (Index j = 0; j<nr; ++j) pb[j] = bp[j];
+            for (Index j = nr; j<gemm_nr; ++j) pb[j] = T();
+            pb += gemm_nr;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+template<class T>
+void gemm_macro_kernel(typename Gemm_kernel<T>::type micro_kernel, Index mc, Index nc, Index kc, const T* pa, const T* pb, T* c, Index ldc)
+    // c[0:mc)[0:nc) += packed A block * packed B block
+    // tiles sticking out of c are computed into a scratch tile and added back
+{
+    for (Index jr = 0; jr<nc; jr += gemm_nr) {
+        const Index nr = std::min(gemm_nr,nc-jr);
+        for (Index ir = 0; ir<mc; ir += gemm_mr) {
+            const Index mr = std::min(gemm_mr,mc-ir);
+            const T* a = pa+ir*kc;
+            const T* b = pb+jr*kc;
+            T* cij = c+ir*ldc+jr;
+            if (mr==gemm_mr && nr==gemm_nr) {
+                micro_kernel(kc,a,b,cij,ldc);
+            }
+            else {
+                T tile[gemm_mr*gemm_nr];
+                for (Index i = 0; i<gemm_mr*gemm_nr; ++i) tile[i] = T();
+                micro_kernel(kc,a,b,tile,gemm_nr);
+                for (Index i = 0; i<mr; ++i)
+                    for (Index j = 0; j<nr; ++j) cij[i*ldc+j] += tile[i*gemm_nr+j];
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+template<class T>
+void gemm(Index m, Index n, Index k, T alpha, const T* a, Index lda, const T* b, Index ldb, T* c, Index ldc)
+    // c[0:m)[0:n) += alpha * a[0:m)[0:k) * b[0:k)[0:n)
+{
+    if (m<=0 || n<=0 || k<=0) return;
+    // packing buffers no bigger than the matrices need:
+    const Index kb = std::min(gemm_kc,k);
+    std::vector<T> pa(std::min(gemm_mc,(m+gemm_mr-1)/gemm_mr*gemm_mr)*kb);
+    std::vector<T> pb(std::min(gemm_nc,(n+gemm_nr-1)/gemm_nr*gemm_nr)*kb);
+    const typename Gemm_kernel<T>::type micro_kernel = gemm_micro_kernel_for(c);
+
+    for (Index jc = 0; jc<n; jc += gemm_nc) {
+        const Index nc = std::min(gemm_nc,n-jc);
+        for (Index pc = 0; pc<k; pc += gemm_kc) {
+            const Index kc = std::min(gemm_kc,k-pc);
+            gemm_pack_b(kc,nc,b+pc*ldb+jc,ldb,&pb[0]);
+            for (Index ic = 0; ic<m; ic += gemm_mc) {
+                const Index mc = std::min(gemm_mc,m-ic);
+                gemm_pack_a(mc,kc,alpha,a+ic*lda+pc,lda,&pa[0]);
+                gemm_macro_kernel(micro_kernel,mc,nc,kc,&pa[0],&pb[0],c+ic*ldc+jc,ldc);
+            }
+        }
+    }
+}
+
+template<class T>
+void gemm(Thread_pool& pool, Index m, Index n, Index k, T alpha, const T* a, Index lda, const T* b, Index ldb, T* c, Index ldc)
+    // the same, with C cut into blocks of rows (and of columns if there are few rows)
+    // that are computed concurrently; each block packs its own panels
+{
+    if (m<=0 || n<=0 || k<=0) return;
+    const Index threads = pool.size()+1;
+    const Index row_blocks = (m+gemm_mc-1)/gemm_mc;
+    Index col_blocks = std::min((4*threads+row_blocks-1)/row_blocks,std::max(Index(1),n/128));
+    const Index nb = ((n+col_blocks-1)/col_blocks+gemm_nr-1)/gemm_nr*gemm_nr;
+    col_blocks = (n+nb-1)/nb;
+
+    pool.parallel_for(0,row_blocks*col_blocks,1,[=](Index lo, Index hi) {
+        for (Index t = lo; t<hi; ++t) {
+            const Index i0 = t/col_blocks*gemm_mc;
+            const Index j0 = t%col_blocks*nb;
+            gemm(std::min(gemm_mc,m-i0),std::min(nb,n-j0),k,alpha,a+i0*lda,lda,b+j0,ldb,c+i0*ldc+j0,ldc);
+        }
+    });
+}
+
+//-----------------------------------------------------------------------------
+
+template<class T> void gemv(Index m, Index n, const T* a, Index lda, const T* x, T* y)
+    // y[0:m) = a[0:m)[0:n) * x[0:n)
+    // four independent sums per row so that the adds don't wait for each other
+{
+    for (Index i = 0; i<m; ++i) {
+        const T* ai = a+i*lda;
+        T s0 = T(), s1 = T(), s2 = T(), s3 = T();
+        Index j = 0;
+        for (; j+4<=n; j += 4) {
+            s0 += ai[j]*x[j];
+            s1 += ai[j+1]*x[j+1];
+            s2 += ai[j+2]*x[j+2];
+            s3 += ai[j+3]*x[j+3];
+        }
+        for (; j<n; ++j) s0 += ai[j]*x[j];
+        y[i] = (s0+s1)+(s2+s3);
+    }
+}
+
+#ifdef MATRIX_LIB_AVX2_KERNELS
+MATRIX_LIB_TARGET("avx2,fma") inline void gemv_avx2(Index m, Index n, const double* a, Index lda, const double* x, double* y)
+    // four rows at a time, so that every load of x is used four times
+{
+    Index i = 0;
+    for (; i+4<=m; i += 4) {
+        const double* a0 = a+i*lda;
+        const double* a1 = a0+lda;
+        const double* a2 = a1+lda;
+        const double* a3 = a2+lda;
+        __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+        __m256d s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd();
+        Index j = 0;
+        for (; j+4<=n; j += 4) {
+            const __m256d xj = _mm256_loadu_pd(x+j);
+            s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a0+j),xj,s0);
+            s1 = _mm256_fmadd_pd(_mm256_loadu_pd(a1+j),xj,s1);
+            s2 = _mm256_fmadd_pd(_mm256_loadu_pd(a2+j),xj,s2);
+            s3 = _mm256_fmadd_pd(_mm256_loadu_pd(a3+j),xj,s3);
+        }
+        // reduce the four accumulators at once: r = { sum(s0) sum(s1) sum(s2) sum(s3) }
+        const __m256d h01 = _mm256_hadd_pd(s0,s1);
+        const __m256d h23 = _mm256_hadd_pd(s2,s3);
+        const __m256d r = _mm256_add_pd(_mm256_permute2f128_pd(h01,h23,0x20),
+                                        _mm256_permute2f128_pd(h01,h23,0x31));
+        double sum[4];
+        _mm256_storeu_pd(sum,r);
+        for (; j<n; ++j) {
+            sum[0] += a0[j]*x[j];
+            sum[1] += a1[j]*x[j];
+            sum[2] += a2[j]*x[j];
+            sum[3] += a3[j]*x[j];
+        }
+        for (Index ii = 0; ii<4; ++ii) y[i+ii] = sum[ii];
+    }
+    if (i<m) gemv<double>(m-i,n,a+i*lda,lda,x,y+i);
+}
+
+inline void gemv(Index m, Index n, const double* a, Index lda, const double* x, double* y)
+{
+    if (simd_level() >= simd_avx2) gemv_avx2(m,n,a,lda,x,y);
+    else gemv<double>(m,n,a,lda,x,y);
+}
+#endif
+
+//-----------------------------------------------------------------------------
+
+template<class T, class C1, class A1, class C2, class A2> Matrix<T,2,C1,A1> operator*(const Matrix<T,2,C1,A1>& a, const Matrix<T,2,C2,A2>& b)
+{
+    if (a.dim2() != b.dim1()) error("matrix multiplication dimension mismatch");
+    Matrix<T,2,C1,A1> res(a.dim1(),b.dim2(),a.get_allocator());
+    gemm(a.dim1(),b.dim2(),a.dim2(),T(1),a.data(),a.dim2(),b.data(),b.dim2(),res.data(),res.dim2());
+    return res;
+}
+
+template<class T, class C1, class A1, class C2, class A2> Matrix<T,1,C1,A1> operator*(const Matrix<T,2,C1,A1>& a, const Matrix<T,1,C2,A2>& v)
+{
+    if (a.dim2() != v.size()) error("matrix vector multiplication dimension mismatch");
+    Matrix<T,1,C1,A1> res(a.dim1(),a.get_allocator());
+    gemv(a.dim1(),a.dim2(),a.data(),a.dim2(),v.data(),res.data());
+    return res;
+}
 
 //-----------------------------------------------------------------------------
 
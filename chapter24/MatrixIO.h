@@ -7,7 +7,7 @@ namespace Numeric_lib {
 
 //-----------------------------------------------------------------------------
 
-template<class T> std::ostream& operator<<(std::ostream& os, const Matrix<T>& v)
+template<class T, class C, class A> std::ostream& operator<<(std::ostream& os, const Matrix<T,1,C,A>& v)
 {
     os << '{';
 
@@ -19,7 +19,7 @@ template<class T> std::ostream& operator<<(std::ostream& os, const Matrix<T>& v)
 
 //-----------------------------------------------------------------------------
 
-template<class T> std::ostream& operator<<(std::ostream& os, const Matrix<T,2>& m)
+template<class T, class C, class A> std::ostream& operator<<(std::ostream& os, const Matrix<T,2,C,A>& m)
 {
     os << "{\n";
 
@@ -32,7 +32,60 @@ template<class T> std::ostream& operator<<(std::ostream& os, const Matrix<T,2>&
 
 //-----------------------------------------------------------------------------
 
-template<class T> std::istream& operator>>(std::istream& is, Matrix<T>& v)
+// views print like the Matrix they look like:
+
+template<class T, class C> std::ostream& operator<<(std::ostream& os, const Vector_view<T,C>& v)
+{
+    os << '{';
+
+    for (Index i = 0; i<v.dim1(); ++i)
+        os << "  " << std::setw(5) << std::setprecision(3) << v(i);
+    os << "  }";
+    return os;
+}
+
+template<class T, class C> std::ostream& operator<<(std::ostream& os, const Matrix_view<T,C>& m)
+{
+    os << "{\n";
+
+    for (Index i = 0; i<m.dim1(); ++i)
+        os << m[i] << '\n';
+
+    os << '}';
+    return os;
+}
+
+//-----------------------------------------------------------------------------
+
+template<class T, int R, int C, class Check> class Small_matrix;    // see Small_matrix.h
+
+template<class T, int R, int C, class Check> std::ostream& operator<<(std::ostream& os, const Small_matrix<T,R,C,Check>& m)
+{
+    return os << m.view();
+}
+
+template<class T, int R, int C, class Check> std::istream& operator>>(std::istream& is, Small_matrix<T,R,C,Check>& m)
+{
+    return is >> m.view();
+}
+
+//-----------------------------------------------------------------------------
+
+// expressions are evaluated first:
+
+template<class T, class E> std::ostream& operator<<(std::ostream& os, const Matrix_expr<T,1,E>& x)
+{
+    return os << Matrix<T>(x);
+}
+
+template<class T, class E> std::ostream& operator<<(std::ostream& os, const Matrix_expr<T,2,E>& x)
+{
+    return os << Matrix<T,2>(x);
+}
+
+//-----------------------------------------------------------------------------
+
+template<class T, class C, class A> std::istream& operator>>(std::istream& is, Matrix<T,1,C,A>& v)
 {
     char ch;
     is >> ch;
@@ -51,7 +104,7 @@ template<class T> std::istream& operator>>(std::istream& is, Matrix<T>& v)
 
 //-----------------------------------------------------------------------------
 
-template<class T> std::istream& operator>>(std::istream& is, Matrix<T,2>& m)
+template<class T, class C, class A> std::istream& operator>>(std::istream& is, Matrix<T,2,C,A>& m)
 {
     char ch;
     is >> ch;
@@ -60,7 +113,7 @@ template<class T> std::istream& operator>>(std::istream& is, Matrix<T,2>& m)
 
     for (Index i = 0; i<m.dim1(); ++i)
     {
-        Matrix<T,1> tmp(m.dim2());
+        Matrix<T,1,C,A> tmp(m.dim2(),m.get_allocator());
         is >> tmp;
         m[i] = tmp;
     }
@@ -74,4 +127,42 @@ template<class T> std::istream& operator>>(std::istream& is, Matrix<T,2>& m)
 
 //-----------------------------------------------------------------------------
 
+// reading into a view reads into the elements it refers to:
+
+template<class T, class C> std::istream& operator>>(std::istream& is, const Vector_view<T,C>& v)
+{
+    char ch;
+    is >> ch;
+
+    if (ch!='{') error("'{' missing in Vector_view input");
+
+    for (Index i = 0; i<v.dim1(); ++i)
+        is >> v(i);
+
+    is >> ch;
+
+    if (ch!='}') error("'}' missing in Vector_view input");
+
+    return is;
+}
+
+template<class T, class C> std::istream& operator>>(std::istream& is, const Matrix_view<T,C>& m)
+{
+    char ch;
+    is >> ch;
+
+    if (ch!='{') error("'{' missing in Matrix_view input");
+
+    for (Index i = 0; i<m.dim1(); ++i)
+        is >> m[i];
+
+    is >> ch;
+
+    if (ch!='}') error("'}' missing in Matrix_view input");
+
+    return is;
+}
+
+//-----------------------------------------------------------------------------
+
 }
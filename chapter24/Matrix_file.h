@@ -0,0 +1,350 @@
+/*
+    A binary file format for Matrix, and memory-mapped read-only views of it
+
+    Text input through operator>> must parse every element; for a 10,000 by
+    10,000 Matrix<double,2> that is 100 million numbers. A Matrix file holds
+    the elements exactly as they are in memory, after a header saying what
+    they are:
+
+        offset  size  contents
+             0     8  magic "NLMATRX" followed by '\0'
+             8     4  format version (1)
+            12     4  byte order mark 0x01020304, as written by the machine
+            16     4  element type (Matrix_dtype<T>::code)
+            20     4  element size in bytes
+            24     4  rank: 1, 2, or 3
+            28     4  unused, 0
+            32    24  dim1, dim2, dim3 as 64-bit integers; 1 beyond the rank
+            56     8  offset of the elements from the start of the file
+            64        padding up to the offset, which is a multiple of 4096
+
+    write_matrix_file() writes a Matrix; a Matrix_file_writer writes one that
+    is too big to be held in memory, a block of rows at a time. A
+    Mapped_matrix maps a Matrix file into memory: opening it costs the same
+    for any size of file, and the elements are read from disk by the
+    operating system as they are first used.
+
+        write_matrix_file("a.nlm",a);
+        Mapped_matrix<double,2> mm("a.nlm");
+        const Matrix<double,2>& b = mm.matrix();    // the elements are in the file
+*/
+
+#ifndef MATRIX_FILE_LIB
+#define MATRIX_FILE_LIB
+
+#include<cstring>
+#include<fstream>
+#include<string>
+#include<vector>
+#include "Matrix.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include<windows.h>
+#else
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+#endif
+
+namespace Numeric_lib {
+
+//-----------------------------------------------------------------------------
+
+// the element types a Matrix file can hold:
+
+template<class T> struct Matrix_dtype;    // no code: not allowed in a file
+
+template<> struct Matrix_dtype<float>         { static const unsigned code = 1; };
+template<> struct Matrix_dtype<double>        { static const unsigned code = 2; };
+template<> struct Matrix_dtype<int>           { static const unsigned code = 3; };
+template<> struct Matrix_dtype<long long>     { static const unsigned code = 4; };
+template<> struct Matrix_dtype<unsigned char> { static const unsigned code = 5; };
+
+//-----------------------------------------------------------------------------
+
+const unsigned matrix_file_version = 1;
+const unsigned matrix_file_byte_order = 0x01020304;
+const long long matrix_file_alignment = 4096;    // a page: the elements of a mapped file are page aligned
+
+struct Matrix_file_header {
+    char magic[8];
+    unsigned version;
+    unsigned byte_order;
+    unsigned dtype;
+    unsigned elem_size;
+    unsigned rank;
+    unsigned unused;
+    long long dims[3];
+    long long offset;
+
+    Matrix_file_header() { std::memset(this,0,sizeof(*this)); }
+
+    long long elements() const { return dims[0]*dims[1]*dims[2]; }
+
+    void check() const
+        // is this a header we can read?
+    {
+        if (std::memcmp(magic,"NLMATRX",8)!=0) error("not a Matrix file");
+        if (byte_order!=matrix_file_byte_order) error("Matrix file: wrong byte order");
+        if (version!=matrix_file_version) error("Matrix file: unknown version");
+        if (rank<1 || 3<rank) error("Matrix file: bad rank");
+        for (unsigned i = 0; i<3; ++i)
+            if (dims[i]<0 || (rank<=i && dims[i]!=1)) error("Matrix file: bad dimensions");
+        if (offset<(long long)sizeof(Matrix_file_header)) error("Matrix file: bad offset");
+    }
+
+    template<class T> void check(int d) const
+        // is this a header for a Matrix<T,d>?
+    {
+        check();
+        if (dtype!=Matrix_dtype<T>::code || elem_size!=sizeof(T)) error("Matrix file: wrong element type");
+        if (rank!=unsigned(d)) error("Matrix file: wrong number of dimensions");
+    }
+};
+
+template<class T> Matrix_file_header matrix_file_header(int d, Index n1, Index n2, Index n3)
+    // header for a file holding a Matrix<T,d>
+{
+    Matrix_file_header h;
+    std::memcpy(h.magic,"NLMATRX",8);
+    h.version = matrix_file_version;
+    h.byte_order = matrix_file_byte_order;
+    h.dtype = Matrix_dtype<T>::code;
+    h.elem_size = sizeof(T);
+    h.rank = d;
+    h.dims[0] = n1;
+    h.dims[1] = d>1 ? n2 : 1;
+    h.dims[2] = d>2 ? n3 : 1;
+    h.offset = matrix_file_alignment;
+    return h;
+}
+
+//-----------------------------------------------------------------------------
+
+class Matrix_file_writer_base {
+    // the non-template part of Matrix_file_writer
+protected:
+    Matrix_file_writer_base(const std::string& path, const Matrix_file_header& h)
+        :os(path.c_str(),std::ios_base::binary|std::ios_base::trunc), hdr(h), written(0)
+    {
+        if (!os) error("cannot open Matrix file for writing");
+        std::vector<char> pad(std::size_t(h.offset),0);
+        std::memcpy(&pad[0],&h,sizeof(h));
+        os.write(&pad[0],pad.size());
+        if (!os) error("cannot write Matrix file header");
+    }
+
+    void write_bytes(const void* p, long long n)
+    {
+        os.write(static_cast<const char*>(p),std::streamsize(n));
+        if (!os) error("cannot write Matrix file");
+    }
+
+    std::ofstream os;
+    Matrix_file_header hdr;
+    long long written;    // elements
+};
+
+//-----------------------------------------------------------------------------
+
+template<class T, int D = 2> class Matrix_file_writer : private Matrix_file_writer_base {
+    // writes a Matrix<T,D> of the given dimensions, block by block along the
+    // first dimension, so that it never has to be in memory all at once:
+    //     Matrix_file_writer<double,2> w("big.nlm",rows,cols);
+    //     for (...) w.append(block);    // a Matrix<double,2> with cols columns, or a row
+    //     w.close();
+public:
+    Matrix_file_writer(const std::string& path, Index n1, Index n2 = 1, Index n3 = 1)
+        :Matrix_file_writer_base(path,matrix_file_header<T>(D,n1,n2,n3)) { }
+
+    ~Matrix_file_writer() { }    // an incomplete file is left as it is; close() reports it
+
+    Index rows_written() const { return Index(written/(hdr.dims[1]*hdr.dims[2])); }
+
+    void append(const T* p, Index n)
+        // the next n elements
+    {
+        if (written+n > hdr.elements()) error("Matrix_file_writer: too many elements");
+        write_bytes(p,(long long)n*sizeof(T));
+        written += n;
+    }
+
+    template<int DD, class C, class A> void append(const Matrix<T,DD,C,A>& m)
+        // the next rows: m can be a block of whole rows, or a single row
+    {
+        if (m.size()%(hdr.dims[1]*hdr.dims[2])) error("Matrix_file_writer: not a whole number of rows");
+        append(m.data(),m.size());
+    }
+
+    void close()
+        // finish the file; throws if not all elements have been written
+    {
+        os.close();
+        if (!os) error("cannot write Matrix file");
+        if (written!=hdr.elements()) error("Matrix_file_writer: file incomplete");
+    }
+};
+
+//-----------------------------------------------------------------------------
+
+template<class T, int D, class C, class A>
+void write_matrix_file(const std::string& path, const Matrix<T,D,C,A>& m, Index n1, Index n2, Index n3)
+{
+    Matrix_file_writer<T,D> w(path,n1,n2,n3);
+    w.append(m);
+    w.close();
+}
+
+template<class T, class C, class A> void write_matrix_file(const std::string& path, const Matrix<T,1,C,A>& m)
+{
+    write_matrix_file(path,m,m.dim1(),1,1);
+}
+
+template<class T, class C, class A> void write_matrix_file(const std::string& path, const Matrix<T,2,C,A>& m)
+{
+    write_matrix_file(path,m,m.dim1(),m.dim2(),1);
+}
+
+template<class T, class C, class A> void write_matrix_file(const std::string& path, const Matrix<T,3,C,A>& m)
+{
+    write_matrix_file(path,m,m.dim1(),m.dim2(),m.dim3());
+}
+
+//-----------------------------------------------------------------------------
+
+class Mapped_file {
+    // a Matrix file mapped read-only into memory
+public:
+    explicit Mapped_file(const std::string& path)
+        :addr(0), len(0)
+    {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(),GENERIC_READ,FILE_SHARE_READ,0,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,0);
+        if (file==INVALID_HANDLE_VALUE) error("cannot open Matrix file");
+        LARGE_INTEGER sz;
+        if (!GetFileSizeEx(file,&sz)) { CloseHandle(file); error("cannot open Matrix file"); }
+        len = sz.QuadPart;
+        mapping = len ? CreateFileMappingA(file,0,PAGE_READONLY,0,0,0) : 0;
+        if (mapping) addr = MapViewOfFile(mapping,FILE_MAP_READ,0,0,0);
+        if (addr==0) {
+            if (mapping) CloseHandle(mapping);
+            CloseHandle(file);
+            error("cannot map Matrix file");
+        }
+#else
+        const int fd = open(path.c_str(),O_RDONLY);
+        if (fd<0) error("cannot open Matrix file");
+        struct stat st;
+        if (fstat(fd,&st)!=0) { ::close(fd); error("cannot open Matrix file"); }
+        len = st.st_size;
+        void* p = len ? mmap(0,std::size_t(len),PROT_READ,MAP_SHARED,fd,0) : MAP_FAILED;
+        ::close(fd);    // the mapping keeps the file open
+        if (p==MAP_FAILED) error("cannot map Matrix file");
+        addr = p;
+#endif
+        if (len<(long long)sizeof(Matrix_file_header)) {
+            unmap();
+            error("not a Matrix file");
+        }
+    }
+
+    ~Mapped_file() { unmap(); }
+
+    const Matrix_file_header& header() const { return *static_cast<const Matrix_file_header*>(addr); }
+    long long size() const { return len; }    // of the file, in bytes
+
+    template<class T> const T* elements(int d) const
+        // the elements of a Matrix<T,d>, after checking that the file holds one
+    {
+        const Matrix_file_header& h = header();
+        h.check<T>(d);
+        if (h.offset%(long long)sizeof(T)) error("Matrix file: bad offset");
+        if (h.offset>len) error("Matrix file: truncated");
+        // compare dimension by dimension with what fits, so that a bad header
+        // can't make dims[0]*dims[1]*dims[2] overflow and look small:
+        long long room = (len-h.offset)/(long long)sizeof(T);
+        if (h.dims[0] && h.dims[1] && h.dims[2])
+            for (int i = 0; i<3; ++i) {
+                if (h.dims[i]>room) error("Matrix file: truncated");
+                room /= h.dims[i];
+            }
+        return reinterpret_cast<const T*>(static_cast<const char*>(addr)+h.offset);
+    }
+private:
+    void unmap()
+    {
+#ifdef _WIN32
+        if (addr) UnmapViewOfFile(addr);
+        CloseHandle(mapping);
+        CloseHandle(file);
+#else
+        if (addr) munmap(addr,std::size_t(len));
+#endif
+        addr = 0;
+    }
+
+    void* addr;
+    long long len;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+
+    Mapped_file(const Mapped_file&);    // no copying of mappings
+    void operator=(const Mapped_file&);
+};
+
+//-----------------------------------------------------------------------------
+
+// Matrix descriptors for elements owned by a Mapped_file:
+
+template<class T, int D, class C> class Mapped_view;
+
+template<class T, class C> class Mapped_view<T,1,C> : public Matrix<T,1,C> {
+public:
+    Mapped_view(const long long* d, T* p) :Matrix<T,1,C>(Index(d[0]),p) { }
+};
+
+template<class T, class C> class Mapped_view<T,2,C> : public Matrix<T,2,C> {
+public:
+    Mapped_view(const long long* d, T* p) :Matrix<T,2,C>(Index(d[0]),Index(d[1]),p) { }
+};
+
+template<class T, class C> class Mapped_view<T,3,C> : public Matrix<T,3,C> {
+public:
+    Mapped_view(const long long* d, T* p) :Matrix<T,3,C>(Index(d[0]),Index(d[1]),Index(d[2]),p) { }
+};
+
+//-----------------------------------------------------------------------------
+
+template<class T = double, int D = 2, class C = Checked> class Mapped_matrix : private Mapped_file {
+    // a read-only Matrix<T,D,C> whose elements are those in a Matrix file
+    // the Matrix is only valid while the Mapped_matrix exists; copy it to keep it:
+    //     Matrix<double,2> m = Mapped_matrix<double,2>("a.nlm").matrix();
+public:
+    explicit Mapped_matrix(const std::string& path)
+        :Mapped_file(path), m(header().dims,const_cast<T*>(elements<T>(D))) { }
+
+    const Matrix<T,D,C>& matrix() const { return m; }
+    using Mapped_file::header;
+private:
+    Mapped_view<T,D,C> m;    // never modified: the pages are read-only
+};
+
+//-----------------------------------------------------------------------------
+
+template<class T, int D> Matrix<T,D> read_matrix_file(const std::string& path)
+    // a Matrix holding a copy of the elements in a Matrix file
+{
+    Mapped_matrix<T,D> mm(path);
+    return mm.matrix();
+}
+
+//-----------------------------------------------------------------------------
+
+}
+#endif
@@ -0,0 +1,295 @@
+/*
+    Random numbers for Numeric_lib: test data and random matrices
+
+    rand()%max is slow (a library call per number), biased (unless max divides
+    RAND_MAX+1, the small values come up more often), has only 15 bits on some
+    systems and shares one hidden state between all threads. Here instead:
+
+    Xoshiro256 is xoshiro256** (Blackman and Vigna): 256 bits of state, a few
+    shifts, rotates and adds per 64-bit result, and it passes the usual
+    statistical test batteries. It meets the requirements of a C++ random
+    number engine, so the <random> distributions work with it as well.
+
+    randint(g,n) is unbiased (Lemire's multiply and reject), uniform01(g) has
+    the full 53 bits of a double.
+
+    fill_uniform() and fill_normal() write straight into a Matrix or a vector.
+    The elements are cut into blocks of random_block elements, and block k gets
+    a generator of its own, seeded from (seed,k) only; the blocks are given
+    out to the thread pool. The result depends on the seed alone, never on the
+    number of threads or on which thread did what:
+
+        Matrix<double,2> m(1000,1000,uninitialized);
+        fill_uniform(m,-10.0,10.0,42);    // the same 10^6 numbers on every machine
+        fill_normal(par,v,0.0,1.0,42);    // on the default thread pool
+*/
+
+#ifndef RANDOM_LIB
+#define RANDOM_LIB
+
+#include<algorithm>
+#include<cmath>
+#include<cstdint>
+#include<limits>
+#include<vector>
+#include "Matrix.h"
+#include "Thread_pool.h"
+
+namespace Numeric_lib {
+
+//-----------------------------------------------------------------------------
+
+inline std::uint64_t splitmix64(std::uint64_t& x)
+    // the next value of a simple 64-bit generator, used to turn a seed into a state
+{
+    std::uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z^(z>>30))*0xbf58476d1ce4e5b9ULL;
+    z = (z^(z>>27))*0x94d049bb133111ebULL;
+    return z^(z>>31);
+}
+
+inline std::uint64_t rotl64(std::uint64_t x, int k) { return (x<<k)|(x>>(64-k)); }
+
+//-----------------------------------------------------------------------------
+
+class Xoshiro256 {
+    // xoshiro256**: period 2^256-1, fast, good enough for anything but cryptography
+public:
+    typedef std::uint64_t result_type;
+
+    explicit Xoshiro256(std::uint64_t seed = 0x853c49e6748fea9bULL) { this->seed(seed); }
+    Xoshiro256(std::uint64_t seed, std::uint64_t stream) { this->seed(seed,stream); }
+
+    void seed(std::uint64_t x)
+    {
+        for (int i = 0; i<4; ++i) s[i] = splitmix64(x);
+    }
+
+    void seed(std::uint64_t x, std::uint64_t stream)
+        // independent streams from one seed: stream k of seed x doesn't
+        // overlap seed x itself or any other stream in practice
+    {
+        std::uint64_t y = x^splitmix64(stream);
+        seed(y);
+    }
+
+    static result_type min() { return 0; }
+    static result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()()
+    {
+        const std::uint64_t r = rotl64(s[1]*5,7)*9;
+        const std::uint64_t t = s[1]<<17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl64(s[3],45);
+        return r;
+    }
+
+    void discard(unsigned long long n) { while (n--) (*this)(); }
+
+    void jump()
+        // as 2^128 calls of operator()(): for up to 2^128 non-overlapping sequences
+    {
+        static const std::uint64_t J[] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                           0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+        std::uint64_t t[4] = { 0, 0, 0, 0 };
+        for (int i = 0; i<4; ++i)
+            for (int b = 0; b<64; ++b) {
+                if (J[i]&(std::uint64_t(1)<<b))
+                    for (int k = 0; k<4; ++k) t[k] ^= s[k];
+                (*this)();
+            }
+        for (int k = 0; k<4; ++k) s[k] = t[k];
+    }
+
+    bool operator==(const Xoshiro256& g) const
+    {
+        return s[0]==g.s[0] && s[1]==g.s[1] && s[2]==g.s[2] && s[3]==g.s[3];
+    }
+    bool operator!=(const Xoshiro256& g) const { return !(*this==g); }
+
+private:
+    std::uint64_t s[4];
+};
+
+//-----------------------------------------------------------------------------
+
+template<class G> inline std::uint64_t randint(G& g, std::uint64_t n)
+    // uniform in [0:n), without the bias of g()%n: the high half of g()*n is
+    // in [0:n), and the few g() that would make some values more frequent
+    // than others are rejected (Lemire); for n of 2^32 and more, g()%n with
+    // the g() below 2^64%n rejected instead
+{
+    if (n==0) error("randint(): empty range");
+    if (n>>32) {
+        const std::uint64_t t = (0-n)%n;    // 2^64%n
+        std::uint64_t x = g();
+        while (x<t) x = g();
+        return x%n;
+    }
+    std::uint64_t x = g()>>32;
+    std::uint64_t m = x*n;
+    std::uint32_t low = std::uint32_t(m);
+    if (low<n) {
+        const std::uint32_t t = std::uint32_t(-std::uint32_t(n)%std::uint32_t(n));
+        while (low<t) {
+            x = g()>>32;
+            m = x*n;
+            low = std::uint32_t(m);
+        }
+    }
+    return m>>32;
+}
+
+template<class G> inline long randint(G& g, long min, long max)
+    // uniform in [min:max)
+{
+    if (max<=min) error("randint(): empty range");
+    return long(std::uint64_t(min)+randint(g,std::uint64_t(max)-std::uint64_t(min)));
+}
+
+template<class G> inline double uniform01(G& g)
+    // uniform in [0:1), with all 53 bits of the mantissa random
+{
+    return double(g()>>11)*(1.0/9007199254740992.0);
+}
+
+//-----------------------------------------------------------------------------
+
+const Index random_block = 4096;    // elements per generator in fill_uniform() and fill_normal()
+
+template<class T> void uniform_block(T* p, Index n, T lo, T hi, std::uint64_t seed, Index block)
+    // the random numbers are made first and converted in a second, simple
+    // loop the compiler vectorizes
+{
+    Xoshiro256 g(seed,std::uint64_t(block));
+    std::uint64_t bits[256];
+    const double scale = double(hi-lo)*(1.0/9007199254740992.0);
+    for (Index i = 0; i<n; i += 256) {
+        const Index m = std::min(n-i,Index(256));
+        for (Index k = 0; k<m; ++k) bits[k] = g();
+        if (std::numeric_limits<T>::is_integer)    // round down, not towards 0
+            for (Index k = 0; k<m; ++k) p[i+k] = T(std::floor(double(lo)+double(bits[k]>>11)*scale));
+        else
+            for (Index k = 0; k<m; ++k) p[i+k] = T(double(lo)+double(bits[k]>>11)*scale);
+    }
+}
+
+template<class T> void normal_block(T* p, Index n, T mean, T sigma, std::uint64_t seed, Index block)
+    // Box-Muller: two uniform numbers give two normally distributed ones
+{
+    Xoshiro256 g(seed,std::uint64_t(block));
+    const double two_pi = 6.283185307179586;
+    Index i = 0;
+    for (; i+2<=n; i += 2) {
+        const double u1 = 1.0-uniform01(g);    // (0:1], for the log
+        const double u2 = uniform01(g);
+        const double r = std::sqrt(-2*std::log(u1));
+        p[i] = T(mean+sigma*r*std::cos(two_pi*u2));
+        p[i+1] = T(mean+sigma*r*std::sin(two_pi*u2));
+    }
+    if (i<n) {
+        const double u1 = 1.0-uniform01(g);
+        const double u2 = uniform01(g);
+        p[i] = T(mean+sigma*std::sqrt(-2*std::log(u1))*std::cos(two_pi*u2));
+    }
+}
+
+template<class T> void fill_uniform(T* p, Index n, T lo, T hi, std::uint64_t seed)
+    // uniform in [lo:hi), block by block
+{
+    for (Index b = 0; b*random_block<n; ++b)
+        uniform_block(p+b*random_block,std::min(random_block,n-b*random_block),lo,hi,seed,b);
+}
+
+template<class T> void fill_uniform(const Parallel& par, T* p, Index n, T lo, T hi, std::uint64_t seed)
+    // the same numbers as fill_uniform(p,n,lo,hi,seed), made on par.thread_pool()
+{
+    const Index blocks = (n+random_block-1)/random_block;
+    par.thread_pool().parallel_for(0,blocks,std::max(Index(1),par.grain/random_block),[=](Index lo_b, Index hi_b) {
+        for (Index b = lo_b; b<hi_b; ++b)
+            uniform_block(p+b*random_block,std::min(random_block,n-b*random_block),lo,hi,seed,b);
+    });
+}
+
+template<class T> void fill_normal(T* p, Index n, T mean, T sigma, std::uint64_t seed)
+{
+    for (Index b = 0; b*random_block<n; ++b)
+        normal_block(p+b*random_block,std::min(random_block,n-b*random_block),mean,sigma,seed,b);
+}
+
+template<class T> void fill_normal(const Parallel& par, T* p, Index n, T mean, T sigma, std::uint64_t seed)
+{
+    const Index blocks = (n+random_block-1)/random_block;
+    par.thread_pool().parallel_for(0,blocks,std::max(Index(1),par.grain/random_block),[=](Index lo_b, Index hi_b) {
+        for (Index b = lo_b; b<hi_b; ++b)
+            normal_block(p+b*random_block,std::min(random_block,n-b*random_block),mean,sigma,seed,b);
+    });
+}
+
+//-----------------------------------------------------------------------------
+
+// the same for Matrices (of any dimension) and vectors:
+
+template<class T, int D, class C, class A> void fill_uniform(Matrix<T,D,C,A>& m, T lo, T hi, std::uint64_t seed)
+{
+    fill_uniform(m.data(),m.size(),lo,hi,seed);
+}
+
+template<class T, int D, class C, class A> void fill_uniform(const Parallel& par, Matrix<T,D,C,A>& m, T lo, T hi, std::uint64_t seed)
+{
+    fill_uniform(par,m.data(),m.size(),lo,hi,seed);
+}
+
+template<class T, int D, class C, class A> void fill_normal(Matrix<T,D,C,A>& m, T mean, T sigma, std::uint64_t seed)
+{
+    fill_normal(m.data(),m.size(),mean,sigma,seed);
+}
+
+template<class T, int D, class C, class A> void fill_normal(const Parallel& par, Matrix<T,D,C,A>& m, T mean, T sigma, std::uint64_t seed)
+{
+    fill_normal(par,m.data(),m.size(),mean,sigma,seed);
+}
+
+template<class T> void fill_uniform(std::vector<T>& v, T lo, T hi, std::uint64_t seed)
+{
+    if (!v.empty()) fill_uniform(&v[0],Index(v.size()),lo,hi,seed);
+}
+
+template<class T> void fill_uniform(const Parallel& par, std::vector<T>& v, T lo, T hi, std::uint64_t seed)
+{
+    if (!v.empty()) fill_uniform(par,&v[0],Index(v.size()),lo,hi,seed);
+}
+
+template<class T> void fill_normal(std::vector<T>& v, T mean, T sigma, std::uint64_t seed)
+{
+    if (!v.empty()) fill_normal(&v[0],Index(v.size()),mean,sigma,seed);
+}
+
+template<class T> void fill_normal(const Parallel& par, std::vector<T>& v, T mean, T sigma, std::uint64_t seed)
+{
+    if (!v.empty()) fill_normal(par,&v[0],Index(v.size()),mean,sigma,seed);
+}
+
+//-----------------------------------------------------------------------------
+
+inline double chi_square(const std::vector<long>& histo, double expected)
+    // Pearson's statistic for counts that should all be expected; for k bins
+    // it is near k-1 (standard deviation sqrt(2*(k-1))) if nothing is biased
+{
+    double x = 0;
+    for (size_t i = 0; i<histo.size(); ++i) {
+        const double d = histo[i]-expected;
+        x += d*d/expected;
+    }
+    return x;
+}
+
+//-----------------------------------------------------------------------------
+
+}
+#endif
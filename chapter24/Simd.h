@@ -0,0 +1,432 @@
+/*
+    SIMD kernels for dot_product() and scale_and_add() in Numeric_lib
+
+    These two are the inner loops of all elimination code: back substitution
+    is a dot_product() per row, elimination a scale_and_add() per row. Written
+    as plain loops, dot_product() is a single chain of dependent adds, which
+    the compiler may not reorder, so it runs at one add per FMA latency
+    whatever the vector width. The kernels here use several vector
+    accumulators instead, and are compiled for SSE2, AVX2/FMA and AVX-512;
+    which one is used is decided when the program runs, from what the
+    processor supports, so one executable is fast on every x86 machine.
+
+    With GCC and Clang on x86 all versions are compiled (using target
+    attributes) and chosen at run time; elsewhere only what the compiler
+    targets is available (e.g. /arch:AVX2 for MSVC), with a scalar fallback
+    that still uses four accumulators.
+
+    Because the products are added in a different order, results can differ
+    from the plain loop in the last bits. dot_product_compensated() in
+    Matrix.h is for when that matters: it is as accurate as the plain loop
+    done in twice the precision.
+*/
+
+#ifndef SIMD_LIB
+#define SIMD_LIB
+
+#include<algorithm>
+#include<cmath>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define MATRIX_LIB_SIMD_DISPATCH
+#define MATRIX_LIB_TARGET(s) __attribute__((target(s)))
+#define MATRIX_LIB_SSE2
+#define MATRIX_LIB_AVX2_KERNELS
+#define MATRIX_LIB_AVX512
+#else
+#define MATRIX_LIB_TARGET(s)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#define MATRIX_LIB_SSE2
+#endif
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#define MATRIX_LIB_AVX2_KERNELS
+#endif
+#if defined(__AVX512F__)
+#define MATRIX_LIB_AVX512
+#endif
+#endif
+
+#if defined(MATRIX_LIB_SSE2) || defined(MATRIX_LIB_AVX2_KERNELS) || defined(MATRIX_LIB_AVX512)
+#include<immintrin.h>
+#endif
+
+namespace Numeric_lib {
+
+//-----------------------------------------------------------------------------
+
+typedef long Index;    // as in Matrix.h
+
+//-----------------------------------------------------------------------------
+
+enum Simd_level { simd_scalar, simd_sse2, simd_avx2, simd_avx512 };
+
+inline const char* simd_name(Simd_level l)
+{
+    static const char* const names[] = { "scalar", "sse2", "avx2", "avx512" };
+    return names[l];
+}
+
+inline Simd_level supported_simd_level()
+    // the best the processor (and compiler) can do
+{
+#if defined(MATRIX_LIB_SIMD_DISPATCH)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return simd_avx512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return simd_avx2;
+    if (__builtin_cpu_supports("sse2")) return simd_sse2;
+    return simd_scalar;
+#elif defined(MATRIX_LIB_AVX512)
+    return simd_avx512;
+#elif defined(MATRIX_LIB_AVX2_KERNELS)
+    return simd_avx2;
+#elif defined(MATRIX_LIB_SSE2)
+    return simd_sse2;
+#else
+    return simd_scalar;
+#endif
+}
+
+inline Simd_level& current_simd_level()
+{
+    static Simd_level l = supported_simd_level();
+    return l;
+}
+
+inline Simd_level simd_level() { return current_simd_level(); }    // the kernels in use
+
+inline void set_simd_level(Simd_level l)
+    // use nothing better than l, e.g. to compare the kernels; never more than
+    // is supported. Not to be called while other threads are computing
+{
+    current_simd_level() = std::min(l,supported_simd_level());
+}
+
+//-----------------------------------------------------------------------------
+
+const Index simd_min_size = 16;    // shorter than this, the plain loop wins: no dispatch
+
+// the portable kernels, also used for element types without a SIMD version:
+
+template<class T> T dot_scalar(const T* a, const T* b, Index n)
+    // four independent sums, so that the adds don't wait for each other
+{
+    T s0 = T(), s1 = T(), s2 = T(), s3 = T();
+    Index i = 0;
+    for (; i+4<=n; i += 4) {
+        s0 += a[i]*b[i];
+        s1 += a[i+1]*b[i+1];
+        s2 += a[i+2]*b[i+2];
+        s3 += a[i+3]*b[i+3];
+    }
+    for (; i<n; ++i) s0 += a[i]*b[i];
+    return (s0+s1)+(s2+s3);
+}
+
+template<class T> void scale_and_add_scalar(Index n, const T* a, T c, const T* b, T* res)
+    // res[i] = a[i]*c+b[i]; res may be a or b
+{
+    for (Index i = 0; i<n; ++i) res[i] = a[i]*c+b[i];
+}
+
+//-----------------------------------------------------------------------------
+
+#ifdef MATRIX_LIB_SSE2
+
+MATRIX_LIB_TARGET("sse2") inline double dot_sse2(const double* a, const double* b, Index n)
+{
+    __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd(), s2 = _mm_setzero_pd(), s3 = _mm_setzero_pd();
+    Index i = 0;
+    for (; i+8<=n; i += 8) {
+        s0 = _mm_add_pd(s0,_mm_mul_pd(_mm_loadu_pd(a+i),_mm_loadu_pd(b+i)));
+        s1 = _mm_add_pd(s1,_mm_mul_pd(_mm_loadu_pd(a+i+2),_mm_loadu_pd(b+i+2)));
+        s2 = _mm_add_pd(s2,_mm_mul_pd(_mm_loadu_pd(a+i+4),_mm_loadu_pd(b+i+4)));
+        s3 = _mm_add_pd(s3,_mm_mul_pd(_mm_loadu_pd(a+i+6),_mm_loadu_pd(b+i+6)));
+    }
+    double r[2];
+    _mm_storeu_pd(r,_mm_add_pd(_mm_add_pd(s0,s1),_mm_add_pd(s2,s3)));
+    double s = r[0]+r[1];
+    for (; i<n; ++i) s += a[i]*b[i];
+    return s;
+}
+
+MATRIX_LIB_TARGET("sse2") inline float dot_sse2(const float* a, const float* b, Index n)
+{
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps(), s2 = _mm_setzero_ps(), s3 = _mm_setzero_ps();
+    Index i = 0;
+    for (; i+16<=n; i += 16) {
+        s0 = _mm_add_ps(s0,_mm_mul_ps(_mm_loadu_ps(a+i),_mm_loadu_ps(b+i)));
+        s1 = _mm_add_ps(s1,_mm_mul_ps(_mm_loadu_ps(a+i+4),_mm_loadu_ps(b+i+4)));
+        s2 = _mm_add_ps(s2,_mm_mul_ps(_mm_loadu_ps(a+i+8),_mm_loadu_ps(b+i+8)));
+        s3 = _mm_add_ps(s3,_mm_mul_ps(_mm_loadu_ps(a+i+12),_mm_loadu_ps(b+i+12)));
+    }
+    float r[4];
+    _mm_storeu_ps(r,_mm_add_ps(_mm_add_ps(s0,s1),_mm_add_ps(s2,s3)));
+    float s = (r[0]+r[1])+(r[2]+r[3]);
+    for (; i<n; ++i) s += a[i]*b[i];
+    return s;
+}
+
+MATRIX_LIB_TARGET("sse2") inline void scale_and_add_sse2(Index n, const double* a, double c, const double* b, double* res)
+{
+    const __m128d cc = _mm_set1_pd(c);
+    Index i = 0;
+    for (; i+4<=n; i += 4) {
+        const __m128d r0 = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(a+i),cc),_mm_loadu_pd(b+i));
+        const __m128d r1 = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(a+i+2),cc),_mm_loadu_pd(b+i+2));
+        _mm_storeu_pd(res+i,r0);
+        _mm_storeu_pd(res+i+2,r1);
+    }
+    for (; i<n; ++i) res[i] = a[i]*c+b[i];
+}
+
+MATRIX_LIB_TARGET("sse2") inline void scale_and_add_sse2(Index n, const float* a, float c, const float* b, float* res)
+{
+    const __m128 cc = _mm_set1_ps(c);
+    Index i = 0;
+    for (; i+8<=n; i += 8) {
+        const __m128 r0 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a+i),cc),_mm_loadu_ps(b+i));
+        const __m128 r1 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a+i+4),cc),_mm_loadu_ps(b+i+4));
+        _mm_storeu_ps(res+i,r0);
+        _mm_storeu_ps(res+i+4,r1);
+    }
+    for (; i<n; ++i) res[i] = a[i]*c+b[i];
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
+
+#ifdef MATRIX_LIB_AVX2_KERNELS
+
+MATRIX_LIB_TARGET("avx2,fma") inline double dot_avx2(const double* a, const double* b, Index n)
+    // four accumulators of four: sixteen products in flight, enough to cover the FMA latency
+{
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd(), s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd();
+    Index i = 0;
+    for (; i+16<=n; i += 16) {
+        s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a+i),_mm256_loadu_pd(b+i),s0);
+        s1 = _mm256_fmadd_pd(_mm256_loadu_pd(a+i+4),_mm256_loadu_pd(b+i+4),s1);
+        s2 = _mm256_fmadd_pd(_mm256_loadu_pd(a+i+8),_mm256_loadu_pd(b+i+8),s2);
+        s3 = _mm256_fmadd_pd(_mm256_loadu_pd(a+i+12),_mm256_loadu_pd(b+i+12),s3);
+    }
+    for (; i+4<=n; i += 4) s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a+i),_mm256_loadu_pd(b+i),s0);
+    const __m256d s = _mm256_add_pd(_mm256_add_pd(s0,s1),_mm256_add_pd(s2,s3));
+    const __m128d h = _mm_add_pd(_mm256_castpd256_pd128(s),_mm256_extractf128_pd(s,1));
+    double r = _mm_cvtsd_f64(_mm_add_sd(h,_mm_unpackhi_pd(h,h)));
+    for (; i<n; ++i) r += a[i]*b[i];
+    return r;
+}
+
+MATRIX_LIB_TARGET("avx2,fma") inline float dot_avx2(const float* a, const float* b, Index n)
+{
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps(), s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+    Index i = 0;
+    for (; i+32<=n; i += 32) {
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i),_mm256_loadu_ps(b+i),s0);
+        s1 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i+8),_mm256_loadu_ps(b+i+8),s1);
+        s2 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i+16),_mm256_loadu_ps(b+i+16),s2);
+        s3 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i+24),_mm256_loadu_ps(b+i+24),s3);
+    }
+    for (; i+8<=n; i += 8) s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i),_mm256_loadu_ps(b+i),s0);
+    const __m256 s = _mm256_add_ps(_mm256_add_ps(s0,s1),_mm256_add_ps(s2,s3));
+    __m128 h = _mm_add_ps(_mm256_castps256_ps128(s),_mm256_extractf128_ps(s,1));
+    h = _mm_add_ps(h,_mm_movehl_ps(h,h));
+    float r = _mm_cvtss_f32(_mm_add_ss(h,_mm_shuffle_ps(h,h,1)));
+    for (; i<n; ++i) r += a[i]*b[i];
+    return r;
+}
+
+MATRIX_LIB_TARGET("avx2,fma") inline void scale_and_add_avx2(Index n, const double* a, double c, const double* b, double* res)
+{
+    const __m256d cc = _mm256_set1_pd(c);
+    Index i = 0;
+    for (; i+8<=n; i += 8) {
+        const __m256d r0 = _mm256_fmadd_pd(_mm256_loadu_pd(a+i),cc,_mm256_loadu_pd(b+i));
+        const __m256d r1 = _mm256_fmadd_pd(_mm256_loadu_pd(a+i+4),cc,_mm256_loadu_pd(b+i+4));
+        _mm256_storeu_pd(res+i,r0);
+        _mm256_storeu_pd(res+i+4,r1);
+    }
+    for (; i<n; ++i) res[i] = a[i]*c+b[i];
+}
+
+MATRIX_LIB_TARGET("avx2,fma") inline void scale_and_add_avx2(Index n, const float* a, float c, const float* b, float* res)
+{
+    const __m256 cc = _mm256_set1_ps(c);
+    Index i = 0;
+    for (; i+16<=n; i += 16) {
+        const __m256 r0 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i),cc,_mm256_loadu_ps(b+i));
+        const __m256 r1 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i+8),cc,_mm256_loadu_ps(b+i+8));
+        _mm256_storeu_ps(res+i,r0);
+        _mm256_storeu_ps(res+i+8,r1);
+    }
+    for (; i<n; ++i) res[i] = a[i]*c+b[i];
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
+
+#ifdef MATRIX_LIB_AVX512
+
+MATRIX_LIB_TARGET("avx512f") inline double dot_avx512(const double* a, const double* b, Index n)
+    // the tail is done with a masked load instead of a scalar loop
+{
+    __m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd(), s2 = _mm512_setzero_pd(), s3 = _mm512_setzero_pd();
+    Index i = 0;
+    for (; i+32<=n; i += 32) {
+        s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a+i),_mm512_loadu_pd(b+i),s0);
+        s1 = _mm512_fmadd_pd(_mm512_loadu_pd(a+i+8),_mm512_loadu_pd(b+i+8),s1);
+        s2 = _mm512_fmadd_pd(_mm512_loadu_pd(a+i+16),_mm512_loadu_pd(b+i+16),s2);
+        s3 = _mm512_fmadd_pd(_mm512_loadu_pd(a+i+24),_mm512_loadu_pd(b+i+24),s3);
+    }
+    for (; i+8<=n; i += 8) s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a+i),_mm512_loadu_pd(b+i),s0);
+    if (i<n) {
+        const __mmask8 m = __mmask8((1u<<(n-i))-1);
+        s1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(m,a+i),_mm512_maskz_loadu_pd(m,b+i),s1);
+    }
+    double r[8];
+    _mm512_storeu_pd(r,_mm512_add_pd(_mm512_add_pd(s0,s1),_mm512_add_pd(s2,s3)));
+    return ((r[0]+r[1])+(r[2]+r[3]))+((r[4]+r[5])+(r[6]+r[7]));
+}
+
+MATRIX_LIB_TARGET("avx512f") inline float dot_avx512(const float* a, const float* b, Index n)
+{
+    __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps(), s2 = _mm512_setzero_ps(), s3 = _mm512_setzero_ps();
+    Index i = 0;
+    for (; i+64<=n; i += 64) {
+        s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a+i),_mm512_loadu_ps(b+i),s0);
+        s1 = _mm512_fmadd_ps(_mm512_loadu_ps(a+i+16),_mm512_loadu_ps(b+i+16),s1);
+        s2 = _mm512_fmadd_ps(_mm512_loadu_ps(a+i+32),_mm512_loadu_ps(b+i+32),s2);
+        s3 = _mm512_fmadd_ps(_mm512_loadu_ps(a+i+48),_mm512_loadu_ps(b+i+48),s3);
+    }
+    for (; i+16<=n; i += 16) s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a+i),_mm512_loadu_ps(b+i),s0);
+    if (i<n) {
+        const __mmask16 m = __mmask16((1u<<(n-i))-1);
+        s1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m,a+i),_mm512_maskz_loadu_ps(m,b+i),s1);
+    }
+    float r[16];
+    _mm512_storeu_ps(r,_mm512_add_ps(_mm512_add_ps(s0,s1),_mm512_add_ps(s2,s3)));
+    for (int k = 8; k>0; k /= 2)
+        for (int j = 0; j<k; ++j) r[j] += r[j+k];
+    return r[0];
+}
+
+MATRIX_LIB_TARGET("avx512f") inline void scale_and_add_avx512(Index n, const double* a, double c, const double* b, double* res)
+{
+    const __m512d cc = _mm512_set1_pd(c);
+    Index i = 0;
+    for (; i+16<=n; i += 16) {
+        const __m512d r0 = _mm512_fmadd_pd(_mm512_loadu_pd(a+i),cc,_mm512_loadu_pd(b+i));
+        const __m512d r1 = _mm512_fmadd_pd(_mm512_loadu_pd(a+i+8),cc,_mm512_loadu_pd(b+i+8));
+        _mm512_storeu_pd(res+i,r0);
+        _mm512_storeu_pd(res+i+8,r1);
+    }
+    for (; i<n; i += 8) {
+        const __mmask8 m = n-i>=8 ? __mmask8(0xff) : __mmask8((1u<<(n-i))-1);
+        _mm512_mask_storeu_pd(res+i,m,_mm512_fmadd_pd(_mm512_maskz_loadu_pd(m,a+i),cc,_mm512_maskz_loadu_pd(m,b+i)));
+    }
+}
+
+MATRIX_LIB_TARGET("avx512f") inline void scale_and_add_avx512(Index n, const float* a, float c, const float* b, float* res)
+{
+    const __m512 cc = _mm512_set1_ps(c);
+    Index i = 0;
+    for (; i+32<=n; i += 32) {
+        const __m512 r0 = _mm512_fmadd_ps(_mm512_loadu_ps(a+i),cc,_mm512_loadu_ps(b+i));
+        const __m512 r1 = _mm512_fmadd_ps(_mm512_loadu_ps(a+i+16),cc,_mm512_loadu_ps(b+i+16));
+        _mm512_storeu_ps(res+i,r0);
+        _mm512_storeu_ps(res+i+16,r1);
+    }
+    for (; i<n; i += 16) {
+        const __mmask16 m = n-i>=16 ? __mmask16(0xffff) : __mmask16((1u<<(n-i))-1);
+        _mm512_mask_storeu_ps(res+i,m,_mm512_fmadd_ps(_mm512_maskz_loadu_ps(m,a+i),cc,_mm512_maskz_loadu_ps(m,b+i)));
+    }
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
+
+// the dispatchers: the best kernel allowed by simd_level()
+
+template<class T> T dot_kernel(const T* a, const T* b, Index n) { return dot_scalar(a,b,n); }
+
+template<class T> void scale_and_add_kernel(Index n, const T* a, T c, const T* b, T* res) { scale_and_add_scalar(n,a,c,b,res); }
+
+#define MATRIX_LIB_DISPATCH(T)                                                     \
+inline T dot_kernel(const T* a, const T* b, Index n)                               \
+{                                                                                  \
+    if (n<simd_min_size) return dot_scalar(a,b,n);                                 \
+    switch (simd_level()) {                                                        \
+    MATRIX_LIB_CASE_AVX512(return dot_avx512(a,b,n);)                              \
+    MATRIX_LIB_CASE_AVX2(return dot_avx2(a,b,n);)                                  \
+    MATRIX_LIB_CASE_SSE2(return dot_sse2(a,b,n);)                                  \
+    default: return dot_scalar(a,b,n);                                             \
+    }                                                                              \
+}                                                                                  \
+inline void scale_and_add_kernel(Index n, const T* a, T c, const T* b, T* res)     \
+{                                                                                  \
+    if (n<simd_min_size) { scale_and_add_scalar(n,a,c,b,res); return; }           \
+    switch (simd_level()) {                                                        \
+    MATRIX_LIB_CASE_AVX512(scale_and_add_avx512(n,a,c,b,res); return;)             \
+    MATRIX_LIB_CASE_AVX2(scale_and_add_avx2(n,a,c,b,res); return;)                 \
+    MATRIX_LIB_CASE_SSE2(scale_and_add_sse2(n,a,c,b,res); return;)                 \
+    default: scale_and_add_scalar(n,a,c,b,res);                                    \
+    }                                                                              \
+}
+
+#ifdef MATRIX_LIB_AVX512
+#define MATRIX_LIB_CASE_AVX512(s) case simd_avx512: s
+#else
+#define MATRIX_LIB_CASE_AVX512(s)
+#endif
+#ifdef MATRIX_LIB_AVX2_KERNELS
+#define MATRIX_LIB_CASE_AVX2(s) case simd_avx2: s
+#else
+#define MATRIX_LIB_CASE_AVX2(s)
+#endif
+#ifdef MATRIX_LIB_SSE2
+#define MATRIX_LIB_CASE_SSE2(s) case simd_sse2: s
+#else
+#define MATRIX_LIB_CASE_SSE2(s)
+#endif
+
+MATRIX_LIB_DISPATCH(double)
+MATRIX_LIB_DISPATCH(float)
+
+#undef MATRIX_LIB_DISPATCH
+#undef MATRIX_LIB_CASE_AVX512
+#undef MATRIX_LIB_CASE_AVX2
+#undef MATRIX_LIB_CASE_SSE2
+
+//-----------------------------------------------------------------------------
+
+// compensated dot product: every product and every sum is split into its
+// rounded value and its exact rounding error (TwoProduct, TwoSum), and the
+// errors are added up on the side (Ogita, Rump and Oishi's Dot2); the result
+// is as accurate as the plain loop computed in twice the working precision.
+// std::fma is a library call unless the compiler may use the FMA instruction
+// (e.g. -mfma), so build with that where accuracy has to be fast as well
+
+template<class T> T dot_compensated_kernel(const T* a, Index sa, const T* b, Index sb, Index n)
+{
+    T s = T();
+    T c = T();
+    for (Index i = 0; i<n; ++i) {
+        const T x = a[i*sa];
+        const T y = b[i*sb];
+        const T p = std::fma(x,y,T());    // x*y, but never contracted into the sum below
+        const T pe = std::fma(x,y,-p);    // x*y == p+pe exactly
+        const T t = s+p;
+        const T z = t-s;
+        const T se = (s-(t-z))+(p-z);     // s+p == t+se exactly
+        s = t;
+        c += pe+se;
+    }
+    return s+c;
+}
+
+//-----------------------------------------------------------------------------
+
+}
+#endif
@@ -0,0 +1,257 @@
+/*
+    Small_matrix: fixed-size matrices for Numeric_lib
+
+    A Matrix<double,2>(3,3) allocates its nine elements on the free store and
+    carries its dimensions around at run time; for millions of 3 by 3 and 4 by 4
+    transforms and fits the allocation alone costs more than the arithmetic.
+    A Small_matrix<T,R,C> holds its elements in itself, its dimensions are
+    compile-time constants, and its loops are unrolled:
+
+        Small_matrix<double,3,3> a = ...;
+        Small_matrix<double,3,1> b = ...;
+        Small_matrix<double,3,1> x = solve(a,b);    // no free store use at all
+*/
+
+#ifndef SMALL_MATRIX_LIB
+#define SMALL_MATRIX_LIB
+
+#include<cmath>
+#include "Matrix.h"
+
+namespace Numeric_lib {
+
+//-----------------------------------------------------------------------------
+
+template<int N> struct Small_unroll {
+    // f(0), f(1), ... f(N-1), without a loop
+    template<class F> static void run(F& f) { Small_unroll<N-1>::run(f); f(N-1); }
+};
+
+template<> struct Small_unroll<0> {
+    template<class F> static void run(F&) { }
+};
+
+//-----------------------------------------------------------------------------
+
+template<class T, int R, int C, class Check = Checked> class Small_matrix {
+    // R rows of C elements, stored row by row like a Matrix<T,2>
+    // ( ) is range checked unless Check says otherwise; the operations below
+    // work on the elements directly and need no checks
+public:
+    static constexpr Index dim1() { return R; }
+    static constexpr Index dim2() { return C; }
+    static constexpr Index size() { return R*C; }
+
+    Small_matrix() { fill(T()); }
+    explicit Small_matrix(Uninitialized) { }
+    explicit Small_matrix(const T& c) { fill(c); }
+
+    Small_matrix(const T (&a)[R][C])
+    {
+        for (Index i = 0; i<R; ++i)
+            for (Index j = 0; j<C; ++j) elem[i*C+j] = a[i][j];
+    }
+
+    template<class C2, class A2> explicit Small_matrix(const Matrix<T,2,C2,A2>& m)
+    {
+        if (m.dim1()!=R || m.dim2()!=C) error("Small_matrix: wrong dimensions");
+        for (Index i = 0; i<R*C; ++i) elem[i] = m.data()[i];
+    }
+
+    Matrix<T,2> matrix() const
+        // a copy on the free store
+    {
+        Matrix<T,2> m(R,C,uninitialized);
+        for (Index i = 0; i<R*C; ++i) m.data()[i] = elem[i];
+        return m;
+    }
+
+    void range_check(Index n1, Index n2) const
+    {
+        if (n1<0 || R<=n1) error("Small_matrix range error: dimension 1");
+        if (n2<0 || C<=n2) error("Small_matrix range error: dimension 2");
+    }
+
+          T& operator()(Index n1, Index n2)       { if (Check::check_elements) range_check(n1,n2); return elem[n1*C+n2]; }
+    const T& operator()(Index n1, Index n2) const { if (Check::check_elements) range_check(n1,n2); return elem[n1*C+n2]; }
+
+          T* data()       { return elem; }
+    const T* data() const { return elem; }
+
+    // for the MatrixIO.h operators and anything else that takes views:
+    Matrix_view<T,Check>       view()       { return Matrix_view<T,Check>(elem,R,C,C); }
+    Matrix_view<const T,Check> view() const { return Matrix_view<const T,Check>(elem,R,C,C); }
+
+    void fill(const T& c)
+    {
+        T* e = elem;
+        auto f = [e,&c](Index i) { e[i] = c; };
+        Small_unroll<R*C>::run(f);
+    }
+
+    Small_matrix& operator+=(const Small_matrix& a)
+    {
+        T* e = elem;
+        auto f = [e,&a](Index i) { e[i] += a.elem[i]; };
+        Small_unroll<R*C>::run(f);
+        return *this;
+    }
+
+    Small_matrix& operator-=(const Small_matrix& a)
+    {
+        T* e = elem;
+        auto f = [e,&a](Index i) { e[i] -= a.elem[i]; };
+        Small_unroll<R*C>::run(f);
+        return *this;
+    }
+
+    Small_matrix& operator*=(const T& c)
+    {
+        T* e = elem;
+        auto f = [e,&c](Index i) { e[i] *= c; };
+        Small_unroll<R*C>::run(f);
+        return *this;
+    }
+private:
+    T elem[R*C];
+};
+
+//-----------------------------------------------------------------------------
+
+template<class T, int R, int C, class Check>
+Small_matrix<T,R,C,Check> operator+(Small_matrix<T,R,C,Check> a, const Small_matrix<T,R,C,Check>& b) { return a += b; }
+
+template<class T, int R, int C, class Check>
+Small_matrix<T,R,C,Check> operator-(Small_matrix<T,R,C,Check> a, const Small_matrix<T,R,C,Check>& b) { return a -= b; }
+
+template<class T, int R, int C, class Check>
+Small_matrix<T,R,C,Check> operator*(Small_matrix<T,R,C,Check> a, const T& c) { return a *= c; }
+
+template<class T, int R, int C, class Check>
+bool operator==(const Small_matrix<T,R,C,Check>& a, const Small_matrix<T,R,C,Check>& b)
+{
+    for (Index i = 0; i<R*C; ++i)
+        if (a.data()[i]!=b.data()[i]) return false;
+    return true;
+}
+
+template<class T, int R, int C, class Check>
+bool operator!=(const Small_matrix<T,R,C,Check>& a, const Small_matrix<T,R,C,Check>& b) { return !(a==b); }
+
+//-----------------------------------------------------------------------------
+
+template<class T, int R, int K, int C, class Check>
+Small_matrix<T,R,C,Check> operator*(const Small_matrix<T,R,K,Check>& a, const Small_matrix<T,K,C,Check>& b)
+    // every element is a dot product of constant length: all loops are unrolled
+{
+    Small_matrix<T,R,C,Check> res(uninitialized);
+    const T* pa = a.data();
+    const T* pb = b.data();
+    T* pr = res.data();
+    auto elem = [=](Index ij) {
+        const Index i = ij/C;
+        const Index j = ij%C;
+        T s = T();
+        auto term = [&](Index k) { s += pa[i*K+k]*pb[k*C+j]; };
+        Small_unroll<K>::run(term);
+        pr[ij] = s;
+    };
+    Small_unroll<R*C>::run(elem);
+    return res;
+}
+
+template<class T, int R, int C, class Check>
+Small_matrix<T,C,R,Check> transpose(const Small_matrix<T,R,C,Check>& a)
+{
+    Small_matrix<T,C,R,Check> res(uninitialized);
+    const T* pa = a.data();
+    T* pr = res.data();
+    auto f = [=](Index ij) { pr[(ij%C)*R+ij/C] = pa[ij]; };
+    Small_unroll<R*C>::run(f);
+    return res;
+}
+
+//-----------------------------------------------------------------------------
+
+template<class T, int N, int M, class Check>
+Small_matrix<T,N,M,Check> solve(Small_matrix<T,N,N,Check> a, Small_matrix<T,N,M,Check> b)
+    // X such that AX==B, by Gaussian elimination with partial pivoting;
+    // the loop bounds are all compile-time constants, so the compiler unrolls them
+    // (M is 1 for a single right-hand side)
+{
+    T* pa = a.data();
+    T* pb = b.data();
+
+    for (Index j = 0; j<N; ++j) {
+        Index p = j;
+        for (Index i = j+1; i<N; ++i)
+            if (std::abs(pa[i*N+j]) > std::abs(pa[p*N+j])) p = i;
+        if (pa[p*N+j]==T()) error("Small_matrix solve(): singular matrix");
+        if (p!=j) {
+            for (Index k = j; k<N; ++k) std::swap(pa[j*N+k],pa[p*N+k]);
+            for (Index k = 0; k<M; ++k) std::swap(pb[j*M+k],pb[p*M+k]);
+        }
+        const T inv = T(1)/pa[j*N+j];
+        for (Index i = j+1; i<N; ++i) {
+            const T l = pa[i*N+j]*inv;
+            for (Index k = j+1; k<N; ++k) pa[i*N+k] -= l*pa[j*N+k];
+            for (Index k = 0; k<M; ++k) pb[i*M+k] -= l*pb[j*M+k];
+        }
+    }
+
+    for (Index i = N-1; i>=0; --i) {
+        const T inv = T(1)/pa[i*N+i];
+        for (Index k = 0; k<M; ++k) {
+            T s = pb[i*M+k];
+            for (Index j = i+1; j<N; ++j) s -= pa[i*N+j]*pb[j*M+k];
+            pb[i*M+k] = s*inv;
+        }
+    }
+    return b;
+}
+
+//-----------------------------------------------------------------------------
+
+template<class T, int N, class Check> Small_matrix<T,N,N,Check> inverse(const Small_matrix<T,N,N,Check>& a)
+{
+    Small_matrix<T,N,N,Check> id;
+    for (Index i = 0; i<N; ++i) id.data()[i*N+i] = T(1);
+    return solve(a,id);
+}
+
+// the closed forms (adjugate over determinant) for the most common sizes:
+
+template<class T, class Check> Small_matrix<T,2,2,Check> inverse(const Small_matrix<T,2,2,Check>& a)
+{
+    const T* m = a.data();
+    const T det = m[0]*m[3]-m[1]*m[2];
+    if (det==T()) error("Small_matrix inverse(): singular matrix");
+    const T r = T(1)/det;
+    Small_matrix<T,2,2,Check> res(uninitialized);
+    T* p = res.data();
+    p[0] = m[3]*r;    p[1] = -m[1]*r;
+    p[2] = -m[2]*r;   p[3] = m[0]*r;
+    return res;
+}
+
+template<class T, class Check> Small_matrix<T,3,3,Check> inverse(const Small_matrix<T,3,3,Check>& a)
+{
+    const T* m = a.data();
+    const T c0 = m[4]*m[8]-m[5]*m[7];
+    const T c1 = m[5]*m[6]-m[3]*m[8];
+    const T c2 = m[3]*m[7]-m[4]*m[6];
+    const T det = m[0]*c0+m[1]*c1+m[2]*c2;
+    if (det==T()) error("Small_matrix inverse(): singular matrix");
+    const T r = T(1)/det;
+    Small_matrix<T,3,3,Check> res(uninitialized);
+    T* p = res.data();
+    p[0] = c0*r;    p[1] = (m[2]*m[7]-m[1]*m[8])*r;    p[2] = (m[1]*m[5]-m[2]*m[4])*r;
+    p[3] = c1*r;    p[4] = (m[0]*m[8]-m[2]*m[6])*r;    p[5] = (m[2]*m[3]-m[0]*m[5])*r;
+    p[6] = c2*r;    p[7] = (m[1]*m[6]-m[0]*m[7])*r;    p[8] = (m[0]*m[4]-m[1]*m[3])*r;
+    return res;
+}
+
+//-----------------------------------------------------------------------------
+
+}
+#endif
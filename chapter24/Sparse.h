@@ -0,0 +1,375 @@
+/*
+    Sparse matrices for Numeric_lib
+
+    A finite difference system on an n point grid has about five nonzeros in
+    each of its n rows; storing it in a dense Matrix<double,2> and eliminating
+    is out of the question beyond a few thousand points. Here the nonzeros are
+    collected in a Coo_builder (coordinate format: any order, duplicates are
+    added), compressed into a Sparse_matrix (by rows, CSR, or by columns, CSC),
+    multiplied by Matrix<T,1> vectors on the thread pool, and symmetric
+    positive definite systems are solved by preconditioned conjugate gradients:
+
+        Coo_builder<double> b(n,n);
+        for (...) b.add(i,j,x);
+        Sparse_matrix<double> a(b);
+        Matrix<double> x(n);
+        Cg_result<double> r = conjugate_gradient(a,rhs,x,Ilu0_preconditioner<double>(a));
+*/
+
+#ifndef SPARSE_LIB
+#define SPARSE_LIB
+
+#include<algorithm>
+#include<cmath>
+#include<utility>
+#include<vector>
+#include "Matrix.h"
+#include "Thread_pool.h"
+
+namespace Numeric_lib {
+
+//-----------------------------------------------------------------------------
+
+template<class T = double> class Coo_builder {
+    // the nonzeros of an n1 by n2 matrix as (row, column, value) triples
+public:
+    Coo_builder(Index n1, Index n2) :d1(n1), d2(n2) { }
+
+    void add(Index i, Index j, T x)
+        // a(i,j) += x
+    {
+        if (i<0 || d1<=i || j<0 || d2<=j) error("Coo_builder::add(): range error");
+        row.push_back(i);
+        col.push_back(j);
+        val.push_back(x);
+    }
+
+    void reserve(Index n) { row.reserve(n); col.reserve(n); val.reserve(n); }
+
+    Index dim1() const { return d1; }
+    Index dim2() const { return d2; }
+    Index entries() const { return Index(val.size()); }    // duplicates counted
+
+    const std::vector<Index>& rows() const { return row; }
+    const std::vector<Index>& columns() const { return col; }
+    const std::vector<T>& values() const { return val; }
+private:
+    Index d1, d2;
+    std::vector<Index> row;
+    std::vector<Index> col;
+    std::vector<T> val;
+};
+
+//-----------------------------------------------------------------------------
+
+enum Sparse_layout { csr, csc };    // compressed by rows, compressed by columns
+
+template<class T = double> class Sparse_matrix {
+    // the nonzeros of line k (a row for csr, a column for csc) are
+    // values()[starts()[k]:starts()[k+1]), at the positions in indices(),
+    // which are increasing within a line
+    // multiplication by a vector runs on the thread pool for csr; convert a
+    // csc matrix with to_csr() if it is to be multiplied many times
+public:
+    explicit Sparse_matrix(const Coo_builder<T>& b, Sparse_layout l = csr);
+
+    Index dim1() const { return d1; }
+    Index dim2() const { return d2; }
+    Index nonzeros() const { return Index(val.size()); }
+    Sparse_layout layout() const { return lay; }
+
+    const std::vector<Index>& starts() const { return start; }
+    const std::vector<Index>& indices() const { return idx; }
+    const std::vector<T>& values() const { return val; }
+    std::vector<T>& values() { return val; }    // the pattern is fixed, the values are not
+
+    T operator()(Index i, Index j) const;    // a(i,j), zero if not stored
+    Index find(Index i, Index j) const;      // the position of a(i,j) in values(), or -1
+
+    Sparse_matrix to_csr() const { return lay==csr ? *this : transposed_layout(); }
+    Sparse_matrix to_csc() const { return lay==csc ? *this : transposed_layout(); }
+
+    void multiply(const T* x, T* y, Thread_pool& pool = default_thread_pool()) const;    // y = Ax
+private:
+    Sparse_matrix(Index n1, Index n2, Sparse_layout l) :d1(n1), d2(n2), lay(l) { }
+    Sparse_matrix transposed_layout() const;
+
+    Index d1, d2;
+    Sparse_layout lay;
+    std::vector<Index> start;    // lines()+1 elements
+    std::vector<Index> idx;
+    std::vector<T> val;
+
+    Index lines() const { return lay==csr ? d1 : d2; }
+};
+
+//-----------------------------------------------------------------------------
+
+template<class T> Sparse_matrix<T>::Sparse_matrix(const Coo_builder<T>& b, Sparse_layout l)
+    :d1(b.dim1()), d2(b.dim2()), lay(l)
+    // bucket the entries by line (a counting sort), then sort each line
+    // by position and add up duplicates
+{
+    const std::vector<Index>& major = lay==csr ? b.rows() : b.columns();
+    const std::vector<Index>& minor = lay==csr ? b.columns() : b.rows();
+    const Index n = lines();
+    const Index ne = b.entries();
+
+    std::vector<Index> pos(n+1,0);
+    for (Index e = 0; e<ne; ++e) ++pos[major[e]+1];
+    for (Index k = 0; k<n; ++k) pos[k+1] += pos[k];
+
+    std::vector<std::pair<Index,T> > ent(ne);
+    std::vector<Index> next(pos.begin(),pos.end()-1);
+    for (Index e = 0; e<ne; ++e)
+        ent[next[major[e]]++] = std::make_pair(minor[e],b.values()[e]);
+
+    start.reserve(n+1);
+    idx.reserve(ne);
+    val.reserve(ne);
+    start.push_back(0);
+    for (Index k = 0; k<n; ++k) {
+        typename std::vector<std::pair<Index,T> >::iterator first = ent.begin()+pos[k];
+        typename std::vector<std::pair<Index,T> >::iterator last = ent.begin()+pos[k+1];
+        std::stable_sort(first,last,[](const std::pair<Index,T>& x, const std::pair<Index,T>& y) { return x.first<y.first; });
+        for (; first!=last; ++first) {
+            if (Index(idx.size())>start.back() && idx.back()==first->first)
+                val.back() += first->second;
+            else {
+                idx.push_back(first->first);
+                val.push_back(first->second);
+            }
+        }
+        start.push_back(Index(idx.size()));
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+template<class T> Sparse_matrix<T> Sparse_matrix<T>::transposed_layout() const
+    // the same matrix, compressed the other way
+{
+    Sparse_matrix<T> t(d1,d2,lay==csr ? csc : csr);
+    const Index n = lines();
+    const Index m = t.lines();
+
+    t.start.assign(m+1,0);
+    for (Index p = 0; p<nonzeros(); ++p) ++t.start[idx[p]+1];
+    for (Index k = 0; k<m; ++k) t.start[k+1] += t.start[k];
+
+    t.idx.resize(nonzeros());
+    t.val.resize(nonzeros());
+    std::vector<Index> next(t.start.begin(),t.start.end()-1);
+    for (Index k = 0; k<n; ++k)    // in order of k, so t's lines come out sorted
+        for (Index p = start[k]; p<start[k+1]; ++p) {
+            const Index q = next[idx[p]]++;
+            t.idx[q] = k;
+            t.val[q] = val[p];
+        }
+    return t;
+}
+
+//-----------------------------------------------------------------------------
+
+template<class T> Index Sparse_matrix<T>::find(Index i, Index j) const
+{
+    if (i<0 || d1<=i || j<0 || d2<=j) error("Sparse_matrix: range error");
+    const Index k = lay==csr ? i : j;
+    const Index x = lay==csr ? j : i;
+    const Index* first = idx.empty() ? 0 : &idx[0];
+    const Index* p = std::lower_bound(first+start[k],first+start[k+1],x);
+    return p!=first+start[k+1] && *p==x ? Index(p-first) : -1;
+}
+
+template<class T> T Sparse_matrix<T>::operator()(Index i, Index j) const
+{
+    const Index p = find(i,j);
+    return p<0 ? T() : val[p];
+}
+
+//-----------------------------------------------------------------------------
+
+template<class T> void Sparse_matrix<T>::multiply(const T* x, T* y, Thread_pool& pool) const
+    // y = Ax; x and y must not overlap
+{
+    const Index* st = &start[0];
+    const Index* ix = idx.empty() ? 0 : &idx[0];
+    const T* v = val.empty() ? 0 : &val[0];
+
+    if (lay==csc) {    // scatter, column by column
+        std::fill(y,y+d1,T());
+        for (Index j = 0; j<d2; ++j) {
+            const T xj = x[j];
+            for (Index p = st[j]; p<st[j+1]; ++p) y[ix[p]] += v[p]*xj;
+        }
+        return;
+    }
+
+    // each row is a dot product of its own; rows are given out in chunks of
+    // some thousands of nonzeros, so small matrices are done by the caller alone
+    const Index per_row = std::max(Index(1),nonzeros()/std::max(Index(1),d1));
+    pool.parallel_for(0,d1,std::max(Index(1),Index(16384)/per_row),[=](Index lo, Index hi) {
+        for (Index i = lo; i<hi; ++i) {
+            T s = T();
+            for (Index p = st[i]; p<st[i+1]; ++p) s += v[p]*x[ix[p]];
+            y[i] = s;
+        }
+    });
+}
+
+//-----------------------------------------------------------------------------
+
+template<class T, class C, class A> Matrix<T,1,C,A> operator*(const Sparse_matrix<T>& a, const Matrix<T,1,C,A>& x)
+{
+    if (a.dim2()!=x.size()) error("Sparse_matrix*vector: wrong sizes");
+    Matrix<T,1,C,A> y(a.dim1(),uninitialized,x.get_allocator());
+    a.multiply(x.data(),y.data());
+    return y;
+}
+
+//-----------------------------------------------------------------------------
+
+// Preconditioners for conjugate_gradient(): z = inverse(M)*r for some M
+// that is close to A, but easy to solve for:
+
+template<class T = double> class Identity_preconditioner {
+    // M = I: plain conjugate gradients
+public:
+    void operator()(const T* r, T* z, Index n) const { std::copy(r,r+n,z); }
+};
+
+template<class T = double> class Jacobi_preconditioner {
+    // M = diagonal of A
+public:
+    explicit Jacobi_preconditioner(const Sparse_matrix<T>& a)
+        :inv(a.dim1())
+    {
+        if (a.dim1()!=a.dim2()) error("Jacobi_preconditioner: matrix not square");
+        for (Index i = 0; i<a.dim1(); ++i) {
+            const T d = a(i,i);
+            if (d==T()) error("Jacobi_preconditioner: zero on the diagonal");
+            inv[i] = T(1)/d;
+        }
+    }
+
+    void operator()(const T* r, T* z, Index n) const
+    {
+        for (Index i = 0; i<n; ++i) z[i] = inv[i]*r[i];
+    }
+private:
+    std::vector<T> inv;
+};
+
+template<class T = double> class Ilu0_preconditioner {
+    // M = LU, the incomplete LU factorization of A with no fill-in: L and U
+    // have nonzeros only where A has them
+public:
+    explicit Ilu0_preconditioner(const Sparse_matrix<T>& a);
+
+    void operator()(const T* r, T* z, Index n) const;
+private:
+    Sparse_matrix<T> lu;         // L (unit diagonal not stored) and U in the pattern of A
+    std::vector<Index> diag;     // position of lu(i,i) in lu.values()
+};
+
+template<class T> Ilu0_preconditioner<T>::Ilu0_preconditioner(const Sparse_matrix<T>& a)
+    :lu(a.to_csr()), diag(a.dim1())
+{
+    const Index n = lu.dim1();
+    if (n!=lu.dim2()) error("Ilu0_preconditioner: matrix not square");
+    const std::vector<Index>& st = lu.starts();
+    const std::vector<Index>& ix = lu.indices();
+    std::vector<T>& v = lu.values();
+
+    for (Index i = 0; i<n; ++i) {
+        diag[i] = lu.find(i,i);
+        if (diag[i]<0) error("Ilu0_preconditioner: zero on the diagonal");
+    }
+
+    std::vector<Index> where(n,-1);    // where[j]: position of (i,j) in row i, or -1
+    for (Index i = 0; i<n; ++i) {
+        for (Index p = st[i]; p<st[i+1]; ++p) where[ix[p]] = p;
+        for (Index p = st[i]; p<st[i+1] && ix[p]<i; ++p) {    // row i -= l(i,k) * row k, for k<i
+            const Index k = ix[p];
+            const T l = v[p] /= v[diag[k]];
+            for (Index q = diag[k]+1; q<st[k+1]; ++q)
+                if (where[ix[q]]>=0) v[where[ix[q]]] -= l*v[q];
+        }
+        if (v[diag[i]]==T()) error("Ilu0_preconditioner: zero pivot");
+        for (Index p = st[i]; p<st[i+1]; ++p) where[ix[p]] = -1;
+    }
+}
+
+template<class T> void Ilu0_preconditioner<T>::operator()(const T* r, T* z, Index n) const
+    // solve Ly = r, then Uz = y
+{
+    const std::vector<Index>& st = lu.starts();
+    const std::vector<Index>& ix = lu.indices();
+    const std::vector<T>& v = lu.values();
+
+    for (Index i = 0; i<n; ++i) {
+        T s = r[i];
+        for (Index p = st[i]; p<diag[i]; ++p) s -= v[p]*z[ix[p]];
+        z[i] = s;
+    }
+    for (Index i = n-1; i>=0; --i) {
+        T s = z[i];
+        for (Index p = diag[i]+1; p<st[i+1]; ++p) s -= v[p]*z[ix[p]];
+        z[i] = s/v[diag[i]];
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+template<class T> struct Cg_result {
+    Index iterations;
+    T residual;        // |b-Ax| / |b| at the end
+    bool converged;    // residual <= the tolerance asked for
+};
+
+template<class T, class C, class A, class P>
+Cg_result<T> conjugate_gradient(const Sparse_matrix<T>& a, const Matrix<T,1,C,A>& b, Matrix<T,1,C,A>& x,
+                                const P& precond, T tol = T(1e-10), Index max_iter = 0,
+                                Thread_pool& pool = default_thread_pool())
+    // solve Ax==b for a symmetric positive definite A, starting from the x passed in,
+    // until |b-Ax| <= tol*|b| or max_iter iterations (default: the size of the system)
+{
+    const Index n = b.size();
+    if (a.dim1()!=n || a.dim2()!=n || x.size()!=n) error("conjugate_gradient(): wrong sizes");
+    if (max_iter<=0) max_iter = std::max(n,Index(1));
+
+    Matrix<T,1,C,A> r(n,uninitialized), z(n,uninitialized), p(n,uninitialized), q(n,uninitialized);
+    a.multiply(x.data(),q.data(),pool);
+    r = scale_and_add(q,T(-1),b);    // r = b-Ax
+    precond(r.data(),z.data(),n);
+    p = z;
+
+    Cg_result<T> res;
+    const T bnorm = std::sqrt(dot_product(b,b));
+    const T scale = bnorm>T() ? bnorm : T(1);
+    T rz = dot_product(r,z);
+    res.residual = std::sqrt(dot_product(r,r))/scale;
+    res.iterations = 0;
+
+    while (res.residual>tol && res.iterations<max_iter) {
+        a.multiply(p.data(),q.data(),pool);
+        const T pq = dot_product(p,q);
+        if (pq<=T()) error("conjugate_gradient(): matrix not positive definite");
+        const T alpha = rz/pq;
+        x = scale_and_add(p,alpha,x);
+        r = scale_and_add(q,-alpha,r);
+        precond(r.data(),z.data(),n);
+        const T rz_new = dot_product(r,z);
+        p = scale_and_add(p,rz_new/rz,z);
+        rz = rz_new;
+        res.residual = std::sqrt(dot_product(r,r))/scale;
+        ++res.iterations;
+    }
+    res.converged = res.residual<=tol;
+    return res;
+}
+
+//-----------------------------------------------------------------------------
+
+}
+#endif
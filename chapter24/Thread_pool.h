@@ -0,0 +1,175 @@
+/*
+    Thread_pool: a fixed set of worker threads for the data-parallel
+    algorithms of Numeric_lib (parallel gemm(), LU_factorization, ...)
+*/
+
+#ifndef THREAD_POOL_LIB
+#define THREAD_POOL_LIB
+
+#include<algorithm>
+#include<atomic>
+#include<condition_variable>
+#include<deque>
+#include<exception>
+#include<functional>
+#include<memory>
+#include<mutex>
+#include<thread>
+#include<vector>
+
+namespace Numeric_lib {
+
+//-----------------------------------------------------------------------------
+
+typedef long Index;    // as in Matrix.h
+
+//-----------------------------------------------------------------------------
+
+class Thread_pool {
+    // a fixed number of worker threads that run submitted tasks
+    // parallel_for() cuts an index range into chunks that the workers and the
+    // calling thread take from a shared counter until none is left, so a slow
+    // chunk doesn't hold up the others; the calling thread does work as well,
+    // which makes nested parallel_for()s safe: at worst the caller does all of it
+public:
+    explicit Thread_pool(unsigned n = default_size())
+        :stop(false)
+    {
+        for (unsigned i = 0; i<n; ++i)
+            workers.push_back(std::thread(&Thread_pool::work,this));
+    }
+
+    ~Thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            stop = true;
+        }
+        cv.notify_all();
+        for (size_t i = 0; i<workers.size(); ++i) workers[i].join();
+    }
+
+    unsigned size() const { return unsigned(workers.size()); }    // not counting the caller
+
+    static unsigned default_size()
+        // one worker per hardware thread, the calling thread takes the last one
+    {
+        unsigned n = std::thread::hardware_concurrency();
+        return n>1 ? n-1 : 0;
+    }
+
+    void submit(const std::function<void()>& task)
+    {
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            tasks.push_back(task);
+        }
+        cv.notify_one();
+    }
+
+    template<class F> void parallel_for(Index begin, Index end, Index grain, F f);
+
+private:
+    void work()
+    {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lck(mtx);
+                while (!stop && tasks.empty()) cv.wait(lck);
+                if (tasks.empty()) return;    // stop, and nothing left to do
+                task = tasks.front();
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()> > tasks;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stop;
+
+    Thread_pool(const Thread_pool&);    // no copying of pools
+    void operator=(const Thread_pool&);
+};
+
+//-----------------------------------------------------------------------------
+
+template<class F> struct Parallel_for_state {
+    // shared by the threads working on one parallel_for()
+    F f;
+    Index begin, end, chunk, chunks;
+    std::atomic<Index> next;    // next chunk to hand out
+    std::atomic<Index> done;    // chunks finished
+    std::exception_ptr error;   // the first exception thrown by f
+    std::mutex mtx;
+    std::condition_variable cv;
+
+    Parallel_for_state(F ff, Index b, Index e, Index c)
+        :f(ff), begin(b), end(e), chunk(c), chunks((e-b+c-1)/c), next(0), done(0) { }
+
+    void run()
+        // do chunks until there are none left
+    {
+        for (Index i = next++; i<chunks; i = next++) {
+            const Index lo = begin+i*chunk;
+            try {
+                f(lo,std::min(lo+chunk,end));
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lck(mtx);
+                if (!error) error = std::current_exception();
+            }
+            if (++done==chunks) {
+                std::lock_guard<std::mutex> lck(mtx);
+                cv.notify_all();
+            }
+        }
+    }
+};
+
+template<class F> void Thread_pool::parallel_for(Index begin, Index end, Index grain, F f)
+    // call f(lo,hi) for consecutive chunks [lo,hi) covering [begin,end), each at
+    // least grain long (but the last), and return when all calls are done
+    // an exception thrown by f is rethrown here
+{
+    if (end<=begin) return;
+    if (grain<1) grain = 1;
+
+    // about four chunks per thread gives some room for balancing the load
+    const Index n = end-begin;
+    const Index chunk = std::max(grain,(n+4*(size()+1)-1)/(4*(size()+1)));
+    if (size()==0 || n<=chunk) {
+        f(begin,end);
+        return;
+    }
+
+    std::shared_ptr<Parallel_for_state<F> > st = std::make_shared<Parallel_for_state<F> >(f,begin,end,chunk);
+    const Index helpers = std::min(Index(size()),st->chunks-1);
+    for (Index i = 0; i<helpers; ++i)
+        submit([st] { st->run(); });    // late helpers find nothing left and return
+
+    st->run();
+    {
+        std::unique_lock<std::mutex> lck(st->mtx);
+        while (st->done<st->chunks) st->cv.wait(lck);
+    }
+    if (st->error) std::rethrow_exception(st->error);
+}
+
+//-----------------------------------------------------------------------------
+
+inline Thread_pool& default_thread_pool()
+    // the pool used by Numeric_lib unless another one is passed explicitly
+    // created on first use
+{
+    static Thread_pool pool;
+    return pool;
+}
+
+//-----------------------------------------------------------------------------
+
+}
+#endif
@@ -0,0 +1,100 @@
+// Chapter 24, apply() benchmark: m.apply(f) and m.apply_new(f) against
+// m.apply(par,f) and m.apply_new(par,f) on the default thread pool, for
+// the cheap triple() of exercise 1 and for a function that costs about a
+// hundred floating-point operations per element. Small matrices show the
+// serial fallback: there par should cost next to nothing.
+//
+// Usage: chapter24_bench_apply [number of elements]
+//
+// Build with optimisation, e.g.
+// g++ -std=c++11 -O3 -march=native -pthread chapter24_bench_apply.cpp
+
+#include<chrono>
+#include<cmath>
+#include<cstdlib>
+#include<iomanip>
+#include<iostream>
+#include "Matrix.h"
+
+using namespace std;
+using namespace Numeric_lib;
+
+//------------------------------------------------------------------------------
+
+void triple(double& x) { x *= 3; }
+
+double tripled(double x) { return 3*x; }
+
+void costly(double& x)
+{
+    for (int i = 0; i<10; ++i) x = sin(x)+0.5*cos(x);
+}
+
+double costlier(double x)
+{
+    costly(x);
+    return x;
+}
+
+//------------------------------------------------------------------------------
+
+double seconds_since(chrono::steady_clock::time_point t)
+{
+    return chrono::duration<double>(chrono::steady_clock::now()-t).count();
+}
+
+//------------------------------------------------------------------------------
+
+template<class F, class G> void run(const char* name, Index n, F f, G g, int reps)
+{
+    Matrix<double> m(n,uninitialized);
+    for (Index i = 0; i<n; ++i) m(i) = double(i%100)/100;
+    Matrix<double> m2 = m;
+
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    for (int r = 0; r<reps; ++r) m.apply(f);
+    const double t1 = seconds_since(t)/reps;
+    t = chrono::steady_clock::now();
+    for (int r = 0; r<reps; ++r) m2.apply(par,f);
+    const double t2 = seconds_since(t)/reps;
+    for (Index i = 0; i<n; ++i)
+        if (m(i)!=m2(i)) error("apply(par,f): wrong result");
+
+    t = chrono::steady_clock::now();
+    Matrix<double> r1 = m.apply_new(g);
+    const double t3 = seconds_since(t);
+    t = chrono::steady_clock::now();
+    Matrix<double> r2 = m.apply_new(par,g);
+    const double t4 = seconds_since(t);
+    for (Index i = 0; i<n; ++i)
+        if (r1(i)!=r2(i)) error("apply_new(par,f): wrong result");
+
+    cout << setw(10) << name << setw(12) << n << scientific << setprecision(3)
+        << setw(12) << t1 << setw(12) << t2 << fixed << setprecision(2) << setw(8) << t1/t2
+        << scientific << setprecision(3) << setw(12) << t3 << setw(12) << t4
+        << fixed << setprecision(2) << setw(8) << t3/t4 << '\n';
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+try {
+    const Index n = argc>1 ? atol(argv[1]) : 20000000;
+
+    cout << default_thread_pool().size()+1 << " threads; times in seconds\n"
+        << setw(10) << "f" << setw(12) << "elements" << setw(12) << "apply" << setw(12) << "apply(par)"
+        << setw(8) << "speedup" << setw(12) << "apply_new" << setw(12) << "new(par)" << setw(8) << "speedup" << '\n';
+    run("triple",1000,triple,tripled,1000);
+    run("triple",n,triple,tripled,5);
+    run("costly",1000,costly,costlier,100);
+    run("costly",n/10,costly,costlier,1);
+}
+catch (Matrix_error& e) {
+    cerr << "Matrix error: " << e.name << '\n';
+}
+catch (exception& e) {
+    cerr << "Exception: " << e.what() << '\n';
+}
+catch (...) {
+    cerr << "Exception\n";
+}
@@ -0,0 +1,141 @@
+// Chapter 24, batched solver benchmark: solve many independent n by n systems
+// Ax==b, one at a time with the elimination of exercise 5, and all at once
+// with batched_solve(), which runs the systems side by side in the SIMD lanes
+// and shares them out among the threads. A few systems are made singular to
+// show that they are reported one by one instead of stopping the run.
+//
+// Usage: chapter24_bench_batched [number of systems]
+//
+// Build with optimisation, e.g.
+// g++ -std=c++11 -O3 -march=native -pthread chapter24_bench_batched.cpp
+
+#include<chrono>
+#include<cmath>
+#include<cstdlib>
+#include<iomanip>
+#include<iostream>
+#include "Matrix.h"
+#include "Batched.h"
+
+using namespace std;
+using namespace Numeric_lib;
+
+//------------------------------------------------------------------------------
+
+// from exercise 5
+bool elim_with_partial_pivot(Matrix<double,2>& A, Matrix<double>& b)
+{
+    const Index n = A.dim1();
+
+    for (Index j = 0; j<n; ++j) {
+        Index pivot_row = j;
+
+        for (Index k = j+1; k<n; ++k)
+            if (abs(A(k,j)) > abs(A(pivot_row,j))) pivot_row = k;
+
+        if (pivot_row != j) {
+            A.swap_rows(j,pivot_row);
+            swap(b(j),b(pivot_row));
+        }
+
+        const double pivot = A(j,j);
+        if (pivot==0) return false;    // exercise 5 throws Elim_failure here
+        for (Index i = j+1; i<n; ++i) {
+            const double mult = A(i,j) / pivot;
+            A[i].slice(j) = scale_and_add(A[j].slice(j),-mult,A[i].slice(j));
+            b(i) -= mult * b(j);
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+Matrix<double> back_substitution(const Matrix<double,2>& A, const Matrix<double>& b)
+{
+    const Index n = A.dim1();
+    Matrix<double> x(n);
+
+    for (Index i = n-1; i>=0; --i)
+        x(i) = (b(i) - dot_product(A[i].slice(i+1),x.slice(i+1))) / A(i,i);
+    return x;
+}
+
+//------------------------------------------------------------------------------
+
+double seconds_since(chrono::steady_clock::time_point t)
+{
+    return chrono::duration<double>(chrono::steady_clock::now()-t).count();
+}
+
+//------------------------------------------------------------------------------
+
+void run(Index count, Index n)
+{
+    Matrix<double,3> a(count,n,n,uninitialized);
+    Matrix<double,2> b(count,n,uninitialized);
+    for (Index i = 0; i<a.size(); ++i) a.data()[i] = double(rand())/RAND_MAX - 0.5;
+    for (Index i = 0; i<b.size(); ++i) b.data()[i] = double(rand())/RAND_MAX - 0.5;
+    for (Index k = 0; k<count; k += 1000)    // singular: two equal rows
+        a[k][n-1] = a[k][0];
+
+    Matrix<double,2> x1(count,n);
+    Index failed1 = 0;
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    for (Index k = 0; k<count; ++k) {
+        Matrix<double,2> A(n,n,uninitialized);
+        Matrix<double> bk(n,uninitialized);
+        for (Index e = 0; e<n*n; ++e) A.data()[e] = a[k].data()[e];
+        for (Index i = 0; i<n; ++i) bk(i) = b(k,i);
+        if (elim_with_partial_pivot(A,bk))
+            x1[k] = back_substitution(A,bk);
+        else
+            ++failed1;
+    }
+    const double t1 = seconds_since(t);
+
+    Matrix<double,2> x2 = b;
+    t = chrono::steady_clock::now();
+    vector<Index> status = batched_solve(a,x2);
+    const double t2 = seconds_since(t);
+
+    // check: the solutions agree, and the singular systems are the same ones
+    Index failed2 = 0;
+    double diff = 0;
+    for (Index k = 0; k<count; ++k) {
+        if (status[k]) {
+            ++failed2;
+            continue;
+        }
+        for (Index i = 0; i<n; ++i) diff = max(diff,abs(x1(k,i)-x2(k,i))/(1+abs(x1(k,i))));
+    }
+    if (failed1!=failed2) error("different numbers of singular systems");
+    if (diff>1e-6) error("solutions differ");
+
+    cout << setw(4) << n << setw(10) << count
+        << setw(12) << fixed << setprecision(4) << t1 << setw(12) << t2
+        << setw(10) << setprecision(1) << t1/t2
+        << setw(10) << failed2 << '\n';
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+try {
+    const Index count = argc>1 ? atol(argv[1]) : 20000;
+    cout << default_thread_pool().size()+1 << " threads, " << batch_lanes << " lanes, seconds\n"
+        << setw(4) << "n" << setw(10) << "systems" << setw(12) << "one by one" << setw(12) << "batched"
+        << setw(10) << "speedup" << setw(10) << "singular" << '\n';
+    const Index sizes[] = { 8, 16, 32, 64 };
+    for (Index n : sizes)
+        run(max(Index(1000),count*8/n),n);
+}
+catch (Matrix_error& e) {
+    cerr << "Matrix error: " << e.name << '\n';
+}
+catch (exception& e) {
+    cerr << "Exception: " << e.what() << '\n';
+}
+catch (...) {
+    cerr << "Exception\n";
+}
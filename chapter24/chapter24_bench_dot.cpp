@@ -0,0 +1,120 @@
+// Chapter 24, dot_product() and scale_and_add() benchmark: the plain loops
+// they used to be, against the SIMD kernels of Simd.h at every level the
+// processor supports, and dot_product_compensated() for its cost and its
+// accuracy on a sum that nearly cancels.
+//
+// Usage: chapter24_bench_dot [repetitions]
+//
+// Build with optimisation, e.g.
+// g++ -std=c++11 -O3 -pthread chapter24_bench_dot.cpp
+// (no -march: the kernels are picked at run time, the plain loops get SSE2 at best)
+
+#include<chrono>
+#include<cmath>
+#include<cstdlib>
+#include<iomanip>
+#include<iostream>
+#include "Matrix.h"
+
+using namespace std;
+using namespace Numeric_lib;
+
+//------------------------------------------------------------------------------
+
+// the loops dot_product() and scale_and_add() used to run:
+
+double old_dot_product(const Matrix<double>& a, const Matrix<double>& b)
+{
+    const double* pa = a.data();
+    const double* pb = b.data();
+    double sum = 0;
+    for (Index i = 0; i<a.size(); ++i) sum += pa[i]*pb[i];
+    return sum;
+}
+
+void old_scale_and_add(const Matrix<double>& a, double c, const Matrix<double>& b, Matrix<double>& res)
+{
+    const double* pa = a.data();
+    const double* pb = b.data();
+    double* pr = res.data();
+    for (Index i = 0; i<res.size(); ++i) pr[i] = pa[i]*c+pb[i];
+}
+
+//------------------------------------------------------------------------------
+
+double seconds_since(chrono::steady_clock::time_point t)
+{
+    return chrono::duration<double>(chrono::steady_clock::now()-t).count();
+}
+
+volatile double sink;
+
+template<class F> double gflops(Index n, long reps, F f)
+{
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    for (long r = 0; r<reps; ++r) f();
+    return 2.0*n*reps/seconds_since(t)/1e9;
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+try {
+    const double work = argc>1 ? atof(argv[1]) : 2e8;    // elements processed per measurement
+    const Simd_level best = supported_simd_level();
+
+    cout << "GFLOP/s; the processor supports " << simd_name(best) << "\n\n"
+        << setw(10) << "n" << setw(12) << "kernel" << setw(10) << "dot" << setw(10) << "saxpy" << '\n';
+
+    for (Index n = 1024; n<=(1<<22); n *= 16) {
+        Matrix<double> a(n,uninitialized), b(n,uninitialized), r(n);
+        for (Index i = 0; i<n; ++i) {
+            a(i) = double(rand())/RAND_MAX;
+            b(i) = double(rand())/RAND_MAX;
+        }
+        const long reps = max(1L,long(work/n));
+
+        cout << fixed << setprecision(2);
+        cout << setw(10) << n << setw(12) << "old loop"
+            << setw(10) << gflops(n,reps,[&] { sink = old_dot_product(a,b); })
+            << setw(10) << gflops(n,reps,[&] { old_scale_and_add(a,1.0001,b,r); }) << '\n';
+        for (int l = simd_scalar; l<=best; ++l) {
+            set_simd_level(Simd_level(l));
+            cout << setw(10) << n << setw(12) << simd_name(Simd_level(l))
+                << setw(10) << gflops(n,reps,[&] { sink = dot_product(a,b); })
+                << setw(10) << gflops(n,reps,[&] { r = scale_and_add(a,1.0001,b); }) << '\n';
+        }
+        set_simd_level(best);
+        cout << setw(10) << n << setw(12) << "compensated"
+            << setw(10) << gflops(n,reps,[&] { sink = dot_product_compensated(a,b); }) << "\n\n";
+    }
+
+    // x.y where pairs of products of about 1e26 cancel exactly, leaving the
+    // small integer products at the end: the exact result is their sum
+    const Index n = 1000;
+    Matrix<double> x(3*n), y(3*n);
+    double exact = 0;
+    for (Index i = 0; i<n; ++i) {
+        x(i) = 1e10*(1+rand()%1000);
+        y(i) = 1e10*(1+rand()%1000);
+        x(n+i) = -x(i);
+        y(n+i) = y(i);
+        x(2*n+i) = i%7;
+        y(2*n+i) = 1;
+        exact += i%7;
+    }
+    cout << scientific << setprecision(6)
+        << "nearly cancelling sum: exact " << exact
+        << ", dot_product " << dot_product(x,y)
+        << ", old loop " << old_dot_product(x,y)
+        << ", compensated " << dot_product_compensated(x,y) << '\n';
+}
+catch (Matrix_error& e) {
+    cerr << "Matrix error: " << e.name << '\n';
+}
+catch (exception& e) {
+    cerr << "Exception: " << e.what() << '\n';
+}
+catch (...) {
+    cerr << "Exception\n";
+}
@@ -0,0 +1,178 @@
+// Chapter 24, GEMM benchmark: compare the blocked matrix-matrix and
+// matrix-vector multiplication from Matrix.h with the straightforward loops
+// through range-checked operator() used in exercise 12.
+//
+// Usage: chapter24_bench_gemm [n1 n2 ...]
+// Without arguments, square matrices of dimension 128 to 2048 are used. The
+// naive matrix-matrix loop is skipped above 1024, as it takes minutes.
+//
+// Build with optimisation and, if the CPU has it, AVX2/FMA, e.g.
+// g++ -std=c++11 -O3 -march=native chapter24_bench_gemm.cpp
+
+#include<chrono>
+#include<cmath>
+#include<cstdlib>
+#include<iomanip>
+#include<iostream>
+#include<vector>
+#include "Matrix.h"
+
+using namespace std;
+using namespace Numeric_lib;
+
+//------------------------------------------------------------------------------
+
+// the loop from exercise 12, made to work for non-square matrices
+Matrix<double> naive_mul(const Matrix<double,2>& m, const Matrix<double>& v)
+{
+    Matrix<double> res(m.dim1());
+    for (Index i = 0; i<m.dim1(); ++i)
+        res(i) = dot_product(m[i],v);
+    return res;
+}
+
+//------------------------------------------------------------------------------
+
+Matrix<double,2> naive_mul(const Matrix<double,2>& a, const Matrix<double,2>& b)
+{
+    Matrix<double,2> res(a.dim1(),b.dim2());
+    for (Index i = 0; i<a.dim1(); ++i)
+        for (Index j = 0; j<b.dim2(); ++j) {
+            double sum = 0;
+            for (Index k = 0; k<a.dim2(); ++k)
+                sum += a(i,k)*b(k,j);
+            res(i,j) = sum;
+        }
+    return res;
+}
+
+//------------------------------------------------------------------------------
+
+void fill_random(double* p, Index n)
+{
+    for (Index i = 0; i<n; ++i)
+        p[i] = double(rand())/RAND_MAX - 0.5;
+}
+
+//------------------------------------------------------------------------------
+
+double max_diff(const double* a, const double* b, Index n)
+{
+    double d = 0;
+    for (Index i = 0; i<n; ++i)
+        d = max(d,abs(a[i]-b[i]));
+    return d;
+}
+
+//------------------------------------------------------------------------------
+
+// run f until at least min_time seconds have passed, return seconds per run
+template<class F> double time_it(F f, double min_time = 0.5)
+{
+    typedef chrono::steady_clock Clock;
+    int runs = 0;
+    Clock::time_point t1 = Clock::now();
+    double elapsed = 0;
+    do {
+        f();
+        ++runs;
+        elapsed = chrono::duration<double>(Clock::now()-t1).count();
+    } while (elapsed<min_time);
+    return elapsed/runs;
+}
+
+//------------------------------------------------------------------------------
+
+struct Gemv_naive {
+    const Matrix<double,2>& a; const Matrix<double>& x; Matrix<double>& y;
+    void operator()() { y = naive_mul(a,x); }
+};
+
+struct Gemv_fast {
+    const Matrix<double,2>& a; const Matrix<double>& x; Matrix<double>& y;
+    void operator()() { y = a*x; }
+};
+
+struct Gemm_naive {
+    const Matrix<double,2>& a; const Matrix<double,2>& b; Matrix<double,2>& c;
+    void operator()() { c = naive_mul(a,b); }
+};
+
+struct Gemm_fast {
+    const Matrix<double,2>& a; const Matrix<double,2>& b; Matrix<double,2>& c;
+    void operator()() { c = a*b; }
+};
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+try {
+    vector<Index> dims;
+    for (int i = 1; i<argc; ++i) dims.push_back(atol(argv[i]));
+    if (dims.empty()) {
+        Index d[] = { 128, 256, 512, 1024, 2048 };
+        dims.assign(d,d+sizeof(d)/sizeof(*d));
+    }
+
+    cout << "micro-kernel: " << (gemm_micro_kernel_for((double*)0)==gemm_micro_kernel<double> ? "portable" : "AVX2/FMA") << '\n';
+
+    cout << "\nmatrix-vector (GFLOP/s)\n"
+        << setw(8) << "n" << setw(12) << "naive" << setw(12) << "gemv"
+        << setw(10) << "speedup" << setw(12) << "max diff\n";
+    for (size_t i = 0; i<dims.size(); ++i) {
+        const Index n = dims[i];
+        Matrix<double,2> a(n,n);
+        Matrix<double> x(n);
+        Matrix<double> y1(n);
+        Matrix<double> y2(n);
+        fill_random(a.data(),a.size());
+        fill_random(x.data(),x.size());
+
+        const double flop = 2.0*n*n;
+        Gemv_naive f1 = { a, x, y1 };
+        Gemv_fast f2 = { a, x, y2 };
+        const double t1 = time_it(f1);
+        const double t2 = time_it(f2);
+        cout << setw(8) << n << fixed << setprecision(2)
+            << setw(12) << flop/t1*1e-9 << setw(12) << flop/t2*1e-9
+            << setw(10) << t1/t2 << setw(12) << scientific << setprecision(1)
+            << max_diff(y1.data(),y2.data(),n) << '\n';
+    }
+
+    cout << "\nmatrix-matrix (GFLOP/s)\n"
+        << setw(8) << "n" << setw(12) << "naive" << setw(12) << "gemm"
+        << setw(10) << "speedup" << setw(12) << "max diff\n";
+    for (size_t i = 0; i<dims.size(); ++i) {
+        const Index n = dims[i];
+        Matrix<double,2> a(n,n);
+        Matrix<double,2> b(n,n);
+        Matrix<double,2> c1(n,n);
+        Matrix<double,2> c2(n,n);
+        fill_random(a.data(),a.size());
+        fill_random(b.data(),b.size());
+
+        const double flop = 2.0*n*n*n;
+        Gemm_fast f2 = { a, b, c2 };
+        const double t2 = time_it(f2);
+        cout << setw(8) << n << fixed << setprecision(2);
+        if (n<=1024) {
+            Gemm_naive f1 = { a, b, c1 };
+            const double t1 = time_it(f1);
+            cout << setw(12) << flop/t1*1e-9 << setw(12) << flop/t2*1e-9
+                << setw(10) << t1/t2 << setw(12) << scientific << setprecision(1)
+                << max_diff(c1.data(),c2.data(),n*n) << '\n';
+        }
+        else {
+            cout << setw(12) << "-" << setw(12) << flop/t2*1e-9 << '\n';
+        }
+    }
+}
+catch (Matrix_error& e) {
+    cerr << "Matrix error: " << e.name << '\n';
+}
+catch (exception& e) {
+    cerr << "Exception: " << e.what() << '\n';
+}
+catch (...) {
+    cerr << "Exception\n";
+}
@@ -0,0 +1,173 @@
+// Chapter 24, LU benchmark: solve many systems Ax==b that share the same A,
+// once by Gaussian elimination with partial pivoting for every b (as in
+// exercise 5) and once by factoring A with LU_factorization and reusing the
+// factors for every b.
+//
+// Usage: chapter24_bench_lu [n [number of right-hand sides]]
+//
+// Build with optimisation, e.g.
+// g++ -std=c++11 -O3 -march=native -pthread chapter24_bench_lu.cpp
+
+#include<chrono>
+#include<cmath>
+#include<cstdlib>
+#include<iomanip>
+#include<iostream>
+#include "Matrix.h"
+#include "LU.h"
+
+using namespace std;
+using Numeric_lib::Index;
+using Numeric_lib::LU_factorization;
+using Numeric_lib::Matrix_error;
+using Numeric_lib::default_thread_pool;
+using Numeric_lib::dot_product;
+using Numeric_lib::error;
+using Numeric_lib::scale_and_add;
+
+typedef Numeric_lib::Matrix<double,2> Matrix;
+typedef Numeric_lib::Matrix<double,1> Vector;
+
+//------------------------------------------------------------------------------
+
+// from exercise 5
+void elim_with_partial_pivot(Matrix& A, Vector& b)
+{
+    const Index n = A.dim1();
+
+    for (Index j = 0; j<n; ++j) {
+        Index pivot_row = j;
+
+        for (Index k = j+1; k<n; ++k)
+            if (abs(A(k,j)) > abs(A(pivot_row,j))) pivot_row = k;
+
+        if (pivot_row != j) {
+            A.swap_rows(j,pivot_row);
+            swap(b(j),b(pivot_row));
+        }
+
+        for (Index i = j+1; i<n; ++i) {
+            const double pivot = A(j,j);
+            if (pivot==0) error("can't solve: pivot==0");
+            const double mult = A(i,j) / pivot;
+            A[i].slice(j) = scale_and_add(A[j].slice(j),-mult,A[i].slice(j));
+            b(i) -= mult * b(j);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+Vector back_substitution(const Matrix& A, const Vector& b)
+{
+    const Index n = A.dim1();
+    Vector x(n);
+
+    for (Index i = n-1; i>=0; --i) {
+        double s = b(i) - dot_product(A[i].slice(i+1),x.slice(i+1));
+        if (double m = A(i,i))
+            x(i) = s / m;
+        else
+            error("back substitution failure");
+    }
+    return x;
+}
+
+//------------------------------------------------------------------------------
+
+Vector gaussian_elimination_w_pivot(Matrix A, Vector b)
+{
+    elim_with_partial_pivot(A,b);
+    return back_substitution(A,b);
+}
+
+//------------------------------------------------------------------------------
+
+double seconds_since(chrono::steady_clock::time_point t)
+{
+    return chrono::duration<double>(chrono::steady_clock::now()-t).count();
+}
+
+//------------------------------------------------------------------------------
+
+// largest |Ax-b|
+double residual(const Matrix& A, const Vector& x, const Vector& b)
+{
+    Vector r = A*x;
+    double m = 0;
+    for (Index i = 0; i<r.size(); ++i)
+        m = max(m,abs(r(i)-b(i)));
+    return m;
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+try {
+    const Index n = argc>1 ? atol(argv[1]) : 1000;
+    const Index nrhs = argc>2 ? atol(argv[2]) : 100;
+
+    Matrix A(n,n);
+    for (Index i = 0; i<A.size(); ++i)
+        A.data()[i] = double(rand())/RAND_MAX - 0.5;
+    Matrix B(n,nrhs);
+    for (Index i = 0; i<B.size(); ++i)
+        B.data()[i] = double(rand())/RAND_MAX - 0.5;
+
+    cout << "n = " << n << ", " << nrhs << " right-hand sides, "
+        << default_thread_pool().size()+1 << " threads\n\n" << fixed;
+
+    // Gaussian elimination for each b; timed for a few and extrapolated
+    const Index runs = min(nrhs,Index(3));
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    double res = 0;
+    for (Index j = 0; j<runs; ++j) {
+        Vector b(n);
+        for (Index i = 0; i<n; ++i) b(i) = B(i,j);
+        res = max(res,residual(A,gaussian_elimination_w_pivot(A,b),b));
+    }
+    const double t_gauss = seconds_since(t)/runs;
+    cout << "elimination per b:    " << setw(10) << setprecision(4) << t_gauss
+        << " s, all b: " << setw(10) << t_gauss*nrhs << " s (estimated)"
+        << ", max residual " << scientific << setprecision(1) << res << fixed << '\n';
+
+    t = chrono::steady_clock::now();
+    LU_factorization<> lu(A);
+    const double t_factor = seconds_since(t);
+    cout << "LU factorization:     " << setw(10) << setprecision(4) << t_factor
+        << " s, " << setprecision(2) << 2.0/3*n*n*n/t_factor*1e-9 << " GFLOP/s\n";
+
+    double t_solve = 0;
+    res = 0;
+    for (Index j = 0; j<nrhs; ++j) {
+        Vector b(n);
+        for (Index i = 0; i<n; ++i) b(i) = B(i,j);
+        t = chrono::steady_clock::now();
+        Vector x = lu.solve(b);
+        t_solve += seconds_since(t);
+        res = max(res,residual(A,x,b));
+    }
+    t_solve /= nrhs;
+    cout << "LU solve per b:       " << setw(10) << setprecision(6) << t_solve
+        << " s, all b: " << setw(10) << setprecision(4) << t_factor+t_solve*nrhs << " s"
+        << ", max residual " << scientific << setprecision(1) << res << fixed << '\n';
+
+    t = chrono::steady_clock::now();
+    Matrix X = lu.solve(B);
+    const double t_block = seconds_since(t);
+    Matrix R = A*X;
+    res = 0;
+    for (Index i = 0; i<R.size(); ++i)
+        res = max(res,abs(R.data()[i]-B.data()[i]));
+    cout << "LU solve of all B:    " << setw(10) << setprecision(4) << t_block
+        << " s, max residual " << scientific << setprecision(1) << res << '\n';
+}
+catch (Matrix_error& e) {
+    cerr << "Matrix error: " << e.name << '\n';
+}
+catch (exception& e) {
+    cerr << "Exception: " << e.what() << '\n';
+}
+catch (...) {
+    cerr << "Exception\n";
+}
@@ -0,0 +1,112 @@
+// Chapter 24, Matrix file benchmark: load an n by n Matrix<double,2> from
+// the { ... } text format of MatrixIO.h and from a binary Matrix file, both by
+// reading it all and by mapping it, and write one row block by row block.
+//
+// Usage: chapter24_bench_matrix_file [n [directory for the files]]
+//
+// Build with optimisation, e.g.
+// g++ -std=c++11 -O3 chapter24_bench_matrix_file.cpp
+
+#include<chrono>
+#include<cstdio>
+#include<cstdlib>
+#include<fstream>
+#include<iomanip>
+#include<iostream>
+#include<string>
+
+using namespace std;
+
+#include "Matrix.h"
+#include "MatrixIO.h"
+#include "Matrix_file.h"
+
+using namespace Numeric_lib;
+
+//------------------------------------------------------------------------------
+
+double seconds_since(chrono::steady_clock::time_point t)
+{
+    return chrono::duration<double>(chrono::steady_clock::now()-t).count();
+}
+
+//------------------------------------------------------------------------------
+
+template<class C> double sum(const Matrix<double,2,C>& m)
+{
+    double s = 0;
+    for (Index i = 0; i<m.size(); ++i) s += m.data()[i];
+    return s;
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+try {
+    const Index n = argc>1 ? atol(argv[1]) : 2000;
+    const string dir = argc>2 ? argv[2] : ".";
+    const string text_name = dir + "/bench_matrix.txt";
+    const string bin_name = dir + "/bench_matrix.nlm";
+
+    Matrix<double,2> m(n,n,uninitialized);
+    for (Index i = 0; i<m.size(); ++i)
+        m.data()[i] = rand()%1000 / 10.0;    // survives the three digits of operator<<
+    const double s = sum(m);
+
+    cout << n << " by " << n << " Matrix<double,2>, "
+        << fixed << setprecision(1) << n*n*8/1e6 << " MB of elements\n\n" << setprecision(4);
+
+    {
+        ofstream os(text_name.c_str());
+        os << m;
+    }
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    write_matrix_file(bin_name,m);
+    cout << "binary write:             " << setw(10) << seconds_since(t) << " s\n";
+
+    t = chrono::steady_clock::now();
+    {
+        const Index rows = 64;    // as if the Matrix were too big to be in memory
+        Matrix_file_writer<double,2> w(bin_name,n,n);
+        for (Index i = 0; i<n; i += rows)
+            w.append(m.data()+i*n,min(rows,n-i)*n);
+        w.close();
+    }
+    cout << "binary write by blocks:   " << setw(10) << seconds_since(t) << " s\n";
+
+    t = chrono::steady_clock::now();
+    {
+        Matrix<double,2> m2(n,n);
+        ifstream is(text_name.c_str());
+        is >> m2;
+        if (sum(m2)!=s) error("text load: wrong sum");
+    }
+    cout << "text load (operator>>):   " << setw(10) << seconds_since(t) << " s\n";
+
+    t = chrono::steady_clock::now();
+    {
+        Matrix<double,2> m2 = read_matrix_file<double,2>(bin_name);
+        if (sum(m2)!=s) error("binary load: wrong sum");
+    }
+    cout << "binary load:              " << setw(10) << seconds_since(t) << " s\n";
+
+    t = chrono::steady_clock::now();
+    {
+        Mapped_matrix<double,2> mm(bin_name);
+        cout << "mapped open:              " << setw(10) << seconds_since(t) << " s\n";
+        if (sum(mm.matrix())!=s) error("mapped: wrong sum");
+        cout << "mapped open and sum:      " << setw(10) << seconds_since(t) << " s\n";
+    }
+
+    remove(text_name.c_str());
+    remove(bin_name.c_str());
+}
+catch (Matrix_error& e) {
+    cerr << "Matrix error: " << e.name << '\n';
+}
+catch (exception& e) {
+    cerr << "Exception: " << e.what() << '\n';
+}
+catch (...) {
+    cerr << "Exception\n";
+}
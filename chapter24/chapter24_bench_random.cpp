@@ -0,0 +1,91 @@
+// Chapter 24, random number benchmark: filling a Matrix the way exercise 10
+// and chapter 26 did, with rand()%max one element at a time, against
+// fill_uniform() and fill_normal() of Random.h, serially and on the default
+// thread pool. The parallel fills must give the very same numbers as the
+// serial ones, whatever the number of threads; that is checked as well.
+//
+// Usage: chapter24_bench_random [number of elements]
+//
+// Build with optimisation, e.g.
+// g++ -std=c++11 -O3 -march=native -pthread chapter24_bench_random.cpp
+
+#include<chrono>
+#include<cmath>
+#include<cstdlib>
+#include<iomanip>
+#include<iostream>
+#include "Random.h"
+
+using namespace std;
+using namespace Numeric_lib;
+
+//------------------------------------------------------------------------------
+
+inline int randint(int max) { return rand()%max; }
+
+inline int randint(int min, int max) { return randint(max-min)+min; }
+
+//------------------------------------------------------------------------------
+
+double seconds_since(chrono::steady_clock::time_point t)
+{
+    return chrono::duration<double>(chrono::steady_clock::now()-t).count();
+}
+
+template<class F> double time_it(F f)
+{
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    f();
+    return seconds_since(t);
+}
+
+bool same(const Matrix<double>& a, const Matrix<double>& b)
+{
+    for (Index i = 0; i<a.size(); ++i)
+        if (a(i)!=b(i)) return false;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+try {
+    const Index n = argc>1 ? atol(argv[1]) : 20000000;
+    Matrix<double> a(n), b(n);    // zeroed, so that no fill pays for page faults
+
+    cout << n << " elements, " << default_thread_pool().size()+1 << " threads\n"
+        << fixed << setprecision(1);
+
+    const double t_rand = time_it([&] { for (Index i = 0; i<n; ++i) a(i) = randint(-10,10); });
+    cout << setw(26) << "rand()%max loop: " << setw(8) << n/t_rand/1e6 << " M/s\n";
+
+    const double t_u = time_it([&] { fill_uniform(a,-10.0,10.0,42); });
+    const double t_up = time_it([&] { fill_uniform(par,b,-10.0,10.0,42); });
+    cout << setw(26) << "fill_uniform: " << setw(8) << n/t_u/1e6 << " M/s\n"
+        << setw(26) << "fill_uniform(par): " << setw(8) << n/t_up/1e6 << " M/s"
+        << (same(a,b) ? "" : "   DIFFERENT from serial!") << '\n';
+
+    const double t_n = time_it([&] { fill_normal(a,0.0,1.0,42); });
+    const double t_np = time_it([&] { fill_normal(par,b,0.0,1.0,42); });
+    cout << setw(26) << "fill_normal: " << setw(8) << n/t_n/1e6 << " M/s\n"
+        << setw(26) << "fill_normal(par): " << setw(8) << n/t_np/1e6 << " M/s"
+        << (same(a,b) ? "" : "   DIFFERENT from serial!") << '\n';
+
+    double sum = 0, sum2 = 0;
+    for (Index i = 0; i<n; ++i) {
+        sum += b(i);
+        sum2 += b(i)*b(i);
+    }
+    const double mean = sum/n;
+    cout << setprecision(5) << "normal: mean " << mean << ", standard deviation "
+        << sqrt(sum2/n-mean*mean) << " (expect 0 and 1)\n";
+}
+catch (Matrix_error& e) {
+    cerr << "Matrix error: " << e.name << '\n';
+}
+catch (exception& e) {
+    cerr << "Exception: " << e.what() << '\n';
+}
+catch (...) {
+    cerr << "Exception\n";
+}
@@ -0,0 +1,90 @@
+// Chapter 24, mixed precision benchmark: solve Ax==b for a random (and so
+// well conditioned) A by LU_factorization<double>, and by
+// mixed_precision_solve(), which factors A in float and refines the solution
+// with residuals in double. Last, a Hilbert matrix, too badly conditioned for
+// float, shows the fall back to a double factorization.
+//
+// Usage: chapter24_bench_refine [largest n]
+//
+// Build with optimisation, e.g.
+// g++ -std=c++11 -O3 -march=native -pthread chapter24_bench_refine.cpp
+
+#include<chrono>
+#include<cmath>
+#include<cstdlib>
+#include<iomanip>
+#include<iostream>
+#include "Matrix.h"
+#include "LU.h"
+
+using namespace std;
+using namespace Numeric_lib;
+
+//------------------------------------------------------------------------------
+
+double seconds_since(chrono::steady_clock::time_point t)
+{
+    return chrono::duration<double>(chrono::steady_clock::now()-t).count();
+}
+
+//------------------------------------------------------------------------------
+
+void report(Index n, double t1, double t2, const Refinement_result& r)
+{
+    cout << setw(6) << n << setw(10) << fixed << setprecision(4) << t1 << setw(10) << t2
+        << setw(9) << setprecision(2) << t1/t2 << setw(7) << r.iterations
+        << setw(12) << scientific << setprecision(2) << r.residual
+        << setw(10) << (r.fell_back ? "double" : "float") << '\n';
+}
+
+//------------------------------------------------------------------------------
+
+void run(const Matrix<double,2>& a)
+{
+    const Index n = a.dim1();
+    Matrix<double> b(n,uninitialized);
+    for (Index i = 0; i<n; ++i) b(i) = double(rand())/RAND_MAX;
+
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    LU_factorization<double> lu(a);
+    Matrix<double> x1 = lu.solve(b);
+    const double t1 = seconds_since(t);
+
+    Matrix<double> x2(n);
+    t = chrono::steady_clock::now();
+    Refinement_result r = mixed_precision_solve(a,b,x2);
+    const double t2 = seconds_since(t);
+
+    report(n,t1,t2,r);
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+try {
+    const Index max_n = argc>1 ? atol(argv[1]) : 2048;
+    cout << setw(6) << "n" << setw(10) << "double" << setw(10) << "mixed" << setw(9) << "speedup"
+        << setw(7) << "steps" << setw(12) << "residual" << setw(10) << "factors" << '\n';
+
+    for (Index n = 128; n<=max_n; n *= 2) {
+        Matrix<double,2> a(n,n,uninitialized);
+        for (Index i = 0; i<a.size(); ++i) a.data()[i] = double(rand())/RAND_MAX - 0.5;
+        run(a);
+    }
+
+    cout << "Hilbert matrix:\n";
+    const Index n = 10;
+    Matrix<double,2> h(n,n,uninitialized);
+    for (Index i = 0; i<n; ++i)
+        for (Index j = 0; j<n; ++j) h(i,j) = 1.0/(i+j+1);
+    run(h);
+}
+catch (Matrix_error& e) {
+    cerr << "Matrix error: " << e.name << '\n';
+}
+catch (exception& e) {
+    cerr << "Exception: " << e.what() << '\n';
+}
+catch (...) {
+    cerr << "Exception\n";
+}
@@ -0,0 +1,132 @@
+// Chapter 24, small matrix benchmark: solve a batch of random 3 by 3 and
+// 4 by 4 systems Ax==b, once the way exercise 5 does it, with a
+// Matrix<double,2> and a Matrix<double> for each system, and once with
+// Small_matrix, which needs no free store and has its loops unrolled.
+//
+// Usage: chapter24_bench_small [number of systems]
+//
+// Build with optimisation, e.g.
+// g++ -std=c++11 -O3 -march=native chapter24_bench_small.cpp
+
+#include<chrono>
+#include<cmath>
+#include<cstdlib>
+#include<iomanip>
+#include<iostream>
+#include<vector>
+#include "Matrix.h"
+#include "Small_matrix.h"
+
+using namespace std;
+using namespace Numeric_lib;
+
+//------------------------------------------------------------------------------
+
+// from exercise 5
+void elim_with_partial_pivot(Matrix<double,2>& A, Matrix<double>& b)
+{
+    const Index n = A.dim1();
+
+    for (Index j = 0; j<n; ++j) {
+        Index pivot_row = j;
+
+        for (Index k = j+1; k<n; ++k)
+            if (abs(A(k,j)) > abs(A(pivot_row,j))) pivot_row = k;
+
+        if (pivot_row != j) {
+            A.swap_rows(j,pivot_row);
+            swap(b(j),b(pivot_row));
+        }
+
+        for (Index i = j+1; i<n; ++i) {
+            const double pivot = A(j,j);
+            if (pivot==0) error("can't solve: pivot==0");
+            const double mult = A(i,j) / pivot;
+            A[i].slice(j) = scale_and_add(A[j].slice(j),-mult,A[i].slice(j));
+            b(i) -= mult * b(j);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+Matrix<double> back_substitution(const Matrix<double,2>& A, const Matrix<double>& b)
+{
+    const Index n = A.dim1();
+    Matrix<double> x(n);
+
+    for (Index i = n-1; i>=0; --i) {
+        double s = b(i) - dot_product(A[i].slice(i+1),x.slice(i+1));
+        if (double m = A(i,i))
+            x(i) = s / m;
+        else
+            error("back substitution failure");
+    }
+    return x;
+}
+
+//------------------------------------------------------------------------------
+
+double seconds_since(chrono::steady_clock::time_point t)
+{
+    return chrono::duration<double>(chrono::steady_clock::now()-t).count();
+}
+
+//------------------------------------------------------------------------------
+
+template<int N> void run(Index count)
+{
+    // the systems, N*N elements of A then N of b for each
+    vector<double> data(count*(N*N+N));
+    for (size_t i = 0; i<data.size(); ++i)
+        data[i] = double(rand())/RAND_MAX - 0.5;
+
+    double check1 = 0;
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    for (Index s = 0; s<count; ++s) {
+        const double* p = &data[s*(N*N+N)];
+        Matrix<double,2> A(N,N);
+        Matrix<double> b(N);
+        for (Index i = 0; i<N*N; ++i) A.data()[i] = p[i];
+        for (Index i = 0; i<N; ++i) b(i) = p[N*N+i];
+        elim_with_partial_pivot(A,b);
+        check1 += back_substitution(A,b)(0);
+    }
+    const double t1 = seconds_since(t);
+
+    double check2 = 0;
+    t = chrono::steady_clock::now();
+    for (Index s = 0; s<count; ++s) {
+        const double* p = &data[s*(N*N+N)];
+        Small_matrix<double,N,N> A(uninitialized);
+        Small_matrix<double,N,1> b(uninitialized);
+        for (Index i = 0; i<N*N; ++i) A.data()[i] = p[i];
+        for (Index i = 0; i<N; ++i) b.data()[i] = p[N*N+i];
+        check2 += solve(A,b).data()[0];
+    }
+    const double t2 = seconds_since(t);
+
+    if (abs(check1-check2) > 1e-6*abs(check1)) error("results differ");
+    cout << N << " by " << N << ": " << setw(12) << fixed << setprecision(4) << t1 << setw(12) << t2
+        << setw(10) << setprecision(1) << t1/t2 << '\n';
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+try {
+    const Index count = argc>1 ? atol(argv[1]) : 1000000;
+    cout << count << " systems, seconds\n"
+        << setw(8) << ' ' << setw(12) << "Matrix" << setw(12) << "Small" << setw(10) << "speedup" << '\n';
+    run<3>(count);
+    run<4>(count);
+}
+catch (Matrix_error& e) {
+    cerr << "Matrix error: " << e.name << '\n';
+}
+catch (exception& e) {
+    cerr << "Exception: " << e.what() << '\n';
+}
+catch (...) {
+    cerr << "Exception\n";
+}
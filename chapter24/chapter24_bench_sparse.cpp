@@ -0,0 +1,115 @@
+// Chapter 24, sparse matrix benchmark: the 5-point finite difference
+// Laplacian on a k by k grid (n = k*k unknowns, about 5n nonzeros), solved
+// by conjugate gradients without a preconditioner, with the Jacobi
+// preconditioner and with the incomplete LU (ILU0) preconditioner. A dense
+// Matrix<double,2> of the same system would take 8*n*n bytes.
+//
+// Usage: chapter24_bench_sparse [k]
+//
+// Build with optimisation, e.g.
+// g++ -std=c++11 -O3 -march=native -pthread chapter24_bench_sparse.cpp
+
+#include<chrono>
+#include<cmath>
+#include<cstdlib>
+#include<iomanip>
+#include<iostream>
+#include "Matrix.h"
+#include "Sparse.h"
+
+using namespace std;
+using namespace Numeric_lib;
+
+//------------------------------------------------------------------------------
+
+double seconds_since(chrono::steady_clock::time_point t)
+{
+    return chrono::duration<double>(chrono::steady_clock::now()-t).count();
+}
+
+//------------------------------------------------------------------------------
+
+Sparse_matrix<double> laplacian(Index k)
+    // -u'' on a k by k grid with zero boundary values
+{
+    Coo_builder<double> b(k*k,k*k);
+    b.reserve(5*k*k);
+    for (Index i = 0; i<k; ++i)
+        for (Index j = 0; j<k; ++j) {
+            const Index r = i*k+j;
+            b.add(r,r,4);
+            if (i>0) b.add(r,r-k,-1);
+            if (i<k-1) b.add(r,r+k,-1);
+            if (j>0) b.add(r,r-1,-1);
+            if (j<k-1) b.add(r,r+1,-1);
+        }
+    return Sparse_matrix<double>(b);
+}
+
+//------------------------------------------------------------------------------
+
+// largest |Ax-b|
+double residual(const Sparse_matrix<double>& a, const Matrix<double>& x, const Matrix<double>& b)
+{
+    Matrix<double> r = a*x;
+    double m = 0;
+    for (Index i = 0; i<r.size(); ++i)
+        m = max(m,abs(r(i)-b(i)));
+    return m;
+}
+
+//------------------------------------------------------------------------------
+
+template<class P> void solve(const char* name, const Sparse_matrix<double>& a, const Matrix<double>& b, const P& precond)
+{
+    Matrix<double> x(b.size());
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    Cg_result<double> r = conjugate_gradient(a,b,x,precond,1e-8);
+    const double sec = seconds_since(t);
+    cout << setw(10) << name << setw(8) << r.iterations << setw(12) << setprecision(4) << fixed << sec
+        << setw(14) << scientific << setprecision(2) << residual(a,x,b) << (r.converged ? "" : "  (not converged)") << '\n';
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+try {
+    const Index k = argc>1 ? atol(argv[1]) : 300;
+    const Index n = k*k;
+
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    const Sparse_matrix<double> a = laplacian(k);
+    cout << "n = " << n << ", " << a.nonzeros() << " nonzeros, assembled in "
+        << fixed << setprecision(4) << seconds_since(t) << " s ("
+        << setprecision(1) << 8.0*n*n/1e9 << " GB as a dense matrix)\n";
+
+    Matrix<double> x(n);
+    for (Index i = 0; i<n; ++i) x(i) = double(rand())/RAND_MAX;
+    Matrix<double> y(n);
+    const int reps = 50;
+    t = chrono::steady_clock::now();
+    for (int i = 0; i<reps; ++i) a.multiply(x.data(),y.data());
+    const double spmv = seconds_since(t)/reps;
+    cout << "SpMV: " << setprecision(6) << spmv << " s, "
+        << setprecision(2) << 2.0*a.nonzeros()/spmv*1e-9 << " GFLOP/s on "
+        << default_thread_pool().size()+1 << " threads\n\n";
+
+    const Matrix<double> b = a*x;
+    cout << setw(10) << "precond" << setw(8) << "iter" << setw(12) << "seconds" << setw(14) << "max |Ax-b|" << '\n';
+    solve("none",a,b,Identity_preconditioner<double>());
+    solve("Jacobi",a,b,Jacobi_preconditioner<double>(a));
+    t = chrono::steady_clock::now();
+    Ilu0_preconditioner<double> ilu(a);
+    const double t_ilu = seconds_since(t);
+    solve("ILU0",a,b,ilu);
+    cout << "\n(the ILU0 factorization took another " << fixed << setprecision(4) << t_ilu << " s)\n";
+}
+catch (Matrix_error& e) {
+    cerr << "Matrix error: " << e.name << '\n';
+}
+catch (exception& e) {
+    cerr << "Exception: " << e.what() << '\n';
+}
+catch (...) {
+    cerr << "Exception\n";
+}
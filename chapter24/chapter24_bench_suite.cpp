@@ -0,0 +1,241 @@
+// Chapter 24, Numeric_lib benchmark suite: the operations of Matrix.h that
+// the exercises of chapters 24 and 26 time by hand with clock(), each over a
+// sweep of sizes whose working sets go from well inside the L1 cache out to
+// main memory:
+//
+//     dot          dot_product(x,y)
+//     saxpy        y = scale_and_add(x,a,y)
+//     apply        x.apply(f), serial and with par
+//     row_slice    dot_product(a[i].slice(j),x.slice(j)) for every row, as in back substitution
+//     column       dot_product(a.column(j),x) for every column: a strided view
+//     matvec       a*x
+//     gemm         a*b
+//     elim         classical_elimination() and elim_with_partial_pivot() of
+//                  exercise 4, and LU_factorization
+//
+// Every measurement is repeated; the output is one comma-separated line per
+// kernel and size (lines starting with # are comments), so that runs can be
+// kept and compared to catch regressions:
+//
+//     kernel,n,working_set_bytes,iterations,repetitions,median_s,min_s,max_s,spread,gflops,gbytes_per_s
+//
+// n is the vector length or the matrix dimension; the times are per
+// iteration; spread is (max-min)/median; gflops and gbytes_per_s are for the
+// median time, counting the floating-point operations the algorithm needs and
+// the bytes it must move at least once (a kernel whose working set fits in a
+// cache can show more than the memory bandwidth).
+//
+// Usage: chapter24_bench_suite [repetitions [largest working set in MB]]
+//
+// Build with optimisation, e.g.
+// g++ -std=c++11 -O3 -march=native -pthread chapter24_bench_suite.cpp
+
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<cstdlib>
+#include<iostream>
+#include<string>
+#include<vector>
+#include "Matrix.h"
+#include "LU.h"
+
+using namespace std;
+using namespace Numeric_lib;
+
+//------------------------------------------------------------------------------
+
+double seconds_since(chrono::steady_clock::time_point t)
+{
+    return chrono::duration<double>(chrono::steady_clock::now()-t).count();
+}
+
+//------------------------------------------------------------------------------
+
+volatile double sink;    // results go here, so that no kernel is optimised away
+
+int repetitions = 7;
+double max_bytes = 256e6;
+const double min_rep_time = 0.02;    // seconds: shorter kernels are run several times per repetition
+
+//------------------------------------------------------------------------------
+
+template<class F> void measure(const string& kernel, Index n, double bytes, double flops, F f)
+    // time f() and write one line of results; each repetition runs f() often
+    // enough to last min_rep_time, the iteration count found by a first run
+{
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    f();    // also warms up the caches and the thread pool
+    const double first = seconds_since(t);
+    const long iter = max(1L,long(min_rep_time/max(first,1e-9)));
+
+    vector<double> times;
+    for (int r = 0; r<repetitions; ++r) {
+        t = chrono::steady_clock::now();
+        for (long i = 0; i<iter; ++i) f();
+        times.push_back(seconds_since(t)/iter);
+    }
+    sort(times.begin(),times.end());
+    const double median = times[times.size()/2];
+    const double lo = times.front();
+    const double hi = times.back();
+
+    cout << kernel << ',' << n << ',' << (long long)bytes << ',' << iter << ',' << repetitions << ','
+        << median << ',' << lo << ',' << hi << ',' << (hi-lo)/median << ','
+        << flops/median/1e9 << ',' << bytes/median/1e9 << endl;
+}
+
+//------------------------------------------------------------------------------
+
+Matrix<double> random_vector(Index n)
+{
+    Matrix<double> v(n,uninitialized);
+    for (Index i = 0; i<n; ++i) v(i) = double(rand())/RAND_MAX;
+    return v;
+}
+
+Matrix<double,2> random_matrix(Index n)
+{
+    Matrix<double,2> m(n,n,uninitialized);
+    for (Index i = 0; i<m.size(); ++i) m.data()[i] = double(rand())/RAND_MAX;
+    return m;
+}
+
+Matrix<double,2> diagonally_dominant(Index n)
+    // random, but safe to eliminate without pivoting
+{
+    Matrix<double,2> m = random_matrix(n);
+    for (Index i = 0; i<n; ++i) m(i,i) += n;
+    return m;
+}
+
+//------------------------------------------------------------------------------
+
+// from exercise 4, with the pivot test of exercise 5
+void classical_elimination(Matrix<double,2>& A, Matrix<double>& b)
+{
+    const Index n = A.dim1();
+
+    for (Index j = 0; j<n-1; ++j) {
+        const double pivot = A(j,j);
+        if (pivot==0) error("can't solve: pivot==0");
+        for (Index i = j+1; i<n; ++i) {
+            const double mult = A(i,j) / pivot;
+            A[i].slice(j) = scale_and_add(A[j].slice(j),-mult,A[i].slice(j));
+            b(i) -= mult * b(j);
+        }
+    }
+}
+
+void elim_with_partial_pivot(Matrix<double,2>& A, Matrix<double>& b)
+{
+    const Index n = A.dim1();
+
+    for (Index j = 0; j<n; ++j) {
+        Index pivot_row = j;
+        for (Index k = j+1; k<n; ++k)
+            if (abs(A(k,j)) > abs(A(pivot_row,j))) pivot_row = k;
+        if (pivot_row != j) {
+            A.swap_rows(j,pivot_row);
+            swap(b(j),b(pivot_row));
+        }
+        for (Index i = j+1; i<n; ++i) {
+            const double pivot = A(j,j);
+            if (pivot==0) error("can't solve: pivot==0");
+            const double mult = A(i,j) / pivot;
+            A[i].slice(j) = scale_and_add(A[j].slice(j),-mult,A[i].slice(j));
+            b(i) -= mult * b(j);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void scale(double& x) { x = x*0.999+0.001; }
+
+void vector_kernels()
+{
+    for (Index n = 256; 24.0*n<=max_bytes; n *= 4) {    // 4 KB to ... for two vectors
+        Matrix<double> x = random_vector(n);
+        Matrix<double> y = random_vector(n);
+
+        measure("dot",n,16.0*n,2.0*n,[&] { sink = dot_product(x,y); });
+        measure("saxpy",n,24.0*n,2.0*n,[&] { y = scale_and_add(x,1e-9,y); });
+        measure("apply",n,16.0*n,2.0*n,[&] { y.apply(scale); });
+        measure("apply_par",n,16.0*n,2.0*n,[&] { y.apply(par,scale); });
+        sink = y(n-1);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void matrix_vector_kernels()
+{
+    for (Index n = 32; 8.0*n*n<=max_bytes; n *= 2) {    // 8 KB to ...
+        Matrix<double,2> a = random_matrix(n);
+        Matrix<double> x = random_vector(n);
+        const double bytes = 8.0*n*n+16.0*n;
+
+        measure("row_slice",n,bytes,double(n)*n,[&] {    // the triangle above the diagonal
+            double s = 0;
+            for (Index i = 0; i<n; ++i) s += dot_product(a[i].slice(i),x.slice(i));
+            sink = s;
+        });
+        measure("column",n,bytes,2.0*n*n,[&] {
+            double s = 0;
+            for (Index j = 0; j<n; ++j) s += dot_product(a.column(j),x);
+            sink = s;
+        });
+        measure("matvec",n,bytes,2.0*n*n,[&] { sink = (a*x)(0); });
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void matrix_kernels()
+{
+    for (Index n = 32; 24.0*n*n<=max_bytes && n<=2048; n *= 2) {
+        Matrix<double,2> a = random_matrix(n);
+        Matrix<double,2> b = random_matrix(n);
+        measure("gemm",n,24.0*n*n,2.0*n*n*n,[&] { sink = (a*b)(0,0); });
+    }
+
+    // the elimination of exercise 4 is slow enough to stop at a smaller size
+    for (Index n = 32; 8.0*n*n<=max_bytes && n<=1024; n *= 2) {
+        const Matrix<double,2> a0 = diagonally_dominant(n);
+        const Matrix<double> b0 = random_vector(n);
+        Matrix<double,2> a = a0;
+        Matrix<double> b = b0;
+        const double bytes = 8.0*n*n+8.0*n;
+        const double flops = 2.0*n*n*n/3;
+
+        // each iteration starts from a fresh copy of the system, O(n^2) against O(n^3)
+        measure("elim_classical",n,bytes,flops,[&] { a = a0; b = b0; classical_elimination(a,b); sink = b(n-1); });
+        measure("elim_partial_pivot",n,bytes,flops,[&] { a = a0; b = b0; elim_with_partial_pivot(a,b); sink = b(n-1); });
+        measure("lu",n,bytes,flops,[&] { LU_factorization<double> lu(a0); sink = lu.factors()(n-1,n-1); });
+    }
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+try {
+    if (argc>1) repetitions = max(1,atoi(argv[1]));
+    if (argc>2) max_bytes = atof(argv[2])*1e6;
+
+    cout << "# Numeric_lib benchmark suite: " << default_thread_pool().size()+1 << " threads, "
+        << repetitions << " repetitions, working sets up to " << max_bytes/1e6 << " MB\n";
+    cout << "kernel,n,working_set_bytes,iterations,repetitions,median_s,min_s,max_s,spread,gflops,gbytes_per_s\n";
+    vector_kernels();
+    matrix_vector_kernels();
+    matrix_kernels();
+}
+catch (Matrix_error& e) {
+    cerr << "Matrix error: " << e.name << '\n';
+}
+catch (exception& e) {
+    cerr << "Exception: " << e.what() << '\n';
+}
+catch (...) {
+    cerr << "Exception\n";
+}
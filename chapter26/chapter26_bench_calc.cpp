@@ -0,0 +1,185 @@
+// Chapter 26, calculator throughput: how fast Calc_lib (chapter 16) turns a
+// file of statements, e.g. the corpus made by chapter26_calc_fuzz, into
+// Tokens and into results. Reports
+// - Tokens per second of the Token_stream alone,
+// - statements per second of Token_stream + expression() + run(), with the
+//   cache of compiled statements off, so that every statement is parsed,
+// - the allocations (operator new) per statement of that,
+// all as the best of a number of runs, each with a fresh Calculator.
+//
+// The other calculator variants (chapters 7, 8, 10 and 25) are programs
+// that read cin, not libraries; -x runs such a program with the corpus as
+// its input (and its output thrown away) and reports the same rates for the
+// whole program, so that a change to any of them shows up as a number:
+//
+//     chapter26_bench_calc pics_and_txt/chapter26_calc_corpus.txt
+//     chapter26_bench_calc -x ./chapter07_drill_and_ex pics_and_txt/chapter26_calc_corpus.txt
+//
+// Usage: chapter26_bench_calc [-r runs] [-x command] corpus
+//
+// Build with optimisation, e.g.
+// g++ -std=c++11 -O2 -pthread chapter26_bench_calc.cpp ../chapter16/chapter16_ex09_calc.cpp
+
+#include<chrono>
+#include<cstdio>
+#include<cstdlib>
+#include<new>
+#include "../chapter16/chapter16_ex09_calc.h"
+
+using namespace Calc_lib;
+
+typedef chrono::steady_clock Clock;
+
+//------------------------------------------------------------------------------
+
+// every allocation is counted
+long allocations = 0;
+
+void* operator new(size_t n)
+{
+    ++allocations;
+    if (void* p = malloc(n ? n : 1)) return p;
+    throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+//------------------------------------------------------------------------------
+
+double seconds_since(Clock::time_point t)
+{
+    return chrono::duration<double>(Clock::now()-t).count();
+}
+
+// a streambuf that forgets everything, so that writing results costs
+// formatting only
+class Null_buffer : public streambuf {
+protected:
+    int overflow(int c) { return c; }
+    streamsize xsputn(const char*, streamsize n) { return n; }
+};
+
+//------------------------------------------------------------------------------
+
+// the statements of [b:e), as run_script() finds them
+struct Statement {
+    const char* b;
+    const char* e;
+    int line;
+};
+
+vector<Statement> split(const char* b, const char* e)
+{
+    vector<Statement> v;
+    int line = 1;
+    while (b < e) {
+        const char* q = b;
+        while (q<e && *q!=';' && *q!='\n') ++q;
+        const char* s = b;
+        while (s<q && isspace(*s)) ++s;
+        if (s < q) {
+            Statement st = { b, q, line };
+            v.push_back(st);
+        }
+        if (q<e && *q=='\n') ++line;
+        b = q+1;
+    }
+    return v;
+}
+
+// read all Tokens of the statements; a bad Token ends its statement
+// returns the number of Tokens read
+long tokenize(const vector<Statement>& v, Symbol_table& st)
+{
+    long n = 0;
+    for (size_t i = 0; i<v.size(); ++i) {
+        Token_stream ts(v[i].b,v[i].e,st,v[i].line);
+        try {
+            while (ts.get().kind != print) ++n;
+        }
+        catch (exception&) {
+            // the bad Token is not counted
+        }
+    }
+    return n;
+}
+
+//------------------------------------------------------------------------------
+
+// the rates of the whole program command with the corpus as its input
+void bench_command(const string& command, const Script_file& corpus, long statements, long tokens, int runs)
+{
+    const string cmd = command + " >/dev/null 2>&1";
+    double best = 1e300;
+    for (int r = 0; r<runs; ++r) {
+        const Clock::time_point t = Clock::now();
+        FILE* p = popen(cmd.c_str(),"w");
+        if (!p) error("cannot run ",command);
+        fwrite(corpus.begin(),1,corpus.size(),p);
+        if (pclose(p) == -1) error("cannot wait for ",command);
+        best = min(best,seconds_since(t));
+    }
+    cout << command << ": " << statements/best << " statements/s, "
+        << tokens/best/1e6 << " M Tokens/s (" << best << " s, the program's start included)\n";
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+try {
+    int runs = 5;
+    string command;
+    int i = 1;
+    for (; i+1<argc && argv[i][0]=='-'; i += 2) {
+        const string a = argv[i];
+        if (a == "-r") runs = max(1,atoi(argv[i+1]));
+        else if (a == "-x") command = argv[i+1];
+        else error("unknown option ",a);
+    }
+    if (i+1 != argc) error("usage: chapter26_bench_calc [-r runs] [-x command] corpus");
+    Script_file corpus(argv[i]);
+    const vector<Statement> statements = split(corpus.begin(),corpus.end());
+    if (statements.empty()) error("no statements in ",argv[i]);
+    const long n = statements.size();
+
+    double t_tokens = 1e300;
+    long tokens = 0;
+    for (int r = 0; r<runs; ++r) {
+        Symbol_table st;
+        const Clock::time_point t = Clock::now();
+        tokens = tokenize(statements,st);
+        t_tokens = min(t_tokens,seconds_since(t));
+    }
+
+    if (!command.empty()) {
+        bench_command(command,corpus,n,tokens,runs);
+        return 0;
+    }
+
+    Null_buffer nb;
+    ostream null(&nb);
+    double t_run = 1e300;
+    long allocs = 0;
+    for (int r = 0; r<runs; ++r) {
+        Calculator calc;
+        calc.set_cache_limit(0);    // parse every statement
+        const long a = allocations;
+        const Clock::time_point t = Clock::now();
+        calc.run_script(corpus.begin(),corpus.end(),null);
+        t_run = min(t_run,seconds_since(t));
+        allocs = allocations-a;
+    }
+
+    cout << n << " statements, " << tokens << " Tokens, " << corpus.size() << " bytes\n"
+        << "Token_stream:       " << tokens/t_tokens/1e6 << " M Tokens/s\n"
+        << "parse and run:      " << n/t_run/1e6 << " M statements/s, "
+        << tokens/t_run/1e6 << " M Tokens/s\n"
+        << "allocations:        " << double(allocs)/n << " per statement\n";
+}
+catch (exception& e) {
+    cerr << "exception: " << e.what() << '\n';
+    return 1;
+}
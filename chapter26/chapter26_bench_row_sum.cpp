@@ -0,0 +1,111 @@
+// Chapter 26, range checking benchmark: the "dumb" row sum workload from
+// exercise 11, run with each of the range checking policies of Matrix:
+// Checked (every subscript, as before), Debug_sampled (only when a row is
+// taken out of the Matrix) and Unchecked.
+//
+// Usage: chapter26_bench_row_sum [n1 n2 ...]
+//
+// Build with optimisation, e.g. (from the top directory)
+// g++ -std=c++11 -O3 -march=native -I. chapter26/chapter26_bench_row_sum.cpp
+
+#include<chrono>
+#include<cstdlib>
+#include<iomanip>
+#include<iostream>
+#include<vector>
+
+#include "chapter24/Matrix.h"
+
+using namespace std;
+using namespace Numeric_lib;
+
+//------------------------------------------------------------------------------
+
+// sum of elements in m[n], subscripting m directly
+template<class C> double row_sum(const Matrix<double,2,C>& m, int n)
+{
+    double sum = 0;
+    for (Index i = 0; i<m.dim2(); ++i)
+        sum += m(n,i);
+    return sum;
+}
+
+//------------------------------------------------------------------------------
+
+// sum of elements in m[n], through the row
+template<class C> double row_sum_by_row(const Matrix<double,2,C>& m, int n)
+{
+    const Row<double,1,C> r = m[n];
+    double sum = 0;
+    for (Index i = 0; i<r.dim1(); ++i)
+        sum += r(i);
+    return sum;
+}
+
+//------------------------------------------------------------------------------
+
+// sum of elements in m[0:n)
+template<class C> double row_accum(const Matrix<double,2,C>& m, int n, bool by_row)
+{
+    double s = 0;
+    for (Index i = 0; i<n; ++i)
+        s += by_row ? row_sum_by_row(m,i) : row_sum(m,i);
+    return s;
+}
+
+//------------------------------------------------------------------------------
+
+// time the dumb method of exercise 11 on m
+template<class C> double time_row_accum(const Matrix<double,2,C>& m, bool by_row, double& check)
+{
+    chrono::steady_clock::time_point t = chrono::steady_clock::now();
+    vector<double> v;
+    for (Index idx = 0; idx<m.dim1(); ++idx)
+        v.push_back(row_accum(m,idx+1,by_row));
+    check = v.back();
+    return chrono::duration<double>(chrono::steady_clock::now()-t).count();
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+try {
+    vector<Index> dims;
+    for (int i = 1; i<argc; ++i) dims.push_back(atol(argv[i]));
+    if (dims.empty()) {
+        Index d[] = { 100, 200, 400, 800, 1600 };
+        dims.assign(d,d+sizeof(d)/sizeof(*d));
+    }
+
+    for (int by_row = 0; by_row<2; ++by_row) {
+        cout << (by_row ? "\nrow_sum() through m[n] (seconds)\n" : "row_sum() with m(n,i) (seconds)\n")
+            << setw(8) << "size" << setw(12) << "Checked" << setw(15) << "Debug_sampled"
+            << setw(12) << "Unchecked" << setw(10) << "speedup" << '\n';
+        for (size_t i = 0; i<dims.size(); ++i) {
+            Matrix<double,2> m(dims[i],dims[i]);
+            for (Index j = 0; j<m.size(); ++j)
+                m.data()[j] = rand()%20 - 10;
+            const Matrix<double,2,Debug_sampled> md = m.expr();
+            const Matrix<double,2,Unchecked> mu = m.expr();
+
+            double s1, s2, s3;
+            const double t1 = time_row_accum(m,by_row!=0,s1);
+            const double t2 = time_row_accum(md,by_row!=0,s2);
+            const double t3 = time_row_accum(mu,by_row!=0,s3);
+            if (s1!=s2 || s1!=s3) error("results differ");
+            cout << setw(8) << dims[i] << fixed << setprecision(4) << setw(12) << t1
+                << setw(15) << t2 << setw(12) << t3 << setprecision(2) << setw(10) << t1/t3 << '\n';
+        }
+    }
+}
+catch (Matrix_error& e) {
+    cerr << "Matrix error: " << e.name << '\n';
+}
+catch (exception& e) {
+    cerr << e.what() << endl;
+}
+catch (...) {
+    cerr << "exception \n";
+}
+
+//------------------------------------------------------------------------------
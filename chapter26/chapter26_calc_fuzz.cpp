@@ -0,0 +1,213 @@
+// Chapter 26, random statements for the calculators: a generator that
+// follows the calculator grammar, for testing and timing (see
+// chapter26_bench_calc.cpp). It keeps to what all the calculator variants
+// (chapters 7, 8, 10, 16 and 25) understand: numbers, + - * / %, parentheses,
+// unary + and -, "let", the constants pi and e and the variables v0, v1, ...
+// which are declared by the first statements. Expressions nest up to depth
+// deep; a given percentage of the statements has an error put into it: an
+// undefined variable, a division by 0, a missing ')' or a bad character.
+// The same seed gives the same statements, one per line, each ended by ';'.
+//
+// Usage: chapter26_calc_fuzz [-n statements] [-d depth] [-v variables]
+//                            [-e error percentage] [-s seed] [-f] [output]
+// -f adds sqrt(), pow() and assignments, which the simplest variants lack.
+// pics_and_txt/chapter26_calc_corpus.txt was made with the defaults.
+//
+// Build with e.g.
+// g++ -std=c++11 -O2 chapter26_calc_fuzz.cpp
+
+#include<cstdlib>
+#include<fstream>
+#include<iostream>
+#include<random>
+#include<sstream>
+#include<string>
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+struct Fuzz_options {
+    long statements;
+    int depth;          // how deep expressions nest at most
+    int variables;      // v0 ... v(variables-1)
+    int error_percent;  // statements with an error in them
+    unsigned seed;
+    bool features;      // sqrt(), pow() and assignments
+    Fuzz_options() :statements(2000), depth(4), variables(8), error_percent(5), seed(26), features(false) { }
+};
+
+//------------------------------------------------------------------------------
+
+class Statement_generator {
+public:
+    explicit Statement_generator(const Fuzz_options& o) :opt(o), rng(o.seed), declared(0) { }
+    string next();      // the next statement, without ';'
+private:
+    Fuzz_options opt;
+    mt19937 rng;
+    int declared;       // variables declared so far
+
+    int pick(int n) { return uniform_int_distribution<int>(0,n-1)(rng); }
+    bool chance(int percent) { return pick(100) < percent; }
+    void number(ostream& os);
+    void divisor(ostream& os);
+    void primary(ostream& os, int depth);
+    void term(ostream& os, int depth);
+    void expression(ostream& os, int depth);
+    string inject_error(string s);
+};
+
+// a floating-point-literal: an integer or a number with a fraction
+void Statement_generator::number(ostream& os)
+{
+    switch (pick(4)) {
+    case 0:  os << pick(10); break;
+    case 1:  os << pick(1000); break;
+    case 2:  os << pick(100) << '.' << pick(100); break;
+    default: os << '.' << 1+pick(99); break;
+    }
+}
+
+// something that is never 0, so that only injected errors divide by 0
+void Statement_generator::divisor(ostream& os)
+{
+    switch (pick(3)) {
+    case 0:  os << 1+pick(99); break;
+    case 1:  os << (pick(2) ? "pi" : "e"); break;
+    default: os << 1+pick(9) << '.' << pick(10); break;
+    }
+}
+
+void Statement_generator::primary(ostream& os, int depth)
+{
+    const int choices = opt.features ? 7 : 5;
+    const int c = depth<=0 ? pick(2) : pick(choices);
+    switch (c) {
+    case 0:
+        number(os);
+        break;
+    case 1:
+        if (declared) os << 'v' << pick(declared);
+        else number(os);
+        break;
+    case 2:
+        os << '(';
+        expression(os,depth-1);
+        os << ')';
+        break;
+    case 3:
+        os << (pick(2) ? '-' : '+');
+        primary(os,depth-1);
+        break;
+    case 4:     // % wants integers
+        os << '(' << pick(1000) << '%' << 1+pick(20) << ')';
+        break;
+    case 5:     // the argument may be negative: an error in every variant
+        os << "sqrt(";
+        expression(os,depth-1);
+        os << ')';
+        break;
+    default:
+        os << "pow(";
+        expression(os,depth-1);
+        os << ',' << pick(4) << ')';
+        break;
+    }
+}
+
+void Statement_generator::term(ostream& os, int depth)
+{
+    primary(os,depth);
+    for (int n = pick(2); n>0; --n) {
+        if (pick(2)) {
+            os << '*';
+            primary(os,depth);
+        }
+        else {
+            os << '/';
+            divisor(os);
+        }
+    }
+}
+
+void Statement_generator::expression(ostream& os, int depth)
+{
+    term(os,depth);
+    for (int n = pick(3); n>0; --n) {
+        os << (pick(2) ? '+' : '-');
+        term(os,depth);
+    }
+}
+
+// spoil a correct statement
+string Statement_generator::inject_error(string s)
+{
+    switch (pick(4)) {
+    case 0:     // a name that was never declared
+        return s + "+undeclared" + to_string(pick(10));
+    case 1:
+        return s + "/0";
+    case 2:
+        return "(" + s;
+    default:    // a character no variant has a Token for
+    {   const char bad[] = "#$@&?";
+        s.insert(pick(s.size()+1),1,bad[pick(5)]);
+        return s;
+    }
+    }
+}
+
+string Statement_generator::next()
+{
+    ostringstream os;
+    if (declared < opt.variables) {     // the variables first, to have something to use
+        os << "let v" << declared << " = ";
+        expression(os,opt.depth);
+        ++declared;
+        return os.str();    // no errors put here, or later statements would fail as well
+    }
+    if (opt.features && declared && chance(10)) os << 'v' << pick(declared) << " = ";
+    expression(os,opt.depth);
+    if (chance(opt.error_percent)) return inject_error(os.str());
+    return os.str();
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+try {
+    Fuzz_options opt;
+    int i = 1;
+    for (; i<argc && argv[i][0]=='-' && argv[i][1]; ++i) {
+        const string a = argv[i];
+        if (a == "-f") {
+            opt.features = true;
+            continue;
+        }
+        if (i+1 == argc) throw runtime_error("value missing for "+a);
+        const long v = atol(argv[++i]);
+        if (a == "-n") opt.statements = v;
+        else if (a == "-d") opt.depth = v;
+        else if (a == "-v") opt.variables = v;
+        else if (a == "-e") opt.error_percent = v;
+        else if (a == "-s") opt.seed = v;
+        else throw runtime_error("unknown option "+a);
+    }
+    if (opt.variables<0 || opt.depth<0) throw runtime_error("-v and -d must not be negative");
+
+    ofstream ofs;
+    if (i < argc) {
+        ofs.open(argv[i]);
+        if (!ofs) throw runtime_error(string("cannot open output file ")+argv[i]);
+    }
+    ostream& os = i<argc ? ofs : cout;
+
+    Statement_generator gen(opt);
+    for (long n = 0; n<opt.statements; ++n)
+        os << gen.next() << ";\n";
+}
+catch (exception& e) {
+    cerr << "exception: " << e.what() << '\n';
+    return 1;
+}
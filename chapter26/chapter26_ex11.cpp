@@ -10,6 +10,7 @@
 // Also worth to mention: the version in the book passes the matrices by value,
 // leading to a lot of copies and unusably slow performance
 
+#include<cmath>
 #include<ctime>
 #include<iostream>
 #include<exception>
@@ -18,18 +19,14 @@
 
 #include "chapter24/Matrix.h"
 #include "chapter24/MatrixIO.h"
+#include "chapter24/Integral_matrix.h"
+#include "chapter24/Random.h"
 
 using namespace std;
 using namespace Numeric_lib;
 
 //------------------------------------------------------------------------------
 
-inline int randint(int max) { return rand()%max; }
-
-inline int randint(int min, int max) { return randint(max-min)+min; }
-
-//------------------------------------------------------------------------------
-
 // sum of elements in m[n]
 double row_sum(const Matrix<double,2>& m, int n)
 {
@@ -52,13 +49,12 @@ double row_accum(const Matrix<double,2>& m, int n)
 
 //------------------------------------------------------------------------------
 
-// creates random nxn-matrix with elements in range [-10:10)
+// creates random nxn-matrix with integer elements in range [-10:10), in parallel
 Matrix<double,2> random_matrix(int n)
 {
-    Matrix<double,2> m(n,n);
-    for (Index i = 0; i<m.dim1(); ++i)
-        for (Index j = 0; j<m.dim2(); ++j)
-            m(i,j) = randint(-10,10);
+    Matrix<double,2> m(n,n,uninitialized);    // every element is set below
+    fill_uniform(par,m,-10.0,10.0,time(0));
+    m.apply(par,[](double& x) { x = floor(x); });  // integers, as randint(-10,10) gave
     return m;
 }
 
@@ -66,7 +62,6 @@ Matrix<double,2> random_matrix(int n)
 
 int main()
 try {
-    srand(time(0));
     vector<int> dims = {100, 200, 400, 800, 1600, 3200};
 
     cout << "With the dumb method:\n";
@@ -109,6 +104,24 @@ try {
             << double(t2-t1)/CLOCKS_PER_SEC << " seconds\n";
     }
 
+    cout << "\nWith a summed-area table:\n";
+    // also linear, and afterwards any rectangle of m can be summed in O(1)
+    for (int i = 0; i<dims.size(); ++i) {
+        clock_t t1 = clock();
+        if (t1 == clock_t(-1))
+            throw exception("sorry, no clock");
+        Matrix<double,2> m = random_matrix(dims[i]);
+        Integral_matrix<double> im(m);
+        vector<double> v;
+        for (Index idx = 0; idx<m.dim1(); ++idx)
+            v.push_back(im.row_prefix(idx+1));
+        clock_t t2 = clock();
+        if (t2 == clock_t(-1))
+            throw exception("sorry, clock overflow");
+        cout << "Size " << setw(8) << dims[i] << ": "
+            << double(t2-t1)/CLOCKS_PER_SEC << " seconds\n";
+    }
+
 }
 catch (exception& e) {
     cerr << e.what() << endl;
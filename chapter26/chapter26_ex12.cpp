@@ -17,18 +17,21 @@
 #include<string>
 #include<set>
 
+#include "chapter24/Random.h"
+
 using namespace std;
 
 //------------------------------------------------------------------------------
 
-inline int randint(int max) { return rand()%max; }
+Numeric_lib::Xoshiro256 gen(time(0));
+
+inline int randint(int max) { return int(Numeric_lib::randint(gen,max)); }
 
 //------------------------------------------------------------------------------
 
 inline double drand(double min, double max)
 {
-    double d = double(rand()) / RAND_MAX;
-    return min + d * (max-min);
+    return min + Numeric_lib::uniform01(gen) * (max-min);
 }
 
 //------------------------------------------------------------------------------
@@ -46,7 +49,6 @@ string rand_string()
 
 int main()
 try {
-    srand(time(0));
     vector<int> sizes = {500000, 5000000};
 
     // use vector<double>
@@ -1420,10 +1420,41 @@ Function::Function(Fct f, double r1, double r2, Point xy,
 
 //------------------------------------------------------------------------------
 
+vector<double> graph_arguments(double r1, double r2, int count)
+// the same arguments as Function uses for an Fct
+{
+    vector<double> x(count);
+    double dist = (r2-r1)/count;
+    double r = r1;
+    for (int i = 0; i<count; ++i) {
+        x[i] = r;
+        r += dist;
+    }
+    return x;
+}
+
+//------------------------------------------------------------------------------
+
+Function::Function(const Column_fct& f, double r1, double r2, Point xy,
+                   int count, double xscale, double yscale)
+// graph f for x in [r1:r2) as above, with f computing all count values at once
+{
+    if (r2-r1<=0) error("bad graphing range");
+    if (count <=0) error("non-positive graphing count");
+    vector<double> x = graph_arguments(r1,r2,count);
+    vector<double> y;
+    f(x,y);
+    if (int(y.size()) != count) error("column function gave the wrong number of values");
+    for (int i = 0; i<count; ++i)
+        add(Point(xy.x+int(x[i]*xscale),xy.y-int(y[i]*yscale)));
+}
+
+//------------------------------------------------------------------------------
+
 Flex_function::Flex_function(Fct f, double r1, double r2, Point xy,int count,
                              double xscale, double yscale, double precision)
     :Function(f,r1,r2,xy,count,xscale,yscale),
-     fct(f), range1(r1), range2(r2), origin(xy),
+     fct(f), cfct(0), range1(r1), range2(r2), origin(xy),
      c(count), xsc(xscale), ysc(yscale), prec(precision)
 {
     reset();
@@ -1466,9 +1497,19 @@ void Flex_function::reset_yscale(double yscale) {
 
 void Flex_function::reset()
 {
+    clear_points();
+    if (cfct) {     // all values at once
+        vector<double> x = graph_arguments(range1,range2,c);
+        vector<double> y;
+        (*cfct)(x,y);
+        if (int(y.size()) != c) error("column function gave the wrong number of values");
+        for (int i = 0; i<c; ++i)
+            add(Point(origin.x+int(int(x[i]*xsc)/prec)*prec,
+                origin.y-int(int(y[i]*ysc)/prec)*prec));
+        return;
+    }
     double dist = (range2-range1)/c;
     double r = range1;
-    clear_points();
     for (int i = 0; i<c; ++i) {
         add(Point(origin.x+int(int(r*xsc)/prec)*prec,
             origin.y-int(int(fct(r)*ysc)/prec)*prec));
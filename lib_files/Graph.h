@@ -173,6 +173,13 @@ private:	// prevent copying
 
 typedef double Fct(double);
 
+// a function computed for many arguments at once: y[i] is f(x[i])
+// e.g. a calculator expression, see Calc_function in Simple_window.h
+struct Column_fct {
+    virtual void operator()(const vector<double>& x, vector<double>& y) const = 0;
+    virtual ~Column_fct() { }
+};
+
 class Shape  {        // deals with color and style, and holds sequence of lines
 public:
     void draw() const;                 // deal with color and draw lines
@@ -234,15 +241,21 @@ struct Function : Shape {
     // the function parameters are not stored
     Function(Fct f, double r1, double r2, Point orig,
              int count = 100, double xscale = 25, double yscale = 25);
+    Function(const Column_fct& f, double r1, double r2, Point orig,
+             int count = 100, double xscale = 25, double yscale = 25);
 };
 
+// the count arguments [r1:r2) is divided into for graphing
+vector<double> graph_arguments(double r1, double r2, int count);
+
 //------------------------------------------------------------------------------
 
 // stores function parameters
 struct Flex_function : Function {
     Flex_function(Fct f, double r1, double r2, Point orig, int count = 100,
                   double xscale = 25, double yscale = 25, double precision = 1);
-    void reset_fct(Fct f) { fct = f; reset(); }
+    void reset_fct(Fct f) { fct = f; cfct = 0; reset(); }
+    void reset_fct(const Column_fct& f) { cfct = &f; reset(); }   // f must outlive *this
     void reset_range(double r1, double r2);
     void reset_orig(Point orig) { origin = orig; reset(); }
     void reset_count(int count);
@@ -252,6 +265,7 @@ struct Flex_function : Function {
 private:
     void reset();
     Fct* fct;
+    const Column_fct* cfct; // used instead of fct if not 0
     double range1;
     double range2;
     Point origin;
@@ -212,6 +212,23 @@ private:
 
 //------------------------------------------------------------------------------
 
+// a calculator expression in one variable, for graphing with Function or
+// Flex_function: all points are computed with one calculate_column()
+struct Calc_function : Column_fct {
+    Calc_function(Calc_lib::Calculator& c, const string& e, const string& v = "x")
+        :calc(c), expr(e), var(v) { }
+    void operator()(const vector<double>& x, vector<double>& y) const
+    {
+        calc.calculate_column(expr,var,x,y);
+    }
+private:
+    Calc_lib::Calculator& calc;
+    string expr;
+    string var;
+};
+
+//------------------------------------------------------------------------------
+
 struct Calc_window : Quit_window {
     Calc_window(Point xy, int w, int h, const string& title);
 private: